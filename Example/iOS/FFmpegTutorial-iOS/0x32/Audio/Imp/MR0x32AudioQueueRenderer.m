@@ -16,6 +16,10 @@
 @interface MR0x32AudioQueueRenderer ()
 {
     AudioQueueBufferRef audioQueueBuffers[QUEUE_BUFFER_SIZE];
+    //已经入队的采样数，减去 AudioQueue 当前播放到的采样就是排在前面的数据
+    Float64 _enqueuedFrames;
+    //设备的输出延迟
+    double _outputLatency;
 }
 
 @property (nonatomic,copy) MRFetchPacketSample fetchBlock;
@@ -44,6 +48,7 @@
 - (void)setup:(int)sampleRate isFloatFmt:(BOOL)isFloat
 {
     // ----- Audio Queue Setup -----
+    _outputLatency = [[AVAudioSession sharedInstance] outputLatency];
     _outputFormat.mSampleRate = sampleRate;
     _outputFormat.mChannelsPerFrame = 2;
     _outputFormat.mFormatID = kAudioFormatLinearPCM;
@@ -85,11 +90,25 @@ static void MRAudioQueueOutputCallback(
     [am renderFramesToBuffer:inBuffer queue:inAQ];
 }
 
+//这次填充的数据要等排在前面的 buffer 都播完，再加上设备的输出延迟才能听到
+- (double)latencyOfNextBuffer:(AudioQueueRef)inAQ
+{
+    Float64 played = 0;
+    AudioTimeStamp ts = {0};
+    //开始播放之前取不到时间，入队的数据都排在前面
+    if (noErr == AudioQueueGetCurrentTime(inAQ, NULL, &ts, NULL) && (ts.mFlags & kAudioTimeStampSampleTimeValid)) {
+        played = ts.mSampleTime;
+    }
+    const Float64 ahead = MAX(_enqueuedFrames - played, 0);
+    return ahead / _outputFormat.mSampleRate + _outputLatency;
+}
+
 - (UInt32)renderFramesToBuffer:(AudioQueueBufferRef) inBuffer queue:(AudioQueueRef)inAQ
 {
     //1、填充数据
-    UInt32 gotBytes = [self fetchPacketSample:inBuffer->mAudioData wantBytes:inBuffer->mAudioDataBytesCapacity];
+    UInt32 gotBytes = [self fetchPacketSample:inBuffer->mAudioData wantBytes:inBuffer->mAudioDataBytesCapacity latency:[self latencyOfNextBuffer:inAQ]];
     inBuffer->mAudioDataByteSize = gotBytes;
+    _enqueuedFrames += gotBytes / _outputFormat.mBytesPerFrame;
     
     // 2、通知 AudioQueue 有可以播放的 buffer 了
     AudioQueueEnqueueBuffer(inAQ, inBuffer, 0, NULL);
@@ -98,10 +117,11 @@ static void MRAudioQueueOutputCallback(
 
 - (UInt32)fetchPacketSample:(uint8_t*)buffer
                   wantBytes:(UInt32)bufferSize
+                    latency:(double)latency
 {
     UInt32 filled = 0;
     if (self.fetchBlock) {
-        filled = self.fetchBlock(buffer,bufferSize);
+        filled = self.fetchBlock(buffer,bufferSize,latency);
     }
     return filled;
 }
@@ -113,6 +133,7 @@ static void MRAudioQueueOutputCallback(
 
 - (void)play
 {
+    _outputLatency = [[AVAudioSession sharedInstance] outputLatency];
     for(int i = 0; i < QUEUE_BUFFER_SIZE;i++){
         AudioQueueBufferRef ref = self->audioQueueBuffers[i];
         [self renderFramesToBuffer:ref queue:self.audioQueue];
@@ -10,6 +10,11 @@
 #import <AVFoundation/AVFoundation.h>
 
 @interface MR0x32AudioUnitRenderer ()
+{
+    //交给 AudioUnit 的数据还要多久才能播放出来：设备输出延迟加一个 IO 缓冲区的时长；
+    //AVAudioSession 不能在渲染线程里访问，在主线程更新
+    volatile double _outputLatency;
+}
 
 @property (nonatomic,copy) MRFetchPacketSample fetchPacketBlock;
 @property (nonatomic,copy) MRFetchPlanarSample fetchPlanarBlock;
@@ -24,6 +29,7 @@
 
 - (void)dealloc
 {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
     if(_audioUnit){
         AudioOutputUnitStop(_audioUnit);
         _audioUnit = NULL;
@@ -45,6 +51,9 @@
      isPacket:(BOOL)isPacket
 {
     self.isPacket = isPacket;
+    [self updateOutputLatency];
+    //耳机、蓝牙等输出设备切换后延迟会变
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(updateOutputLatency) name:AVAudioSessionRouteChangeNotification object:nil];
     
     // ----- Audio Unit Setup -----
 
@@ -128,6 +137,12 @@
 #undef kInputBus
 }
 
+- (void)updateOutputLatency
+{
+    AVAudioSession *session = [AVAudioSession sharedInstance];
+    _outputLatency = session.outputLatency + session.IOBufferDuration;
+}
+
 #pragma mark - 音频
 
 //音频渲染回调；
@@ -184,7 +199,7 @@ static inline OSStatus MRRenderCallback(void *inRefCon,
              */
             
             //3. 获取 bufferSize 个字节，并塞到 buffer 里；
-            [self fetchPacketSample:buffer wantBytes:bufferSize];
+            [self fetchPacketSample:buffer wantBytes:bufferSize latency:_outputLatency];
         } else {
             NSLog(@"what's wrong?");
         }
@@ -213,11 +228,11 @@ static inline OSStatus MRRenderCallback(void *inRefCon,
              同理，对于 S16P 也是如此！一一对应！
              */
             //3. 获取左右声道数据
-            [self fetchPlanarSample:ioData->mBuffers[0].mData leftSize:ioData->mBuffers[0].mDataByteSize right:ioData->mBuffers[1].mData rightSize:ioData->mBuffers[1].mDataByteSize];
+            [self fetchPlanarSample:ioData->mBuffers[0].mData leftSize:ioData->mBuffers[0].mDataByteSize right:ioData->mBuffers[1].mData rightSize:ioData->mBuffers[1].mDataByteSize latency:_outputLatency];
         }
         //when outputFormat.mChannelsPerFrame == 1;不会左右分开
         else {
-            [self fetchPlanarSample:ioData->mBuffers[0].mData leftSize:ioData->mBuffers[0].mDataByteSize right:NULL rightSize:0];
+            [self fetchPlanarSample:ioData->mBuffers[0].mData leftSize:ioData->mBuffers[0].mDataByteSize right:NULL rightSize:0 latency:_outputLatency];
         }
     }
     return noErr;
@@ -225,10 +240,11 @@ static inline OSStatus MRRenderCallback(void *inRefCon,
 
 - (UInt32)fetchPacketSample:(uint8_t*)buffer
                   wantBytes:(UInt32)bufferSize
+                    latency:(double)latency
 {
     UInt32 filled = 0;
     if (self.fetchPacketBlock) {
-        filled = self.fetchPacketBlock(buffer,bufferSize);
+        filled = self.fetchPacketBlock(buffer,bufferSize,latency);
     }
     return filled;
 }
@@ -237,10 +253,11 @@ static inline OSStatus MRRenderCallback(void *inRefCon,
                    leftSize:(UInt32)leftSize
                       right:(uint8_t*)right
                   rightSize:(UInt32)rightSize
+                    latency:(double)latency
 {
     UInt32 filled = 0;
     if (self.fetchPlanarBlock) {
-        filled = self.fetchPlanarBlock(left,leftSize,right,rightSize);
+        filled = self.fetchPlanarBlock(left,leftSize,right,rightSize,latency);
     }
     return filled;
 }
@@ -252,6 +269,7 @@ static inline OSStatus MRRenderCallback(void *inRefCon,
 
 - (void)play
 {
+    [self updateOutputLatency];
     OSStatus status = AudioOutputUnitStart(_audioUnit);
     NSAssert(noErr == status, @"AudioOutputUnitStart");
 }
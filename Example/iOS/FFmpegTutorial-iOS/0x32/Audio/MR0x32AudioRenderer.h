@@ -10,8 +10,9 @@
 #import <FFmpegTutorial/FFPlayerHeader.h>
 NS_ASSUME_NONNULL_BEGIN
 
-typedef UInt32(^MRFetchPacketSample)(uint8_t*buffer,UInt32 bufferSize);
-typedef UInt32(^MRFetchPlanarSample)(uint8_t*left,UInt32 leftSize,uint8_t*right,UInt32 rightSize);
+//latency：这次取出的第一个采样从现在起还要多久才能播放出来，单位s
+typedef UInt32(^MRFetchPacketSample)(uint8_t*buffer,UInt32 bufferSize,double latency);
+typedef UInt32(^MRFetchPlanarSample)(uint8_t*left,UInt32 leftSize,uint8_t*right,UInt32 rightSize,double latency);
 
 @interface MR0x32AudioRenderer : NSObject
 
@@ -95,9 +95,9 @@
 - (void)onFetchPacketSample:(MRFetchPacketSample)block
 {
 #if DEBUG_RECORD_PCM_TO_FILE
-    [self.audioRendererImp onFetchPacketSample:^UInt32(uint8_t * _Nonnull buffer, UInt32 bufferSize) {
+    [self.audioRendererImp onFetchPacketSample:^UInt32(uint8_t * _Nonnull buffer, UInt32 bufferSize, double latency) {
         if (block) {
-            UInt32 filled = block(buffer,bufferSize);
+            UInt32 filled = block(buffer,bufferSize,latency);
             fwrite(buffer, 1, filled, self->file_pcm_l);
             return filled;
         } else {
@@ -112,9 +112,9 @@
 - (void)onFetchPlanarSample:(MRFetchPlanarSample)block
 {
 #if DEBUG_RECORD_PCM_TO_FILE
-    [self.audioRendererImp onFetchPlanarSample:^UInt32(uint8_t * _Nonnull left, UInt32 leftSize, uint8_t * _Nonnull right, UInt32 rightSize) {
+    [self.audioRendererImp onFetchPlanarSample:^UInt32(uint8_t * _Nonnull left, UInt32 leftSize, uint8_t * _Nonnull right, UInt32 rightSize, double latency) {
         if (block) {
-            UInt32 filled = block(left,leftSize,right,rightSize);
+            UInt32 filled = block(left,leftSize,right,rightSize,latency);
             fwrite(left, 1, filled, self->file_pcm_l);
             fwrite(right, 1, filled, self->file_pcm_r);
             return filled;
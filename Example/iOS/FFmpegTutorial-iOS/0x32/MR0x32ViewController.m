@@ -169,15 +169,18 @@
     //播放器使用的采样率
     [self.audioRender setupWithFmt:fmt sampleRate:self.player.supportedSampleRate];
     __weakSelf__
-    [self.audioRender onFetchPacketSample:^UInt32(uint8_t * _Nonnull buffer, UInt32 bufferSize) {
+    //把输出延迟交给播放器，音频时钟按正在播放的采样计算
+    [self.audioRender onFetchPacketSample:^UInt32(uint8_t * _Nonnull buffer, UInt32 bufferSize, double latency) {
         __strongSelf__
-        UInt32 filled = [self.player fetchPacketSample:buffer wantBytes:bufferSize];
+        UInt32 filled = [self.player fetchPacketSample:buffer wantBytes:bufferSize latency:latency];
         return filled;
     }];
     
-    [self.audioRender onFetchPlanarSample:^UInt32(uint8_t * _Nonnull left, UInt32 leftSize, uint8_t * _Nonnull right, UInt32 rightSize) {
+    [self.audioRender onFetchPlanarSample:^UInt32(uint8_t * _Nonnull left, UInt32 leftSize, uint8_t * _Nonnull right, UInt32 rightSize, double latency) {
         __strongSelf__
-        UInt32 filled = [self.player fetchPlanarSample:left leftSize:leftSize right:right rightSize:rightSize];
+        uint8_t *planes[2] = {left, right};
+        UInt32 size = right ? MIN(leftSize, rightSize) : leftSize;
+        UInt32 filled = [self.player fetchPlanarSamples:planes count:right ? 2 : 1 planeSize:size latency:latency];
         return filled;
     }];
 }
@@ -0,0 +1,173 @@
+//
+//  FFAudioMixer0x32Tests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 多音轨混音：按 pts 对齐、音轨内部的空隙补静音、跟不上的音轨一直等到断粮才按静音处理、来晚的数据丢掉
+
+@import XCTest;
+#import <FFmpegTutorial/FFAudioMixer0x32.h>
+
+#define TEST_SAMPLE_RATE 8000
+//一个块的时长
+#define TEST_BLOCK_DURATION ((double)FF_AUDIO_MIX_BLOCK_SAMPLES / TEST_SAMPLE_RATE)
+
+@interface FFAudioMixer0x32Tests : XCTestCase
+
+@property (nonatomic, strong) FFAudioMixer0x32 *mixer;
+//混音输出，单声道
+@property (nonatomic, strong) NSMutableData *mixed;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *blockPts;
+@property (nonatomic, copy) FFAudioMixerOutput0x32 output;
+
+@end
+
+@implementation FFAudioMixer0x32Tests
+
+- (void)setUp
+{
+    [super setUp];
+    self.mixer = [[FFAudioMixer0x32 alloc] initWithTracks:2 channels:1 sampleRate:TEST_SAMPLE_RATE];
+    XCTAssertNotNil(self.mixer);
+    self.mixed = [NSMutableData data];
+    self.blockPts = [NSMutableArray array];
+    __weak typeof(self) weakSelf = self;
+    self.output = ^int(float * const *data, int samples, double pts) {
+        [weakSelf.mixed appendBytes:data[0] length:samples * sizeof(float)];
+        [weakSelf.blockPts addObject:@(pts)];
+        return 0;
+    };
+}
+
+//写入 samples 个值都为 value 的采样
+- (void)pushTrack:(int)track value:(float)value samples:(int)samples pts:(double)pts
+{
+    float *buf = malloc(samples * sizeof(float));
+    for (int i = 0; i < samples; i++) {
+        buf[i] = value;
+    }
+    const float *data[1] = {buf};
+    XCTAssertEqual([self.mixer pushTrack:track data:data samples:samples pts:pts output:self.output], 0);
+    free(buf);
+}
+
+//从第 from 个输出采样开始的 count 个采样都等于 value
+- (void)assertMixedFrom:(int)from count:(int)count value:(float)value
+{
+    XCTAssertGreaterThanOrEqual(self.mixed.length, (from + count) * sizeof(float));
+    const float *out = self.mixed.bytes;
+    for (int i = from; i < from + count && i * sizeof(float) < self.mixed.length; i++) {
+        XCTAssertEqualWithAccuracy(out[i], value, 1e-6, @"sample %d", i);
+    }
+}
+
+- (void)testInvalidParameters
+{
+    XCTAssertNil([[FFAudioMixer0x32 alloc] initWithTracks:0 channels:1 sampleRate:TEST_SAMPLE_RATE]);
+    XCTAssertNil([[FFAudioMixer0x32 alloc] initWithTracks:FF_AUDIO_MIX_MAX_TRACKS + 1 channels:1 sampleRate:TEST_SAMPLE_RATE]);
+    XCTAssertNil([[FFAudioMixer0x32 alloc] initWithTracks:2 channels:MR_CH_LAYOUT_MAX_CHANNELS + 1 sampleRate:TEST_SAMPLE_RATE]);
+}
+
+//第 1 路晚半个块开始，第 0 路中间断了半个块，都按 pts 对齐，缺的部分是静音
+- (void)testAlignByPts
+{
+    const int half = FF_AUDIO_MIX_BLOCK_SAMPLES / 2;
+    [self pushTrack:0 value:0.25f samples:half pts:0];
+    [self pushTrack:0 value:0.25f samples:FF_AUDIO_MIX_BLOCK_SAMPLES pts:TEST_BLOCK_DURATION];
+    //第 1 路还没有数据，不会开始混音
+    XCTAssertEqual(self.mixed.length, 0);
+
+    [self pushTrack:1 value:0.5f samples:half * 3 pts:TEST_BLOCK_DURATION / 2];
+    XCTAssertEqual(self.blockPts.count, 2);
+    XCTAssertEqualWithAccuracy(self.blockPts[0].doubleValue, 0, 1e-9);
+    XCTAssertEqualWithAccuracy(self.blockPts[1].doubleValue, TEST_BLOCK_DURATION, 1e-9);
+    [self assertMixedFrom:0 count:half value:0.25f];
+    [self assertMixedFrom:half count:half value:0.5f];
+    [self assertMixedFrom:FF_AUDIO_MIX_BLOCK_SAMPLES count:FF_AUDIO_MIX_BLOCK_SAMPLES value:0.75f];
+
+    XCTAssertEqual([self.mixer endTrack:0 output:self.output], 0);
+    XCTAssertFalse(self.mixer.finished);
+    XCTAssertEqual([self.mixer endTrack:1 output:self.output], 0);
+    XCTAssertTrue(self.mixer.finished);
+
+    FFAudioMixerStats0x32 stats = [self.mixer stats];
+    XCTAssertEqual(stats.blocks, 2);
+    XCTAssertEqual(stats.underruns, 0);
+    XCTAssertEqual(stats.dropped, 0);
+}
+
+//第 1 路跟不上时一直等它，不丢数据；断粮后才按静音处理，之后来晚的数据丢掉，准时的数据正常混音
+- (void)testWaitLaggingTrackUntilStarved
+{
+    const int n = FF_AUDIO_MIX_BLOCK_SAMPLES;
+    __block BOOL starved = NO;
+    self.mixer.trackStarved = ^BOOL(int track) {
+        return track == 1 && starved;
+    };
+    [self pushTrack:0 value:0.25f samples:n pts:0];
+    [self pushTrack:1 value:0.5f samples:n pts:0];
+    XCTAssertEqual(self.blockPts.count, 1);
+
+    //第 0 路领先 4 块，第 1 路还没断粮，继续等
+    for (int i = 1; i <= 4; i++) {
+        [self pushTrack:0 value:0.25f samples:n pts:i * TEST_BLOCK_DURATION];
+    }
+    XCTAssertEqual(self.blockPts.count, 1);
+
+    //交错得比较远的数据到了，正常混音
+    [self pushTrack:1 value:0.5f samples:n pts:TEST_BLOCK_DURATION];
+    XCTAssertEqual(self.blockPts.count, 2);
+    [self assertMixedFrom:n count:n value:0.75f];
+    FFAudioMixerStats0x32 stats = [self.mixer stats];
+    XCTAssertEqual(stats.underruns, 0);
+    XCTAssertEqual(stats.dropped, 0);
+
+    //第 1 路断粮了，不再等它，第 0 路缓存的块都混出来，缺的部分是静音
+    starved = YES;
+    [self pushTrack:0 value:0.25f samples:n pts:5 * TEST_BLOCK_DURATION];
+    XCTAssertEqual(self.blockPts.count, 6);
+    [self assertMixedFrom:2 * n count:4 * n value:0.25f];
+    stats = [self.mixer stats];
+    XCTAssertEqual(stats.underruns, 4);
+
+    //这块已经按静音混过了，来晚了丢掉
+    starved = NO;
+    [self pushTrack:1 value:0.5f samples:n pts:2 * TEST_BLOCK_DURATION];
+    stats = [self.mixer stats];
+    XCTAssertEqual(stats.dropped, n);
+    XCTAssertEqual(self.blockPts.count, 6);
+
+    //准时的数据正常混音，这时第 0 路还没有数据，等它
+    [self pushTrack:1 value:0.5f samples:n pts:6 * TEST_BLOCK_DURATION];
+    XCTAssertEqual(self.blockPts.count, 6);
+    [self pushTrack:0 value:0.25f samples:n pts:6 * TEST_BLOCK_DURATION];
+    XCTAssertEqual(self.blockPts.count, 7);
+    [self assertMixedFrom:6 * n count:n value:0.75f];
+
+    XCTAssertEqual([self.mixer endTrack:1 output:self.output], 0);
+    XCTAssertFalse(self.mixer.finished);
+    XCTAssertEqual([self.mixer endTrack:0 output:self.output], 0);
+    XCTAssertTrue(self.mixer.finished);
+
+    for (int i = 0; i < self.blockPts.count; i++) {
+        XCTAssertEqualWithAccuracy(self.blockPts[i].doubleValue, i * TEST_BLOCK_DURATION, 1e-9);
+    }
+    stats = [self.mixer stats];
+    XCTAssertEqual(stats.blocks, 7);
+    XCTAssertEqual(stats.underruns, 4);
+    XCTAssertEqual(stats.dropped, n);
+}
+
+- (void)testOutputErrorStopsMixing
+{
+    FFAudioMixerOutput0x32 failing = ^int(float * const *data, int samples, double pts) {
+        return -1;
+    };
+    float buf[FF_AUDIO_MIX_BLOCK_SAMPLES] = {0};
+    const float *data[1] = {buf};
+    XCTAssertEqual([self.mixer pushTrack:0 data:data samples:FF_AUDIO_MIX_BLOCK_SAMPLES pts:0 output:failing], 0);
+    XCTAssertEqual([self.mixer pushTrack:1 data:data samples:FF_AUDIO_MIX_BLOCK_SAMPLES pts:0 output:failing], -1);
+}
+
+@end
@@ -0,0 +1,143 @@
+//
+//  FFFramePool0x32Tests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 视频帧内存池：对齐、归还后复用同一块内存、slab 按需增加、尺寸变化时重建并释放旧的 slab
+
+@import XCTest;
+#import <FFmpegTutorial/FFFramePool0x32.h>
+#import <libavcodec/avcodec.h>
+
+#define TEST_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+@interface FFFramePool0x32Tests : XCTestCase
+{
+    AVCodecContext *_avctx;
+}
+
+@property (nonatomic, strong) FFFramePool0x32 *pool;
+
+@end
+
+@implementation FFFramePool0x32Tests
+
+- (void)setUp
+{
+    [super setUp];
+    //不需要打开解码器，get_buffer2 只用到类型、能力和像素格式
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    XCTAssertTrue(codec != NULL && (codec->capabilities & AV_CODEC_CAP_DR1));
+    _avctx = avcodec_alloc_context3(codec);
+    XCTAssertTrue(_avctx != NULL);
+    self.pool = [[FFFramePool0x32 alloc] init];
+}
+
+- (void)tearDown
+{
+    self.pool = nil;
+    avcodec_free_context(&_avctx);
+    [super tearDown];
+}
+
+- (AVFrame *)getFrameWithWidth:(int)width height:(int)height
+{
+    _avctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    _avctx->width = width;
+    _avctx->height = height;
+    AVFrame *frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = width;
+    frame->height = height;
+    XCTAssertEqual([self.pool getBuffer:_avctx frame:frame flags:0], 0);
+    for (int p = 0; p < 3; p++) {
+        XCTAssertTrue(frame->buf[p] != NULL);
+        XCTAssertEqual((uintptr_t)frame->data[p] % self.pool.alignment, 0);
+        XCTAssertEqual(frame->linesize[p] % self.pool.alignment, 0);
+    }
+    XCTAssertTrue(frame->buf[3] == NULL);
+    //整块内存可写，越界时 ASan 能发现
+    memset(frame->data[0], 0x10, frame->linesize[0] * height);
+    memset(frame->data[1], 0x80, frame->linesize[1] * ((height + 1) / 2));
+    memset(frame->data[2], 0x80, frame->linesize[2] * ((height + 1) / 2));
+    return frame;
+}
+
+- (void)testReuseReturnedBlocks
+{
+    AVFrame *frame = [self getFrameWithWidth:1280 height:720];
+    uint8_t *data[3] = {frame->data[0], frame->data[1], frame->data[2]};
+    FFFramePoolStats0x32 stats = [self.pool stats];
+    XCTAssertEqual(stats.gets, 3);
+    XCTAssertEqual(stats.allocs, 3);
+    XCTAssertEqual(stats.reuses, 0);
+    //每个平面一个池子，各有一个 slab，按大页取整
+    XCTAssertEqual(stats.slabs, 3);
+    XCTAssertEqual(stats.slab_bytes % TEST_HUGE_PAGE_SIZE, 0);
+
+    //归还后再取，拿到的是同一块内存，不再分配
+    av_frame_free(&frame);
+    frame = [self getFrameWithWidth:1280 height:720];
+    for (int p = 0; p < 3; p++) {
+        XCTAssertEqual(frame->data[p], data[p]);
+    }
+    stats = [self.pool stats];
+    XCTAssertEqual(stats.gets, 6);
+    XCTAssertEqual(stats.allocs, 3);
+    XCTAssertEqual(stats.reuses, 3);
+    XCTAssertEqual(stats.slabs, 3);
+    XCTAssertEqual(stats.resets, 0);
+    av_frame_free(&frame);
+}
+
+//同时持有的帧多到一个 slab 放不下时再分配 slab，切出来的块互不重叠
+- (void)testSlabGrowth
+{
+    const int count = 16;
+    AVFrame *frames[count];
+    for (int i = 0; i < count; i++) {
+        frames[i] = [self getFrameWithWidth:1280 height:720];
+    }
+    FFFramePoolStats0x32 stats = [self.pool stats];
+    XCTAssertEqual(stats.allocs, count * 3);
+    //亮度平面约 1MB，8MB 的 slab 放不下 16 个
+    XCTAssertGreaterThan(stats.slabs, 3);
+    XCTAssertEqual(stats.slab_bytes % TEST_HUGE_PAGE_SIZE, 0);
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            const uint8_t *a = frames[i]->data[0];
+            const uint8_t *b = frames[j]->data[0];
+            const size_t size = frames[i]->linesize[0] * 720;
+            XCTAssertTrue(a + size <= b || b + size <= a, @"frame %d and %d overlap", i, j);
+        }
+    }
+    const int slabs = stats.slabs;
+    for (int i = 0; i < count; i++) {
+        av_frame_free(&frames[i]);
+    }
+    //归还的块留在池子里复用，slab 不释放
+    stats = [self.pool stats];
+    XCTAssertEqual(stats.slabs, slabs);
+}
+
+//尺寸变化时重建池子；旧的块都归还后旧的 slab 释放，还被持有的帧在池子释放后依然可用
+- (void)testResetAndFree
+{
+    AVFrame *frame = [self getFrameWithWidth:1280 height:720];
+    av_frame_free(&frame);
+
+    frame = [self getFrameWithWidth:640 height:360];
+    FFFramePoolStats0x32 stats = [self.pool stats];
+    XCTAssertEqual(stats.resets, 1);
+    //旧尺寸的 slab 已经释放，只剩新尺寸的 3 个
+    XCTAssertEqual(stats.slabs, 3);
+
+    //池子先释放，帧还在渲染器手里
+    self.pool = nil;
+    memset(frame->data[0], 0x20, frame->linesize[0] * 360);
+    XCTAssertEqual(frame->data[0][0], 0x20);
+    av_frame_free(&frame);
+}
+
+@end
@@ -0,0 +1,108 @@
+//
+//  FFPlayer0x32TimeoutTests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 用本地回环的慢服务器检查打开、读包、连续读不到包三种超时
+
+@import XCTest;
+#import <FFmpegTutorial/FFPlayer0x32.h>
+#import "MRStallingHTTPServer.h"
+
+@interface FFPlayer0x32TimeoutTests : XCTestCase
+
+@property (nonatomic, strong) MRStallingHTTPServer *server;
+@property (nonatomic, strong) FFPlayer0x32 *player;
+
+@end
+
+@implementation FFPlayer0x32TimeoutTests
+
+- (void)tearDown
+{
+    [self.player asyncStop];
+    self.player = nil;
+    [self.server stop];
+    self.server = nil;
+    [super tearDown];
+}
+
+//打开慢服务器上的 WAV，等待出错回调
+- (FFPlayer0x32IOStatus)playStallingServer:(MRStallingHTTPServerMode)mode
+                               openTimeout:(double)openTimeout
+                               readTimeout:(double)readTimeout
+                              stallTimeout:(double)stallTimeout
+{
+    self.server = [[MRStallingHTTPServer alloc] initWithMode:mode];
+    XCTAssertTrue([self.server start]);
+
+    FFPlayer0x32 *player = [[FFPlayer0x32 alloc] init];
+    player.contentPath = self.server.url;
+    player.supportedSampleFormats = MR_SAMPLE_FMT_MASK_AUTO;
+    player.supportedChannelLayouts = MR_CH_LAYOUT_MASK_AUTO;
+    player.supportedSampleRate = 8000;
+    player.openTimeout = openTimeout;
+    player.readTimeout = readTimeout;
+    player.stallTimeout = stallTimeout;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"io timeout"];
+    [player onError:^{
+        [expectation fulfill];
+    }];
+    self.player = player;
+
+    const NSTimeInterval begin = [NSDate timeIntervalSinceReferenceDate];
+    [player prepareToPlay];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    const NSTimeInterval cost = [NSDate timeIntervalSinceReferenceDate] - begin;
+
+    XCTAssertEqual(player.error.code, FFPlayerErrorCode_IOTimeout);
+    //超时时间是 1s，加上 interrupt 回调的检查间隔，不应该等太久
+    XCTAssertLessThan(cost, 5);
+    return [player ioStatus];
+}
+
+- (void)testTimeoutsDisabledByDefault
+{
+    FFPlayer0x32 *player = [[FFPlayer0x32 alloc] init];
+    XCTAssertEqual(player.openTimeout, 0);
+    XCTAssertEqual(player.readTimeout, 0);
+    XCTAssertEqual(player.stallTimeout, 0);
+}
+
+- (void)testOpenTimeout
+{
+    FFPlayer0x32IOStatus status = [self playStallingServer:MRStallingHTTPServerStallBeforeResponse
+                                               openTimeout:1
+                                               readTimeout:0
+                                              stallTimeout:0];
+    XCTAssertEqual(status.open_timeouts, 1);
+    XCTAssertEqual(status.read_timeouts, 0);
+    XCTAssertEqual(status.stall_timeouts, 0);
+}
+
+- (void)testReadTimeout
+{
+    FFPlayer0x32IOStatus status = [self playStallingServer:MRStallingHTTPServerStallAfterBody
+                                               openTimeout:5
+                                               readTimeout:1
+                                              stallTimeout:0];
+    XCTAssertEqual(status.open_timeouts, 0);
+    XCTAssertEqual(status.read_timeouts, 1);
+    XCTAssertEqual(status.stall_timeouts, 0);
+}
+
+- (void)testStallTimeout
+{
+    FFPlayer0x32IOStatus status = [self playStallingServer:MRStallingHTTPServerStallAfterBody
+                                               openTimeout:5
+                                               readTimeout:0
+                                              stallTimeout:1];
+    XCTAssertEqual(status.open_timeouts, 0);
+    XCTAssertEqual(status.read_timeouts, 0);
+    XCTAssertEqual(status.stall_timeouts, 1);
+    XCTAssertGreaterThanOrEqual(status.max_stall_duration, 1);
+}
+
+@end
@@ -0,0 +1,176 @@
+//
+//  FFPlayerPCMRingTests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// PCM 环形缓冲区：跨越末尾的读写、discard_pos 跳过旧数据、时钟和停止标记
+
+@import XCTest;
+#import "FFPlayerPCMRingHeader.h"
+
+@interface FFPlayerPCMRingTests : XCTestCase
+{
+    PCMRing _ring;
+}
+@end
+
+@implementation FFPlayerPCMRingTests
+
+- (void)tearDown
+{
+    pcm_ring_destroy(&_ring);
+    [super tearDown];
+}
+
+//按字节序号填充，第 p 个平面加上 p * 64，能看出错位和串了平面
+static void fill_planes(uint8_t planes[][64], int nb_planes, uint64_t from, uint32_t size)
+{
+    for (int p = 0; p < nb_planes; p++) {
+        for (uint32_t i = 0; i < size; i++) {
+            planes[p][i] = (uint8_t)(from + i + p * 64);
+        }
+    }
+}
+
+- (void)testCapacityRoundsUpToPowerOfTwo
+{
+    XCTAssertEqual(pcm_ring_init(&_ring, 1, 8, 48000, 100), 0);
+    XCTAssertEqual(_ring.capacity, 128 * 8);
+    XCTAssertEqual(_ring.bytes_per_sec, 48000 * 8);
+    pcm_ring_destroy(&_ring);
+    XCTAssertEqual(pcm_ring_init(&_ring, PCM_RING_MAX_PLANES + 1, 2, 48000, 100), AVERROR(EINVAL));
+    XCTAssertEqual(pcm_ring_init(&_ring, 1, 2, 48000, 0), AVERROR(EINVAL));
+}
+
+//写入和读出的大小和缓冲区容量互质，读写位置会停在各种偏移上跨越末尾
+- (void)testWraparound
+{
+    const int planes = 2;
+    //s16p，64 个采样点，每个平面 128 字节
+    XCTAssertEqual(pcm_ring_init(&_ring, planes, 2, 8000, 64), 0);
+    XCTAssertEqual(_ring.capacity, 128);
+
+    uint8_t in[PCM_RING_MAX_PLANES][64];
+    uint8_t out[PCM_RING_MAX_PLANES][64];
+    uint8_t *src[PCM_RING_MAX_PLANES];
+    uint8_t *dst[PCM_RING_MAX_PLANES];
+    for (int p = 0; p < planes; p++) {
+        src[p] = in[p];
+        dst[p] = out[p];
+    }
+
+    uint64_t written = 0;
+    uint64_t read = 0;
+    const int writeSamples[] = {3, 29, 17, 1, 31};
+    const uint32_t readSizes[] = {10, 64, 2, 46, 38, 64};
+    for (int round = 0; round < 200; round++) {
+        const uint32_t size = writeSamples[round % 5] * 2;
+        //单线程测试，写之前保证有空间，不会阻塞
+        if (written + size - read <= _ring.capacity) {
+            fill_planes(in, planes, written, size);
+            XCTAssertEqual(pcm_ring_write(&_ring, src, size / 2, NAN, 1.0), 0);
+            written += size;
+        }
+        XCTAssertEqual(pcm_ring_readable(&_ring), written - read);
+
+        //peek 不会跨越缓冲区末尾
+        uint8_t *peek[PCM_RING_MAX_PLANES];
+        const uint32_t n = pcm_ring_peek(&_ring, peek, 64);
+        XCTAssertLessThanOrEqual(n, _ring.capacity - read % _ring.capacity);
+
+        const uint32_t want = readSizes[round % 6];
+        const uint32_t got = pcm_ring_read(&_ring, dst, planes, want);
+        XCTAssertEqual(got, MIN(want, written - read));
+        for (int p = 0; p < planes; p++) {
+            for (uint32_t i = 0; i < got; i++) {
+                XCTAssertEqual(out[p][i], (uint8_t)(read + i + p * 64), @"round %d plane %d byte %u", round, p, i);
+            }
+        }
+        read += got;
+    }
+    //至少绕了几圈
+    XCTAssertGreaterThan(read, _ring.capacity * 4);
+    XCTAssertEqual(atomic_load(&_ring.read_pos), read);
+    XCTAssertEqual(atomic_load(&_ring.write_pos), written);
+}
+
+//discard_pos 之前的数据读的一方直接跳过，之后写入的数据正常读出，时钟跟着新的段
+- (void)testDiscardWritten
+{
+    XCTAssertEqual(pcm_ring_init(&_ring, 1, 2, 8000, 64), 0);
+    uint8_t in[PCM_RING_MAX_PLANES][64];
+    uint8_t out[PCM_RING_MAX_PLANES][64];
+    uint8_t *src[PCM_RING_MAX_PLANES] = {in[0]};
+    uint8_t *dst[PCM_RING_MAX_PLANES] = {out[0]};
+
+    fill_planes(in, 1, 0, 60);
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 30, 1.0, 1.0), 0);
+    XCTAssertEqual(pcm_ring_read(&_ring, dst, 1, 8), 8);
+    fill_planes(in, 1, 60, 40);
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 20, 2.0, 1.0), 0);
+
+    pcm_ring_discard_written(&_ring);
+    XCTAssertEqual(pcm_ring_readable(&_ring), 0);
+    //读的一方读一次才会跳过，写的一方的可用空间也是在这之后才释放
+    XCTAssertEqual(pcm_ring_read(&_ring, dst, 1, 64), 0);
+    XCTAssertEqual(atomic_load(&_ring.read_pos), 100);
+
+    fill_planes(in, 1, 200, 40);
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 20, 5.0, 1.0), 0);
+    XCTAssertEqual(pcm_ring_readable(&_ring), 40);
+
+    //跨越末尾前后的数据都是新写入的
+    XCTAssertEqual(pcm_ring_read(&_ring, dst, 1, 64), 40);
+    for (int i = 0; i < 40; i++) {
+        XCTAssertEqual(out[0][i], (uint8_t)(200 + i), @"byte %d", i);
+    }
+    //旧的两段已经丢掉，时钟是新段的起点加上读出的 20 个采样
+    XCTAssertEqual(pcm_ring_nb_chunks(&_ring), 1);
+    XCTAssertEqualWithAccuracy(pcm_ring_read_clock(&_ring, NULL), 5.0 + 20 / 8000.0, 1e-9);
+    XCTAssertEqual(pcm_ring_read(&_ring, dst, 1, 64), 0);
+}
+
+//大于半个缓冲区的帧拆成几段写入，每段的 pts 按速率往后推
+- (void)testClockAcrossSplitChunks
+{
+    //flt 双声道交错，64 个采样点，每个平面 512 字节
+    XCTAssertEqual(pcm_ring_init(&_ring, 1, 8, 1000, 64), 0);
+    uint8_t *data = av_mallocz(48 * 8);
+    uint8_t *src[PCM_RING_MAX_PLANES] = {data};
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 48, 10.0, 2.0), 0);
+    av_free(data);
+    XCTAssertEqual(pcm_ring_nb_chunks(&_ring), 2);
+
+    double speed = 0;
+    XCTAssertEqualWithAccuracy(pcm_ring_read_clock(&_ring, &speed), 10.0, 1e-9);
+    XCTAssertEqual(speed, 2.0);
+
+    //读完第一段（32 个采样）再读 4 个，进入第二段
+    XCTAssertEqual(pcm_ring_read(&_ring, (uint8_t * const []){NULL}, 1, 36 * 8), 36 * 8);
+    XCTAssertEqual(pcm_ring_nb_chunks(&_ring), 1);
+    XCTAssertEqualWithAccuracy(pcm_ring_read_clock(&_ring, NULL), 10.0 + 36 / 1000.0 * 2.0, 1e-9);
+}
+
+- (void)testAbortStopsBlockedWriter
+{
+    XCTAssertEqual(pcm_ring_init(&_ring, 1, 2, 8000, 16), 0);
+    uint8_t data[64] = {0};
+    uint8_t *src[PCM_RING_MAX_PLANES] = {data};
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 16, NAN, 1.0), 0);
+    XCTAssertEqual(pcm_ring_readable(&_ring), _ring.capacity);
+    XCTAssertTrue(isnan(pcm_ring_read_clock(&_ring, NULL)));
+
+    //缓冲区满了，写的一方在等待；停止后返回 -1
+    PCMRing *ring = &_ring;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 50 * NSEC_PER_MSEC), dispatch_get_global_queue(0, 0), ^{
+        pcm_ring_abort(ring);
+    });
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 1, NAN, 1.0), -1);
+
+    pcm_ring_resume(&_ring);
+    XCTAssertEqual(pcm_ring_read(&_ring, (uint8_t * const []){NULL}, 1, 2), 2);
+    XCTAssertEqual(pcm_ring_write(&_ring, src, 1, NAN, 1.0), 0);
+}
+
+@end
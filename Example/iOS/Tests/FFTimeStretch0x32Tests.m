@@ -0,0 +1,127 @@
+//
+//  FFTimeStretch0x32Tests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 变速不变调：0.5、1、2 倍速时输出的时长，1 倍速时输出和输入一样
+
+@import XCTest;
+#import <FFmpegTutorial/FFTimeStretch0x32.h>
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_CHANNELS 2
+//和解码器出帧的大小差不多
+#define TEST_FRAME_SAMPLES 1024
+#define TEST_FRAMES 172
+
+@interface FFTimeStretch0x32Tests : XCTestCase
+{
+    float *_input[TEST_CHANNELS];
+    int _inputSamples;
+}
+@end
+
+@implementation FFTimeStretch0x32Tests
+
+- (void)setUp
+{
+    [super setUp];
+    //约 4s 的 440Hz/660Hz 正弦波，两个声道不一样
+    _inputSamples = TEST_FRAME_SAMPLES * TEST_FRAMES;
+    for (int c = 0; c < TEST_CHANNELS; c++) {
+        _input[c] = malloc(_inputSamples * sizeof(float));
+        const double freq = c == 0 ? 440 : 660;
+        for (int i = 0; i < _inputSamples; i++) {
+            _input[c][i] = 0.5f * sinf(2.0 * M_PI * freq * i / TEST_SAMPLE_RATE);
+        }
+    }
+}
+
+- (void)tearDown
+{
+    for (int c = 0; c < TEST_CHANNELS; c++) {
+        free(_input[c]);
+    }
+    [super tearDown];
+}
+
+//按帧送入全部输入，返回 flush 之前的输出采样数；output 不为 NULL 时收集全部输出（包括 flush）
+- (int)stretchWithRate:(double)rate flushedSamples:(int *)flushed output:(float **)output
+{
+    FFTimeStretch0x32 *stretch = [[FFTimeStretch0x32 alloc] initWithFormat:MR_SAMPLE_FMT_FLTP channels:TEST_CHANNELS sampleRate:TEST_SAMPLE_RATE];
+    XCTAssertNotNil(stretch);
+    stretch.rate = rate;
+
+    __block int total = 0;
+    __block double lastPts = -1;
+    FFTimeStretchOutput0x32 collect = ^(uint8_t * const *data, int samples, double pts) {
+        XCTAssertGreaterThan(samples, 0);
+        //输出的 pts 只增不减；0.5 倍速时相邻窗口的搜索范围有重叠，可能相等
+        XCTAssertGreaterThanOrEqual(pts, lastPts);
+        lastPts = pts;
+        if (output) {
+            for (int c = 0; c < TEST_CHANNELS; c++) {
+                output[c] = realloc(output[c], (total + samples) * sizeof(float));
+                memcpy(output[c] + total, data[c], samples * sizeof(float));
+            }
+        }
+        total += samples;
+    };
+
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        uint8_t *src[TEST_CHANNELS];
+        for (int c = 0; c < TEST_CHANNELS; c++) {
+            src[c] = (uint8_t *)(_input[c] + f * TEST_FRAME_SAMPLES);
+        }
+        XCTAssertEqual([stretch process:src samples:TEST_FRAME_SAMPLES pts:(double)f * TEST_FRAME_SAMPLES / TEST_SAMPLE_RATE output:collect], 0);
+    }
+    const int processed = total;
+    [stretch flush:collect];
+    if (flushed) {
+        *flushed = total - processed;
+    }
+    return processed;
+}
+
+//处理过的输出时长是输入的 1/rate，差值不超过还没处理的输入（一个窗口加上搜索范围）
+- (void)assertOutputLengthForRate:(double)rate
+{
+    int flushed = 0;
+    const int out = [self stretchWithRate:rate flushedSamples:&flushed output:NULL];
+    //窗口 40ms，搜索范围 ±10ms，再留一个输出间隔
+    const int slack = (int)(TEST_SAMPLE_RATE * 0.08);
+    XCTAssertEqualWithAccuracy((double)out, _inputSamples / rate, slack / rate, @"rate %.1f", rate);
+    //flush 交出的是还没处理的输入，不变速
+    XCTAssertLessThanOrEqual(flushed, slack * 2, @"rate %.1f", rate);
+}
+
+- (void)testHalfSpeedLength
+{
+    [self assertOutputLengthForRate:0.5];
+}
+
+- (void)testDoubleSpeedLength
+{
+    [self assertOutputLengthForRate:2.0];
+}
+
+- (void)testNormalSpeedIsTransparent
+{
+    float *output[TEST_CHANNELS] = {NULL};
+    int flushed = 0;
+    const int out = [self stretchWithRate:1.0 flushedSamples:&flushed output:output];
+    //不丢也不多出采样
+    XCTAssertEqual(out + flushed, _inputSamples);
+    for (int c = 0; c < TEST_CHANNELS; c++) {
+        float maxDiff = 0;
+        for (int i = 0; i < _inputSamples; i++) {
+            maxDiff = MAX(maxDiff, fabsf(output[c][i] - _input[c][i]));
+        }
+        //汉宁窗叠加后的和是 1，只有浮点误差
+        XCTAssertLessThan(maxDiff, 1e-5, @"channel %d", c);
+        free(output[c]);
+    }
+}
+
+@end
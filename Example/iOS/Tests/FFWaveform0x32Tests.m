@@ -0,0 +1,215 @@
+//
+//  FFWaveform0x32Tests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 波形文件往返：生成已知内容的 WAV，用 FFWaveformAnalyzer0x32 写成 MRWF，再用 FFWaveform0x32 读回来逐个 bin 比较
+
+@import XCTest;
+#import <FFmpegTutorial/FFWaveformAnalyzer0x32.h>
+#import <FFmpegTutorial/FFWaveform0x32.h>
+
+#define TEST_SAMPLE_RATE 8000
+#define TEST_CHANNELS 2
+//不是 256 的整数倍，最后一个 bin 不满
+#define TEST_SAMPLES 100003
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = (v >> 24) & 0xFF;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF;
+}
+
+//和分析时一样：s16 转成 float，再按最小值向下、最大值向上量化
+static int16_t quantize_min(int16_t s)
+{
+    return (int16_t)floorf((s * (1.0f / 32768.0f)) * 32767.0f);
+}
+
+static int16_t quantize_max(int16_t s)
+{
+    return (int16_t)ceilf((s * (1.0f / 32768.0f)) * 32767.0f);
+}
+
+@interface FFWaveform0x32Tests : XCTestCase
+{
+    int16_t *_samples;
+}
+
+@property (nonatomic, copy) NSString *wavPath;
+@property (nonatomic, copy) NSString *waveformPath;
+@property (nonatomic, strong) FFWaveformAnalyzer0x32 *analyzer;
+
+@end
+
+@implementation FFWaveform0x32Tests
+
+- (void)setUp
+{
+    [super setUp];
+    NSString *dir = NSTemporaryDirectory();
+    NSString *name = [[NSUUID UUID] UUIDString];
+    self.wavPath = [dir stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"wav"]];
+    self.waveformPath = [dir stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"mrwf"]];
+
+    //交错的 s16 双声道；左声道是伪随机数，右声道是慢慢变化的锯齿波，开头放上满幅的值
+    _samples = malloc(TEST_SAMPLES * TEST_CHANNELS * sizeof(int16_t));
+    uint32_t seed = 0x13579BDF;
+    for (int i = 0; i < TEST_SAMPLES; i++) {
+        seed = seed * 1664525 + 1013904223;
+        _samples[i * 2] = (int16_t)(seed >> 16);
+        _samples[i * 2 + 1] = (int16_t)((i * 7) % 65536 - 32768);
+    }
+    _samples[0] = INT16_MIN;
+    _samples[1] = INT16_MAX;
+
+    NSMutableData *wav = [NSMutableData dataWithLength:44];
+    uint8_t *h = wav.mutableBytes;
+    const uint32_t dataBytes = TEST_SAMPLES * TEST_CHANNELS * sizeof(int16_t);
+    memcpy(h, "RIFF", 4);
+    put_le32(h + 4, 36 + dataBytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le32(h + 16, 16);
+    put_le16(h + 20, 1);
+    put_le16(h + 22, TEST_CHANNELS);
+    put_le32(h + 24, TEST_SAMPLE_RATE);
+    put_le32(h + 28, TEST_SAMPLE_RATE * TEST_CHANNELS * 2);
+    put_le16(h + 32, TEST_CHANNELS * 2);
+    put_le16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    put_le32(h + 40, dataBytes);
+    [wav appendBytes:_samples length:dataBytes];
+    XCTAssertTrue([wav writeToFile:self.wavPath atomically:YES]);
+}
+
+- (void)tearDown
+{
+    [self.analyzer cancel];
+    self.analyzer = nil;
+    free(_samples);
+    [[NSFileManager defaultManager] removeItemAtPath:self.wavPath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:self.waveformPath error:NULL];
+    [super tearDown];
+}
+
+- (FFWaveform0x32 *)analyze
+{
+    FFWaveformAnalyzer0x32 *analyzer = [[FFWaveformAnalyzer0x32 alloc] init];
+    analyzer.contentPath = self.wavPath;
+    analyzer.outputPath = self.waveformPath;
+    analyzer.samplesPerBin = 256;
+    analyzer.levelFactor = 4;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"waveform"];
+    __block FFWaveformAnalyzerStats0x32 stats = {0};
+    [analyzer onFinished:^(FFWaveformAnalyzerStats0x32 st) {
+        stats = st;
+        [expectation fulfill];
+    }];
+    [analyzer onError:^{
+        [expectation fulfill];
+    }];
+    self.analyzer = analyzer;
+    [analyzer start];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertNil(analyzer.error);
+    XCTAssertEqual(stats.samples, TEST_SAMPLES);
+
+    NSDictionary *attr = [[NSFileManager defaultManager] attributesOfItemAtPath:self.waveformPath error:NULL];
+    XCTAssertEqual([attr fileSize], stats.file_size);
+    return [[FFWaveform0x32 alloc] initWithPath:self.waveformPath];
+}
+
+- (void)testRoundTrip
+{
+    FFWaveform0x32 *waveform = [self analyze];
+    XCTAssertNotNil(waveform);
+    XCTAssertEqual(waveform.sampleRate, TEST_SAMPLE_RATE);
+    XCTAssertEqual(waveform.channels, TEST_CHANNELS);
+    XCTAssertEqual(waveform.samplesPerBin, 256);
+    XCTAssertEqual(waveform.levelFactor, 4);
+    XCTAssertEqual(waveform.totalSamples, TEST_SAMPLES);
+    XCTAssertEqualWithAccuracy(waveform.duration, (double)TEST_SAMPLES / TEST_SAMPLE_RATE, 1e-9);
+
+    //391 -> 98 -> 25 -> 7 -> 2，bin 数少于 4 的一层为最上层
+    const int64_t expectCounts[] = {391, 98, 25, 7, 2};
+    XCTAssertEqual(waveform.levelCount, 5);
+
+    //第 0 层和 WAV 里的采样逐个比较
+    int64_t count = 0;
+    const int16_t *bins = [waveform binsAtLevel:0 count:&count];
+    XCTAssertEqual(count, expectCounts[0]);
+    XCTAssertEqual((uintptr_t)bins % sizeof(int16_t), 0);
+    for (int64_t b = 0; b < count; b++) {
+        const int from = (int)(b * 256);
+        const int to = MIN(from + 256, TEST_SAMPLES);
+        for (int c = 0; c < TEST_CHANNELS; c++) {
+            int16_t lo = INT16_MAX, hi = INT16_MIN;
+            for (int i = from; i < to; i++) {
+                lo = MIN(lo, _samples[i * TEST_CHANNELS + c]);
+                hi = MAX(hi, _samples[i * TEST_CHANNELS + c]);
+            }
+            XCTAssertEqual(bins[(b * TEST_CHANNELS + c) * 2], quantize_min(lo), @"bin %lld ch %d", b, c);
+            XCTAssertEqual(bins[(b * TEST_CHANNELS + c) * 2 + 1], quantize_max(hi), @"bin %lld ch %d", b, c);
+        }
+    }
+
+    //上面每层的一个 bin 是下一层 4 个 bin 的包络，最后一个可以不满
+    for (int level = 1; level < waveform.levelCount; level++) {
+        int64_t childCount = 0;
+        const int16_t *child = [waveform binsAtLevel:level - 1 count:&childCount];
+        const int16_t *parent = [waveform binsAtLevel:level count:&count];
+        XCTAssertEqual(count, expectCounts[level]);
+        XCTAssertEqual([waveform samplesPerBinAtLevel:level], 256LL << (2 * level));
+        for (int64_t b = 0; b < count; b++) {
+            for (int c = 0; c < TEST_CHANNELS; c++) {
+                int16_t lo = INT16_MAX, hi = INT16_MIN;
+                for (int64_t k = b * 4; k < MIN(b * 4 + 4, childCount); k++) {
+                    lo = MIN(lo, child[(k * TEST_CHANNELS + c) * 2]);
+                    hi = MAX(hi, child[(k * TEST_CHANNELS + c) * 2 + 1]);
+                }
+                XCTAssertEqual(parent[(b * TEST_CHANNELS + c) * 2], lo, @"level %d bin %lld ch %d", level, b, c);
+                XCTAssertEqual(parent[(b * TEST_CHANNELS + c) * 2 + 1], hi, @"level %d bin %lld ch %d", level, b, c);
+            }
+        }
+    }
+    //满幅的采样量化后是 ±32767
+    const int16_t *top = [waveform binsAtLevel:waveform.levelCount - 1 count:NULL];
+    XCTAssertEqual(top[0], -32767);
+    XCTAssertEqual(top[3], 32767);
+
+    XCTAssertEqual([waveform levelForWidth:90], 1);
+    XCTAssertEqual([waveform levelForWidth:1000], 0);
+    XCTAssertEqual([waveform levelForWidth:1], 4);
+    XCTAssertTrue([waveform binsAtLevel:waveform.levelCount count:&count] == NULL);
+    XCTAssertEqual(count, 0);
+}
+
+//文件被截断或者魔数不对时打开失败，不会越界读
+- (void)testRejectsCorruptFile
+{
+    XCTAssertNotNil([self analyze]);
+    NSData *good = [NSData dataWithContentsOfFile:self.waveformPath];
+    NSString *path = [self.waveformPath stringByAppendingString:@".bad"];
+
+    NSData *truncated = [good subdataWithRange:NSMakeRange(0, good.length - 1)];
+    XCTAssertTrue([truncated writeToFile:path atomically:YES]);
+    XCTAssertNil([[FFWaveform0x32 alloc] initWithPath:path]);
+
+    NSMutableData *badMagic = [good mutableCopy];
+    ((uint8_t *)badMagic.mutableBytes)[0] = 'X';
+    XCTAssertTrue([badMagic writeToFile:path atomically:YES]);
+    XCTAssertNil([[FFWaveform0x32 alloc] initWithPath:path]);
+
+    NSData *headerOnly = [good subdataWithRange:NSMakeRange(0, sizeof(MRWaveformFileHeader) - 1)];
+    XCTAssertTrue([headerOnly writeToFile:path atomically:YES]);
+    XCTAssertNil([[FFWaveform0x32 alloc] initWithPath:path]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+@end
@@ -0,0 +1,243 @@
+//
+//  MRAudioKernelsTests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 音频格式转换和标量参考实现逐字节比较，覆盖 1~8 声道和不是 SIMD 宽度整数倍的采样数
+
+@import XCTest;
+#import <FFmpegTutorial/MRAudioKernels.h>
+
+#define TEST_MAX_SAMPLES 1027
+
+static const MRSampleFormat kFormats[] = {MR_SAMPLE_FMT_S16, MR_SAMPLE_FMT_S16P, MR_SAMPLE_FMT_FLT, MR_SAMPLE_FMT_FLTP};
+
+//和 MRAudioKernels 约定的一样：乘 32768，饱和，四舍五入偶数优先
+static int16_t ref_flt_to_s16(float f)
+{
+    f *= 32768.0f;
+    if (!(f <= 32767.0f)) {
+        f = 32767.0f;
+    }
+    if (f < -32768.0f) {
+        f = -32768.0f;
+    }
+    return (int16_t)lrintf(f);
+}
+
+static float ref_sample(const uint8_t * const *planes, MRSampleFormat fmt, int channels, int c, int i)
+{
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(fmt);
+    const int idx = planar ? i : i * channels + c;
+    const uint8_t *p = planes[planar ? c : 0];
+    if (MR_Sample_Fmt_Is_FloatX(fmt)) {
+        return ((const float *)p)[idx];
+    }
+    return ((const int16_t *)p)[idx] * (1.0f / 32768.0f);
+}
+
+//标量参考实现：逐个采样读出再写入
+static void ref_convert(const uint8_t * const *src, MRSampleFormat srcFmt, uint8_t * const *dst, MRSampleFormat dstFmt, int channels, int samples)
+{
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(dstFmt);
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < samples; i++) {
+            const int idx = planar ? i : i * channels + c;
+            uint8_t *p = dst[planar ? c : 0];
+            if (MR_Sample_Fmt_Is_FloatX(dstFmt)) {
+                //float 到 float 原样拷贝，不能经过 int16
+                if (MR_Sample_Fmt_Is_FloatX(srcFmt)) {
+                    const BOOL sp = MR_Sample_Fmt_Is_Planar(srcFmt);
+                    ((float *)p)[idx] = ((const float *)src[sp ? c : 0])[sp ? i : i * channels + c];
+                } else {
+                    ((float *)p)[idx] = ref_sample(src, srcFmt, channels, c, i);
+                }
+            } else if (MR_Sample_Fmt_Is_FloatX(srcFmt)) {
+                ((int16_t *)p)[idx] = ref_flt_to_s16(ref_sample(src, srcFmt, channels, c, i));
+            } else {
+                const BOOL sp = MR_Sample_Fmt_Is_Planar(srcFmt);
+                ((int16_t *)p)[idx] = ((const int16_t *)src[sp ? c : 0])[sp ? i : i * channels + c];
+            }
+        }
+    }
+}
+
+@interface MRAudioKernelsTests : XCTestCase
+{
+    uint8_t *_src[MR_CH_LAYOUT_MAX_CHANNELS];
+    uint8_t *_out[MR_CH_LAYOUT_MAX_CHANNELS];
+    uint8_t *_ref[MR_CH_LAYOUT_MAX_CHANNELS];
+}
+@end
+
+@implementation MRAudioKernelsTests
+
+- (void)setUp
+{
+    [super setUp];
+    //交错格式只用第 0 个平面，按最多声道数分配
+    const size_t bytes = TEST_MAX_SAMPLES * MR_CH_LAYOUT_MAX_CHANNELS * sizeof(float);
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        _src[c] = malloc(bytes);
+        _out[c] = malloc(bytes);
+        _ref[c] = malloc(bytes);
+    }
+}
+
+- (void)tearDown
+{
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        free(_src[c]);
+        free(_out[c]);
+        free(_ref[c]);
+    }
+    [super tearDown];
+}
+
+//可重复的伪随机内容，float 包含超出 [-1, 1] 的值和刚好落在 .5 上的值，检查饱和与舍入
+- (void)fillSource:(MRSampleFormat)fmt
+{
+    uint32_t seed = 0x2468ACE1;
+    const size_t count = TEST_MAX_SAMPLES * MR_CH_LAYOUT_MAX_CHANNELS;
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        for (size_t i = 0; i < count; i++) {
+            seed = seed * 1664525 + 1013904223;
+            if (MR_Sample_Fmt_Is_FloatX(fmt)) {
+                float v;
+                switch (i % 8) {
+                    case 0: v = ((int32_t)(seed >> 16) - 32768 + 0.5f) / 32768.0f; break;
+                    case 1: v = (float)(int32_t)seed / (float)INT32_MAX * 1.5f; break;
+                    default: v = (float)(int32_t)seed / (float)INT32_MAX; break;
+                }
+                ((float *)_src[c])[i] = v;
+            } else {
+                ((int16_t *)_src[c])[i] = (int16_t)(seed >> 16);
+            }
+        }
+    }
+}
+
+- (void)testConvertMatchesReference
+{
+    const int sampleCounts[] = {1, 3, 7, 16, 33, 64, TEST_MAX_SAMPLES};
+    for (int s = 0; s < 4; s++) {
+        const MRSampleFormat srcFmt = kFormats[s];
+        [self fillSource:srcFmt];
+        for (int d = 0; d < 4; d++) {
+            const MRSampleFormat dstFmt = kFormats[d];
+            const int bps = MR_Sample_Fmt_Is_FloatX(dstFmt) ? sizeof(float) : sizeof(int16_t);
+            for (int ch = 1; ch <= MR_CH_LAYOUT_MAX_CHANNELS; ch++) {
+                for (int k = 0; k < sizeof(sampleCounts) / sizeof(sampleCounts[0]); k++) {
+                    const int samples = sampleCounts[k];
+                    [MRAudioKernels convert:_src format:srcFmt to:_out format:dstFmt channels:ch samples:samples];
+                    ref_convert((const uint8_t * const *)_src, srcFmt, _ref, dstFmt, ch, samples);
+                    const int planes = MR_Sample_Fmt_Is_Planar(dstFmt) ? ch : 1;
+                    const size_t bytes = (size_t)samples * bps * (planes == 1 ? ch : 1);
+                    for (int p = 0; p < planes; p++) {
+                        XCTAssertEqual(memcmp(_out[p], _ref[p], bytes), 0, @"%d->%d %dch %d samples plane %d [%@]", srcFmt, dstFmt, ch, samples, p, [MRAudioKernels activeISA]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+- (void)testS16RoundTripIsLossless
+{
+    int16_t *s16 = (int16_t *)_src[0];
+    for (int i = 0; i < 65536; i += TEST_MAX_SAMPLES) {
+        const int n = MIN(TEST_MAX_SAMPLES, 65536 - i);
+        for (int j = 0; j < n; j++) {
+            s16[j] = (int16_t)(i + j - 32768);
+        }
+        [MRAudioKernels s16ToFloat:s16 dst:(float *)_out[0] count:n];
+        [MRAudioKernels floatToS16:(float *)_out[0] dst:(int16_t *)_ref[0] count:n];
+        XCTAssertEqual(memcmp(s16, _ref[0], n * sizeof(int16_t)), 0, @"from %d", i - 32768);
+    }
+}
+
+- (void)testFloatToS16RoundsAndSaturates
+{
+    const float in[]    = {0.5f / 32768, 1.5f / 32768, 2.5f / 32768, -0.5f / 32768, -1.5f / 32768, 1.0f, 2.0f, -1.0f, -2.0f, NAN};
+    const int16_t out[] = {0,            2,            2,            0,             -2,            32767, 32767, -32768, -32768, 32767};
+    const int n = sizeof(in) / sizeof(in[0]);
+    //凑够一个 SIMD 宽度，检查向量路径和尾部的标量路径
+    float src[32];
+    int16_t dst[32];
+    for (int i = 0; i < 32; i++) {
+        src[i] = in[i % n];
+    }
+    [MRAudioKernels floatToS16:src dst:dst count:32];
+    for (int i = 0; i < 32; i++) {
+        XCTAssertEqual(dst[i], out[i % n], @"%g", src[i]);
+    }
+}
+
+- (void)testInterleaveRoundTrip
+{
+    [self fillSource:MR_SAMPLE_FMT_FLTP];
+    for (int ch = 1; ch <= MR_CH_LAYOUT_MAX_CHANNELS; ch++) {
+        for (int bps = 2; bps <= 4; bps += 2) {
+            [MRAudioKernels interleave:(const uint8_t * const *)_src dst:_out[0] channels:ch samples:TEST_MAX_SAMPLES bytesPerSample:bps];
+            for (int i = 0; i < TEST_MAX_SAMPLES; i++) {
+                for (int c = 0; c < ch; c++) {
+                    XCTAssertEqual(memcmp(_out[0] + (i * ch + c) * bps, _src[c] + i * bps, bps), 0);
+                }
+            }
+            [MRAudioKernels deinterleave:_out[0] dst:_ref channels:ch samples:TEST_MAX_SAMPLES bytesPerSample:bps];
+            for (int c = 0; c < ch; c++) {
+                XCTAssertEqual(memcmp(_ref[c], _src[c], TEST_MAX_SAMPLES * bps), 0, @"%dch %d bytes", ch, bps);
+            }
+        }
+    }
+}
+
+- (void)testDeliverFuncMatchesConvert
+{
+    const int sampleCounts[] = {1, 7, 33, TEST_MAX_SAMPLES};
+    for (int s = 0; s < 4; s++) {
+        const MRSampleFormat srcFmt = kFormats[s];
+        [self fillSource:srcFmt];
+        for (int d = 0; d < 4; d++) {
+            const MRSampleFormat dstFmt = kFormats[d];
+            const int bps = MR_Sample_Fmt_Is_FloatX(dstFmt) ? sizeof(float) : sizeof(int16_t);
+            for (int ch = 1; ch <= 2; ch++) {
+                MRAudioDeliverFunc func = [MRAudioKernels deliverFuncFrom:srcFmt to:dstFmt channels:ch];
+                XCTAssertTrue(func != NULL, @"%d->%d %dch", srcFmt, dstFmt, ch);
+                if (!func) {
+                    continue;
+                }
+                for (int k = 0; k < sizeof(sampleCounts) / sizeof(sampleCounts[0]); k++) {
+                    const int samples = sampleCounts[k];
+                    [MRAudioKernels convert:_src format:srcFmt to:_ref format:dstFmt channels:ch samples:samples];
+                    func(_src, _out, samples);
+                    const int planes = MR_Sample_Fmt_Is_Planar(dstFmt) ? ch : 1;
+                    const size_t bytes = (size_t)samples * bps * (planes == 1 ? ch : 1);
+                    for (int p = 0; p < planes; p++) {
+                        XCTAssertEqual(memcmp(_out[p], _ref[p], bytes), 0, @"%d->%d %dch %d samples plane %d", srcFmt, dstFmt, ch, samples, p);
+                    }
+                }
+            }
+        }
+    }
+}
+
+- (void)testDeliverFuncOnlyForMonoAndStereo
+{
+    for (int ch = 3; ch <= MR_CH_LAYOUT_MAX_CHANNELS; ch++) {
+        XCTAssertTrue([MRAudioKernels deliverFuncFrom:MR_SAMPLE_FMT_FLTP to:MR_SAMPLE_FMT_S16 channels:ch] == NULL, @"%dch", ch);
+    }
+}
+
+- (void)testBenchmarkDeliverBitExact
+{
+    //奇数采样数，覆盖尾部的标量路径
+    NSString *report = [MRAudioKernels benchmarkDeliverWithSamples:1027 iterations:1];
+    XCTAssertFalse([report containsString:@"MISMATCH"], @"%@", report);
+    XCTAssertFalse([report containsString:@"skipped"], @"%@", report);
+    //16 个格式对，每个 1~2 声道
+    XCTAssertEqual([report componentsSeparatedByString:@"bit-exact"].count - 1, 32, @"%@", report);
+}
+
+@end
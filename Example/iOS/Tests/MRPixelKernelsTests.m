@@ -0,0 +1,139 @@
+//
+//  MRPixelKernelsTests.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 各指令集的 YUV 重排内核和 swscale 逐个平面比较，包含奇数宽高；不一致时给出第一个不同的像素
+
+@import XCTest;
+#import <FFmpegTutorial/MRPixelKernels.h>
+#import <libavutil/frame.h>
+#import <libavutil/imgutils.h>
+#import <libavutil/pixdesc.h>
+#import <libswscale/swscale.h>
+
+@interface MRPixelKernelsTests : XCTestCase
+
+@end
+
+@implementation MRPixelKernelsTests
+
+static AVFrame * alloc_frame(int format, int width, int height)
+{
+    AVFrame *frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 64) < 0) {
+        av_frame_free(&frame);
+    }
+    return frame;
+}
+
+//可重复的伪随机内容，包括对齐填充的字节
+static void fill_frame(AVFrame *frame)
+{
+    uint32_t seed = 0x12345678;
+    for (int p = 0; p < AV_NUM_DATA_POINTERS && frame->buf[p]; p++) {
+        for (int b = 0; b < frame->buf[p]->size; b++) {
+            seed = seed * 1664525 + 1013904223;
+            frame->buf[p]->data[b] = seed >> 24;
+        }
+    }
+}
+
+//逐个平面比较可见区域，对齐填充的字节不参与比较；不一致时返回第一个不同的字节所在的平面、行和列
+- (NSString *)diffFrame:(AVFrame *)ref with:(AVFrame *)out
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ref->format);
+    int linesizes[4];
+    av_image_fill_linesizes(linesizes, ref->format, ref->width);
+    for (int p = 0; p < 4 && ref->data[p]; p++) {
+        const int shift = (p == 1 || p == 2) ? desc->log2_chroma_h : 0;
+        const int rows = AV_CEIL_RSHIFT(ref->height, shift);
+        for (int y = 0; y < rows; y++) {
+            const uint8_t *a = ref->data[p] + y * ref->linesize[p];
+            const uint8_t *b = out->data[p] + y * out->linesize[p];
+            if (memcmp(a, b, linesizes[p]) == 0) {
+                continue;
+            }
+            for (int x = 0; x < linesizes[p]; x++) {
+                if (a[x] != b[x]) {
+                    return [NSString stringWithFormat:@"plane %d row %d byte %d: swscale 0x%02x, kernel 0x%02x", p, y, x, a[x], b[x]];
+                }
+            }
+        }
+    }
+    return nil;
+}
+
+- (void)assertBitExactWithWidth:(int)width height:(int)height
+{
+    const int pairs[][2] = {
+        {AV_PIX_FMT_NV21, AV_PIX_FMT_NV12},
+        {AV_PIX_FMT_NV12, AV_PIX_FMT_NV21},
+        {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12},
+        {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV21},
+        {AV_PIX_FMT_UYVY422, AV_PIX_FMT_NV16},
+        {AV_PIX_FMT_YUYV422, AV_PIX_FMT_NV16},
+        {AV_PIX_FMT_UYVY422, AV_PIX_FMT_YUV422P},
+        {AV_PIX_FMT_YUYV422, AV_PIX_FMT_YUV422P},
+    };
+    NSArray<NSString *> *isas = [MRPixelKernels availableISAs];
+    //至少有 C 实现，当前使用的是最快的一个
+    XCTAssertEqualObjects(isas.firstObject, @"C");
+    XCTAssertEqualObjects(isas.lastObject, [MRPixelKernels activeISA]);
+
+    for (int i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        const int src = pairs[i][0];
+        const int dst = pairs[i][1];
+        XCTAssertTrue([MRPixelKernels canConvertFrom:src to:dst]);
+        AVFrame *inF = alloc_frame(src, width, height);
+        AVFrame *ref = alloc_frame(dst, width, height);
+        struct SwsContext *sws = sws_getContext(width, height, src, width, height, dst, SWS_POINT, NULL, NULL, NULL);
+        XCTAssertTrue(inF && ref && sws);
+        if (!inF || !ref || !sws) {
+            sws_freeContext(sws);
+            av_frame_free(&inF);
+            av_frame_free(&ref);
+            continue;
+        }
+        fill_frame(inF);
+        XCTAssertEqual(sws_scale(sws, (const uint8_t * const *)inF->data, inF->linesize, 0, height, ref->data, ref->linesize), height);
+
+        for (NSString *isa in isas) {
+            AVFrame *outF = alloc_frame(dst, width, height);
+            XCTAssertTrue(outF != NULL);
+            XCTAssertTrue([MRPixelKernels convertFrame:inF to:outF isa:isa]);
+            NSString *diff = [self diffFrame:ref with:outF];
+            XCTAssertNil(diff, @"%dx%d %s->%s %@: %@", width, height, av_get_pix_fmt_name(src), av_get_pix_fmt_name(dst), isa, diff);
+            av_frame_free(&outF);
+        }
+        sws_freeContext(sws);
+        av_frame_free(&inF);
+        av_frame_free(&ref);
+    }
+}
+
+- (void)testBitExactEvenSize
+{
+    [self assertBitExactWithWidth:1280 height:720];
+}
+
+- (void)testBitExactOddWidth
+{
+    [self assertBitExactWithWidth:641 height:360];
+}
+
+- (void)testBitExactOddSize
+{
+    [self assertBitExactWithWidth:33 height:17];
+}
+
+- (void)testBitExactTinySize
+{
+    [self assertBitExactWithWidth:1 height:1];
+}
+
+@end
@@ -0,0 +1,30 @@
+//
+//  MRStallingHTTPServer.h
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 本地回环的 HTTP 服务，用来模拟很慢的服务器：
+// 收到请求后不回应，或者只发送响应头和一小段 WAV 数据后就不再发送，连接一直保持到 stop。
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef enum : NSUInteger {
+    MRStallingHTTPServerStallBeforeResponse,//收到请求后不回应，用来触发打开超时
+    MRStallingHTTPServerStallAfterBody,     //发送响应头和 1s 的 WAV 数据后不再发送，用来触发读包超时
+} MRStallingHTTPServerMode;
+
+@interface MRStallingHTTPServer : NSObject
+
+///监听 127.0.0.1 的随机端口，start 之后有效
+@property (nonatomic, copy, readonly, nullable) NSString *url;
+
+- (instancetype)initWithMode:(MRStallingHTTPServerMode)mode;
+- (BOOL)start;
+- (void)stop;
+
+@end
+
+NS_ASSUME_NONNULL_END
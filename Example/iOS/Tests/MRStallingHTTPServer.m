@@ -0,0 +1,187 @@
+//
+//  MRStallingHTTPServer.m
+//  FFmpegTutorial_Tests
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "MRStallingHTTPServer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+//8kHz 单声道 16bit
+#define WAV_SAMPLE_RATE 8000
+#define WAV_BODY_BYTES (WAV_SAMPLE_RATE * 2)
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = (v >> 24) & 0xFF;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF;
+}
+
+static BOOL send_all(int fd, const void *buf, size_t size)
+{
+    const uint8_t *p = buf;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, 0);
+        if (n <= 0) {
+            return NO;
+        }
+        p += n;
+        size -= n;
+    }
+    return YES;
+}
+
+@interface MRStallingHTTPServer ()
+
+@property (nonatomic, assign) MRStallingHTTPServerMode mode;
+@property (nonatomic, copy, readwrite, nullable) NSString *url;
+@property (atomic, assign) BOOL stopped;
+@property (nonatomic, assign) int listenFd;
+@property (nonatomic, strong) NSThread *thread;
+//保持住的连接，stop 时关闭
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *clients;
+
+@end
+
+@implementation MRStallingHTTPServer
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+- (instancetype)initWithMode:(MRStallingHTTPServerMode)mode
+{
+    self = [super init];
+    if (self) {
+        _mode = mode;
+        _listenFd = -1;
+        _clients = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (BOOL)start
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return NO;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 4) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        close(fd);
+        return NO;
+    }
+
+    self.listenFd = fd;
+    self.stopped = NO;
+    self.url = [NSString stringWithFormat:@"http://127.0.0.1:%d/stall.wav", ntohs(addr.sin_port)];
+    self.thread = [[NSThread alloc] initWithTarget:self selector:@selector(acceptLoop) object:nil];
+    self.thread.name = @"mr-stalling-http";
+    [self.thread start];
+    return YES;
+}
+
+- (void)stop
+{
+    self.stopped = YES;
+    @synchronized (self) {
+        for (NSNumber *client in self.clients) {
+            close([client intValue]);
+        }
+        [self.clients removeAllObjects];
+    }
+    //accept 线程每 100ms 检查一次 stopped，退出后关闭监听的 socket
+}
+
+- (void)acceptLoop
+{
+    const int fd = self.listenFd;
+    while (!self.stopped) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        [self serve:client];
+        @synchronized (self) {
+            if (self.stopped) {
+                close(client);
+            } else {
+                [self.clients addObject:@(client)];
+            }
+        }
+    }
+    close(fd);
+}
+
+//读完请求头，按模式回应；连接不关闭
+- (void)serve:(int)client
+{
+    NSMutableData *request = [NSMutableData data];
+    char buf[1024];
+    while (!self.stopped) {
+        struct pollfd pfd = { .fd = client, .events = POLLIN };
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        ssize_t n = recv(client, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return;
+        }
+        [request appendBytes:buf length:n];
+        if ([request rangeOfData:[@"\r\n\r\n" dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, request.length)].location != NSNotFound) {
+            break;
+        }
+    }
+
+    if (self.mode == MRStallingHTTPServerStallBeforeResponse) {
+        return;
+    }
+
+    //不给 Content-Length，作为不能 seek 的流；WAV 的数据长度写成很大，读完 1s 的数据后就等不到下一个包
+    const char *header = "HTTP/1.1 200 OK\r\nContent-Type: audio/wav\r\nConnection: close\r\n\r\n";
+    uint8_t wav[44 + WAV_BODY_BYTES] = {0};
+    memcpy(wav, "RIFF", 4);
+    put_le32(wav + 4, 0x7FFFFFFF);
+    memcpy(wav + 8, "WAVEfmt ", 8);
+    put_le32(wav + 16, 16);
+    put_le16(wav + 20, 1);
+    put_le16(wav + 22, 1);
+    put_le32(wav + 24, WAV_SAMPLE_RATE);
+    put_le32(wav + 28, WAV_SAMPLE_RATE * 2);
+    put_le16(wav + 32, 2);
+    put_le16(wav + 34, 16);
+    memcpy(wav + 36, "data", 4);
+    put_le32(wav + 40, 0x7FFFFFDB);
+    if (!send_all(client, header, strlen(header))) {
+        return;
+    }
+    send_all(client, wav, sizeof(wav));
+}
+
+@end
@@ -16,6 +16,8 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, copy) NSString *contentPath;
 ///code is FFPlayerErrorCode enum.
 @property (nonatomic, strong, nullable) NSError *error;
+///缓存本地文件的流信息，再次打开时缩短 avformat_find_stream_info；默认 NO
+@property (nonatomic, assign) BOOL useStreamInfoCache;
 
 ///准备
 - (void)prepareToPlay;
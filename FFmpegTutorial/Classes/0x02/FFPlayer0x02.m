@@ -8,6 +8,7 @@
 #import "FFPlayer0x02.h"
 #import "MRThread.h"
 #import "FFPlayerInternalHeader.h"
+#import "FFStreamInfoCache.h"
 
 #include <libavformat/avformat.h>
 #include <libavutil/pixdesc.h>
@@ -83,8 +84,19 @@
         /* 刚才只是打开了文件，检测了下文件头而已，并不知道流信息；因此开始读包以获取流信息
          设置读包探测大小和最大时长，避免读太多的包！
          */
-        formatCtx->probesize = 500 * 1024;
-        formatCtx->max_analyze_duration = 5 * AV_TIME_BASE;
+        //命中流信息缓存时，直接填充上次的探测结果
+        FFStreamInfoCacheResult cacheResult = FFStreamInfoCacheMiss;
+        if (self.useStreamInfoCache) {
+            cacheResult = [[FFStreamInfoCache sharedCache] applyForPath:self.contentPath context:formatCtx bestStreams:NULL count:0];
+        }
+        //命中时流都已创建，只需读很少的包补齐缓存以外的字段
+        if (cacheResult != FFStreamInfoCacheMiss) {
+            formatCtx->probesize = 32 * 1024;
+            formatCtx->max_analyze_duration = AV_TIME_BASE / 2;
+        } else {
+            formatCtx->probesize = 500 * 1024;
+            formatCtx->max_analyze_duration = 5 * AV_TIME_BASE;
+        }
 #if DEBUG
         NSTimeInterval begin = [[NSDate date] timeIntervalSinceReferenceDate];
 #endif
@@ -97,8 +109,11 @@
             NSTimeInterval end = [[NSDate date] timeIntervalSinceReferenceDate];
             //用于查看详细信息，调试的时候打出来看下很有必要
             av_dump_format(formatCtx, 0, moviePath, false);
-            MRFF_DEBUG_LOG(@"avformat_find_stream_info coast time:%g",end-begin);
+            MRFF_DEBUG_LOG(@"avformat_find_stream_info coast time:%g,stream info cache:%d",end-begin,(int)cacheResult);
 #endif
+            if (self.useStreamInfoCache && cacheResult != FFStreamInfoCacheHitFull) {
+                [[FFStreamInfoCache sharedCache] storeForPath:self.contentPath context:formatCtx bestStreams:NULL count:0];
+            }
             /* 接下来，尝试找到我们关心的信息*/
             NSMutableString *text = [[NSMutableString alloc]init];
             
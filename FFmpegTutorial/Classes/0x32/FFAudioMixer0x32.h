@@ -0,0 +1,66 @@
+//
+//  FFAudioMixer0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 多音轨混音，比如对白、音乐、音效分别是一路音频流
+// 每路音轨有自己的解码线程，解码后转换成相同的采样率和声道数（FLTP）写进各自的缓冲区，按 pts 对齐；
+// 所有音轨都凑够一个固定大小的块时，由写入最后一份数据的解码线程按增益叠加（SIMD）后交出，不另开线程。
+// 某一路跟不上时一直等它，由包队列的容量限制领先多少；只有它已经断粮（包队列空了并且读包结束或者缓存满了）时才不再等，
+// 缺的部分按静音处理，之后来晚的数据丢掉。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayerHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+///最多混音的音轨数
+#define FF_AUDIO_MIX_MAX_TRACKS 8
+///每次混音的采样数
+#define FF_AUDIO_MIX_BLOCK_SAMPLES 1024
+
+typedef struct FFAudioMixerStats0x32 {
+    //混音的块数
+    int64_t blocks;
+    //有音轨没跟上、缺的部分用静音补齐的块数
+    int64_t underruns;
+    //来晚了被丢掉的采样数
+    int64_t dropped;
+    //每块的混音耗时，单位s
+    double total_time;
+    double last_time;
+    double max_time;
+} FFAudioMixerStats0x32;
+
+///data 为每个声道的平面，pts 为第一个采样的媒体时间；返回小于 0 时停止混音并把错误返回给调用方
+typedef int(^FFAudioMixerOutput0x32)(float * _Nonnull const * _Nonnull data, int samples, double pts);
+///音轨没有数据可以解码了，再等也等不到，在写入数据的线程里调用
+typedef BOOL(^FFAudioMixerStarved0x32)(int track);
+
+@interface FFAudioMixer0x32 : NSObject
+
+@property (nonatomic, assign, readonly) int tracks;
+@property (nonatomic, assign, readonly) int channels;
+@property (nonatomic, assign, readonly) int sampleRate;
+///所有音轨都结束了，剩下的数据也都交出去了
+@property (atomic, assign, readonly) BOOL finished;
+///判断跟不上的音轨是否断粮；为空时一直等到音轨结束
+@property (atomic, copy, nullable) FFAudioMixerStarved0x32 trackStarved;
+
+- (nullable instancetype)initWithTracks:(int)tracks channels:(int)channels sampleRate:(int)sampleRate;
+
+///音轨的增益，默认 1.0；可以在任意线程修改，下一个块生效
+- (void)setGain:(float)gain track:(int)track;
+- (float)gainOfTrack:(int)track;
+
+///写入 samples 个 FLTP 采样，pts 为第一个采样的媒体时间，可以为 NAN；凑够块时在调用线程里混音并通过 output 交出；return 0 没有错误
+- (int)pushTrack:(int)track data:(const float * _Nonnull const * _Nonnull)data samples:(int)samples pts:(double)pts output:(FFAudioMixerOutput0x32)output;
+///音轨结束了，之后不再等它；全部结束时把剩下的数据混音交出
+- (int)endTrack:(int)track output:(FFAudioMixerOutput0x32)output;
+
+- (FFAudioMixerStats0x32)stats;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,350 @@
+//
+//  FFAudioMixer0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFAudioMixer0x32.h"
+#import "MRAudioKernels.h"
+#import <libavutil/mem.h>
+#import <libavutil/common.h>
+#import <libavutil/time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <math.h>
+
+//同一音轨前后两帧的 pts 间隔超过这个值时补静音，单位s
+#define MIX_GAP_TOLERANCE 0.02
+//一次最多补的静音，单位s
+#define MIX_MAX_GAP 1.0
+
+typedef struct MixTrack {
+    //待混音的采样在 [head, head + len)
+    float *fifo[MR_CH_LAYOUT_MAX_CHANNELS];
+    int head;
+    int len;
+    int cap;
+    //fifo 里第一个采样的媒体时间，NAN 表示不知道，按写入的顺序接着混
+    double pts;
+    BOOL ended;
+    _Atomic(float) gain;
+} MixTrack;
+
+@interface FFAudioMixer0x32 ()
+
+@property (atomic, assign, readwrite) BOOL finished;
+
+@end
+
+@implementation FFAudioMixer0x32
+{
+    MixTrack _track[FF_AUDIO_MIX_MAX_TRACKS];
+    float *_out[MR_CH_LAYOUT_MAX_CHANNELS];
+    //下一个块的媒体时间
+    double _mixPts;
+    BOOL _mixStarted;
+    //写入和混音都在这个锁里，输出时缓存满了会阻塞在这里，其他解码线程也随之等待
+    pthread_mutex_t _mutex;
+    FFAudioMixerStats0x32 _stats;
+    pthread_mutex_t _statsMutex;
+}
+
+- (void)dealloc
+{
+    for (int t = 0; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+            av_freep(&_track[t].fifo[c]);
+        }
+    }
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        av_freep(&_out[c]);
+    }
+    pthread_mutex_destroy(&_mutex);
+    pthread_mutex_destroy(&_statsMutex);
+}
+
+- (instancetype)initWithTracks:(int)tracks channels:(int)channels sampleRate:(int)sampleRate
+{
+    if (tracks <= 0 || tracks > FF_AUDIO_MIX_MAX_TRACKS || channels <= 0 || channels > MR_CH_LAYOUT_MAX_CHANNELS || sampleRate <= 0) {
+        return nil;
+    }
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_mutex_init(&_statsMutex, NULL);
+        _tracks = tracks;
+        _channels = channels;
+        _sampleRate = sampleRate;
+        _mixPts = NAN;
+        for (int t = 0; t < tracks; t++) {
+            _track[t].pts = NAN;
+            atomic_init(&_track[t].gain, 1.0f);
+        }
+        for (int c = 0; c < channels; c++) {
+            _out[c] = av_malloc_array(FF_AUDIO_MIX_BLOCK_SAMPLES, sizeof(float));
+            if (!_out[c]) {
+                return nil;
+            }
+        }
+    }
+    return self;
+}
+
+- (void)setGain:(float)gain track:(int)track
+{
+    if (track >= 0 && track < self.tracks) {
+        atomic_store(&_track[track].gain, FFMAX(gain, 0.0f));
+    }
+}
+
+- (float)gainOfTrack:(int)track
+{
+    if (track >= 0 && track < self.tracks) {
+        return atomic_load(&_track[track].gain);
+    }
+    return 0;
+}
+
+- (FFAudioMixerStats0x32)stats
+{
+    pthread_mutex_lock(&_statsMutex);
+    FFAudioMixerStats0x32 stats = _stats;
+    pthread_mutex_unlock(&_statsMutex);
+    return stats;
+}
+
+#pragma mark - 缓冲区
+
+//保证 fifo 后面至少还有 need 个采样的空间，前面消费掉的部分先挪走
+- (BOOL)reserve:(MixTrack *)tr need:(int)need
+{
+    if (tr->head + tr->len + need <= tr->cap) {
+        return YES;
+    }
+    if (tr->head > 0) {
+        for (int c = 0; c < _channels; c++) {
+            memmove(tr->fifo[c], tr->fifo[c] + tr->head, tr->len * sizeof(float));
+        }
+        tr->head = 0;
+        if (tr->len + need <= tr->cap) {
+            return YES;
+        }
+    }
+    const int cap = FFMAX(tr->len + need, tr->cap * 2);
+    for (int c = 0; c < _channels; c++) {
+        float *p = av_realloc_array(tr->fifo[c], cap, sizeof(float));
+        if (!p) {
+            return NO;
+        }
+        tr->fifo[c] = p;
+    }
+    tr->cap = cap;
+    return YES;
+}
+
+- (int)append:(MixTrack *)tr data:(const float * const *)data samples:(int)samples pts:(double)pts
+{
+    int gap = 0;
+    if (tr->len == 0) {
+        //空的时候直接以新数据为准，和混音位置之间的空隙混音时按静音处理
+        if (!isnan(pts)) {
+            tr->pts = pts;
+        }
+    } else if (!isnan(pts) && !isnan(tr->pts)) {
+        const double diff = pts - (tr->pts + (double)tr->len / _sampleRate);
+        if (diff > MIX_GAP_TOLERANCE) {
+            gap = (int)lrint(FFMIN(diff, MIX_MAX_GAP) * _sampleRate);
+        }
+    }
+    if (![self reserve:tr need:gap + samples]) {
+        return AVERROR(ENOMEM);
+    }
+    for (int c = 0; c < _channels; c++) {
+        float *dst = tr->fifo[c] + tr->head + tr->len;
+        memset(dst, 0, gap * sizeof(float));
+        memcpy(dst + gap, data[c], samples * sizeof(float));
+    }
+    tr->len += gap + samples;
+    return 0;
+}
+
+//丢掉 fifo 前面的 n 个采样
+static void mix_track_consume(MixTrack *tr, int n, int sampleRate)
+{
+    tr->head += n;
+    tr->len -= n;
+    if (!isnan(tr->pts)) {
+        tr->pts += (double)n / sampleRate;
+    }
+    if (tr->len == 0) {
+        tr->head = 0;
+    }
+}
+
+#pragma mark - 混音
+
+//混音位置之前的数据来晚了，丢掉；返回从混音位置开始这一路已有的采样数（包括前面要补的静音），lead 为前面要补的静音
+- (int)coverageOf:(MixTrack *)tr lead:(int *)lead
+{
+    *lead = 0;
+    if (isnan(tr->pts) || isnan(_mixPts)) {
+        return tr->len;
+    }
+    const int offset = (int)lrint((_mixPts - tr->pts) * _sampleRate);
+    if (offset > 0) {
+        const int drop = FFMIN(offset, tr->len);
+        mix_track_consume(tr, drop, _sampleRate);
+        if (drop > 0) {
+            pthread_mutex_lock(&_statsMutex);
+            _stats.dropped += drop;
+            pthread_mutex_unlock(&_statsMutex);
+        }
+        //丢完了下一次写入时重新以新数据的 pts 为准
+        if (tr->len == 0) {
+            tr->pts = NAN;
+        }
+        return tr->len;
+    }
+    *lead = -offset;
+    return *lead + tr->len;
+}
+
+//没结束的音轨数据不够时要不要等它：断粮了就不等，缺的部分按静音处理
+- (BOOL)shouldWaitTrack:(int)track starved:(FFAudioMixerStarved0x32)starved
+{
+    return !_track[track].ended && !(starved && starved(track));
+}
+
+//能混就一直混，直到有音轨的数据不够
+- (int)mixAvailable:(FFAudioMixerOutput0x32)output
+{
+    FFAudioMixerStarved0x32 starved = self.trackStarved;
+    for (;;) {
+        //所有要等的音轨都有数据后，从最早的 pts 开始
+        if (!_mixStarted) {
+            BOOL waiting = NO;
+            BOOL hasData = NO;
+            BOOL allEnded = YES;
+            double start = NAN;
+            for (int t = 0; t < _tracks; t++) {
+                MixTrack *tr = &_track[t];
+                allEnded = allEnded && tr->ended;
+                if (tr->len == 0) {
+                    waiting = waiting || [self shouldWaitTrack:t starved:starved];
+                    continue;
+                }
+                hasData = YES;
+                if (!isnan(tr->pts) && (isnan(start) || tr->pts < start)) {
+                    start = tr->pts;
+                }
+            }
+            //都断粮了还没有数据时不能开始，否则起点定不下来
+            if (waiting || (!hasData && !allEnded)) {
+                return 0;
+            }
+            _mixPts = isnan(start) ? 0 : start;
+            _mixStarted = YES;
+        }
+        
+        BOOL allReady = YES;
+        BOOL allEnded = YES;
+        int maxCoverage = 0;
+        int lead[FF_AUDIO_MIX_MAX_TRACKS];
+        for (int t = 0; t < _tracks; t++) {
+            MixTrack *tr = &_track[t];
+            const int coverage = [self coverageOf:tr lead:&lead[t]];
+            maxCoverage = FFMAX(maxCoverage, coverage);
+            allEnded = allEnded && tr->ended;
+            if (coverage < FF_AUDIO_MIX_BLOCK_SAMPLES && [self shouldWaitTrack:t starved:starved]) {
+                allReady = NO;
+            }
+        }
+        
+        int n = FF_AUDIO_MIX_BLOCK_SAMPLES;
+        if (allEnded) {
+            //全部结束了，最后一块可以不满
+            n = FFMIN(n, maxCoverage);
+            if (n == 0) {
+                self.finished = YES;
+                return 0;
+            }
+        } else if (!allReady) {
+            return 0;
+        } else if (maxCoverage == 0) {
+            return 0;
+        }
+        
+        const double begin = av_gettime_relative() / 1000000.0;
+        BOOL underrun = NO;
+        for (int c = 0; c < _channels; c++) {
+            memset(_out[c], 0, n * sizeof(float));
+        }
+        for (int t = 0; t < _tracks; t++) {
+            MixTrack *tr = &_track[t];
+            const int k = FFMAX(FFMIN(n - lead[t], tr->len), 0);
+            if (k > 0) {
+                const float gain = atomic_load(&tr->gain);
+                if (gain > 0) {
+                    for (int c = 0; c < _channels; c++) {
+                        [MRAudioKernels mix:tr->fifo[c] + tr->head gain:gain into:_out[c] + lead[t] count:k];
+                    }
+                }
+                mix_track_consume(tr, k, _sampleRate);
+            }
+            //断粮的音轨缺的部分是静音，之后来的这段数据会因为来晚了被丢掉
+            if (!tr->ended && lead[t] + k < n) {
+                underrun = YES;
+            }
+        }
+        const double cost = av_gettime_relative() / 1000000.0 - begin;
+        pthread_mutex_lock(&_statsMutex);
+        _stats.blocks++;
+        if (underrun) {
+            _stats.underruns++;
+        }
+        _stats.total_time += cost;
+        _stats.last_time = cost;
+        _stats.max_time = FFMAX(_stats.max_time, cost);
+        pthread_mutex_unlock(&_statsMutex);
+        
+        const double pts = _mixPts;
+        _mixPts += (double)n / _sampleRate;
+        int ret = output(_out, n, pts);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+}
+
+- (int)pushTrack:(int)track data:(const float * const *)data samples:(int)samples pts:(double)pts output:(FFAudioMixerOutput0x32)output
+{
+    if (track < 0 || track >= self.tracks || samples <= 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&_mutex);
+    MixTrack *tr = &_track[track];
+    int ret = 0;
+    if (!tr->ended) {
+        ret = [self append:tr data:data samples:samples pts:pts];
+        if (ret == 0) {
+            ret = [self mixAvailable:output];
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+    return ret;
+}
+
+- (int)endTrack:(int)track output:(FFAudioMixerOutput0x32)output
+{
+    if (track < 0 || track >= self.tracks) {
+        return 0;
+    }
+    pthread_mutex_lock(&_mutex);
+    _track[track].ended = YES;
+    int ret = [self mixAvailable:output];
+    pthread_mutex_unlock(&_mutex);
+    return ret;
+}
+
+@end
@@ -5,6 +5,8 @@
 //  Created by Matt Reach on 2020/8/4.
 //
 // 音频格式转换类
+// 采样率和声道布局都不变、只是 S16/S16P/FLT/FLTP 之间转换时不走 swr，直接用 SIMD 转换（交错/解交错）；
+// 其他情况使用 swr，按 profile 设置滤波器长度和抖动。
 
 #import <Foundation/Foundation.h>
 #import "FFPlayerHeader.h"
@@ -13,28 +15,60 @@ NS_ASSUME_NONNULL_BEGIN
 
 typedef struct AVFrame AVFrame;
 
+typedef enum : NSUInteger {
+    FFAudioResampleProfileDefault0x32,  //swr 的默认参数
+    FFAudioResampleProfileFast0x32,     //短滤波器 + 线性插值，最快，适合同时处理很多路音频
+    FFAudioResampleProfileHigh0x32,     //有 soxr 时使用 soxr，否则用长滤波器；转 S16 时加抖动
+} FFAudioResampleProfile0x32;
+
+typedef struct FFAudioResampleStats0x32 {
+    //转换的帧数
+    int64_t frames;
+    //其中不走 swr 的帧数
+    int64_t bypassed;
+    //转换耗时，单位s
+    double total_time;
+    double last_time;
+    double max_time;
+} FFAudioResampleStats0x32;
+
 @interface FFAudioResample0x32 : NSObject
 
 @property (nonatomic, assign, readonly) int out_sample_fmt;
 @property (nonatomic, assign, readonly) int out_sample_rate;
+@property (nonatomic, assign, readonly) FFAudioResampleProfile0x32 profile;
+///是否只做格式转换，不走 swr
+@property (nonatomic, assign, readonly) BOOL bypass;
 
 /// @param srcFmt 原音频格式
 /// @param dstFmt 目标音频格式
-/// @param srcChannel 原声道数
-/// @param dstChannel 目标声道数
+/// @param srcChannel 原声道布局（AV_CH_LAYOUT_*），不是声道数
+/// @param dstChannel 目标声道布局（AV_CH_LAYOUT_*），不是声道数
 /// @param srcRate 原采样率
 /// @param dstRate 目标采样率
 - (instancetype)initWithSrcSampleFmt:(int)srcFmt
                         dstSampleFmt:(int)dstFmt
-                          srcChannel:(int)srcChannel
-                          dstChannel:(int)dstChannel
+                          srcChannel:(int64_t)srcChannel
+                          dstChannel:(int64_t)dstChannel
                           srcRate:(int)srcRate
                           dstRate:(int)dstRate;
 
+/// 同上，profile 为转换质量
+- (instancetype)initWithSrcSampleFmt:(int)srcFmt
+                        dstSampleFmt:(int)dstFmt
+                          srcChannel:(int64_t)srcChannel
+                          dstChannel:(int64_t)dstChannel
+                          srcRate:(int)srcRate
+                          dstRate:(int)dstRate
+                             profile:(FFAudioResampleProfile0x32)profile;
+
 /// @param inF 需要转换的帧
 /// @param outP 转换的结果[不要free相关内存，通过ref/unref的方式使用]
 - (BOOL)resampleFrame:(AVFrame *)inF out:(AVFrame *_Nonnull*_Nonnull)outP;
 
+///每帧的转换耗时
+- (FFAudioResampleStats0x32)stats;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,13 +7,28 @@
 
 #import "FFAudioResample0x32.h"
 #import "FFPlayerInternalHeader.h"
+#import "MRAudioKernels.h"
 #include <libswresample/swresample.h>
 #include <libavutil/samplefmt.h>
+#include <libavutil/opt.h>
+#include <libavutil/time.h>
+#include <pthread.h>
 
 @interface FFAudioResample0x32()
+{
+    FFAudioResampleStats0x32 _stats;
+    pthread_mutex_t _statsMutex;
+}
 
 @property (nonatomic, assign, readwrite) int out_sample_fmt;
 @property (nonatomic, assign, readwrite) int out_sample_rate;
+@property (nonatomic, assign, readwrite) FFAudioResampleProfile0x32 profile;
+@property (nonatomic, assign, readwrite) BOOL bypass;
+@property (nonatomic, assign) int64_t out_ch_layout;
+//不走 swr 时输入和输出的格式
+@property (nonatomic, assign) MRSampleFormat bypassSrcFmt;
+@property (nonatomic, assign) MRSampleFormat bypassDstFmt;
+@property (nonatomic, assign) int bypassChannels;
 
 @property (nonatomic, assign) struct SwrContext *swr_ctx;
 //复用一个，效率更高些
@@ -31,32 +46,127 @@
         }
 //        av_frame_free(&_frame);
     }
+    if (_swr_ctx) {
+        swr_free(&_swr_ctx);
+    }
+    pthread_mutex_destroy(&_statsMutex);
+}
+
+//交付时能直接转换的格式，其他格式返回 MR_SAMPLE_FMT_NONE
+static MRSampleFormat resample_mr_fmt(int av_fmt)
+{
+    for (int i = MR_SAMPLE_FMT_BEGIN; i <= MR_SAMPLE_FMT_END; i++) {
+        if (MRSampleFormat2AV(i) == av_fmt) {
+            return i;
+        }
+    }
+    return MR_SAMPLE_FMT_NONE;
+}
+
+static struct SwrContext *resample_create_swr(int64_t out_ch_layout, int out_sample_fmt, int out_sample_rate,
+                                              int64_t in_ch_layout, int in_sample_fmt, int in_sample_rate,
+                                              FFAudioResampleProfile0x32 profile, int use_soxr)
+{
+    SwrContext *swr_ctx = swr_alloc_set_opts(NULL,
+                                             out_ch_layout,out_sample_fmt,out_sample_rate,
+                                             in_ch_layout,in_sample_fmt,in_sample_rate,
+                                             0,
+                                             NULL);
+    if (!swr_ctx) {
+        return NULL;
+    }
+    
+    const int to_s16 = (out_sample_fmt == AV_SAMPLE_FMT_S16 || out_sample_fmt == AV_SAMPLE_FMT_S16P) &&
+                       av_get_bytes_per_sample(in_sample_fmt) > 2;
+    switch (profile) {
+        case FFAudioResampleProfileFast0x32:
+            //滤波器从默认的 32 缩短到 8，相位数减少，系数在相位之间线性插值
+            av_opt_set_int(swr_ctx, "filter_size", 8, 0);
+            av_opt_set_int(swr_ctx, "phase_shift", 6, 0);
+            av_opt_set_int(swr_ctx, "linear_interp", 1, 0);
+            break;
+        case FFAudioResampleProfileHigh0x32:
+            if (use_soxr) {
+                av_opt_set(swr_ctx, "resampler", "soxr", 0);
+                av_opt_set_int(swr_ctx, "precision", 28, 0);
+            } else {
+                av_opt_set_int(swr_ctx, "filter_size", 64, 0);
+                av_opt_set_int(swr_ctx, "phase_shift", 12, 0);
+                av_opt_set_int(swr_ctx, "exact_rational", 1, 0);
+            }
+            //降低到 16 位时加高通三角抖动，量化噪声听起来更平
+            if (to_s16) {
+                av_opt_set_int(swr_ctx, "dither_method", SWR_DITHER_TRIANGULAR_HIGHPASS, 0);
+            }
+            break;
+        case FFAudioResampleProfileDefault0x32:
+        default:
+            break;
+    }
+    
+    if (swr_init(swr_ctx)) {
+        swr_free(&swr_ctx);
+        return NULL;
+    }
+    return swr_ctx;
+}
+
+- (instancetype)initWithSrcSampleFmt:(int)in_sample_fmt
+                        dstSampleFmt:(int)out_sample_fmt
+                          srcChannel:(int64_t)in_ch_layout
+                          dstChannel:(int64_t)out_ch_layout
+                             srcRate:(int)in_sample_rate
+                             dstRate:(int)out_sample_rate
+{
+    return [self initWithSrcSampleFmt:in_sample_fmt
+                         dstSampleFmt:out_sample_fmt
+                           srcChannel:in_ch_layout
+                           dstChannel:out_ch_layout
+                              srcRate:in_sample_rate
+                              dstRate:out_sample_rate
+                              profile:FFAudioResampleProfileDefault0x32];
 }
 
 - (instancetype)initWithSrcSampleFmt:(int)in_sample_fmt
                         dstSampleFmt:(int)out_sample_fmt
-                          srcChannel:(int)in_ch_layout
-                          dstChannel:(int)out_ch_layout
+                          srcChannel:(int64_t)in_ch_layout
+                          dstChannel:(int64_t)out_ch_layout
                              srcRate:(int)in_sample_rate
                              dstRate:(int)out_sample_rate
+                             profile:(FFAudioResampleProfile0x32)profile
 {
     self = [super init];
     if (self) {
         
         self.out_sample_rate = out_sample_rate;
         self.out_sample_fmt = out_sample_fmt;
+        self.out_ch_layout = out_ch_layout;
+        self.profile = profile;
+        pthread_mutex_init(&_statsMutex, NULL);
         
-        SwrContext *swr_ctx = swr_alloc_set_opts(NULL,
-                                                 out_ch_layout,out_sample_fmt,out_sample_rate,
-                                                 in_ch_layout,in_sample_fmt,in_sample_rate,
-                                                 0,
-                                                 NULL);
-        
-        int ret = swr_init(swr_ctx);
-        if (ret) {
-            swr_free(&swr_ctx);
-            return nil;
+        //只是 S16/S16P/FLT/FLTP 之间转换，不用 swr
+        const MRSampleFormat srcFmt = resample_mr_fmt(in_sample_fmt);
+        const MRSampleFormat dstFmt = resample_mr_fmt(out_sample_fmt);
+        const int channels = av_get_channel_layout_nb_channels(in_ch_layout);
+        if (in_sample_rate == out_sample_rate && in_ch_layout == out_ch_layout &&
+            srcFmt != MR_SAMPLE_FMT_NONE && dstFmt != MR_SAMPLE_FMT_NONE &&
+            channels > 0 && channels <= MR_CH_LAYOUT_MAX_CHANNELS) {
+            self.bypass = YES;
+            self.bypassSrcFmt = srcFmt;
+            self.bypassDstFmt = dstFmt;
+            self.bypassChannels = channels;
         } else {
+            SwrContext *swr_ctx = NULL;
+            if (profile == FFAudioResampleProfileHigh0x32) {
+                //没有编译 soxr 时初始化会失败，换成 swr 的长滤波器
+                swr_ctx = resample_create_swr(out_ch_layout, out_sample_fmt, out_sample_rate, in_ch_layout, in_sample_fmt, in_sample_rate, profile, 1);
+            }
+            if (!swr_ctx) {
+                swr_ctx = resample_create_swr(out_ch_layout, out_sample_fmt, out_sample_rate, in_ch_layout, in_sample_fmt, in_sample_rate, profile, 0);
+            }
+            if (!swr_ctx) {
+                return nil;
+            }
             self.swr_ctx = swr_ctx;
         }
         
@@ -65,6 +175,19 @@
     return self;
 }
 
+- (BOOL)convertFrame:(AVFrame *)inF out:(AVFrame *)out_frame
+{
+    if (self.bypass) {
+        out_frame->nb_samples = inF->nb_samples;
+        if (av_frame_get_buffer(out_frame, 0) < 0) {
+            return NO;
+        }
+        [MRAudioKernels convert:inF->extended_data format:self.bypassSrcFmt to:out_frame->extended_data format:self.bypassDstFmt channels:self.bypassChannels samples:inF->nb_samples];
+        return YES;
+    }
+    return swr_convert_frame(self.swr_ctx, out_frame, inF) >= 0;
+}
+
 - (BOOL)resampleFrame:(AVFrame *)inF out:(AVFrame **)outP
 {
     AVFrame *out_frame = self.frame;
@@ -73,21 +196,40 @@
     //important！
     av_frame_copy_props(out_frame, inF);
 
-    //int64_t dst_ch_layout;
-    //av_opt_get_int(d.swr_ctx, "out_channel_layout", 0, &dst_ch_layout);
-    out_frame->channel_layout = inF->channel_layout;
+    //声道数可能变了，使用目标声道布局
+    out_frame->channel_layout = self.out_ch_layout;
     out_frame->sample_rate = self.out_sample_rate;
     out_frame->format = self.out_sample_fmt;
     
-    int ret = swr_convert_frame(self.swr_ctx, out_frame, inF);
-    if(ret < 0){
+    const double begin = av_gettime_relative() / 1000000.0;
+    BOOL ok = [self convertFrame:inF out:out_frame];
+    const double cost = av_gettime_relative() / 1000000.0 - begin;
+    if (!ok) {
         // convert error, try next frame
         av_log(NULL, AV_LOG_ERROR, "fail resample audio");
         return NO;
     }
     
+    pthread_mutex_lock(&_statsMutex);
+    _stats.frames++;
+    if (self.bypass) {
+        _stats.bypassed++;
+    }
+    _stats.total_time += cost;
+    _stats.last_time = cost;
+    _stats.max_time = FFMAX(_stats.max_time, cost);
+    pthread_mutex_unlock(&_statsMutex);
+    
     *outP = out_frame;
     return YES;
 }
 
+- (FFAudioResampleStats0x32)stats
+{
+    pthread_mutex_lock(&_statsMutex);
+    FFAudioResampleStats0x32 stats = _stats;
+    pthread_mutex_unlock(&_statsMutex);
+    return stats;
+}
+
 @end
@@ -8,6 +8,7 @@
 // 通过代理衔接输入输出
 
 #import <Foundation/Foundation.h>
+#import "FFFramePool0x32.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -26,6 +27,10 @@ typedef struct AVRational AVRational;
 ///将解码后的 AVFrame 给 delegater
 - (void)decoder:(FFDecoder0x32 *)decoder reveivedAFrame:(AVFrame *)frame;
 
+@optional
+///解码结束（eof 或者解码出错），在解码线程里调用；取消时不调用
+- (void)decoderDidReachEnd:(FFDecoder0x32 *)decoder;
+
 @end
 
 @interface FFDecoder0x32 : NSObject
@@ -35,6 +40,8 @@ typedef struct AVRational AVRational;
 @property (nonatomic, copy) NSString * name;
 @property (nonatomic, weak) id <FFDecoderDelegate0x32> delegate;
 @property (nonatomic, assign, readonly) AVStream * stream;
+///流的时间基，在拷贝流参数时取出
+@property (nonatomic, assign, readonly) AVRational timeBase;
 //for video is enum AVPixelFormat,for audio is enum AVSampleFormat,
 @property (nonatomic, assign, readonly) int format;
 @property (nonatomic, assign, readonly) int picWidth;
@@ -42,8 +49,21 @@ typedef struct AVRational AVRational;
 @property (nonatomic, assign, readonly) AVRational frameRate;
 
 @property (nonatomic, assign, readonly) int sampleRate;
-@property (nonatomic, assign, readonly) int channelLayout;
+@property (nonatomic, assign, readonly) int64_t channelLayout;
+@property (nonatomic, assign, readonly) int channels;
 @property (atomic, assign) BOOL eof;
+///不解码的帧，取值为 enum AVDiscard，比如倍速播放时丢弃非参考帧；默认 AVDISCARD_DEFAULT，在解码线程里生效
+@property (atomic, assign) int skipFrame;
+///视频帧每个平面的首地址和行字节数按此对齐，比如 64 和 CVPixelBuffer 一致，渲染时可以零拷贝；需要在 open 之前设置，默认 0 使用 FFmpeg 的默认分配
+@property (nonatomic, assign) int linesizeAlignment;
+///linesizeAlignment 大于 0 时，视频帧从这个内存池分配并复用
+@property (nonatomic, strong, readonly, nullable) FFFramePool0x32 *framePool;
+/**
+ 拷贝流的参数（codecpar、时间基、帧率），之后 open 只使用拷贝，不再访问 ic 里的流；
+ 和读包并行打开时要在开始读包之前调用，因为读包过程中解封装器可能修改流参数；不调用时由 open 拷贝
+ return 0;（没有错误）
+ */
+- (int)copyStreamParameters;
 /**
  打开解码器，创建解码线程;
  return 0;（没有错误）
@@ -15,7 +15,12 @@
 //解码线程
 @property (nonatomic, strong) MRThread * workThread;
 @property (nonatomic, assign, readwrite) AVStream * stream;
+@property (nonatomic, assign, readwrite) AVRational timeBase;
+//拷贝的流参数，open 时使用
+@property (nonatomic, assign) AVCodecParameters * par;
+@property (nonatomic, assign) AVRational guessedFrameRate;
 @property (nonatomic, assign) AVCodecContext * avctx;
+@property (nonatomic, strong, readwrite, nullable) FFFramePool0x32 *framePool;
 @property (nonatomic, assign) int abort_request;
 //for video
 @property (nonatomic, assign, readwrite) int format;
@@ -24,10 +29,22 @@
 @property (nonatomic, assign, readwrite) AVRational frameRate;
 //for audio
 @property (nonatomic, assign, readwrite) int sampleRate;
-@property (nonatomic, assign, readwrite) int channelLayout;
+@property (nonatomic, assign, readwrite) int64_t channelLayout;
+@property (nonatomic, assign, readwrite) int channels;
 
 @end
 
+//视频帧从 framePool 分配，按 linesizeAlignment 对齐
+static int mr_get_buffer2(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    FFDecoder0x32 *decoder = (__bridge FFDecoder0x32 *)avctx->opaque;
+    FFFramePool0x32 *pool = decoder.framePool;
+    if (!pool) {
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+    return [pool getBuffer:avctx frame:frame flags:flags];
+}
+
 @implementation FFDecoder0x32
 
 - (void)dealloc
@@ -37,6 +54,7 @@
         avcodec_free_context(&_avctx);
         _avctx = NULL;
     }
+    avcodec_parameters_free(&_par);
 }
 
 - (instancetype)init
@@ -48,7 +66,7 @@
     return self;
 }
 
-- (int)open
+- (int)copyStreamParameters
 {
     if (self.ic == NULL) {
         return -1;
@@ -59,6 +77,33 @@
     }
     
     AVStream *stream = self.ic->streams[self.streamIdx];
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    if (!par) {
+        return AVERROR(ENOMEM);
+    }
+    if (avcodec_parameters_copy(par, stream->codecpar) < 0) {
+        avcodec_parameters_free(&par);
+        return AVERROR(ENOMEM);
+    }
+    avcodec_parameters_free(&_par);
+    self.par = par;
+    self.timeBase = stream->time_base;
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        self.guessedFrameRate = av_guess_frame_rate(self.ic, stream, NULL);
+    }
+    stream->discard = AVDISCARD_DEFAULT;
+    self.stream = stream;
+    return 0;
+}
+
+- (int)open
+{
+    if (!self.par) {
+        int ret = [self copyStreamParameters];
+        if (ret != 0) {
+            return ret;
+        }
+    }
     
     //创建解码器上下文
     AVCodecContext *avctx = avcodec_alloc_context3(NULL);
@@ -67,12 +112,12 @@
     }
     
     //填充下相关参数
-    if (avcodec_parameters_to_context(avctx, stream->codecpar)) {
+    if (avcodec_parameters_to_context(avctx, self.par)) {
         avcodec_free_context(&avctx);
         return -1;
     }
     
-    av_codec_set_pkt_timebase(avctx, stream->time_base);
+    av_codec_set_pkt_timebase(avctx, self.timeBase);
     
     //查找解码器
     AVCodec *codec = avcodec_find_decoder(avctx->codec_id);
@@ -83,25 +128,36 @@
     
     avctx->codec_id = codec->id;
     
+    if (self.linesizeAlignment > 0 && avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        FFFramePool0x32 *pool = [[FFFramePool0x32 alloc] init];
+        pool.alignment = self.linesizeAlignment;
+        self.framePool = pool;
+        avctx->opaque = (__bridge void *)self;
+        avctx->get_buffer2 = mr_get_buffer2;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+        //framePool 可以在任意线程分配，帧级多线程解码时不用切回解码线程
+        avctx->thread_safe_callbacks = 1;
+#endif
+    }
+    
     //打开解码器
     if (avcodec_open2(avctx, codec, NULL)) {
         avcodec_free_context(&avctx);
         return -1;
     }
     
-    stream->discard = AVDISCARD_DEFAULT;
-    self.stream = stream;
     self.avctx = avctx;
     
     if (avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
         self.format = avctx->sample_fmt;
         self.sampleRate = avctx->sample_rate;
-        self.channelLayout = (int)avctx->channel_layout;
+        self.channelLayout = avctx->channel_layout;
+        self.channels = avctx->channels;
     } else if (avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
         self.format = avctx->pix_fmt;
         self.picWidth = avctx->width;
         self.picHeight = avctx->height;
-        self.frameRate = av_guess_frame_rate(self.ic, stream, NULL);
+        self.frameRate = self.guessedFrameRate;
     } else {
         NSAssert(NO, @"hasn't handle other media type!");
     }
@@ -156,6 +212,10 @@
             return -1;
         }
         
+        //倍速播放时可能要丢弃部分帧
+        if (avctx->skip_frame != self.skipFrame) {
+            avctx->skip_frame = self.skipFrame;
+        }
         //发送给解码器去解码
         if (avcodec_send_packet(avctx, &pkt) == AVERROR(EAGAIN)) {
             av_log(avctx, AV_LOG_ERROR, "Receive_frame and send_packet both returned EAGAIN, which is an API violation.\n");
@@ -189,6 +249,9 @@
                 av_log(NULL, AV_LOG_ERROR, "%s decode err %d.\n",[self.name UTF8String],got_frame);
                 self.eof = YES;
             }
+            if (self.eof && [self.delegate respondsToSelector:@selector(decoderDidReachEnd:)]) {
+                [self.delegate decoderDidReachEnd:self];
+            }
             break;
         } else {
             if (self.avctx->codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -0,0 +1,49 @@
+//
+//  FFFramePool0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 解码器的视频帧内存池，作为 get_buffer2 的实现
+// 每个平面的首地址和行字节数都按 alignment 对齐，解码出的帧不用重排就能交给渲染器；
+// 内存从按 2MB 对齐的大块（slab）里切出来，系统可以用大页映射，归还后复用，不再每帧 malloc/free。
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct AVCodecContext AVCodecContext;
+typedef struct AVFrame AVFrame;
+
+typedef struct FFFramePoolStats0x32 {
+    //分配的平面总数
+    int64_t gets;
+    //从 slab 里新切出来的块数
+    int64_t allocs;
+    //复用池里已归还的块数
+    int64_t reuses;
+    //当前持有的 slab 个数
+    int slabs;
+    //当前 slab 占用的内存，单位字节
+    int64_t slab_bytes;
+    //尺寸或像素格式变化导致内存池重建的次数
+    int resets;
+} FFFramePoolStats0x32;
+
+@interface FFFramePool0x32 : NSObject
+
+///首地址和行字节数的对齐，必须是 2 的幂；默认 64，和 CVPixelBuffer 一致
+@property (nonatomic, assign) int alignment;
+///每个平面尾部额外的字节数，给解码器的 SIMD 越界读写留余量；默认 64
+@property (nonatomic, assign) int padding;
+///slab 的大小，单位字节，会向上取整到 2MB；单个平面比它大时一个 slab 只放一块；默认 8MB
+@property (nonatomic, assign) size_t slabSize;
+
+///get_buffer2 的实现，可在解码器的任意线程调用；不支持的格式走 avcodec_default_get_buffer2
+- (int)getBuffer:(AVCodecContext *)avctx frame:(AVFrame *)frame flags:(int)flags;
+///内存池复用情况
+- (FFFramePoolStats0x32)stats;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,306 @@
+//
+//  FFFramePool0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFFramePool0x32.h"
+#import <libavcodec/avcodec.h>
+#import <libavutil/buffer.h>
+#import <libavutil/imgutils.h>
+#import <libavutil/pixdesc.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+//大页的大小，slab 按它对齐
+#define MR_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+typedef size_t mr_pool_size_t;
+#else
+typedef int mr_pool_size_t;
+#endif
+
+//计数器，内存池重建后旧的 slab 可能还被渲染器持有，所以单独分配，最后一个使用者释放
+typedef struct MRFramePoolCounters {
+    pthread_mutex_t mutex;
+    int refs;
+    int64_t gets;
+    int64_t allocs;
+    int slabs;
+    int64_t slab_bytes;
+} MRFramePoolCounters;
+
+//某个平面尺寸的 slab 分配器，作为 AVBufferPool 的 opaque
+typedef struct MRSlabAllocator {
+    pthread_mutex_t mutex;
+    size_t block_size;
+    size_t slab_size;
+    //当前 slab 还没切出去的部分
+    uint8_t *cur;
+    size_t cur_left;
+    uint8_t **slabs;
+    int nb_slabs;
+    MRFramePoolCounters *counters;
+} MRSlabAllocator;
+
+static MRFramePoolCounters *mr_counters_alloc(void)
+{
+    MRFramePoolCounters *c = av_mallocz(sizeof(MRFramePoolCounters));
+    if (c) {
+        pthread_mutex_init(&c->mutex, NULL);
+        c->refs = 1;
+    }
+    return c;
+}
+
+static MRFramePoolCounters *mr_counters_retain(MRFramePoolCounters *c)
+{
+    pthread_mutex_lock(&c->mutex);
+    c->refs++;
+    pthread_mutex_unlock(&c->mutex);
+    return c;
+}
+
+static void mr_counters_release(MRFramePoolCounters *c)
+{
+    pthread_mutex_lock(&c->mutex);
+    const int refs = --c->refs;
+    pthread_mutex_unlock(&c->mutex);
+    if (refs == 0) {
+        pthread_mutex_destroy(&c->mutex);
+        av_free(c);
+    }
+}
+
+//块的内存属于 slab，池子释放时统一归还
+static void mr_slab_block_free(void *opaque, uint8_t *data)
+{
+}
+
+static AVBufferRef *mr_slab_alloc(void *opaque, mr_pool_size_t size)
+{
+    MRSlabAllocator *a = (MRSlabAllocator *)opaque;
+    if ((size_t)size > a->block_size) {
+        return NULL;
+    }
+    pthread_mutex_lock(&a->mutex);
+    if (a->cur_left < a->block_size) {
+        void *mem = NULL;
+        uint8_t **slabs = av_realloc_array(a->slabs, a->nb_slabs + 1, sizeof(uint8_t *));
+        if (!slabs || posix_memalign(&mem, MR_HUGE_PAGE_SIZE, a->slab_size)) {
+            if (slabs) {
+                a->slabs = slabs;
+            }
+            pthread_mutex_unlock(&a->mutex);
+            return NULL;
+        }
+        a->slabs = slabs;
+        a->slabs[a->nb_slabs++] = mem;
+        a->cur = mem;
+        a->cur_left = a->slab_size;
+
+        pthread_mutex_lock(&a->counters->mutex);
+        a->counters->slabs++;
+        a->counters->slab_bytes += a->slab_size;
+        pthread_mutex_unlock(&a->counters->mutex);
+    }
+    uint8_t *ptr = a->cur;
+    a->cur += a->block_size;
+    a->cur_left -= a->block_size;
+    pthread_mutex_unlock(&a->mutex);
+
+    pthread_mutex_lock(&a->counters->mutex);
+    a->counters->allocs++;
+    pthread_mutex_unlock(&a->counters->mutex);
+
+    return av_buffer_create(ptr, (int)size, mr_slab_block_free, NULL, 0);
+}
+
+//所有块都归还后由 AVBufferPool 调用
+static void mr_slab_pool_free(void *opaque)
+{
+    MRSlabAllocator *a = (MRSlabAllocator *)opaque;
+    for (int i = 0; i < a->nb_slabs; i++) {
+        free(a->slabs[i]);
+    }
+    pthread_mutex_lock(&a->counters->mutex);
+    a->counters->slabs -= a->nb_slabs;
+    a->counters->slab_bytes -= (int64_t)a->nb_slabs * a->slab_size;
+    pthread_mutex_unlock(&a->counters->mutex);
+    mr_counters_release(a->counters);
+
+    av_free(a->slabs);
+    pthread_mutex_destroy(&a->mutex);
+    av_free(a);
+}
+
+static AVBufferPool *mr_slab_pool_create(size_t block_size, size_t slab_size, MRFramePoolCounters *counters)
+{
+    MRSlabAllocator *a = av_mallocz(sizeof(MRSlabAllocator));
+    if (!a) {
+        return NULL;
+    }
+    pthread_mutex_init(&a->mutex, NULL);
+    a->block_size = block_size;
+    //一个 slab 放整数个块，大小取整到大页
+    const size_t blocks = FFMAX(slab_size / block_size, 1);
+    a->slab_size = FFALIGN(blocks * block_size, MR_HUGE_PAGE_SIZE);
+    a->counters = mr_counters_retain(counters);
+
+    AVBufferPool *pool = av_buffer_pool_init2((int)block_size, a, mr_slab_alloc, mr_slab_pool_free);
+    if (!pool) {
+        mr_counters_release(a->counters);
+        pthread_mutex_destroy(&a->mutex);
+        av_free(a);
+    }
+    return pool;
+}
+
+@implementation FFFramePool0x32
+{
+    pthread_mutex_t _mutex;
+    MRFramePoolCounters *_counters;
+    AVBufferPool *_pools[4];
+    int _linesizes[4];
+    size_t _blockSizes[4];
+    int _planes;
+    int _format;
+    int _width;
+    int _height;
+    int _resets;
+}
+
+- (void)dealloc
+{
+    [self uninitPools];
+    mr_counters_release(_counters);
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_mutex, NULL);
+        _counters = mr_counters_alloc();
+        _alignment = 64;
+        _padding = 64;
+        _slabSize = 4 * MR_HUGE_PAGE_SIZE;
+        _format = AV_PIX_FMT_NONE;
+    }
+    return self;
+}
+
+//还被引用的块会在归还后释放
+- (void)uninitPools
+{
+    for (int p = 0; p < 4; p++) {
+        av_buffer_pool_uninit(&_pools[p]);
+    }
+    _planes = 0;
+    _format = AV_PIX_FMT_NONE;
+}
+
+//按解码器要求的宽高计算每个平面的行字节数和块大小，和当前的池子不一致时重建
+- (BOOL)preparePools:(AVCodecContext *)avctx frame:(AVFrame *)frame desc:(const AVPixFmtDescriptor *)desc
+{
+    if (frame->format == _format && frame->width == _width && frame->height == _height && _planes > 0) {
+        return YES;
+    }
+
+    int w = frame->width;
+    int h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    //解码器要求的宽高填充（宏块对齐、运动补偿的边缘扩展）
+    avcodec_align_dimensions2(avctx, &w, &h, linesize_align);
+
+    int linesizes[4];
+    if (av_image_fill_linesizes(linesizes, frame->format, w) < 0) {
+        return NO;
+    }
+
+    const BOOL reset = _planes > 0;
+    [self uninitPools];
+
+    const int planes = av_pix_fmt_count_planes(frame->format);
+    for (int p = 0; p < planes; p++) {
+        const int align = FFMAX(self.alignment, linesize_align[p]);
+        const int plane_h = (p == 1 || p == 2) ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+        _linesizes[p] = FFALIGN(linesizes[p], align);
+        //块大小也按对齐取整，slab 里切出来的每一块首地址都是对齐的
+        _blockSizes[p] = FFALIGN((size_t)_linesizes[p] * plane_h + self.padding, (size_t)align);
+        _pools[p] = mr_slab_pool_create(_blockSizes[p], self.slabSize, _counters);
+        if (!_pools[p]) {
+            [self uninitPools];
+            return NO;
+        }
+    }
+    _planes = planes;
+    _format = frame->format;
+    _width = frame->width;
+    _height = frame->height;
+    if (reset) {
+        _resets++;
+        av_log(avctx, AV_LOG_INFO, "frame pool reset for %s %dx%d\n", av_get_pix_fmt_name(frame->format), frame->width, frame->height);
+    }
+    return YES;
+}
+
+- (int)getBuffer:(AVCodecContext *)avctx frame:(AVFrame *)frame flags:(int)flags
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    //音频、硬解、调色板格式以及不支持自定义内存的解码器，走默认分配
+    if (avctx->codec_type != AVMEDIA_TYPE_VIDEO || !(avctx->codec->capabilities & AV_CODEC_CAP_DR1) || !desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+
+    pthread_mutex_lock(&_mutex);
+    if (![self preparePools:avctx frame:frame desc:desc]) {
+        pthread_mutex_unlock(&_mutex);
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+
+    for (int p = 0; p < _planes; p++) {
+        AVBufferRef *buf = av_buffer_pool_get(_pools[p]);
+        if (!buf) {
+            pthread_mutex_unlock(&_mutex);
+            for (int i = 0; i < p; i++) {
+                av_buffer_unref(&frame->buf[i]);
+                frame->data[i] = NULL;
+            }
+            return AVERROR(ENOMEM);
+        }
+        frame->buf[p] = buf;
+        frame->data[p] = buf->data;
+        frame->linesize[p] = _linesizes[p];
+    }
+    const int planes = _planes;
+    pthread_mutex_unlock(&_mutex);
+
+    frame->extended_data = frame->data;
+
+    pthread_mutex_lock(&_counters->mutex);
+    _counters->gets += planes;
+    pthread_mutex_unlock(&_counters->mutex);
+    return 0;
+}
+
+- (FFFramePoolStats0x32)stats
+{
+    FFFramePoolStats0x32 stats = {0};
+    pthread_mutex_lock(&_counters->mutex);
+    stats.gets = _counters->gets;
+    stats.allocs = _counters->allocs;
+    stats.slabs = _counters->slabs;
+    stats.slab_bytes = _counters->slab_bytes;
+    pthread_mutex_unlock(&_counters->mutex);
+    stats.reuses = stats.gets - stats.allocs;
+    pthread_mutex_lock(&_mutex);
+    stats.resets = _resets;
+    pthread_mutex_unlock(&_mutex);
+    return stats;
+}
+
+@end
@@ -7,14 +7,83 @@
 
 #import <Foundation/Foundation.h>
 #import "FFPlayerHeader.h"
+#import "FFVideoScale.h"
+#import "FFFramePool0x32.h"
+#import "FFAudioResample0x32.h"
+#import "MRAudioMeter.h"
+#import "FFAudioMixer0x32.h"
 #import <CoreVideo/CVPixelBuffer.h>
+#import <CoreGraphics/CGGeometry.h>
 
 NS_ASSUME_NONNULL_BEGIN
+
+///探测流信息的方式
+typedef enum : NSUInteger {
+    FFPlayer0x32ProbeModeFixed,     //固定的探测量 500KB/5s
+    FFPlayer0x32ProbeModeAdaptive,  //自适应探测，从 32KB 开始
+    FFPlayer0x32ProbeModeCached,    //命中流信息缓存，只做很短的探测
+} FFPlayer0x32ProbeMode;
+
+#define FF_PROBE_MODE_NB 3
+
+///启动各阶段完成的时间点，相对开始打开输入流的时间，单位s；为 0 表示还没到该阶段
+typedef struct FFPlayer0x32StartupTimings {
+    double open_input;          //avformat_open_input 完成
+    double find_stream_info;    //探测流信息完成
+    double audio_decoder_open;  //音频解码器打开
+    double video_decoder_open;  //视频解码器打开
+    double video_scale_create;  //像素格式转换器创建，不需要转换时为 0
+    double first_packet;        //读到第一个包
+    double first_audio_frame;   //解码出第一帧音频
+    double first_video_frame;   //解码出第一帧视频
+    double first_display;       //第一帧视频交给 delegate，即首帧耗时
+    FFPlayer0x32ProbeMode probe_mode;   //这次探测流信息的方式
+    int probe_rounds;           //调用 avformat_find_stream_info 的次数，合成媒体源不探测为 0
+} FFPlayer0x32StartupTimings;
+
+///进程内所有 0x32 播放器按探测方式分别统计的首帧耗时，用来对比打开和关闭 adaptiveProbe 的效果；只统计有视频的播放
+typedef struct FFPlayer0x32ProbeComparison {
+    int count[FF_PROBE_MODE_NB];                    //按 FFPlayer0x32ProbeMode 分组的播放次数
+    double mean_find_stream_info[FF_PROBE_MODE_NB]; //平均探测完成时间，单位s
+    double mean_first_display[FF_PROBE_MODE_NB];    //平均首帧耗时，单位s
+} FFPlayer0x32ProbeComparison;
+
+///读包 IO 状态
+typedef struct FFPlayer0x32IOStatus {
+    int open_timeouts;          //打开（含探测流信息）超时次数
+    int read_timeouts;          //单次读包超时次数
+    int stall_timeouts;         //连续读不到包超时次数
+    int stalls;                 //卡顿次数，读一个包超过 200ms 算一次卡顿
+    double last_stall_duration; //最近一次卡顿时长，单位s
+    double max_stall_duration;  //最长的一次卡顿时长，单位s
+} FFPlayer0x32IOStatus;
+
+///播放哪些流
+typedef enum : NSUInteger {
+    FFPlayer0x32MediaSelectionBoth,         //音视频都播放
+    FFPlayer0x32MediaSelectionAudioOnly,    //只播放音频，视频流在解封装时就丢弃，不读包也不解码
+    FFPlayer0x32MediaSelectionVideoOnly,    //只播放视频，视频按自己的时钟播放
+} FFPlayer0x32MediaSelection;
+
+///音视频同步误差直方图的分组数，分组边界（ms）：-200,-100,-50,-20,-10,10,20,50,100,200
+#define FF_SYNC_HISTOGRAM_BINS 11
+
+///音视频同步情况，每显示一帧视频统计一次，误差为视频减音频，正数表示视频超前；只有音频时钟在走时统计
+typedef struct FFPlayer0x32SyncStats {
+    int64_t histogram[FF_SYNC_HISTOGRAM_BINS];
+    int64_t samples;            //统计的帧数
+    double mean_abs_error;      //误差绝对值的平均值，单位s
+    double max_abs_error;       //误差绝对值的最大值，单位s
+    double last_error;          //最近一次的误差，单位s
+} FFPlayer0x32SyncStats;
+
 @protocol FFPlayer0x32Delegate <NSObject>
 
 @optional
 - (void)reveiveFrameToRenderer:(CVPixelBufferRef)img;
 - (void)onInitAudioRender:(MRSampleFormat)fmt;
+///实现了这个方法就不再调用 onInitAudioRender:，channels 为协商出的声道数
+- (void)onInitAudioRender:(MRSampleFormat)fmt channels:(int)channels;
 - (void)onDurationUpdate:(long)du;
 
 @end
@@ -31,6 +100,42 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign) MRSampleFormatMask supportedSampleFormats;
 ///期望的音频采样率，比如 44100;不指定时使用音频的采样率
 @property (nonatomic, assign) int supportedSampleRate;
+///期望的声道布局，音频的声道数不在里面时用 swr 混音到最接近的声道数；默认 MR_CH_LAYOUT_MASK_NONE 即双声道
+@property (nonatomic, assign) MRChannelLayoutMask supportedChannelLayouts;
+///需要重采样或混音时 swr 的质量，默认 FFAudioResampleProfileDefault0x32；只是格式不同时不经过 swr
+@property (nonatomic, assign) FFAudioResampleProfile0x32 audioResampleProfile;
+///协商出的输出采样格式，S16/FLT 之间的转换和交错/解交错在取音频数据时完成
+@property (nonatomic, assign, readonly) MRSampleFormat outputSampleFormat;
+///协商出的输出声道数
+@property (nonatomic, assign, readonly) int outputChannels;
+///播放速率，0.5~4，默认 1.0；音频变速不变调，超过 1.5 倍时视频不解码非参考帧
+@property (nonatomic, assign) double playbackRate;
+///播放哪些流，默认 FFPlayer0x32MediaSelectionBoth；选中的流不存在时（比如只要音频但没有音频流）忽略这个设置；
+///播放过程中修改时由读包线程关掉或打开对应的流，不用重新打开，中途打开的视频从下一个关键帧开始显示
+@property (nonatomic, assign) FFPlayer0x32MediaSelection mediaSelection;
+///同时解码并混音的音频流（AVStream 的序号），有效的至少两路时生效，最多 FF_AUDIO_MIX_MAX_TRACKS 路；
+///第一路为主音轨，按它协商输出格式，其余的每路一个解码线程，转换成相同的采样率和声道数后按 pts 对齐混音；需要在 prepareToPlay 之前设置，默认 nil 只播放最优的一路
+@property (nonatomic, copy, nullable) NSArray<NSNumber *> *mixAudioStreams;
+///输出画面的最大尺寸（像素），比如预览窗口或缩略图的大小；视频比它大时按宽高比缩小，
+///缩放和像素格式转换在同一次 sws_scale 里完成，帧队列占用的内存也随之减少；默认 CGSizeZero 即输出原尺寸
+@property (nonatomic, assign) CGSize outputSize;
+///像素格式转换时使用的缩放算法，默认 FFVideoScaleProfileFastPoint
+@property (nonatomic, assign) FFVideoScaleProfile videoScaleProfile;
+///渲染时直接用解码后的内存构造 CVPixelBuffer，省掉每帧一次整帧拷贝；行字节数不满足对齐或需要重排时自动回退到拷贝；默认 NO
+///注：零拷贝的 CVPixelBuffer 不是 IOSurface，使用 CVOpenGLESTextureCache / CVMetalTextureCache 渲染时不能打开
+@property (nonatomic, assign) BOOL zeroCopyPixelBuffer;
+///缓存本地文件的流信息，再次打开时缩短 avformat_find_stream_info；默认 NO
+@property (nonatomic, assign) BOOL useStreamInfoCache;
+///自适应探测流信息：mp4/mov/mkv 从 32KB 开始探测，选中的流参数可用就立即结束；默认 NO
+@property (nonatomic, assign) BOOL adaptiveProbe;
+///打开输入流和探测流信息的超时时间，单位s，0 表示不限制；默认 0，网络流建议设置为 15s
+@property (nonatomic, assign) double openTimeout;
+///单次读包（av_read_frame）的超时时间，单位s，0 表示不限制；默认 0，网络流建议设置为 10s
+@property (nonatomic, assign) double readTimeout;
+///连续读不到包的超时时间，单位s，0 表示不限制；默认 0，网络流建议设置为 30s；读包出错重试的时间也算在内
+@property (nonatomic, assign) double stallTimeout;
+///在音频解码线程里统计电平（峰值、有效值、EBU R128 响度），通过 audioMeterSnapshot 读取；默认 NO
+@property (atomic, assign) BOOL audioMeterEnabled;
 
 @property (nonatomic, weak) id <FFPlayer0x32Delegate> delegate;
 //时长，单位s
@@ -39,8 +144,10 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign) double position;
 ///记录解码后的视频桢总数
 @property (atomic, assign, readonly) int videoFrameCount;
-///记录解码后的音频桢总数
+///缓存中还没有取走的音频桢数
 @property (atomic, assign, readonly) int audioFrameCount;
+///音频已经全部取走，即音频播放完毕；没有选中音频时为 NO
+@property (atomic, assign, readonly) BOOL audioEnds;
 
 ///准备
 - (void)prepareToPlay;
@@ -57,12 +164,47 @@ NS_ASSUME_NONNULL_BEGIN
 
 ///缓冲情况
 - (MR_PACKET_SIZE)peekPacketBufferStatus;
+///启动各阶段耗时
+- (FFPlayer0x32StartupTimings)startupTimings;
+///各探测方式的首帧耗时对比
++ (FFPlayer0x32ProbeComparison)probeComparison;
+///读包 IO 状态
+- (FFPlayer0x32IOStatus)ioStatus;
+///视频解码器内存池的复用情况
+- (FFFramePoolStats0x32)videoFramePoolStats;
+///音视频同步误差
+- (FFPlayer0x32SyncStats)syncStats;
+///音频重采样每帧的耗时，没有重采样时都为 0
+- (FFAudioResampleStats0x32)audioResampleStats;
+///最近 100ms 的电平，可以在任意线程（比如 UI 刷新时）调用；没有打开 audioMeterEnabled 时为空
+- (MRAudioMeterSnapshot)audioMeterSnapshot;
+///混音的耗时和各音轨的对齐情况，没有混音时都为 0
+- (FFAudioMixerStats0x32)audioMixerStats;
+///混音时音轨的增益，track 为 mixAudioStreams 里的序号，默认 1.0；可以在播放过程中修改
+- (void)setGain:(float)gain forMixTrack:(int)track;
 
 // 获取 packet 形式的音频数据，返回实际填充的字节数
 - (UInt32)fetchPacketSample:(uint8_t*)buffer
                   wantBytes:(UInt32)bufferSize;
 
-// 获取 planar 形式的音频数据，返回实际填充的字节数
+// 同上，latency 为这次取出的第一个采样从现在起还要多久才能播放出来，单位s，
+// 一般是渲染回调的时间戳减去当前时间，再加上设备的输出延迟；音频时钟按正在播放的采样计算，否则按已经交出去的采样计算
+- (UInt32)fetchPacketSample:(uint8_t*)buffer
+                  wantBytes:(UInt32)bufferSize
+                    latency:(double)latency;
+
+// 获取 planar 形式的音频数据，planes 为每个声道的缓冲区，count 不能小于 outputChannels；返回每个平面实际填充的字节数
+- (UInt32)fetchPlanarSamples:(uint8_t * _Nonnull const * _Nonnull)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize;
+
+// 同上，latency 的含义和 fetchPacketSample:wantBytes:latency: 一样
+- (UInt32)fetchPlanarSamples:(uint8_t * _Nonnull const * _Nonnull)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+                     latency:(double)latency;
+
+// 获取 planar 形式的双声道音频数据，返回实际填充的字节数
 - (UInt32)fetchPlanarSample:(uint8_t*)left
                    leftSize:(UInt32)leftSize
                       right:(uint8_t*)right
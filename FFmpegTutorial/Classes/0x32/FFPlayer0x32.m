@@ -10,16 +10,36 @@
 #import "FFPlayerInternalHeader.h"
 #import "FFPlayerPacketHeader.h"
 #import "FFPlayerFrameHeader.h"
+#import "FFPlayerPCMRingHeader.h"
 #import "FFDecoder0x32.h"
 #import "FFVideoScale.h"
 #import "FFAudioResample0x32.h"
 #import "FFSyncClock0x32.h"
 #import "MRConvertUtil.h"
+#import "MRAudioKernels.h"
+#import "FFStreamInfoCache.h"
+#import "FFSyntheticSource0x32.h"
+#import "FFTimeStretch0x32.h"
 #import <CoreVideo/CVPixelBufferPool.h>
 #import <libavutil/time.h>
+#import <pthread.h>
 
 //是否使用POOL
 #define USE_PIXEL_BUFFER_POOL 1
+//读一个包超过这个时长算一次卡顿，单位s
+#define IO_STALL_THRESHOLD 0.2
+
+//各探测方式的首帧耗时，进程内所有播放器共用
+static FFPlayer0x32ProbeComparison g_probe_comparison;
+static pthread_mutex_t g_probe_comparison_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//IO 超时类型
+typedef enum : int {
+    FFIOTimeoutNone,
+    FFIOTimeoutOpen,
+    FFIOTimeoutRead,
+    FFIOTimeoutStall,
+} FFIOTimeoutKind;
 
 @interface FFPlayer0x32 ()<FFDecoderDelegate0x32>
 {
@@ -28,10 +48,42 @@
     //解码前的视频包缓存队列
     PacketQueue _videoq;
     
-    //解码后的音频帧缓存队列
-    FrameQueue _sampq;
+    //解码后的音频采样缓存，解码线程写，音频渲染回调读
+    PCMRing _sampRing;
     //解码后的视频帧缓存队列
     FrameQueue _pictq;
+    //启动各阶段耗时，读包线程、解码器打开和渲染线程都会写，用 _startupLock 保护
+    FFPlayer0x32StartupTimings _startupTimings;
+    pthread_mutex_t _startupLock;
+    //读包 IO 状态
+    FFPlayer0x32IOStatus _ioStatus;
+    //当前 IO 操作的截止时间，0 表示不限制；在中断回调里检查
+    volatile double _ioDeadline;
+    //截止时间对应的超时类型
+    volatile FFIOTimeoutKind _ioDeadlineKind;
+    //被中断回调打断时的超时类型
+    volatile FFIOTimeoutKind _ioTimedOut;
+    //开始等包的时间，读到包或者队列满了就重置
+    double _ioWaitBegin;
+    //音视频同步误差，渲染线程写
+    FFPlayer0x32SyncStats _syncStats;
+    //中途打开视频后，跳过关键帧之前的包；只在读包线程使用
+    BOOL _videoWaitKeyframe;
+    //混音的音轨数，0 表示不混音；第 0 路是主音轨，使用 _audioq 和 audioDecoder，其余的使用 _mixq 和 mixDecoders
+    int _mixTrackCount;
+    int _mixStreamIdx[FF_AUDIO_MIX_MAX_TRACKS];
+    PacketQueue _mixq[FF_AUDIO_MIX_MAX_TRACKS];
+    float _mixGain[FF_AUDIO_MIX_MAX_TRACKS];
+    //每路转换成混音的格式，只在各自的解码线程里使用
+    FFAudioResample0x32 *_mixResample[FF_AUDIO_MIX_MAX_TRACKS];
+    //创建 _mixResample 时的输入格式，中途变化时重新创建
+    int _mixResampleFormat[FF_AUDIO_MIX_MAX_TRACKS];
+    int64_t _mixResampleLayout[FF_AUDIO_MIX_MAX_TRACKS];
+    int _mixResampleRate[FF_AUDIO_MIX_MAX_TRACKS];
+    //音频解码完了（混音时所有音轨都混完），解码线程写，渲染回调只读这个标记
+    atomic_bool _audioDecodeEnded;
+    //渲染回调发现音频播放完毕，由渲染线程打日志并检查是否播放结束
+    atomic_bool _audioEndsPending;
 }
 
 //读包线程
@@ -40,13 +92,29 @@
 @property (nonatomic, strong) MRThread *rendererThread;
 
 //音频解码器
-@property (nonatomic, strong) FFDecoder0x32 *audioDecoder;
+@property (atomic, strong) FFDecoder0x32 *audioDecoder;
 //视频解码器
-@property (nonatomic, strong) FFDecoder0x32 *videoDecoder;
+@property (atomic, strong) FFDecoder0x32 *videoDecoder;
 //图像格式转换/缩放器
 @property (nonatomic, strong) FFVideoScale *videoScale;
+//synthetic:// 地址的合成媒体源
+@property (atomic, strong) FFSyntheticSource0x32 *syntheticSource;
 //音频格式转换器
-@property (nonatomic, strong) FFAudioResample0x32 *audioResample;
+@property (atomic, strong) FFAudioResample0x32 *audioResample;
+//采样缓存里的格式，交付时再转换成输出格式
+@property (nonatomic, assign) MRSampleFormat sampleRingFormat;
+@property (nonatomic, assign, readwrite) MRSampleFormat outputSampleFormat;
+@property (nonatomic, assign, readwrite) int outputChannels;
+//采样缓存格式到输出格式的特化交付函数，打开音频时选一次；为 NULL 时用通用的转换
+@property (atomic, assign, nullable) MRAudioDeliverFunc deliverFunc;
+//变速不变调，只在音频解码线程里使用
+@property (nonatomic, strong, nullable) FFTimeStretch0x32 *timeStretch;
+//电平表，在音频解码线程里创建和更新，任意线程读取结果
+@property (atomic, strong, nullable) MRAudioMeter *audioMeter;
+//多音轨混音，混音后的数据写进采样缓存
+@property (atomic, strong, nullable) FFAudioMixer0x32 *audioMixer;
+//第 1 路开始的音轨的解码器
+@property (atomic, copy, nullable) NSArray<FFDecoder0x32 *> *mixDecoders;
 //音频时钟
 @property (nonatomic, strong) FFSyncClock0x32 *audioClk;
 //视频时钟
@@ -54,6 +122,10 @@
 
 //PixelBuffer池可提升效率
 @property (assign, nonatomic) CVPixelBufferPoolRef pixelBufferPool;
+//PixelBuffer池对应的图像格式和尺寸，分辨率中途变化时要重建
+@property (assign, nonatomic) int poolFormat;
+@property (assign, nonatomic) int poolWidth;
+@property (assign, nonatomic) int poolHeight;
 @property (atomic, assign) int abort_request;
 
 @property (nonatomic, copy) dispatch_block_t onErrorBlock;
@@ -68,10 +140,20 @@
 @property (atomic, assign) BOOL eof;
 @property (atomic, assign) BOOL videoEnds;
 @property (atomic, assign) BOOL paused;
-@property (atomic, assign) BOOL audioFrameEmpty;
 @property (atomic, assign) BOOL videoFrameEmpty;
 @property (atomic, assign, readwrite) int videoFrameCount;
-@property (atomic, assign, readwrite) int audioFrameCount;
+//开始打开输入流的时间
+@property (nonatomic, assign) double openBeginTime;
+//选中的音视频流，解码器打开之前读包线程就要用来分发包
+@property (atomic, assign) int audioStreamIdx;
+@property (atomic, assign) int videoStreamIdx;
+//最优的音视频流，不管有没有选中，播放过程中修改媒体选择时使用
+@property (atomic, assign) int bestAudioStreamIdx;
+@property (atomic, assign) int bestVideoStreamIdx;
+//启动时的解码器都打开了，之后读包线程才能切换媒体选择
+@property (atomic, assign) BOOL streamsOpened;
+//媒体选择修改了，等读包线程处理
+@property (atomic, assign) BOOL mediaSelectionChanged;
 
 @end
 
@@ -80,7 +162,29 @@
 static int decode_interrupt_cb(void *ctx)
 {
     FFPlayer0x32 *player = (__bridge FFPlayer0x32 *)ctx;
-    return player.abort_request;
+    if (player.abort_request) {
+        return 1;
+    }
+    //阻塞在协议层的读操作会反复调用这里，超过截止时间就打断
+    const double deadline = player->_ioDeadline;
+    if (deadline > 0 && av_gettime_relative() / 1000000.0 > deadline) {
+        player->_ioTimedOut = player->_ioDeadlineKind;
+        return 1;
+    }
+    return 0;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _playbackRate = 1.0;
+        pthread_mutex_init(&_startupLock, NULL);
+        for (int t = 0; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+            _mixGain[t] = 1.0;
+        }
+    }
+    return self;
 }
 
 - (void)_stop
@@ -90,28 +194,65 @@ static int decode_interrupt_cb(void *ctx)
         self.abort_request = 1;
         _audioq.abort_request = 1;
         _videoq.abort_request = 1;
-        _sampq.abort_request = 1;
+        pcm_ring_abort(&_sampRing);
         _pictq.abort_request = 1;
+        [self abortMixQueues];
         
         [self.readThread cancel];
         [self.audioDecoder cancel];
         [self.videoDecoder cancel];
         [self.rendererThread cancel];
+        for (FFDecoder0x32 *decoder in self.mixDecoders) {
+            [decoder cancel];
+        }
         
         [self.readThread join];
+        //读包线程切换媒体选择时会重置停止标记，等它结束后再标记一次
+        _audioq.abort_request = 1;
+        _videoq.abort_request = 1;
+        pcm_ring_abort(&_sampRing);
+        _pictq.abort_request = 1;
+        [self abortMixQueues];
+        for (FFDecoder0x32 *decoder in self.mixDecoders) {
+            [decoder cancel];
+        }
         [self.audioDecoder join];
         [self.videoDecoder join];
         [self.rendererThread join];
+        for (FFDecoder0x32 *decoder in self.mixDecoders) {
+            [decoder join];
+        }
     }
     [self performSelectorOnMainThread:@selector(didStop:) withObject:self waitUntilDone:YES];
 }
 
 - (void)didStop:(id)sender
 {
+    if (self.videoDecoder.framePool) {
+        FFFramePoolStats0x32 st = [self.videoDecoder.framePool stats];
+        MRFF_INFO_LOG(@"video frame pool:gets:%lld,allocs:%lld,reuses:%lld,slabs:%d(%lld bytes),resets:%d",st.gets,st.allocs,st.reuses,st.slabs,st.slab_bytes,st.resets);
+    }
+    if (_syncStats.samples > 0) {
+        FFPlayer0x32SyncStats st = _syncStats;
+        MRFF_INFO_LOG(@"A-V sync:frames:%lld,mean:%0.1fms,max:%0.1fms,histogram:[%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld]",st.samples,st.mean_abs_error * 1000,st.max_abs_error * 1000,st.histogram[0],st.histogram[1],st.histogram[2],st.histogram[3],st.histogram[4],st.histogram[5],st.histogram[6],st.histogram[7],st.histogram[8],st.histogram[9],st.histogram[10]);
+    }
+    if (self.audioResample) {
+        FFAudioResampleStats0x32 st = [self.audioResample stats];
+        MRFF_INFO_LOG(@"audio resample:profile:%d,frames:%lld,bypassed:%lld,avg:%0.3fms,max:%0.3fms",(int)self.audioResample.profile,st.frames,st.bypassed,st.frames > 0 ? st.total_time * 1000 / st.frames : 0,st.max_time * 1000);
+    }
+    if (self.audioMixer) {
+        FFAudioMixerStats0x32 st = [self.audioMixer stats];
+        MRFF_INFO_LOG(@"audio mixer:tracks:%d,blocks:%lld,underruns:%lld,dropped:%lld,avg:%0.3fms,max:%0.3fms",self.audioMixer.tracks,st.blocks,st.underruns,st.dropped,st.blocks > 0 ? st.total_time * 1000 / st.blocks : 0,st.max_time * 1000);
+    }
     self.readThread = nil;
     self.audioDecoder = nil;
     self.videoDecoder = nil;
+    self.mixDecoders = nil;
+    for (int t = 0; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        _mixResample[t] = nil;
+    }
     self.rendererThread = nil;
+    self.syntheticSource = nil;
     
     if (self.pixelBufferPool){
         CVPixelBufferPoolRelease(self.pixelBufferPool);
@@ -120,13 +261,17 @@ static int decode_interrupt_cb(void *ctx)
     
     packet_queue_destroy(&_audioq);
     packet_queue_destroy(&_videoq);
+    for (int t = 1; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        packet_queue_destroy(&_mixq[t]);
+    }
     
     frame_queue_destory(&_pictq);
-    frame_queue_destory(&_sampq);
+    pcm_ring_destroy(&_sampRing);
 }
 
 - (void)dealloc
 {
+    pthread_mutex_destroy(&_startupLock);
     PRINT_DEALLOC;
 }
 
@@ -141,13 +286,34 @@ static int decode_interrupt_cb(void *ctx)
     packet_queue_init(&_videoq);
     //初始化音频包队列
     packet_queue_init(&_audioq);
+    //混音时其余音轨的包队列
+    for (int t = 1; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        packet_queue_init(&_mixq[t]);
+    }
+    _mixTrackCount = 0;
     //初始化ffmpeg相关函数
     init_ffmpeg_once();
     
     //初始化视频帧队列
     frame_queue_init(&_pictq, VIDEO_PICTURE_QUEUE_SIZE, "pictq", 1);
-    //初始化音频帧队列
-    frame_queue_init(&_sampq, SAMPLE_QUEUE_SIZE, "sampq", 1);
+    //音频采样缓存在音频格式确定后创建
+    memset(&_sampRing, 0, sizeof(_sampRing));
+    
+    self.audioStreamIdx = -1;
+    self.videoStreamIdx = -1;
+    self.bestAudioStreamIdx = -1;
+    self.bestVideoStreamIdx = -1;
+    self.streamsOpened = NO;
+    self.mediaSelectionChanged = NO;
+    _videoWaitKeyframe = NO;
+    pthread_mutex_lock(&_startupLock);
+    memset(&_startupTimings, 0, sizeof(_startupTimings));
+    pthread_mutex_unlock(&_startupLock);
+    memset(&_ioStatus, 0, sizeof(_ioStatus));
+    memset(&_syncStats, 0, sizeof(_syncStats));
+    _ioDeadline = 0;
+    _ioTimedOut = FFIOTimeoutNone;
+    _ioWaitBegin = 0;
     
     self.readThread = [[MRThread alloc] initWithTarget:self selector:@selector(readPacketsFunc) object:nil];
     self.readThread.name = @"mr-read";
@@ -160,23 +326,23 @@ static int decode_interrupt_cb(void *ctx)
 {
     self.videoClk = [[FFSyncClock0x32 alloc] init];
     [self.videoClk setClock:0];
+    self.videoClk.speed = self.playbackRate;
+    //预加载时是以暂停状态打开的
+    self.videoClk.paused = self.paused;
 }
 
 - (void)initAudioClock
 {
     self.audioClk = [[FFSyncClock0x32 alloc] init];
     [self.audioClk setClock:0];
-    enum AVSampleFormat fmt = 0;
-    if (self.audioResample) {
-        fmt = self.audioResample.out_sample_fmt;
-    } else {
-        fmt = self.audioDecoder.format;
-    }
+    self.audioClk.speed = self.playbackRate;
+    self.audioClk.paused = self.paused;
+    const MRSampleFormat fmt = self.outputSampleFormat;
     
     int bytesPerSample = 0;
-    if (fmt == AV_SAMPLE_FMT_FLT || fmt == AV_SAMPLE_FMT_FLTP) {
+    if (MR_Sample_Fmt_Is_FloatX(fmt)) {
         bytesPerSample = sizeof(float);
-    } else if (fmt == AV_SAMPLE_FMT_S16 || fmt == AV_SAMPLE_FMT_S16P) {
+    } else if (MR_Sample_Fmt_Is_S16X(fmt)) {
         bytesPerSample = sizeof(int16_t);
     }
     self.audioClk.bytesPerSample = bytesPerSample;
@@ -184,12 +350,15 @@ static int decode_interrupt_cb(void *ctx)
 
 #pragma mark - 打开解码器创建解码线程
 
-- (FFDecoder0x32 *)openStreamComponent:(AVFormatContext *)ic streamIdx:(int)idx
+//在读包线程里创建解码器并拷贝流参数，之后在别的线程打开时不再访问 ic
+- (FFDecoder0x32 *)createStreamComponent:(AVFormatContext *)ic streamIdx:(int)idx
 {
     FFDecoder0x32 *decoder = [FFDecoder0x32 new];
     decoder.ic = ic;
     decoder.streamIdx = idx;
-    if ([decoder open] == 0) {
+    //视频帧从解码器的内存池分配并复用，按 CVPixelBuffer 的对齐分配，不需要转换格式的帧可以直接包装
+    decoder.linesizeAlignment = MR_PIXEL_BUFFER_ALIGNMENT;
+    if ([decoder copyStreamParameters] == 0) {
         return decoder;
     } else {
         return nil;
@@ -210,10 +379,24 @@ static int decode_interrupt_cb(void *ctx)
             break;
         }
         
+        //播放过程中修改了媒体选择，在读包线程里关掉或打开对应的流
+        if (self.mediaSelectionChanged && self.streamsOpened) {
+            self.mediaSelectionChanged = NO;
+            [self applyMediaSelection:formatCtx];
+            continue;
+        }
+        
         /* 队列不满继续读，满了则休眠10 ms */
-        if (_audioq.size + _videoq.size > MAX_QUEUE_SIZE
-            || (stream_has_enough_packets(self.audioDecoder.stream, self.audioDecoder.streamIdx, &_audioq) &&
-                stream_has_enough_packets(self.videoDecoder.stream, self.videoDecoder.streamIdx, &_videoq))) {
+        const int audioIdx = self.audioStreamIdx;
+        const int videoIdx = self.videoStreamIdx;
+        AVStream *audioSt = audioIdx >= 0 ? formatCtx->streams[audioIdx] : NULL;
+        AVStream *videoSt = videoIdx >= 0 ? formatCtx->streams[videoIdx] : NULL;
+        //关掉音频时混音的音轨也一起关掉了
+        const int mixTracks = audioIdx >= 0 ? _mixTrackCount : 0;
+        if (_audioq.size + _videoq.size + [self mixQueuesSize:mixTracks] > MAX_QUEUE_SIZE
+            || (stream_has_enough_packets(audioSt, audioIdx, &_audioq) &&
+                stream_has_enough_packets(videoSt, videoIdx, &_videoq) &&
+                [self mixQueues:formatCtx haveEnoughPackets:mixTracks])) {
             
             if (!self.packetBufferIsFull) {
                 self.packetBufferIsFull = YES;
@@ -221,29 +404,50 @@ static int decode_interrupt_cb(void *ctx)
                     self.onPacketBufferFullBlock();
                 }
             }
+            //队列满了不算卡顿
+            _ioWaitBegin = 0;
             /* wait 10 ms */
             mr_msleep(10);
             continue;
         }
         
         self.packetBufferIsFull = NO;
+        if (_ioWaitBegin <= 0) {
+            _ioWaitBegin = av_gettime_relative() / 1000000.0;
+        }
         //读包
-        int ret = av_read_frame(formatCtx, pkt);
+        [self beginReadIO];
+        FFSyntheticSource0x32 *synthetic = self.syntheticSource;
+        int ret = synthetic ? [synthetic readPacket:pkt] : av_read_frame(formatCtx, pkt);
+        [self endIO];
         //读包出错
         if (ret < 0) {
+            //超时了，不再读包
+            if (_ioTimedOut != FFIOTimeoutNone) {
+                [self onIOTimeout:_ioTimedOut];
+                break;
+            }
+            
             //读到最后结束了
             if ((ret == AVERROR_EOF || avio_feof(formatCtx->pb)) && !self.eof) {
                 //最后放一个空包进去
-                if (self.audioDecoder.streamIdx >= 0) {
-                    packet_queue_put_nullpacket(&_audioq, self.audioDecoder.streamIdx);
+                if (audioIdx >= 0) {
+                    packet_queue_put_nullpacket(&_audioq, audioIdx);
                 }
                     
-                if (self.videoDecoder.streamIdx >= 0) {
-                    packet_queue_put_nullpacket(&_videoq, self.videoDecoder.streamIdx);
+                if (videoIdx >= 0) {
+                    packet_queue_put_nullpacket(&_videoq, videoIdx);
+                }
+                for (int t = 1; t < mixTracks; t++) {
+                    packet_queue_put_nullpacket(&_mixq[t], _mixStreamIdx[t]);
                 }
                 //标志为读包结束
                 self.eof = 1;
             }
+            //读完了不算卡顿
+            if (self.eof) {
+                _ioWaitBegin = 0;
+            }
             
             if (formatCtx->pb && formatCtx->pb->error) {
                 break;
@@ -252,13 +456,25 @@ static int decode_interrupt_cb(void *ctx)
             mr_msleep(10);
             continue;
         } else {
+            [self markStartupPhase:&_startupTimings.first_packet];
+            [self updateStallStatus];
+            const int mixTrack = [self mixTrackOfStream:pkt->stream_index tracks:mixTracks];
             //音频包入音频队列
-            if (pkt->stream_index == self.audioDecoder.streamIdx) {
+            if (pkt->stream_index == audioIdx) {
                 packet_queue_put(&_audioq, pkt);
             }
-            //视频包入视频队列
-            else if (pkt->stream_index == self.videoDecoder.streamIdx) {
-                packet_queue_put(&_videoq, pkt);
+            //视频包入视频队列，中途打开的视频从关键帧开始
+            else if (pkt->stream_index == videoIdx) {
+                if (_videoWaitKeyframe && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+                    av_packet_unref(pkt);
+                } else {
+                    _videoWaitKeyframe = NO;
+                    packet_queue_put(&_videoq, pkt);
+                }
+            }
+            //混音的其他音轨
+            else if (mixTrack > 0) {
+                packet_queue_put(&_mixq[mixTrack], pkt);
             }
             //其他包释放内存忽略掉
             else {
@@ -300,6 +516,143 @@ static int decode_interrupt_cb(void *ctx)
     (*st_index)[AVMEDIA_TYPE_AUDIO] = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, (*st_index)[AVMEDIA_TYPE_AUDIO], (*st_index)[AVMEDIA_TYPE_VIDEO], NULL, 0);
 }
 
+//按媒体选择去掉不需要的流，去掉的流保持丢弃，不会读进包队列；选中的流不存在时忽略媒体选择
+- (void)selectStreams:(int (*) [AVMEDIA_TYPE_NB])st_index
+{
+    const FFPlayer0x32MediaSelection selection = self.mediaSelection;
+    if (selection == FFPlayer0x32MediaSelectionAudioOnly && (*st_index)[AVMEDIA_TYPE_AUDIO] >= 0) {
+        (*st_index)[AVMEDIA_TYPE_VIDEO] = -1;
+    } else if (selection == FFPlayer0x32MediaSelectionVideoOnly && (*st_index)[AVMEDIA_TYPE_VIDEO] >= 0) {
+        (*st_index)[AVMEDIA_TYPE_AUDIO] = -1;
+    }
+}
+
+#pragma mark - 探测流信息
+
+//头部信息完整的封装格式，打开时就能知道全部的流，适合从很小的探测量开始
+- (BOOL)hasFullHeader:(AVFormatContext *)formatCtx
+{
+    const char *name = formatCtx->iformat ? formatCtx->iformat->name : NULL;
+    if (!name) {
+        return NO;
+    }
+    return strstr(name, "mov") || strstr(name, "mp4") || strstr(name, "matroska") || strstr(name, "webm");
+}
+
+//选中的流参数是否已经够用了（够创建解码器和格式转换器）
+- (BOOL)isStreamUsable:(AVStream *)st
+{
+    AVCodecParameters *par = st->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE) {
+        return NO;
+    }
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return par->width > 0 && par->height > 0 && par->format != AV_PIX_FMT_NONE;
+    } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+        return par->sample_rate > 0 && par->channels > 0 && par->format != AV_SAMPLE_FMT_NONE;
+    }
+    return YES;
+}
+
+- (BOOL)isBestStreamsUsable:(AVFormatContext *)formatCtx
+{
+    int st_index[AVMEDIA_TYPE_NB];
+    memset(st_index, -1, sizeof(st_index));
+    [self findBestStreams:formatCtx result:&st_index];
+    //不需要的流不用等它的参数
+    [self selectStreams:&st_index];
+    
+    BOOL found = NO;
+    for (int type = 0; type < AVMEDIA_TYPE_NB; type++) {
+        int idx = st_index[type];
+        if (idx < 0) {
+            continue;
+        }
+        AVStream *st = formatCtx->streams[idx];
+        //后续继续探测时只读选中的流，其他流已被 findBestStreams 丢弃
+        st->discard = AVDISCARD_DEFAULT;
+        if (![self isStreamUsable:st]) {
+            return NO;
+        }
+        found = YES;
+    }
+    return found;
+}
+
+/*
+ 自适应探测：
+ 头部完整的封装格式（mp4/mov/mkv）先用 32KB 的探测量，只要 findBestStreams 选中的流参数可用就立即结束；
+ 否则每次按 4 倍增长，直到达到原来的固定上限（500KB/5s）。
+ 其他封装格式仍旧使用固定的探测量。
+ */
+- (int)findStreamInfo:(AVFormatContext *)formatCtx cacheResult:(FFStreamInfoCacheResult)cacheResult
+{
+    /* 刚才只是打开了文件，检测了下文件头而已，并不知道流信息；因此开始读包以获取流信息
+     设置读包探测大小和最大时长，避免读太多的包！
+    */
+    const int64_t max_probesize = 500 * 1024;
+    const int64_t max_analyze_duration = 5 * AV_TIME_BASE;
+    
+    if (cacheResult != FFStreamInfoCacheMiss) {
+        //流都已创建并填充了缓存的参数，只需读很少的包补齐缓存以外的字段（解码器延迟、由 extradata 解析的参数等）
+        [self markProbeMode:FFPlayer0x32ProbeModeCached rounds:1];
+        formatCtx->probesize = 32 * 1024;
+        formatCtx->max_analyze_duration = AV_TIME_BASE / 2;
+        return avformat_find_stream_info(formatCtx, NULL);
+    }
+    
+    if (!self.adaptiveProbe || ![self hasFullHeader:formatCtx]) {
+        [self markProbeMode:FFPlayer0x32ProbeModeFixed rounds:1];
+        formatCtx->probesize = max_probesize;
+        formatCtx->max_analyze_duration = max_analyze_duration;
+        return avformat_find_stream_info(formatCtx, NULL);
+    }
+    
+    int64_t probesize = 32 * 1024;
+    int64_t analyze_duration = AV_TIME_BASE / 4;
+    int round = 0;
+    for (;;) {
+        formatCtx->probesize = probesize;
+        formatCtx->max_analyze_duration = analyze_duration;
+        int ret = avformat_find_stream_info(formatCtx, NULL);
+        round++;
+        [self markProbeMode:FFPlayer0x32ProbeModeAdaptive rounds:round];
+        if (ret < 0) {
+            return ret;
+        }
+        if (self.abort_request) {
+            return AVERROR_EXIT;
+        }
+        if ([self isBestStreamsUsable:formatCtx]) {
+            av_log(NULL, AV_LOG_INFO, "adaptive probe done:%lldKB,%d round\n", probesize / 1024, round);
+            return 0;
+        }
+        if (probesize >= max_probesize) {
+            //已达上限，参数不全的流交给后面的打开解码器流程去处理
+            return 0;
+        }
+        probesize = FFMIN(probesize * 4, max_probesize);
+        analyze_duration = FFMIN(analyze_duration * 4, max_analyze_duration);
+    }
+}
+
+//缓存里的流索引需要和当前流的类型对得上
+- (BOOL)isValidStreams:(AVFormatContext *)formatCtx index:(int (*) [AVMEDIA_TYPE_NB])st_index
+{
+    BOOL found = NO;
+    for (int type = 0; type < AVMEDIA_TYPE_NB; type++) {
+        int idx = (*st_index)[type];
+        if (idx < 0) {
+            continue;
+        }
+        if (idx >= formatCtx->nb_streams || formatCtx->streams[idx]->codecpar->codec_type != type) {
+            return NO;
+        }
+        found = YES;
+    }
+    return found;
+}
+
 #pragma mark - 视频像素格式转换
 
 - (FFVideoScale *)createVideoScaleIfNeed
@@ -313,38 +666,35 @@ static int decode_interrupt_cb(void *ctx)
     //当前视频的像素格式
     const enum AVPixelFormat format = self.videoDecoder.format;
     
-    bool matched = false;
-    MRPixelFormat firstSupportedFmt = MR_PIX_FMT_NONE;
-    for (int i = MR_PIX_FMT_BEGIN; i <= MR_PIX_FMT_END; i ++) {
-        const MRPixelFormat fmt = i;
-        const MRPixelFormatMask mask = 1 << fmt;
-        if (self.supportedPixelFormats & mask) {
-            if (firstSupportedFmt == MR_PIX_FMT_NONE) {
-                firstSupportedFmt = fmt;
-            }
-            
-            if (format == MRPixelFormat2AV(fmt)) {
-                matched = true;
-                break;
-            }
-        }
-    }
+    //按转换代价挑选目标格式，而不是取枚举值最小的那个
+    int dest = [FFVideoScale negotiateDstPixFmt:format supportedPixelFormats:self.supportedPixelFormats];
     
-    if (matched) {
+    //视频比期望的输出尺寸大，即使格式一致也需要缩小
+    const int maxWidth = (int)self.outputSize.width;
+    const int maxHeight = (int)self.outputSize.height;
+    const BOOL needResize = (maxWidth > 0 && self.videoDecoder.picWidth > maxWidth) || (maxHeight > 0 && self.videoDecoder.picHeight > maxHeight);
+    
+    if (dest == format && !needResize) {
         //期望像素格式包含了当前视频像素格式，则直接使用当前格式，不再转换。
         av_log(NULL, AV_LOG_INFO, "video not need rescale!\n");
         return nil;
     }
     
-    if (firstSupportedFmt == MR_PIX_FMT_NONE) {
+    if (dest == AV_PIX_FMT_NONE) {
         NSAssert(NO, @"supportedPixelFormats is invalid!");
         return nil;
     }
     
-    int dest = MRPixelFormat2AV(firstSupportedFmt);
     if ([FFVideoScale checkCanConvertFrom:format to:dest]) {
         //创建像素格式转换上下文
         FFVideoScale *scale = [[FFVideoScale alloc] initWithSrcPixFmt:format dstPixFmt:dest picWidth:self.videoDecoder.picWidth picHeight:self.videoDecoder.picHeight];
+        scale.profile = self.videoScaleProfile;
+        scale.maxOutputWidth = maxWidth;
+        scale.maxOutputHeight = maxHeight;
+        //1080p 以上的图像单核转换跟不上解码，分片并发转换
+        if (self.videoDecoder.picWidth * self.videoDecoder.picHeight > 1920 * 1080) {
+            scale.sliceCount = (int)FFMIN([[NSProcessInfo processInfo] activeProcessorCount], 4);
+        }
         return scale;
     } else {
         //TODO ??
@@ -352,6 +702,39 @@ static int decode_interrupt_cb(void *ctx)
     }
 }
 
+//解码出来的声道数
+- (int)decodedChannels
+{
+    int channels = av_get_channel_layout_nb_channels(self.audioDecoder.channelLayout);
+    if (channels <= 0) {
+        channels = self.audioDecoder.channels;
+    }
+    return channels;
+}
+
+//音频的声道数在期望的声道布局里就直接使用，否则使用不超过它的最多声道数，都超过时使用最少的；未指定时使用双声道
+- (int)negotiateChannels:(int)channels
+{
+    MRChannelLayoutMask mask = self.supportedChannelLayouts;
+    if (mask == MR_CH_LAYOUT_MASK_NONE) {
+        mask = MR_CH_LAYOUT_MASK_STEREO;
+    }
+    if (MR_Channel_Layout_Mask_Has(mask, channels)) {
+        return channels;
+    }
+    for (int c = FFMIN(channels, MR_CH_LAYOUT_MAX_CHANNELS); c > 0; c--) {
+        if (MR_Channel_Layout_Mask_Has(mask, c)) {
+            return c;
+        }
+    }
+    for (int c = channels + 1; c <= MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        if (MR_Channel_Layout_Mask_Has(mask, c)) {
+            return c;
+        }
+    }
+    return 2;
+}
+
 - (FFAudioResample0x32 *)createAudioResampleIfNeed
 {
     //未指定期望音频格式
@@ -365,14 +748,19 @@ static int decode_interrupt_cb(void *ctx)
         self.supportedSampleRate = self.audioDecoder.sampleRate;
     }
     
-    //当前视频的像素格式
+    //当前音频的采样格式
     const enum AVSampleFormat format = self.audioDecoder.format;
     
+    //解码出来的格式是否是交付时可以直接转换的格式
+    MRSampleFormat decodedFmt = MR_SAMPLE_FMT_NONE;
     bool matched = false;
     MRSampleFormat firstSupportedFmt = MR_SAMPLE_FMT_NONE;
     for (int i = MR_SAMPLE_FMT_BEGIN; i <= MR_SAMPLE_FMT_END; i ++) {
         const MRSampleFormat fmt = i;
         const MRSampleFormatMask mask = 1 << fmt;
+        if (format == MRSampleFormat2AV(fmt)) {
+            decodedFmt = fmt;
+        }
         if (self.supportedSampleFormats & mask) {
             if (firstSupportedFmt == MR_SAMPLE_FMT_NONE) {
                 firstSupportedFmt = fmt;
@@ -380,42 +768,82 @@ static int decode_interrupt_cb(void *ctx)
             
             if (format == MRSampleFormat2AV(fmt)) {
                 matched = true;
-                break;
             }
         }
     }
     
-    if (matched) {
-        //采样率不匹配
-        if (self.supportedSampleRate != self.audioDecoder.sampleRate) {
-            firstSupportedFmt = AVSampleFormat2MR(format);
-            matched = NO;
-        }
+    if (firstSupportedFmt == MR_SAMPLE_FMT_NONE) {
+        NSAssert(NO, @"supportedSampleFormats is invalid!");
+        return nil;
     }
     
-    if (matched) {
-        //期望音频格式包含了当前音频格式，则直接使用当前格式，不再转换。
+    //期望音频格式包含了当前音频格式，则输出当前格式
+    const MRSampleFormat outFmt = matched ? decodedFmt : firstSupportedFmt;
+    const int channels = [self decodedChannels];
+    const int outChannels = [self negotiateChannels:channels];
+    self.outputSampleFormat = outFmt;
+    self.outputChannels = outChannels;
+    
+    //采样率和声道数都不变时不用 swr，S16/FLT 之间的转换和交错/解交错在交付时完成
+    if (decodedFmt != MR_SAMPLE_FMT_NONE && self.supportedSampleRate == self.audioDecoder.sampleRate && outChannels == channels) {
+        self.sampleRingFormat = decodedFmt;
         av_log(NULL, AV_LOG_INFO, "audio not need resample!\n");
         return nil;
     }
+    self.sampleRingFormat = outFmt;
     
-    if (firstSupportedFmt == MR_SAMPLE_FMT_NONE) {
-        NSAssert(NO, @"supportedSampleFormats is invalid!");
-        return nil;
+    int64_t srcLayout = self.audioDecoder.channelLayout;
+    if (av_get_channel_layout_nb_channels(srcLayout) != channels) {
+        srcLayout = av_get_default_channel_layout(channels);
     }
+    const int64_t dstLayout = outChannels == channels ? srcLayout : av_get_default_channel_layout(outChannels);
     
-    //创建音频格式转换上下文
+    //创建音频格式转换上下文，声道数变化时 swr 同时完成混音
     FFAudioResample0x32 *resample = [[FFAudioResample0x32 alloc] initWithSrcSampleFmt:format
-                                                                         dstSampleFmt:MRSampleFormat2AV(firstSupportedFmt)
-                                                                           srcChannel:self.audioDecoder.channelLayout
-                                                                           dstChannel:self.audioDecoder.channelLayout
+                                                                         dstSampleFmt:MRSampleFormat2AV(outFmt)
+                                                                           srcChannel:srcLayout
+                                                                           dstChannel:dstLayout
                                                                               srcRate:self.audioDecoder.sampleRate
-                                                                              dstRate:self.supportedSampleRate];
+                                                                              dstRate:self.supportedSampleRate
+                                                                              profile:self.audioResampleProfile];
     return resample;
 }
 
+//合成的媒体源不需要打开和探测，流信息在创建时就是完整的
+- (AVFormatContext *)openSyntheticSource
+{
+    FFSyntheticSource0x32 *source = [[FFSyntheticSource0x32 alloc] initWithURL:self.contentPath];
+    self.openBeginTime = av_gettime_relative() / 1000000.0;
+    if ([source open] != 0) {
+        self.error = _make_nserror_desc(FFPlayerErrorCode_OpenFileFailed, @"合成媒体源创建失败！");
+        [self performErrorResultOnMainThread];
+        return NULL;
+    }
+    //停止或读包超时时打断直播模式的等待
+    source.formatContext->interrupt_callback.callback = decode_interrupt_cb;
+    source.formatContext->interrupt_callback.opaque = (__bridge void *)self;
+    self.syntheticSource = source;
+    [self markStartupPhase:&_startupTimings.open_input];
+    [self markStartupPhase:&_startupTimings.find_stream_info];
+    return source.formatContext;
+}
+
 - (void)readPacketsFunc
 {
+    if ([FFSyntheticSource0x32 isSyntheticURL:self.contentPath]) {
+        AVFormatContext *formatCtx = [self openSyntheticSource];
+        if (formatCtx) {
+            self.max_frame_duration = 3600.0;
+            int st_index[AVMEDIA_TYPE_NB];
+            memset(st_index, -1, sizeof(st_index));
+            [self findBestStreams:formatCtx result:&st_index];
+            [self startPlaybackWithFormatContext:formatCtx streams:st_index];
+            //formatCtx 由 syntheticSource 释放
+            MRFF_INFO_LOG(@"%@", [self.syntheticSource statsDescription]);
+        }
+        return;
+    }
+    
     if (![self.contentPath hasPrefix:@"/"]) {
         _init_net_work_once();
     }
@@ -437,175 +865,954 @@ static int decode_interrupt_cb(void *ctx)
     //低版本是 av_open_input_file 方法
     const char *moviePath = [self.contentPath cStringUsingEncoding:NSUTF8StringEncoding];
     
+    self.openBeginTime = av_gettime_relative() / 1000000.0;
+    //打开和探测流信息共用一个截止时间
+    [self beginIO:FFIOTimeoutOpen timeout:self.openTimeout];
     //打开文件流，读取头信息；
     if (0 != avformat_open_input(&formatCtx, moviePath , NULL, NULL)) {
+        [self endIO];
         //释放内存
         avformat_free_context(formatCtx);
         //当取消掉时，不给上层回调
         if (self.abort_request) {
             return;
         }
+        if (_ioTimedOut != FFIOTimeoutNone) {
+            [self onIOTimeout:_ioTimedOut];
+            return;
+        }
         self.error = _make_nserror_desc(FFPlayerErrorCode_OpenFileFailed, @"文件打开失败！");
         [self performErrorResultOnMainThread];
         return;
     }
+    [self markStartupPhase:&_startupTimings.open_input];
+    
+    int st_index[AVMEDIA_TYPE_NB];
+    memset(st_index, -1, sizeof(st_index));
+    
+    //命中流信息缓存时，直接填充上次的探测结果
+    FFStreamInfoCacheResult cacheResult = FFStreamInfoCacheMiss;
+    if (self.useStreamInfoCache) {
+        cacheResult = [[FFStreamInfoCache sharedCache] applyForPath:self.contentPath context:formatCtx bestStreams:st_index count:AVMEDIA_TYPE_NB];
+    }
     
-    /* 刚才只是打开了文件，检测了下文件头而已，并不知道流信息；因此开始读包以获取流信息
-     设置读包探测大小和最大时长，避免读太多的包！
-    */
-    formatCtx->probesize = 500 * 1024;
-    formatCtx->max_analyze_duration = 5 * AV_TIME_BASE;
 #if DEBUG
     NSTimeInterval begin = [[NSDate date] timeIntervalSinceReferenceDate];
 #endif
-    if (0 != avformat_find_stream_info(formatCtx, NULL)) {
+    if (0 != [self findStreamInfo:formatCtx cacheResult:cacheResult]) {
+        [self endIO];
+        //出错了，销毁下相关结构体
         avformat_close_input(&formatCtx);
+        if (self.abort_request) {
+            return;
+        }
+        if (_ioTimedOut != FFIOTimeoutNone) {
+            [self onIOTimeout:_ioTimedOut];
+            return;
+        }
         self.error = _make_nserror_desc(FFPlayerErrorCode_StreamNotFound, @"不能找到流！");
         [self performErrorResultOnMainThread];
-        //出错了，销毁下相关结构体
-        avformat_close_input(&formatCtx);
         return;
     }
+    [self endIO];
     
+    [self markStartupPhase:&_startupTimings.find_stream_info];
 #if DEBUG
     NSTimeInterval end = [[NSDate date] timeIntervalSinceReferenceDate];
     //用于查看详细信息，调试的时候打出来看下很有必要
     av_dump_format(formatCtx, 0, moviePath, false);
     
-    MRFF_DEBUG_LOG(@"avformat_find_stream_info coast time:%g",end-begin);
+    MRFF_DEBUG_LOG(@"avformat_find_stream_info coast time:%g,stream info cache:%d,adaptive probe:%d",end-begin,(int)cacheResult,self.adaptiveProbe);
 #endif
     self.max_frame_duration = (formatCtx->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
     //确定最优的音视频流
-    int st_index[AVMEDIA_TYPE_NB];
-    memset(st_index, -1, sizeof(st_index));
-    [self findBestStreams:formatCtx result:&st_index];
-    
-    //打开音频解码器，创建解码线程
-    if (st_index[AVMEDIA_TYPE_AUDIO] >= 0){
-        
-        self.audioDecoder = [self openStreamComponent:formatCtx streamIdx:st_index[AVMEDIA_TYPE_AUDIO]];
-        
-        if(self.audioDecoder){
-            self.audioDecoder.delegate = self;
-            self.audioDecoder.name = @"mr-audio-dec";
-            self.audioResample = [self createAudioResampleIfNeed];
-        } else {
-            av_log(NULL, AV_LOG_ERROR, "can't open audio stream.\n");
-            self.error = _make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"音频流打开失败！");
-            [self performErrorResultOnMainThread];
-            //出错了，销毁下相关结构体
-            avformat_close_input(&formatCtx);
-            return;
+    if (cacheResult == FFStreamInfoCacheHitFull && [self isValidStreams:formatCtx index:&st_index]) {
+        //使用缓存的选择结果，其他流同样丢弃掉
+        for (int i = 0; i < formatCtx->nb_streams; i++) {
+            formatCtx->streams[i]->discard = AVDISCARD_ALL;
         }
-        
-        if ([self.delegate respondsToSelector:@selector(onInitAudioRender:)]) {
-            if (self.audioResample) {
-                [self.delegate onInitAudioRender:AVSampleFormat2MR(self.audioResample.out_sample_fmt)];
-            } else {
-                [self.delegate onInitAudioRender:AVSampleFormat2MR(self.audioDecoder.format)];
-            }
+    } else {
+        memset(st_index, -1, sizeof(st_index));
+        [self findBestStreams:formatCtx result:&st_index];
+        if (self.useStreamInfoCache) {
+            [[FFStreamInfoCache sharedCache] storeForPath:self.contentPath context:formatCtx bestStreams:st_index count:AVMEDIA_TYPE_NB];
         }
     }
+    
+    [self startPlaybackWithFormatContext:formatCtx streams:st_index];
+    //读包线程结束了，销毁下相关结构体
+    avformat_close_input(&formatCtx);
+}
 
-    //打开视频解码器，创建解码线程
-    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0){
-        self.videoDecoder = [self openStreamComponent:formatCtx streamIdx:st_index[AVMEDIA_TYPE_VIDEO]];
-        if(self.videoDecoder){
-            self.videoDecoder.delegate = self;
-            self.videoDecoder.name = @"mr-video-dec";
-            self.videoScale = [self createVideoScaleIfNeed];
-        } else {
-            av_log(NULL, AV_LOG_ERROR, "can't open video stream.");
-            self.error = _make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"视频流打开失败！");
-            [self performErrorResultOnMainThread];
-            //出错了，销毁下相关结构体
-            avformat_close_input(&formatCtx);
-            return;
-        }
-    }
+//打开选中的流并开始读包，读包结束后返回
+- (void)startPlaybackWithFormatContext:(AVFormatContext *)formatCtx streams:(int *)st_index
+{
+    //混音时主音轨换成 mixAudioStreams 的第一路
+    [self resolveMixTracks:formatCtx audioIdx:&st_index[AVMEDIA_TYPE_AUDIO]];
+    self.bestAudioStreamIdx = st_index[AVMEDIA_TYPE_AUDIO];
+    self.bestVideoStreamIdx = st_index[AVMEDIA_TYPE_VIDEO];
+    //只打开媒体选择需要的流
+    int selected[AVMEDIA_TYPE_NB];
+    memcpy(selected, st_index, sizeof(selected));
+    [self selectStreams:&selected];
+    self.audioStreamIdx = selected[AVMEDIA_TYPE_AUDIO];
+    self.videoStreamIdx = selected[AVMEDIA_TYPE_VIDEO];
+    
     self.duration = (long)(formatCtx->duration/AV_TIME_BASE);
     if ([self.delegate respondsToSelector:@selector(onDurationUpdate:)]) {
         [self.delegate onDurationUpdate:self.duration];
     }
-    //初始化同步时钟
-    [self initVideoClock];
-    [self initAudioClock];
-    //音视频解码线程开始工作
-    [self.audioDecoder start];
-    [self.videoDecoder start];
-    //准备渲染线程
-    [self prepareRendererThread];
-    //渲染线程开始工作
-    [self.rendererThread start];
+    
+    /*
+     打开解码器、创建格式转换器和读包并行：
+     音视频解码器分别在并发队列里打开，各自打开后立即开始解码，视频不必等音频；
+     读包线程不等解码器，直接开始读包，包会先缓存在队列里；
+     两个解码器都打开后再开始渲染。
+     */
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    
+    //block 里不能捕获数组
+    const int audioIdx = selected[AVMEDIA_TYPE_AUDIO];
+    const int videoIdx = selected[AVMEDIA_TYPE_VIDEO];
+    //解码器打开前就开始读包了，选中的流不能被丢弃
+    if (audioIdx >= 0) {
+        formatCtx->streams[audioIdx]->discard = AVDISCARD_DEFAULT;
+        for (int t = 1; t < _mixTrackCount; t++) {
+            formatCtx->streams[_mixStreamIdx[t]]->discard = AVDISCARD_DEFAULT;
+        }
+    }
+    if (videoIdx >= 0) {
+        formatCtx->streams[videoIdx]->discard = AVDISCARD_DEFAULT;
+    }
+    //读包时解封装器可能修改流参数，所以先在这里把流参数拷贝到解码器里，并行打开时只用拷贝
+    FFDecoder0x32 *audioDecoder = audioIdx >= 0 ? [self createStreamComponent:formatCtx streamIdx:audioIdx] : nil;
+    NSArray<FFDecoder0x32 *> *mixDecoders = audioIdx >= 0 ? [self createMixDecoders:formatCtx] : nil;
+    FFDecoder0x32 *videoDecoder = videoIdx >= 0 ? [self createStreamComponent:formatCtx streamIdx:videoIdx] : nil;
+    //打开音频解码器，创建解码线程
+    if (audioIdx >= 0){
+        dispatch_group_async(group, queue, ^{
+            [self openAudioComponent:audioDecoder mixDecoders:mixDecoders];
+        });
+    }
+    
+    //打开视频解码器，创建解码线程
+    if (videoIdx >= 0){
+        dispatch_group_async(group, queue, ^{
+            [self openVideoComponent:videoDecoder];
+        });
+    }
+    
+    dispatch_group_notify(group, queue, ^{
+        if (self.abort_request) {
+            return;
+        }
+        //初始化同步时钟
+        [self initVideoClock];
+        [self initAudioClock];
+        //没有选中的流不参与同步，也不用等它播放完毕
+        self.audioClk.eof = audioIdx < 0;
+        self.videoClk.eof = videoIdx < 0;
+        //准备渲染线程
+        [self prepareRendererThread];
+        //渲染线程开始工作
+        [self.rendererThread start];
+        self.streamsOpened = YES;
+    });
+    
     //循环读包
     [self readPacketLoop:formatCtx];
-    //读包线程结束了，销毁下相关结构体
-    avformat_close_input(&formatCtx);
+    //解码器可能还在打开，要等它们用完 formatCtx
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
 }
 
-#pragma mark - FFDecoderDelegate0x32
-
-- (int)decoder:(FFDecoder0x32 *)decoder wantAPacket:(AVPacket *)pkt
+//decoder 和 mixDecoders 由 createStreamComponent 创建，可能为 nil
+- (void)openAudioComponent:(FFDecoder0x32 *)decoder mixDecoders:(NSArray<FFDecoder0x32 *> *)mixDecoders
 {
-    if (decoder == self.audioDecoder) {
-        return packet_queue_get(&_audioq, pkt, 1);
-    } else if (decoder == self.videoDecoder) {
-        return packet_queue_get(&_videoq, pkt, 1);
-    } else {
-        return -1;
+    const int ret = decoder ? [decoder open] : -1;
+    [self markStartupPhase:&_startupTimings.audio_decoder_open];
+    
+    if (ret != 0) {
+        av_log(NULL, AV_LOG_ERROR, "can't open audio stream.\n");
+        [self onOpenStreamFailed:_make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"音频流打开失败！")];
+        return;
     }
-}
-
-- (void)decoder:(FFDecoder0x32 *)decoder reveivedAFrame:(AVFrame *)frame
-{
-    if (decoder == self.audioDecoder) {
-        FrameQueue *fq = &_sampq;
-        
-        AVFrame *outP = nil;
-        if (self.audioResample) {
-            if (![self.audioResample resampleFrame:frame out:&outP]) {
-                self.error = _make_nserror_desc(FFPlayerErrorCode_ResampleFrameFailed, @"音频帧重采样失败！");
-                [self performErrorResultOnMainThread];
-                return;
-            }
-        } else {
-            outP = frame;
+    
+    decoder.delegate = self;
+    decoder.name = @"mr-audio-dec";
+    atomic_store(&_audioDecodeEnded, false);
+    atomic_store(&_audioEndsPending, false);
+    self.audioDecoder = decoder;
+    self.audioResample = [self createAudioResampleIfNeed];
+    if (_mixTrackCount > 1 && ![self openMixTracks:mixDecoders]) {
+        av_log(NULL, AV_LOG_ERROR, "can't open audio mix tracks.\n");
+        [self onOpenStreamFailed:_make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"音频流打开失败！")];
+        return;
+    }
+    //中途重新打开音频时采样缓存还在，渲染回调也在读，不能重建，音频渲染也不用再初始化
+    if (_sampRing.planes == 0) {
+        if (![self createSampleRing]) {
+            av_log(NULL, AV_LOG_ERROR, "can't create audio sample ring.\n");
+            [self onOpenStreamFailed:_make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"音频流打开失败！")];
+            return;
         }
-        double duration = av_q2d((AVRational){outP->nb_samples, outP->sample_rate});
-        AVRational tb = (AVRational){1, frame->sample_rate};
-        frame_queue_push_v2(fq, outP,^(Frame * const af){
-            af->duration = duration;
-            af->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);;
-        });
-        self.audioFrameEmpty = NO;
-        self.audioFrameCount++;
-    } else if (decoder == self.videoDecoder) {
-        FrameQueue *fq = &_pictq;
         
-        AVFrame *outP = nil;
-        if (self.videoScale) {
-            if (![self.videoScale rescaleFrame:frame out:&outP]) {
-                self.error = _make_nserror_desc(FFPlayerErrorCode_RescaleFrameFailed, @"视频帧重转失败！");
-                [self performErrorResultOnMainThread];
-                return;
-            }
-        } else {
-            outP = frame;
+        if ([self.delegate respondsToSelector:@selector(onInitAudioRender:channels:)]) {
+            [self.delegate onInitAudioRender:self.outputSampleFormat channels:self.outputChannels];
+        } else if ([self.delegate respondsToSelector:@selector(onInitAudioRender:)]) {
+            [self.delegate onInitAudioRender:self.outputSampleFormat];
         }
-        
-        double duration = (self.videoDecoder.frameRate.num && self.videoDecoder.frameRate.den ? av_q2d(self.videoDecoder.frameRate) : 0);
-        duration = 1.0 / duration;
-        AVRational tb = self.videoDecoder.stream->time_base;
-        double pts = (outP->pts == AV_NOPTS_VALUE) ? NAN : outP->pts * av_q2d(tb);
-        frame_queue_push_v2(fq, outP,^(Frame * const af){
-            af->duration = duration;
-            af->pts = pts;
-        });
-        self.videoFrameEmpty = NO;
-        self.videoFrameCount++;
+    }
+    //格式确定了，选出对应的交付函数，渲染回调里不用再按格式分支
+    self.deliverFunc = [MRAudioKernels deliverFuncFrom:self.sampleRingFormat to:self.outputSampleFormat channels:self.outputChannels];
+    if (self.abort_request) {
+        return;
+    }
+    //音频解码线程开始工作
+    [self.audioDecoder start];
+    for (FFDecoder0x32 *mixDecoder in self.mixDecoders) {
+        [mixDecoder start];
     }
 }
 
+//按协商后的格式创建音频采样缓存，交错格式 1 个平面，平面格式每个声道一个平面；缓存大约 0.25s
+- (BOOL)createSampleRing
+{
+    const MRSampleFormat fmt = self.sampleRingFormat;
+    const int sampleRate = self.supportedSampleRate;
+    const int channels = self.outputChannels;
+    if (fmt == MR_SAMPLE_FMT_NONE || channels <= 0 || channels > MR_CH_LAYOUT_MAX_CHANNELS || sampleRate <= 0) {
+        return NO;
+    }
+    const int bytesPerSample = MR_Sample_Fmt_Is_FloatX(fmt) ? sizeof(float) : sizeof(int16_t);
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(fmt);
+    const int planes = planar ? channels : 1;
+    const int frameBytes = bytesPerSample * (planar ? 1 : channels);
+    const uint32_t nb_samples = FFMAX(sampleRate / 4, 8192);
+    return pcm_ring_init(&_sampRing, planes, frameBytes, sampleRate, nb_samples) == 0;
+}
+
+- (void)openVideoComponent:(FFDecoder0x32 *)decoder
+{
+    const int ret = decoder ? [decoder open] : -1;
+    [self markStartupPhase:&_startupTimings.video_decoder_open];
+    
+    if (ret != 0) {
+        av_log(NULL, AV_LOG_ERROR, "can't open video stream.");
+        [self onOpenStreamFailed:_make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"视频流打开失败！")];
+        return;
+    }
+    
+    decoder.delegate = self;
+    decoder.name = @"mr-video-dec";
+    decoder.skipFrame = [self videoSkipFrameForRate:self.playbackRate];
+    self.videoDecoder = decoder;
+    self.videoScale = [self createVideoScaleIfNeed];
+    //不需要转换时没有创建，不记录这一步
+    if (self.videoScale) {
+        [self markStartupPhase:&_startupTimings.video_scale_create];
+    }
+    if (self.abort_request) {
+        return;
+    }
+    //视频解码线程开始工作
+    [self.videoDecoder start];
+}
+
+#pragma mark - 切换媒体选择
+
+//在读包线程里调用，按当前的媒体选择关掉或打开音视频流
+- (void)applyMediaSelection:(AVFormatContext *)formatCtx
+{
+    int st_index[AVMEDIA_TYPE_NB];
+    memset(st_index, -1, sizeof(st_index));
+    st_index[AVMEDIA_TYPE_AUDIO] = self.bestAudioStreamIdx;
+    st_index[AVMEDIA_TYPE_VIDEO] = self.bestVideoStreamIdx;
+    [self selectStreams:&st_index];
+    
+    const int audioIdx = st_index[AVMEDIA_TYPE_AUDIO];
+    const int videoIdx = st_index[AVMEDIA_TYPE_VIDEO];
+    //先关再开，关掉的流不再占用解码线程
+    if (audioIdx < 0 && self.audioStreamIdx >= 0) {
+        [self closeAudioStream:formatCtx];
+    }
+    if (videoIdx < 0 && self.videoStreamIdx >= 0) {
+        [self closeVideoStream:formatCtx];
+    }
+    if (audioIdx >= 0 && self.audioStreamIdx < 0) {
+        [self reopenAudioStream:formatCtx streamIdx:audioIdx];
+    }
+    if (videoIdx >= 0 && self.videoStreamIdx < 0) {
+        [self reopenVideoStream:formatCtx streamIdx:videoIdx];
+    }
+    av_log(NULL, AV_LOG_INFO, "media selection:%d,audio:%d,video:%d\n", (int)self.mediaSelection, self.audioStreamIdx, self.videoStreamIdx);
+    //关掉的可能是唯一还在播放的流
+    [self maybeReachEnds];
+}
+
+- (void)closeAudioStream:(AVFormatContext *)formatCtx
+{
+    formatCtx->streams[self.audioStreamIdx]->discard = AVDISCARD_ALL;
+    self.audioStreamIdx = -1;
+    //视频改为按自己的时钟播放
+    self.audioClk.eof = YES;
+    
+    //解码线程可能在等包或者等缓存空间，标记为停止才能退出
+    _audioq.abort_request = 1;
+    [self abortMixQueues];
+    pcm_ring_abort(&_sampRing);
+    [self.audioDecoder cancel];
+    for (FFDecoder0x32 *decoder in self.mixDecoders) {
+        [decoder cancel];
+    }
+    [self.audioDecoder join];
+    for (FFDecoder0x32 *decoder in self.mixDecoders) {
+        [decoder join];
+    }
+    self.audioDecoder = nil;
+    [self closeMixTracks:formatCtx];
+    self.timeStretch = nil;
+    self.audioMeter = nil;
+    
+    packet_queue_flush(&_audioq);
+    //缓存里剩下的采样不再播放，渲染回调下次取的时候丢掉
+    pcm_ring_discard_written(&_sampRing);
+    if (!self.abort_request) {
+        _audioq.abort_request = 0;
+        pcm_ring_resume(&_sampRing);
+    }
+}
+
+- (void)closeVideoStream:(AVFormatContext *)formatCtx
+{
+    formatCtx->streams[self.videoStreamIdx]->discard = AVDISCARD_ALL;
+    self.videoStreamIdx = -1;
+    self.videoClk.eof = YES;
+    
+    _videoq.abort_request = 1;
+    _pictq.abort_request = 1;
+    [self.videoDecoder cancel];
+    [self.videoDecoder join];
+    //帧队列里剩下的帧由渲染线程丢掉
+    self.videoDecoder = nil;
+    
+    packet_queue_flush(&_videoq);
+    if (!self.abort_request) {
+        _videoq.abort_request = 0;
+        _pictq.abort_request = 0;
+    }
+}
+
+- (void)reopenAudioStream:(AVFormatContext *)formatCtx streamIdx:(int)idx
+{
+    formatCtx->streams[idx]->discard = AVDISCARD_DEFAULT;
+    for (int t = 1; t < _mixTrackCount; t++) {
+        formatCtx->streams[_mixStreamIdx[t]]->discard = AVDISCARD_DEFAULT;
+    }
+    [self openAudioComponent:[self createStreamComponent:formatCtx streamIdx:idx] mixDecoders:[self createMixDecoders:formatCtx]];
+    if (!self.audioDecoder) {
+        return;
+    }
+    //新的音频数据到来前音频时钟先接着视频时钟走
+    if (self.videoStreamIdx >= 0) {
+        [self.audioClk setClock:[self.videoClk getClock]];
+    }
+    self.audioClk.eof = NO;
+    self.audioStreamIdx = idx;
+    //已经读完了就直接让解码器结束
+    if (self.eof) {
+        packet_queue_put_nullpacket(&_audioq, idx);
+        for (int t = 1; t < _mixTrackCount; t++) {
+            packet_queue_put_nullpacket(&_mixq[t], _mixStreamIdx[t]);
+        }
+    }
+}
+
+- (void)reopenVideoStream:(AVFormatContext *)formatCtx streamIdx:(int)idx
+{
+    formatCtx->streams[idx]->discard = AVDISCARD_DEFAULT;
+    [self openVideoComponent:[self createStreamComponent:formatCtx streamIdx:idx]];
+    if (!self.videoDecoder) {
+        return;
+    }
+    _videoWaitKeyframe = YES;
+    self.videoClk.frame_timer = av_gettime_relative() / 1000000.0;
+    self.videoClk.eof = NO;
+    self.videoStreamIdx = idx;
+    if (self.eof) {
+        packet_queue_put_nullpacket(&_videoq, idx);
+    }
+}
+
+#pragma mark - 多音轨混音
+
+//mixAudioStreams 里有效的音频流至少两路时开始混音，第一路作为主音轨
+- (void)resolveMixTracks:(AVFormatContext *)formatCtx audioIdx:(int *)audioIdx
+{
+    _mixTrackCount = 0;
+    if (*audioIdx < 0) {
+        return;
+    }
+    int count = 0;
+    int streams[FF_AUDIO_MIX_MAX_TRACKS];
+    for (NSNumber *num in self.mixAudioStreams) {
+        const int idx = [num intValue];
+        if (idx < 0 || idx >= formatCtx->nb_streams || formatCtx->streams[idx]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+            continue;
+        }
+        BOOL dup = NO;
+        for (int t = 0; t < count; t++) {
+            dup = dup || streams[t] == idx;
+        }
+        if (dup) {
+            continue;
+        }
+        streams[count++] = idx;
+        if (count == FF_AUDIO_MIX_MAX_TRACKS) {
+            break;
+        }
+    }
+    if (count < 2) {
+        return;
+    }
+    memcpy(_mixStreamIdx, streams, sizeof(streams));
+    _mixTrackCount = count;
+    *audioIdx = streams[0];
+    av_log(NULL, AV_LOG_INFO, "audio mix tracks:%d\n", count);
+}
+
+- (int)mixTrackOfStream:(int)streamIdx tracks:(int)tracks
+{
+    for (int t = 1; t < tracks; t++) {
+        if (_mixStreamIdx[t] == streamIdx) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+//主音轨为 0，不是混音的音轨返回 -1
+- (int)mixTrackOfDecoder:(FFDecoder0x32 *)decoder
+{
+    if (decoder == self.audioDecoder) {
+        return 0;
+    }
+    NSUInteger idx = [self.mixDecoders indexOfObjectIdenticalTo:decoder];
+    return idx == NSNotFound ? -1 : (int)idx + 1;
+}
+
+- (int)mixQueuesSize:(int)tracks
+{
+    int size = 0;
+    for (int t = 1; t < tracks; t++) {
+        size += _mixq[t].size;
+    }
+    return size;
+}
+
+- (BOOL)mixQueues:(AVFormatContext *)formatCtx haveEnoughPackets:(int)tracks
+{
+    for (int t = 1; t < tracks; t++) {
+        if (!stream_has_enough_packets(formatCtx->streams[_mixStreamIdx[t]], _mixStreamIdx[t], &_mixq[t])) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+//跟不上的音轨断粮了：包队列空了，并且读包结束或者缓存满了不再读包，再等也等不到它的数据
+- (BOOL)mixTrackStarved:(int)track
+{
+    const PacketQueue *q = track == 0 ? &_audioq : &_mixq[track];
+    return q->nb_packets == 0 && (self.eof || self.packetBufferIsFull);
+}
+
+- (void)abortMixQueues
+{
+    for (int t = 1; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        _mixq[t].abort_request = 1;
+    }
+}
+
+//在读包线程里为第 1 路开始的音轨创建解码器；不混音时为空数组，出错时返回 nil
+- (NSArray<FFDecoder0x32 *> *)createMixDecoders:(AVFormatContext *)formatCtx
+{
+    NSMutableArray *decoders = [NSMutableArray array];
+    for (int t = 1; t < _mixTrackCount; t++) {
+        FFDecoder0x32 *decoder = [self createStreamComponent:formatCtx streamIdx:_mixStreamIdx[t]];
+        if (!decoder) {
+            return nil;
+        }
+        [decoders addObject:decoder];
+    }
+    return decoders;
+}
+
+//在主音轨打开后调用：混音后是 FLTP，交付时再转换成输出格式；其余音轨各开一个解码器
+- (BOOL)openMixTracks:(NSArray<FFDecoder0x32 *> *)decoders
+{
+    if (decoders.count + 1 != _mixTrackCount) {
+        return NO;
+    }
+    self.audioResample = nil;
+    self.sampleRingFormat = MR_SAMPLE_FMT_FLTP;
+    FFAudioMixer0x32 *mixer = [[FFAudioMixer0x32 alloc] initWithTracks:_mixTrackCount channels:self.outputChannels sampleRate:self.supportedSampleRate];
+    if (!mixer) {
+        return NO;
+    }
+    for (int t = 0; t < _mixTrackCount; t++) {
+        [mixer setGain:_mixGain[t] track:t];
+    }
+    //混音器由播放器持有，不能强引用回来
+    __weak typeof(self) weakSelf = self;
+    mixer.trackStarved = ^BOOL(int track) {
+        return [weakSelf mixTrackStarved:track];
+    };
+    for (int t = 1; t < _mixTrackCount; t++) {
+        FFDecoder0x32 *decoder = decoders[t - 1];
+        if ([decoder open] != 0) {
+            return NO;
+        }
+        decoder.delegate = self;
+        decoder.name = [NSString stringWithFormat:@"mr-audio-dec%d", t];
+    }
+    self.audioMixer = mixer;
+    self.mixDecoders = decoders;
+    return YES;
+}
+
+//解码线程都已经结束后调用
+- (void)closeMixTracks:(AVFormatContext *)formatCtx
+{
+    for (int t = 1; t < _mixTrackCount; t++) {
+        formatCtx->streams[_mixStreamIdx[t]]->discard = AVDISCARD_ALL;
+        packet_queue_flush(&_mixq[t]);
+        if (!self.abort_request) {
+            _mixq[t].abort_request = 0;
+        }
+    }
+    for (int t = 0; t < FF_AUDIO_MIX_MAX_TRACKS; t++) {
+        _mixResample[t] = nil;
+    }
+    self.mixDecoders = nil;
+    self.audioMixer = nil;
+}
+
+//转换成混音的格式后交给混音器，凑够一块时在当前解码线程里混音并写进采样缓存
+- (void)mixFrame:(AVFrame *)frame track:(int)track mixer:(FFAudioMixer0x32 *)mixer
+{
+    AVFrame *outP = frame;
+    if (frame->format != AV_SAMPLE_FMT_FLTP || frame->channels != mixer.channels || frame->sample_rate != mixer.sampleRate) {
+        if (!frame->channel_layout) {
+            frame->channel_layout = av_get_default_channel_layout(frame->channels);
+        }
+        //音轨中途换了格式、声道布局或采样率
+        if (!_mixResample[track] || _mixResampleFormat[track] != frame->format || _mixResampleLayout[track] != (int64_t)frame->channel_layout || _mixResampleRate[track] != frame->sample_rate) {
+            _mixResample[track] = [[FFAudioResample0x32 alloc] initWithSrcSampleFmt:frame->format
+                                                                       dstSampleFmt:AV_SAMPLE_FMT_FLTP
+                                                                         srcChannel:frame->channel_layout
+                                                                         dstChannel:av_get_default_channel_layout(mixer.channels)
+                                                                            srcRate:frame->sample_rate
+                                                                            dstRate:mixer.sampleRate
+                                                                            profile:self.audioResampleProfile];
+            _mixResampleFormat[track] = frame->format;
+            _mixResampleLayout[track] = frame->channel_layout;
+            _mixResampleRate[track] = frame->sample_rate;
+        }
+        if (![_mixResample[track] resampleFrame:frame out:&outP]) {
+            [self onMixFailed:AVERROR(EINVAL) desc:@"音频帧重采样失败！"];
+            return;
+        }
+    }
+    AVRational tb = (AVRational){1, frame->sample_rate};
+    double pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+    int ret = [mixer pushTrack:track data:(const float * const *)outP->extended_data samples:outP->nb_samples pts:pts output:^int(float * const *data, int samples, double mixPts) {
+        return [self writeMixedSamples:data samples:samples pts:mixPts];
+    }];
+    if (ret < 0) {
+        [self onMixFailed:ret desc:@"混音失败！"];
+        return;
+    }
+    if (track == 0) {
+        [self markStartupPhase:&_startupTimings.first_audio_frame];
+    }
+}
+
+- (int)writeMixedSamples:(float * const *)data samples:(int)samples pts:(double)pts
+{
+    [self meterSamples:(uint8_t * const *)data samples:samples pts:pts];
+    return [self writeSamples:(uint8_t * const *)data samples:samples pts:pts];
+}
+
+- (void)decoderDidReachEnd:(FFDecoder0x32 *)decoder
+{
+    FFAudioMixer0x32 *mixer = self.audioMixer;
+    if (!mixer) {
+        if (decoder == self.audioDecoder) {
+            atomic_store(&_audioDecodeEnded, true);
+        }
+        return;
+    }
+    const int track = [self mixTrackOfDecoder:decoder];
+    if (track < 0) {
+        return;
+    }
+    //全部音轨都结束时把剩下的数据混完
+    int ret = [mixer endTrack:track output:^int(float * const *data, int samples, double mixPts) {
+        return [self writeMixedSamples:data samples:samples pts:mixPts];
+    }];
+    if (ret < 0) {
+        [self onMixFailed:ret desc:@"混音失败！"];
+    } else if (mixer.finished) {
+        atomic_store(&_audioDecodeEnded, true);
+    }
+}
+
+//混音出错后各路都不用再解码了，停掉全部音轨的解码器；停止播放时采样缓存写不进去不算出错
+- (void)onMixFailed:(int)ret desc:(NSString *)desc
+{
+    [self.audioDecoder cancel];
+    for (FFDecoder0x32 *decoder in self.mixDecoders) {
+        [decoder cancel];
+    }
+    if (self.abort_request || atomic_load(&_sampRing.abort_request)) {
+        return;
+    }
+    av_log(NULL, AV_LOG_ERROR, "audio mix failed:%d\n", ret);
+    self.error = _make_nserror_desc(FFPlayerErrorCode_ResampleFrameFailed, desc);
+    [self performErrorResultOnMainThread];
+}
+
+- (FFAudioMixerStats0x32)audioMixerStats
+{
+    FFAudioMixer0x32 *mixer = self.audioMixer;
+    if (mixer) {
+        return [mixer stats];
+    }
+    FFAudioMixerStats0x32 stats = {0};
+    return stats;
+}
+
+- (void)setGain:(float)gain forMixTrack:(int)track
+{
+    if (track < 0 || track >= FF_AUDIO_MIX_MAX_TRACKS) {
+        return;
+    }
+    _mixGain[track] = gain;
+    [self.audioMixer setGain:gain track:track];
+}
+
+- (void)onOpenStreamFailed:(NSError *)error
+{
+    @synchronized (self) {
+        //音视频都失败时只回调一次
+        if (self.error) {
+            return;
+        }
+        self.error = error;
+    }
+    //出错了，停止读包，读包线程结束后会销毁相关结构体
+    self.abort_request = 1;
+    [self performErrorResultOnMainThread];
+}
+
+#pragma mark - IO 超时
+
+- (void)beginIO:(FFIOTimeoutKind)kind timeout:(double)timeout
+{
+    _ioTimedOut = FFIOTimeoutNone;
+    if (timeout > 0) {
+        _ioDeadlineKind = kind;
+        _ioDeadline = av_gettime_relative() / 1000000.0 + timeout;
+    } else {
+        _ioDeadline = 0;
+    }
+}
+
+//单次读包的截止时间和连续读不到包的截止时间，取先到的那个
+- (void)beginReadIO
+{
+    const double now = av_gettime_relative() / 1000000.0;
+    double deadline = 0;
+    FFIOTimeoutKind kind = FFIOTimeoutNone;
+    if (self.readTimeout > 0) {
+        deadline = now + self.readTimeout;
+        kind = FFIOTimeoutRead;
+    }
+    if (self.stallTimeout > 0 && _ioWaitBegin > 0) {
+        const double stall = _ioWaitBegin + self.stallTimeout;
+        if (deadline <= 0 || stall < deadline) {
+            deadline = stall;
+            kind = FFIOTimeoutStall;
+        }
+    }
+    _ioTimedOut = FFIOTimeoutNone;
+    _ioDeadlineKind = kind;
+    _ioDeadline = deadline;
+}
+
+- (void)endIO
+{
+    _ioDeadline = 0;
+}
+
+//读到包了，统计这次等了多久
+- (void)updateStallStatus
+{
+    if (_ioWaitBegin <= 0) {
+        return;
+    }
+    const double wait = av_gettime_relative() / 1000000.0 - _ioWaitBegin;
+    _ioWaitBegin = 0;
+    if (wait > IO_STALL_THRESHOLD) {
+        _ioStatus.stalls++;
+        _ioStatus.last_stall_duration = wait;
+        _ioStatus.max_stall_duration = FFMAX(_ioStatus.max_stall_duration, wait);
+        av_log(NULL, AV_LOG_WARNING, "io stall:%0.3fs\n", wait);
+    }
+}
+
+- (void)onIOTimeout:(FFIOTimeoutKind)kind
+{
+    NSString *desc = nil;
+    if (kind == FFIOTimeoutOpen) {
+        _ioStatus.open_timeouts++;
+        desc = @"打开超时！";
+    } else if (kind == FFIOTimeoutRead) {
+        _ioStatus.read_timeouts++;
+        desc = @"读包超时！";
+    } else {
+        _ioStatus.stall_timeouts++;
+        if (_ioWaitBegin > 0) {
+            _ioStatus.last_stall_duration = av_gettime_relative() / 1000000.0 - _ioWaitBegin;
+            _ioStatus.max_stall_duration = FFMAX(_ioStatus.max_stall_duration, _ioStatus.last_stall_duration);
+        }
+        desc = @"长时间读不到数据！";
+    }
+    av_log(NULL, AV_LOG_ERROR, "io timeout:%d\n", kind);
+    self.error = _make_nserror_desc(FFPlayerErrorCode_IOTimeout, desc);
+    [self performErrorResultOnMainThread];
+}
+
+- (FFPlayer0x32IOStatus)ioStatus
+{
+    return _ioStatus;
+}
+
+- (FFFramePoolStats0x32)videoFramePoolStats
+{
+    FFFramePool0x32 *pool = self.videoDecoder.framePool;
+    if (pool) {
+        return [pool stats];
+    }
+    FFFramePoolStats0x32 stats = {0};
+    return stats;
+}
+
+- (FFAudioResampleStats0x32)audioResampleStats
+{
+    FFAudioResample0x32 *resample = self.audioResample;
+    if (resample) {
+        return [resample stats];
+    }
+    FFAudioResampleStats0x32 stats = {0};
+    return stats;
+}
+
+- (MRAudioMeterSnapshot)audioMeterSnapshot
+{
+    MRAudioMeter *meter = self.audioMeter;
+    if (meter) {
+        return [meter snapshot];
+    }
+    MRAudioMeterSnapshot snapshot = {0};
+    snapshot.momentary = -INFINITY;
+    snapshot.shortTerm = -INFINITY;
+    snapshot.pts = NAN;
+    return snapshot;
+}
+
+#pragma mark - 启动耗时
+
+//phase 是 _startupTimings 的字段，只记录第一次；返回是否是这次记录的
+- (BOOL)markStartupPhase:(double *)phase
+{
+    const double t = av_gettime_relative() / 1000000.0 - self.openBeginTime;
+    BOOL marked = NO;
+    pthread_mutex_lock(&_startupLock);
+    if (*phase <= 0) {
+        *phase = t;
+        marked = YES;
+    }
+    pthread_mutex_unlock(&_startupLock);
+    return marked;
+}
+
+- (void)markProbeMode:(FFPlayer0x32ProbeMode)mode rounds:(int)rounds
+{
+    pthread_mutex_lock(&_startupLock);
+    _startupTimings.probe_mode = mode;
+    _startupTimings.probe_rounds = rounds;
+    pthread_mutex_unlock(&_startupLock);
+}
+
+- (FFPlayer0x32StartupTimings)startupTimings
+{
+    pthread_mutex_lock(&_startupLock);
+    FFPlayer0x32StartupTimings t = _startupTimings;
+    pthread_mutex_unlock(&_startupLock);
+    return t;
+}
+
+//首帧显示后按探测方式累计，合成媒体源不探测，不参与对比
++ (void)addProbeComparison:(FFPlayer0x32StartupTimings)t
+{
+    if (t.probe_rounds <= 0 || t.probe_mode >= FF_PROBE_MODE_NB) {
+        return;
+    }
+    pthread_mutex_lock(&g_probe_comparison_lock);
+    FFPlayer0x32ProbeComparison *c = &g_probe_comparison;
+    const int m = (int)t.probe_mode;
+    const int n = ++c->count[m];
+    c->mean_find_stream_info[m] += (t.find_stream_info - c->mean_find_stream_info[m]) / n;
+    c->mean_first_display[m] += (t.first_display - c->mean_first_display[m]) / n;
+    pthread_mutex_unlock(&g_probe_comparison_lock);
+}
+
++ (FFPlayer0x32ProbeComparison)probeComparison
+{
+    pthread_mutex_lock(&g_probe_comparison_lock);
+    FFPlayer0x32ProbeComparison c = g_probe_comparison;
+    pthread_mutex_unlock(&g_probe_comparison_lock);
+    return c;
+}
+
+#pragma mark - FFDecoderDelegate0x32
+
+- (int)decoder:(FFDecoder0x32 *)decoder wantAPacket:(AVPacket *)pkt
+{
+    if (decoder == self.audioDecoder) {
+        return packet_queue_get(&_audioq, pkt, 1);
+    } else if (decoder == self.videoDecoder) {
+        return packet_queue_get(&_videoq, pkt, 1);
+    } else {
+        const int track = [self mixTrackOfDecoder:decoder];
+        return track > 0 ? packet_queue_get(&_mixq[track], pkt, 1) : -1;
+    }
+}
+
+- (void)decoder:(FFDecoder0x32 *)decoder reveivedAFrame:(AVFrame *)frame
+{
+    FFAudioMixer0x32 *mixer = self.audioMixer;
+    const int mixTrack = mixer ? [self mixTrackOfDecoder:decoder] : -1;
+    if (mixTrack >= 0) {
+        [self mixFrame:frame track:mixTrack mixer:mixer];
+    } else if (decoder == self.audioDecoder) {
+        AVFrame *outP = nil;
+        if (self.audioResample) {
+            //swr 按声道布局检查输入，部分音频没有布局
+            if (!frame->channel_layout) {
+                frame->channel_layout = av_get_default_channel_layout(frame->channels);
+            }
+            if (![self.audioResample resampleFrame:frame out:&outP]) {
+                self.error = _make_nserror_desc(FFPlayerErrorCode_ResampleFrameFailed, @"音频帧重采样失败！");
+                [self performErrorResultOnMainThread];
+                return;
+            }
+        } else {
+            outP = frame;
+        }
+        AVRational tb = (AVRational){1, frame->sample_rate};
+        double pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+        //电平按变速前的数据统计，和媒体时间对应
+        [self meterSamples:outP->extended_data samples:outP->nb_samples pts:pts];
+        //缓存满了在解码线程等待，渲染回调不会被阻塞
+        if ([self writeSamples:outP->extended_data samples:outP->nb_samples pts:pts] < 0) {
+            return;
+        }
+        [self markStartupPhase:&_startupTimings.first_audio_frame];
+    } else if (decoder == self.videoDecoder) {
+        FrameQueue *fq = &_pictq;
+        
+        AVFrame *outP = nil;
+        if (self.videoScale) {
+            if (![self.videoScale rescaleFrame:frame out:&outP]) {
+                self.error = _make_nserror_desc(FFPlayerErrorCode_RescaleFrameFailed, @"视频帧重转失败！");
+                [self performErrorResultOnMainThread];
+                return;
+            }
+        } else {
+            outP = frame;
+        }
+        
+        double duration = (self.videoDecoder.frameRate.num && self.videoDecoder.frameRate.den ? av_q2d(self.videoDecoder.frameRate) : 0);
+        duration = 1.0 / duration;
+        AVRational tb = self.videoDecoder.timeBase;
+        double pts = (outP->pts == AV_NOPTS_VALUE) ? NAN : outP->pts * av_q2d(tb);
+        frame_queue_push_v2(fq, outP,^(Frame * const af){
+            af->duration = duration;
+            af->pts = pts;
+        });
+        self.videoFrameEmpty = NO;
+        self.videoFrameCount++;
+        [self markStartupPhase:&_startupTimings.first_video_frame];
+    }
+}
+
+- (void)meterSamples:(uint8_t * const *)data samples:(int)samples pts:(double)pts
+{
+    if (!self.audioMeterEnabled) {
+        if (self.audioMeter) {
+            self.audioMeter = nil;
+        }
+        return;
+    }
+    MRAudioMeter *meter = self.audioMeter;
+    if (!meter) {
+        meter = [[MRAudioMeter alloc] initWithChannels:self.outputChannels sampleRate:self.supportedSampleRate];
+        if (!meter) {
+            return;
+        }
+        self.audioMeter = meter;
+    }
+    [meter process:data format:self.sampleRingFormat samples:samples pts:pts];
+}
+
+//写入音频采样缓存，变速在这里完成；恢复 1 倍速时把变速器里剩余的数据交出后不再经过变速
+- (int)writeSamples:(uint8_t * const *)src samples:(int)count pts:(double)pts
+{
+    const double rate = self.playbackRate;
+    __block int ret = 0;
+    if (rate == 1.0) {
+        if (self.timeStretch) {
+            [self.timeStretch flush:^(uint8_t * const *data, int samples, double outPts) {
+                ret = pcm_ring_write(&self->_sampRing, data, samples, outPts, 1.0);
+            }];
+            self.timeStretch = nil;
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        return pcm_ring_write(&_sampRing, src, count, pts, 1.0);
+    }
+    
+    if (!self.timeStretch) {
+        self.timeStretch = [[FFTimeStretch0x32 alloc] initWithFormat:self.sampleRingFormat channels:self.outputChannels sampleRate:self.supportedSampleRate];
+        if (!self.timeStretch) {
+            return pcm_ring_write(&_sampRing, src, count, pts, 1.0);
+        }
+    }
+    FFTimeStretch0x32 *stretch = self.timeStretch;
+    stretch.rate = rate;
+    const double speed = stretch.rate;
+    int err = [stretch process:src samples:count pts:pts output:^(uint8_t * const *data, int samples, double outPts) {
+        if (ret >= 0) {
+            ret = pcm_ring_write(&self->_sampRing, data, samples, outPts, speed);
+        }
+    }];
+    return err < 0 ? err : ret;
+}
+
 #pragma mark - RendererThread
 
 - (void)prepareRendererThread
@@ -617,16 +1824,23 @@ static int decode_interrupt_cb(void *ctx)
 - (CVPixelBufferRef _Nullable)pixelBufferFromAVFrame:(AVFrame *)frame
 {
 #if USE_PIXEL_BUFFER_POOL
+    if (self.pixelBufferPool && (frame->format != self.poolFormat || frame->width != self.poolWidth || frame->height != self.poolHeight)) {
+        CVPixelBufferPoolRelease(self.pixelBufferPool);
+        self.pixelBufferPool = NULL;
+    }
     if (!self.pixelBufferPool){
         CVPixelBufferPoolRef pixelBufferPool = [MRConvertUtil createCVPixelBufferPoolRef:frame->format w:frame->width h:frame->height fullRange:frame->color_range != AVCOL_RANGE_MPEG];
         if (pixelBufferPool) {
             CVPixelBufferPoolRetain(pixelBufferPool);
             self.pixelBufferPool = pixelBufferPool;
+            self.poolFormat = frame->format;
+            self.poolWidth = frame->width;
+            self.poolHeight = frame->height;
         }
     }
 #endif
     
-    CVPixelBufferRef pixelBuffer = [MRConvertUtil pixelBufferFromAVFrame:frame opt:self.pixelBufferPool];
+    CVPixelBufferRef pixelBuffer = [MRConvertUtil pixelBufferFromAVFrame:frame opt:self.pixelBufferPool zeroCopy:self.zeroCopyPixelBuffer];
     return pixelBuffer;
 }
 
@@ -641,6 +1855,11 @@ static int decode_interrupt_cb(void *ctx)
             CVPixelBufferRef pixelBuffer = [self pixelBufferFromAVFrame:vp->frame];
             if (pixelBuffer) {
                 [self.delegate reveiveFrameToRenderer:pixelBuffer];
+                if ([self markStartupPhase:&_startupTimings.first_display]) {
+                    FFPlayer0x32StartupTimings t = [self startupTimings];
+                    [FFPlayer0x32 addProbeComparison:t];
+                    MRFF_INFO_LOG(@"time to first frame:%gs,probe mode:%d,rounds:%d [open:%g,probe:%g,audio dec:%g,video dec:%g,scale:%g,first pkt:%g,first audio:%g,first video:%g]",t.first_display,(int)t.probe_mode,t.probe_rounds,t.open_input,t.find_stream_info,t.audio_decoder_open,t.video_decoder_open,t.video_scale_create,t.first_packet,t.first_audio_frame,t.first_video_frame);
+                }
             }
         }
     }
@@ -662,7 +1881,8 @@ static int decode_interrupt_cb(void *ctx)
         return delay;
     }
     
-    double diff = [self.videoClk getClock] - [self.audioClk getClock];
+    //时钟的差是媒体时间，换算成实际时间
+    double diff = ([self.videoClk getClock] - [self.audioClk getClock]) / self.playbackRate;
     
     /* skip or repeat frame. We take into account the
        delay to compute the threshold. I still don't know
@@ -681,8 +1901,48 @@ static int decode_interrupt_cb(void *ctx)
     return delay;
 }
 
+//记录这一帧显示时和音频的误差，按实际时间计算
+- (void)updateSyncStats
+{
+    if (self.audioClk.eof) {
+        return;
+    }
+    const double diff = ([self.videoClk getClock] - [self.audioClk getClock]) / self.playbackRate;
+    if (isnan(diff) || fabs(diff) > AV_NOSYNC_THRESHOLD) {
+        return;
+    }
+    static const double edges[FF_SYNC_HISTOGRAM_BINS - 1] = {-0.2, -0.1, -0.05, -0.02, -0.01, 0.01, 0.02, 0.05, 0.1, 0.2};
+    int bin = 0;
+    while (bin < FF_SYNC_HISTOGRAM_BINS - 1 && diff >= edges[bin]) {
+        bin++;
+    }
+    FFPlayer0x32SyncStats *st = &_syncStats;
+    st->histogram[bin]++;
+    st->samples++;
+    st->mean_abs_error += (fabs(diff) - st->mean_abs_error) / st->samples;
+    st->max_abs_error = FFMAX(st->max_abs_error, fabs(diff));
+    st->last_error = diff;
+}
+
+- (FFPlayer0x32SyncStats)syncStats
+{
+    return _syncStats;
+}
+
 - (void)video_refresh:(double *)remaining_time
 {
+    //视频关掉了，之前解码出来的帧不再显示
+    if (self.videoStreamIdx < 0) {
+        while (frame_queue_nb_remaining(&_pictq) > 0) {
+            frame_queue_pop(&_pictq);
+            self.videoFrameCount--;
+        }
+        //保留的上一帧和之后重新打开的视频接不上，不能用来计算显示时长
+        frame_queue_peek_last(&_pictq)->pts = NAN;
+        self.videoFrameEmpty = YES;
+        return;
+    }
+    
     if (frame_queue_nb_remaining(&_pictq) > 0) {
         Frame *vp, *lastvp;
         //上一帧
@@ -696,8 +1956,10 @@ static int decode_interrupt_cb(void *ctx)
         
         //当前帧
         vp = frame_queue_peek(&_pictq);
+        //倍速播放时每帧实际显示的时长按速率缩短
+        const double rate = self.playbackRate;
         //计算上一帧的持续时长
-        const double last_duration = [self vp_durationWithP1:lastvp p2:vp];
+        const double last_duration = [self vp_durationWithP1:lastvp p2:vp] / rate;
         //参考audio clock计算上一帧真正的持续时长
         const double delay = [self compute_target_delay:last_duration];
         //相对系统时间
@@ -720,7 +1982,7 @@ static int decode_interrupt_cb(void *ctx)
         //丢帧逻辑
         if (frame_queue_nb_remaining(&_pictq) > 1) {
             Frame *nextvp = frame_queue_peek_next(&_pictq);
-            double duration = [self vp_durationWithP1:vp p2:nextvp];//当前帧显示时长
+            double duration = [self vp_durationWithP1:vp p2:nextvp] / rate;//当前帧显示时长
             if(time > self.videoClk.frame_timer + duration){//如果系统时间已经大于当前帧，则丢弃当前帧
                 static int frame_drops_late = 0;
                 frame_drops_late++;
@@ -737,12 +1999,13 @@ static int decode_interrupt_cb(void *ctx)
             }
         }
         
+        [self updateSyncStats];
         [self doDisplayVideoFrame:vp];
         frame_queue_pop(&_pictq);
         self.videoFrameCount--;
         if (frame_queue_nb_remaining(&_pictq) > 1) {
             Frame *nextvp = frame_queue_peek(&_pictq);
-            double duration = [self vp_durationWithP1:vp p2:nextvp];//vp显示时长
+            double duration = [self vp_durationWithP1:vp p2:nextvp] / rate;//vp显示时长
             *remaining_time = FFMIN(duration, *remaining_time);
         } else {
             self.videoFrameEmpty = YES;
@@ -764,73 +2027,115 @@ static int decode_interrupt_cb(void *ctx)
             mr_sleep(remaining_time);
         }
         remaining_time = REFRESH_RATE;
+        //音频渲染回调里不能打日志，也不能派发到主线程，由这里代为检查
+        if (atomic_exchange(&_audioEndsPending, false)) {
+            av_log(NULL, AV_LOG_INFO, "audio frame is eof\n");
+            [self maybeReachEnds];
+        }
         [self video_refresh:&remaining_time];
     }
 }
 
-- (void)updateAudioClock:(Frame *)ap filled:(UInt32)filled
+//音频渲染回调里调用，不加锁、不分配内存、不打日志；filled 为这次取出的采样点数
+- (void)updateAudioClock:(UInt32)filled latency:(double)latency
 {
-    double audio_pts = ap->pts + 1.0 * ap->frame->nb_samples / ap->frame->sample_rate;
-    double bytes_per_sec = self.supportedSampleRate * self.audioClk.bytesPerSample;
-    double audio_clock = audio_pts - 2.0 * (ap->offset + filled) / bytes_per_sec;
-    [self.audioClk setClock:audio_clock];
+    if (filled > 0) {
+        //已交给音频渲染的最后一个采样之后的时间
+        double speed = 1.0;
+        double audio_clock = pcm_ring_read_clock(&_sampRing, &speed);
+        //往前推到此刻正在播放的采样：这次取出的采样要等 latency 之后才开始播放；
+        //不知道输出延迟时按还有一个回调缓冲区没播完估算，和以前的 2 * filled 一样
+        if (!isnan(audio_clock) && self.supportedSampleRate > 0) {
+            const double duration = (double)filled / self.supportedSampleRate;
+            audio_clock -= (duration + (isnan(latency) ? duration : latency)) * speed;
+        }
+        if (!isnan(audio_clock)) {
+            [self.audioClk setClock:audio_clock];
+            //速率按缓存里数据的实际速率，修改速率后要等之前的数据播完才生效
+            self.audioClk.speed = speed;
+        }
+    }
+    //没有取出采样，读包eof，解码也eof时标记为音频渲染完毕
+    else if (self.eof && !self.audioClk.eof && atomic_load_explicit(&_audioDecodeEnded, memory_order_acquire) && pcm_ring_readable(&_sampRing) == 0) {
+        self.audioClk.eof = YES;
+        //只设置标记，渲染线程轮询到后再通知
+        atomic_store_explicit(&_audioEndsPending, true, memory_order_release);
+    }
 }
 
-- (UInt32)fetchPacketSample:(uint8_t *)buffer
-                  wantBytes:(UInt32)bufferSize
+//从采样缓存取出最多 samples 个采样点，转换成输出格式写到 dst；返回取出的采样点数
+- (UInt32)deliverSamples:(uint8_t * const *)dst samples:(UInt32)samples latency:(double)latency
 {
+    const MRSampleFormat ringFmt = self.sampleRingFormat;
+    const MRSampleFormat outFmt = self.outputSampleFormat;
+    const int channels = self.outputChannels;
+    const int ringFrameBytes = _sampRing.frame_bytes;
+    const int outPlanes = MR_Sample_Fmt_Is_Planar(outFmt) ? channels : 1;
+    const int outFrameBytes = (MR_Sample_Fmt_Is_FloatX(outFmt) ? sizeof(float) : sizeof(int16_t)) * (outPlanes == 1 ? channels : 1);
+    const MRAudioDeliverFunc deliver = self.deliverFunc;
+    
     UInt32 filled = 0;
-    Frame *ap = NULL;
-    while (bufferSize > 0) {
-        //队列里缓存帧大于0，则取出
-        if (frame_queue_nb_remaining(&_sampq) > 0) {
-            ap = frame_queue_peek(&_sampq);
-            av_log(NULL, AV_LOG_VERBOSE, "render audio frame %lld\n", ap->frame->pts);
-        } else {
-            //队列里没有音频桢了，跳出循环
+    uint8_t *src[PCM_RING_MAX_PLANES];
+    uint8_t *out[PCM_RING_MAX_PLANES];
+    //缓存首尾相接处分两次取
+    while (ringFrameBytes > 0 && filled < samples) {
+        const UInt32 n = pcm_ring_peek(&_sampRing, src, (samples - filled) * ringFrameBytes) / ringFrameBytes;
+        if (n == 0) {
             break;
         }
-        
-        uint8_t *src = ap->frame->data[0];
-        const int fmt = ap->frame->format;
-        assert(0 == av_sample_fmt_is_planar(fmt));
-        
-        int data_size = av_samples_get_buffer_size(ap->frame->linesize, 2, ap->frame->nb_samples, fmt, 1);
-        int l_src_size = data_size;//ap->frame->linesize[0];
-        const int offset = ap->offset;
-        const void *from = src + offset;
-        int left = l_src_size - offset;
-        
-        //根据剩余数据长度和需要数据长度算出应当copy的长度
-        int leftBytesToCopy = FFMIN(bufferSize, left);
-        
-        memcpy(buffer, from, leftBytesToCopy);
-        buffer += leftBytesToCopy;
-        bufferSize -= leftBytesToCopy;
-        ap->offset += leftBytesToCopy;
-        filled += leftBytesToCopy;
-        if (leftBytesToCopy >= left){
-            //读取完毕，则清空；读取下一个包
-            av_log(NULL, AV_LOG_DEBUG, "packet sample:next frame\n");
-            frame_queue_pop(&_sampq);
-            self.audioFrameCount--;
-            if (frame_queue_nb_remaining(&_sampq) == 0) {
-                self.audioFrameEmpty = YES;
-            }
+        for (int p = 0; p < outPlanes; p++) {
+            out[p] = dst[p] + filled * outFrameBytes;
         }
+        if (deliver) {
+            deliver(src, out, n);
+        } else {
+            [MRAudioKernels convert:src format:ringFmt to:out format:outFmt channels:channels samples:n];
+        }
+        pcm_ring_consume(&_sampRing, n * ringFrameBytes);
+        filled += n;
     }
-    
-    if (NULL !=ap && filled > 0) {
-        [self updateAudioClock:ap filled:filled];
+    [self updateAudioClock:filled latency:latency];
+    return filled;
+}
+
+- (UInt32)fetchPacketSample:(uint8_t *)buffer
+                  wantBytes:(UInt32)bufferSize
+{
+    return [self fetchPacketSample:buffer wantBytes:bufferSize latency:NAN];
+}
+
+- (UInt32)fetchPacketSample:(uint8_t *)buffer
+                  wantBytes:(UInt32)bufferSize
+                    latency:(double)latency
+{
+    const MRSampleFormat fmt = self.outputSampleFormat;
+    if (!MR_Sample_Fmt_Is_Packet(fmt) || self.outputChannels <= 0) {
+        return 0;
     }
-    //没有取出采样桢，读包eof，解码也eof时标记为音频渲染完毕
-    else if(self.eof && self.audioDecoder.eof){
-        self.audioClk.eof = YES;
-        av_log(NULL, AV_LOG_INFO, "audio frame is eof\n");
-        [self maybeReachEnds];
+    const UInt32 frameBytes = (MR_Sample_Fmt_Is_FloatX(fmt) ? sizeof(float) : sizeof(int16_t)) * self.outputChannels;
+    uint8_t *dst[1] = {buffer};
+    return [self deliverSamples:dst samples:bufferSize / frameBytes latency:latency] * frameBytes;
+}
+
+- (UInt32)fetchPlanarSamples:(uint8_t * const *)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+{
+    return [self fetchPlanarSamples:planes count:count planeSize:planeSize latency:NAN];
+}
+
+- (UInt32)fetchPlanarSamples:(uint8_t * const *)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+                     latency:(double)latency
+{
+    const MRSampleFormat fmt = self.outputSampleFormat;
+    //每个声道都要有一个平面
+    if (!MR_Sample_Fmt_Is_Planar(fmt) || self.outputChannels <= 0 || count < self.outputChannels) {
+        return 0;
     }
-    
-    return filled;
+    const UInt32 bytesPerSample = MR_Sample_Fmt_Is_FloatX(fmt) ? sizeof(float) : sizeof(int16_t);
+    return [self deliverSamples:planes samples:planeSize / bytesPerSample latency:latency] * bytesPerSample;
 }
 
 - (UInt32)fetchPlanarSample:(uint8_t *)l_buffer
@@ -838,71 +2143,9 @@ static int decode_interrupt_cb(void *ctx)
                       right:(uint8_t *)r_buffer
                   rightSize:(UInt32)r_size
 {
-    UInt32 filled = 0;
-    Frame *ap = NULL;
-    while (l_size > 0 || r_size > 0) {
-        //队列里缓存帧大于0，则取出
-        if (frame_queue_nb_remaining(&_sampq) > 0) {
-            ap = frame_queue_peek(&_sampq);
-            av_log(NULL, AV_LOG_VERBOSE, "render audio frame %lld\n", ap->frame->pts);
-        } else {
-            //队列里没有音频桢了，跳出循环
-            break;
-        }
-        uint8_t *l_src = ap->frame->data[0];
-        const int fmt  = ap->frame->format;
-        assert(av_sample_fmt_is_planar(fmt));
-        
-        int data_size = av_samples_get_buffer_size(ap->frame->linesize, 1, ap->frame->nb_samples, fmt, 1);
-        
-        int l_src_size = data_size;//af->frame->linesize[0];
-        const int offset = ap->offset;
-        const void *leftFrom = l_src + offset;
-        int leftBytesLeft = l_src_size - offset;
-        
-        //根据剩余数据长度和需要数据长度算出应当copy的长度
-        int leftBytesToCopy = FFMIN(l_size, leftBytesLeft);
-        
-        memcpy(l_buffer, leftFrom, leftBytesToCopy);
-        l_buffer += leftBytesToCopy;
-        l_size -= leftBytesToCopy;
-        ap->offset += leftBytesToCopy;
-        filled += leftBytesToCopy;
-        uint8_t *r_src = ap->frame->data[1];
-        int r_src_size = l_src_size;//af->frame->linesize[1];
-        if (r_src) {
-            const void *right_from = r_src + offset;
-            int right_bytes_left = r_src_size - offset;
-            
-            //根据剩余数据长度和需要数据长度算出应当copy的长度
-            int rightBytesToCopy = FFMIN(r_size, right_bytes_left);
-            memcpy(r_buffer, right_from, rightBytesToCopy);
-            r_buffer += rightBytesToCopy;
-            r_size -= rightBytesToCopy;
-        }
-        
-        if (leftBytesToCopy >= leftBytesLeft){
-            //读取完毕，则清空；读取下一个包
-            av_log(NULL, AV_LOG_DEBUG, "packet sample:next frame\n");
-            frame_queue_pop(&_sampq);
-            self.audioFrameCount--;
-            if (frame_queue_nb_remaining(&_sampq) == 0) {
-                self.audioFrameEmpty = YES;
-            }
-        }
-    }
-    
-    if (NULL !=ap && filled > 0) {
-        [self updateAudioClock:ap filled:filled];
-    }
-    //没有取出采样桢，读包eof，解码也eof时标记为音频渲染完毕
-    else if(self.eof && self.audioDecoder.eof){
-        self.audioClk.eof = YES;
-        av_log(NULL, AV_LOG_INFO, "audio frame is eof\n");
-        [self maybeReachEnds];
-    }
-    
-    return filled;
+    uint8_t *planes[2] = {l_buffer, r_buffer};
+    UInt32 size = r_buffer ? FFMIN(l_size, r_size) : l_size;
+    return [self fetchPlanarSamples:planes count:r_buffer ? 2 : 1 planeSize:size];
 }
 
 - (void)maybeReachEnds
@@ -975,12 +2218,54 @@ static int decode_interrupt_cb(void *ctx)
     return (MR_PACKET_SIZE){_videoq.nb_packets,_audioq.nb_packets,0};
 }
 
+- (int)audioFrameCount
+{
+    return pcm_ring_nb_chunks(&_sampRing);
+}
+
+- (void)setPlaybackRate:(double)playbackRate
+{
+    playbackRate = av_clipd(playbackRate, 0.5, 4.0);
+    if (_playbackRate == playbackRate) {
+        return;
+    }
+    _playbackRate = playbackRate;
+    self.videoClk.speed = playbackRate;
+    //没有音频时音频时钟不走，视频按自己的时钟
+    if (!self.audioDecoder) {
+        self.audioClk.speed = playbackRate;
+    }
+    self.videoDecoder.skipFrame = [self videoSkipFrameForRate:playbackRate];
+}
+
+//倍速较高时不解码非参考帧，解码量不随速率线性增长
+- (int)videoSkipFrameForRate:(double)rate
+{
+    return rate > 1.5 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+- (BOOL)audioEnds
+{
+    //没有选中音频时不算，由视频播放完毕来结束
+    return self.audioStreamIdx >= 0 && self.audioClk.eof;
+}
+
+- (void)setMediaSelection:(FFPlayer0x32MediaSelection)mediaSelection
+{
+    if (_mediaSelection == mediaSelection) {
+        return;
+    }
+    _mediaSelection = mediaSelection;
+    //还没开始播放时在选择流时生效，否则由读包线程切换
+    self.mediaSelectionChanged = YES;
+}
+
 - (double)position
 {
     if (self.videoEnds) {
         return (double)self.duration;
     }
-    if (self.audioClk) {
+    if (self.audioClk && self.audioStreamIdx >= 0) {
         return self.audioClk.pts;
     } else if(self.videoClk) {
         return self.videoClk.pts;
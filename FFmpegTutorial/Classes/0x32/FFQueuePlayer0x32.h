@@ -0,0 +1,97 @@
+//
+//  FFQueuePlayer0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 无缝连播的播放列表
+// 当前节目剩余时长小于 preloadRemainingTime 时，在后台以暂停状态打开下一个节目（打开、探测、预解码），
+// 音频取完时在同一次 fetch 里切到下一个节目继续填充，节目之间没有空隙。
+// 音频回调里只切换预加载好的播放器指针，播放新节目、停止旧节目和通知都在主线程的检查定时器里完成。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayer0x32.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface FFQueuePlayer0x32 : NSObject
+
+///播放列表
+@property (nonatomic, copy, readonly) NSArray<NSString *> *items;
+///当前播放的节目索引
+@property (atomic, assign, readonly) NSInteger currentIndex;
+///当前节目的播放器
+@property (atomic, strong, readonly, nullable) FFPlayer0x32 *currentPlayer;
+///code is FFPlayerErrorCode enum.
+@property (nonatomic, strong, nullable) NSError *error;
+///当前节目剩余多少秒时开始预加载下一个节目，默认 5s
+@property (nonatomic, assign) double preloadRemainingTime;
+///期望的像素格式
+@property (nonatomic, assign) MRPixelFormatMask supportedPixelFormats;
+///期望的音频采样深度，后续节目会使用第一个节目协商出的采样格式
+@property (nonatomic, assign) MRSampleFormatMask supportedSampleFormats;
+///期望的声道布局，后续节目会使用第一个节目协商出的声道数
+@property (nonatomic, assign) MRChannelLayoutMask supportedChannelLayouts;
+///期望的音频采样率，不指定时使用第一个节目的采样率，后续节目都会重采样到这个采样率
+@property (nonatomic, assign) int supportedSampleRate;
+///需要重采样时 swr 的质量，默认 FFAudioResampleProfileDefault0x32
+@property (nonatomic, assign) FFAudioResampleProfile0x32 audioResampleProfile;
+///缓存本地文件的流信息，默认 NO
+@property (nonatomic, assign) BOOL useStreamInfoCache;
+///自适应探测流信息，默认 NO
+@property (nonatomic, assign) BOOL adaptiveProbe;
+///播放速率，0.5~4，默认 1.0；对当前节目和后续节目都生效
+@property (nonatomic, assign) double playbackRate;
+///播放哪些流，默认 FFPlayer0x32MediaSelectionBoth；对当前节目和后续节目都生效，比如后台播放时只要音频
+@property (nonatomic, assign) FFPlayer0x32MediaSelection mediaSelection;
+///统计电平，默认 NO；对当前节目和后续节目都生效，通过 currentPlayer 的 audioMeterSnapshot 读取
+@property (nonatomic, assign) BOOL audioMeterEnabled;
+
+@property (nonatomic, weak) id <FFPlayer0x32Delegate> delegate;
+
+- (instancetype)initWithItems:(NSArray<NSString *> *)items;
+///追加节目，可在播放过程中调用
+- (void)appendItem:(NSString *)path;
+
+///准备
+- (void)prepareToPlay;
+- (void)pause;
+- (void)play;
+///停止当前节目和预加载的节目
+- (void)asyncStop;
+///发生错误，具体错误为 self.error
+- (void)onError:(dispatch_block_t)block;
+///切换到了下一个节目
+- (void)onItemChanged:(void(^)(NSInteger index))block;
+///列表全部播放完毕
+- (void)onPlaylistEnds:(dispatch_block_t)block;
+
+// 获取 packet 形式的音频数据，返回实际填充的字节数；当前节目的音频取完时接着从下一个节目填充
+- (UInt32)fetchPacketSample:(uint8_t*)buffer
+                  wantBytes:(UInt32)bufferSize;
+
+// 同上，latency 为第一个采样从现在起还要多久才能播放出来，单位s，见 FFPlayer0x32
+- (UInt32)fetchPacketSample:(uint8_t*)buffer
+                  wantBytes:(UInt32)bufferSize
+                    latency:(double)latency;
+
+// 获取 planar 形式的音频数据，planes 为每个声道的缓冲区，返回每个平面实际填充的字节数；当前节目的音频取完时接着从下一个节目填充
+- (UInt32)fetchPlanarSamples:(uint8_t * _Nonnull const * _Nonnull)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize;
+
+// 同上，latency 为第一个采样从现在起还要多久才能播放出来，单位s
+- (UInt32)fetchPlanarSamples:(uint8_t * _Nonnull const * _Nonnull)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+                     latency:(double)latency;
+
+// 获取 planar 形式的双声道音频数据，返回实际填充的字节数；当前节目的音频取完时接着从下一个节目填充
+- (UInt32)fetchPlanarSample:(uint8_t*)left
+                   leftSize:(UInt32)leftSize
+                      right:(uint8_t*)right
+                  rightSize:(UInt32)rightSize;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,535 @@
+//
+//  FFQueuePlayer0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFQueuePlayer0x32.h"
+#import "FFPlayerInternalHeader.h"
+#include <stdatomic.h>
+
+//检查是否需要预加载、完成切换的间隔，单位s；音频回调切到下一个节目后，最多这么久开始显示它的画面
+#define PRELOAD_CHECK_INTERVAL 0.05
+
+@interface FFQueuePlayer0x32 ()<FFPlayer0x32Delegate>
+{
+    //音频渲染回调使用的节目，回调里只读这个指针，不经过 atomic 属性；指向的对象由 currentPlayer/nextPlayer 持有
+    _Atomic(void *) _renderPlayer;
+    //预加载好的下一个节目，回调里取走它就完成了切换，谁先取到谁切换
+    _Atomic(void *) _armedPlayer;
+    //回调里已经切到了下一个节目，等定时器在主线程播放新节目、停止旧节目并通知
+    atomic_bool _swapPending;
+}
+
+@property (nonatomic, strong) NSMutableArray<NSString *> *mutableItems;
+@property (atomic, assign, readwrite) NSInteger currentIndex;
+@property (atomic, strong, readwrite, nullable) FFPlayer0x32 *currentPlayer;
+//预加载的下一个节目
+@property (atomic, strong, nullable) FFPlayer0x32 *nextPlayer;
+//下一个要播放的节目索引，预加载失败时跳过
+@property (atomic, assign) NSInteger nextIndex;
+//当前节目结束了，但下一个节目还没准备好
+@property (atomic, assign) BOOL waitingForNext;
+//第一个节目协商出的音频格式，后续节目都使用这个格式，保证音频渲染器不用重新初始化
+@property (atomic, assign) MRSampleFormat sampleFormat;
+@property (atomic, assign) int channels;
+@property (nonatomic, strong, nullable) dispatch_source_t preloadTimer;
+//刚切走的节目多留一个检查间隔再释放，渲染回调可能还在用它
+@property (nonatomic, strong, nullable) FFPlayer0x32 *retiredPlayer;
+@property (atomic, assign) BOOL stopped;
+
+@property (nonatomic, copy) dispatch_block_t onErrorBlock;
+@property (nonatomic, copy) void(^onItemChangedBlock)(NSInteger index);
+@property (nonatomic, copy) dispatch_block_t onPlaylistEndsBlock;
+
+@end
+
+@implementation FFQueuePlayer0x32
+
+- (void)dealloc
+{
+    PRINT_DEALLOC;
+}
+
+- (instancetype)initWithItems:(NSArray<NSString *> *)items
+{
+    self = [super init];
+    if (self) {
+        _mutableItems = [NSMutableArray arrayWithArray:items];
+        _preloadRemainingTime = 5.0;
+        _playbackRate = 1.0;
+        _sampleFormat = MR_SAMPLE_FMT_NONE;
+        atomic_init(&_renderPlayer, NULL);
+        atomic_init(&_armedPlayer, NULL);
+        atomic_init(&_swapPending, false);
+    }
+    return self;
+}
+
+- (instancetype)init
+{
+    return [self initWithItems:@[]];
+}
+
+- (NSArray<NSString *> *)items
+{
+    @synchronized (self) {
+        return [self.mutableItems copy];
+    }
+}
+
+- (void)appendItem:(NSString *)path
+{
+    @synchronized (self) {
+        [self.mutableItems addObject:path];
+    }
+}
+
+- (NSString *)itemAtIndex:(NSInteger)idx
+{
+    @synchronized (self) {
+        return idx < self.mutableItems.count ? self.mutableItems[idx] : nil;
+    }
+}
+
+#pragma mark - 创建节目的播放器
+
+- (FFPlayer0x32 *)createPlayer:(NSString *)path
+{
+    FFPlayer0x32 *player = [[FFPlayer0x32 alloc] init];
+    player.contentPath = path;
+    player.supportedPixelFormats = self.supportedPixelFormats;
+    player.useStreamInfoCache = self.useStreamInfoCache;
+    player.adaptiveProbe = self.adaptiveProbe;
+    player.playbackRate = self.playbackRate;
+    player.mediaSelection = self.mediaSelection;
+    player.audioMeterEnabled = self.audioMeterEnabled;
+
+    const MRSampleFormat fmt = self.sampleFormat;
+    if (fmt != MR_SAMPLE_FMT_NONE) {
+        //和正在播放的节目保持一样的采样格式、声道数和采样率，切换时才能接着填充同一个缓冲区
+        player.supportedSampleFormats = 1 << fmt;
+        player.supportedChannelLayouts = 1 << self.channels;
+    } else {
+        player.supportedSampleFormats = self.supportedSampleFormats;
+        player.supportedChannelLayouts = self.supportedChannelLayouts;
+    }
+    player.supportedSampleRate = self.supportedSampleRate;
+    player.audioResampleProfile = self.audioResampleProfile;
+
+    __weak __typeof(self)weakSelf = self;
+    __weak FFPlayer0x32 *weakPlayer = player;
+    [player onError:^{
+        [weakSelf onPlayer:weakPlayer error:weakPlayer.error];
+    }];
+
+    [player onVideoEnds:^{
+        [weakSelf onPlayerEnds:weakPlayer];
+    }];
+    return player;
+}
+
+- (void)prepareToPlay
+{
+    NSString *path = [self itemAtIndex:0];
+    if (!path) {
+        NSAssert(NO, @"播放列表为空");
+        return;
+    }
+    if (self.currentPlayer) {
+        NSAssert(NO, @"不允许重复创建");
+    }
+
+    self.stopped = NO;
+    self.currentIndex = 0;
+    self.nextIndex = 1;
+    FFPlayer0x32 *player = [self createPlayer:path];
+    player.delegate = self;
+    self.currentPlayer = player;
+    atomic_store(&_renderPlayer, (__bridge void *)player);
+    [player prepareToPlay];
+
+    [self startPreloadTimer];
+}
+
+#pragma mark - 预加载
+
+- (void)startPreloadTimer
+{
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+    dispatch_source_set_timer(timer, DISPATCH_TIME_NOW, PRELOAD_CHECK_INTERVAL * NSEC_PER_SEC, 0.05 * NSEC_PER_SEC);
+    __weak __typeof(self)weakSelf = self;
+    dispatch_source_set_event_handler(timer, ^{
+        [weakSelf checkPreload];
+    });
+    dispatch_resume(timer);
+    self.preloadTimer = timer;
+}
+
+- (void)stopPreloadTimer
+{
+    if (self.preloadTimer) {
+        dispatch_source_cancel(self.preloadTimer);
+        self.preloadTimer = nil;
+    }
+}
+
+- (void)checkPreload
+{
+    self.retiredPlayer = nil;
+    if (self.stopped) {
+        return;
+    }
+
+    //音频回调里已经切过去了；或者当前节目结束时下一个节目还没准备好，准备好后立即切换
+    if (atomic_load(&_swapPending) || self.waitingForNext) {
+        if ([self swapToNextPlayer]) {
+            return;
+        }
+    }
+
+    if (self.nextPlayer) {
+        return;
+    }
+
+    FFPlayer0x32 *player = self.currentPlayer;
+    //当前节目还没开始播
+    if (!player || [player startupTimings].first_display <= 0) {
+        return;
+    }
+    //时长未知时（直播）开播后就预加载
+    if (player.duration > 0 && player.duration - player.position > self.preloadRemainingTime) {
+        return;
+    }
+
+    NSInteger idx = self.nextIndex;
+    NSString *path = [self itemAtIndex:idx];
+    if (!path) {
+        return;
+    }
+
+    FFPlayer0x32 *next = [self createPlayer:path];
+    //以暂停状态打开，解码出的帧缓存在队列里等待切换；不设置 delegate，预加载时不输出画面
+    [next pause];
+    self.nextPlayer = next;
+    atomic_store(&_armedPlayer, (__bridge void *)next);
+    [next prepareToPlay];
+    av_log(NULL, AV_LOG_INFO, "preload item %ld:%s\n", (long)idx, [path UTF8String]);
+}
+
+//在音频渲染回调里切换：不加锁、不分配内存、不打日志，只取走预加载好的节目并标记，其余的由定时器在主线程完成
+- (FFPlayer0x32 *)renderSwapToArmedPlayer
+{
+    void *armed = atomic_exchange(&_armedPlayer, NULL);
+    if (!armed) {
+        return nil;
+    }
+    atomic_store(&_renderPlayer, armed);
+    atomic_store(&_swapPending, true);
+    return (__bridge FFPlayer0x32 *)armed;
+}
+
+//在主线程完成切换：播放新节目、停止旧节目并通知；音频回调已经切过去时只做这些收尾
+- (BOOL)swapToNextPlayer
+{
+    if (self.stopped) {
+        return NO;
+    }
+    if (!atomic_exchange(&_swapPending, false)) {
+        //没有音频的节目由结束回调切换，在这里取走预加载好的节目
+        void *armed = atomic_exchange(&_armedPlayer, NULL);
+        if (!armed) {
+            return NO;
+        }
+        atomic_store(&_renderPlayer, armed);
+    }
+
+    FFPlayer0x32 *old = nil;
+    FFPlayer0x32 *next = nil;
+    NSInteger idx = 0;
+    @synchronized (self) {
+        next = self.nextPlayer;
+        old = self.currentPlayer;
+        self.nextPlayer = nil;
+        self.currentPlayer = next;
+        idx = self.nextIndex;
+        self.currentIndex = idx;
+        self.nextIndex = idx + 1;
+        self.waitingForNext = NO;
+    }
+    self.retiredPlayer = old;
+
+    old.delegate = nil;
+    next.delegate = self;
+    [next play];
+    [old asyncStop];
+    av_log(NULL, AV_LOG_INFO, "swap to item %ld\n", (long)idx);
+
+    if ([self.delegate respondsToSelector:@selector(onDurationUpdate:)]) {
+        [self.delegate onDurationUpdate:next.duration];
+    }
+    if (self.onItemChangedBlock) {
+        self.onItemChangedBlock(idx);
+    }
+    return YES;
+}
+
+- (BOOL)hasMoreItems
+{
+    @synchronized (self) {
+        return self.nextPlayer || self.nextIndex < self.mutableItems.count;
+    }
+}
+
+- (void)onPlayerEnds:(FFPlayer0x32 *)player
+{
+    //音频取完时已经切换过了，旧节目的结束回调忽略掉
+    if (!player || player != self.currentPlayer) {
+        return;
+    }
+    //没有音频的节目在这里切换
+    if ([self swapToNextPlayer]) {
+        return;
+    }
+    if ([self hasMoreItems]) {
+        self.waitingForNext = YES;
+    } else {
+        [self stopPreloadTimer];
+        if (self.onPlaylistEndsBlock) {
+            self.onPlaylistEndsBlock();
+        }
+    }
+}
+
+- (void)onPlayer:(FFPlayer0x32 *)player error:(NSError *)error
+{
+    if (!player) {
+        return;
+    }
+    void *expected = (__bridge void *)player;
+    if (player == self.nextPlayer && !atomic_compare_exchange_strong(&_armedPlayer, &expected, NULL)) {
+        //音频回调已经切到这个节目了，先完成切换，再按当前节目的错误处理
+        [self swapToNextPlayer];
+    }
+    if (player == self.nextPlayer) {
+        //预加载失败，跳过这个节目
+        av_log(NULL, AV_LOG_ERROR, "preload item %ld failed:%s\n", (long)self.nextIndex, [[error localizedDescription] UTF8String]);
+        @synchronized (self) {
+            self.nextPlayer = nil;
+            self.nextIndex++;
+        }
+        [player asyncStop];
+        return;
+    }
+    if (player == self.currentPlayer) {
+        self.error = error;
+        if (self.onErrorBlock) {
+            self.onErrorBlock();
+        }
+    }
+}
+
+#pragma mark - FFPlayer0x32Delegate
+
+- (void)reveiveFrameToRenderer:(CVPixelBufferRef)img
+{
+    if ([self.delegate respondsToSelector:@selector(reveiveFrameToRenderer:)]) {
+        [self.delegate reveiveFrameToRenderer:img];
+    }
+}
+
+- (void)onInitAudioRender:(MRSampleFormat)fmt channels:(int)channels
+{
+    //只有第一个带音频的节目会走到这里，后续节目沿用这个格式
+    self.channels = channels;
+    self.sampleFormat = fmt;
+    if (self.supportedSampleRate == 0) {
+        self.supportedSampleRate = self.currentPlayer.supportedSampleRate;
+    }
+    if ([self.delegate respondsToSelector:@selector(onInitAudioRender:channels:)]) {
+        [self.delegate onInitAudioRender:fmt channels:channels];
+    } else if ([self.delegate respondsToSelector:@selector(onInitAudioRender:)]) {
+        [self.delegate onInitAudioRender:fmt];
+    }
+}
+
+- (void)onDurationUpdate:(long)du
+{
+    if ([self.delegate respondsToSelector:@selector(onDurationUpdate:)]) {
+        [self.delegate onDurationUpdate:du];
+    }
+}
+
+#pragma mark - 音频
+
+//已经填充的字节数对应的播放时长，planar 时按一个平面计算
+- (double)durationOfBytes:(UInt32)bytes player:(FFPlayer0x32 *)player planar:(BOOL)planar
+{
+    const MRSampleFormat fmt = player.outputSampleFormat;
+    const int sampleRate = player.supportedSampleRate;
+    const int frameBytes = (MR_Sample_Fmt_Is_FloatX(fmt) ? sizeof(float) : sizeof(int16_t)) * (planar ? 1 : player.outputChannels);
+    if (bytes == 0 || sampleRate <= 0 || frameBytes <= 0) {
+        return 0;
+    }
+    return (double)bytes / frameBytes / sampleRate;
+}
+
+- (UInt32)fetchPacketSample:(uint8_t *)buffer
+                  wantBytes:(UInt32)bufferSize
+{
+    return [self fetchPacketSample:buffer wantBytes:bufferSize latency:NAN];
+}
+
+- (UInt32)fetchPacketSample:(uint8_t *)buffer
+                  wantBytes:(UInt32)bufferSize
+                    latency:(double)latency
+{
+    UInt32 filled = 0;
+    __unsafe_unretained FFPlayer0x32 *player = (__bridge FFPlayer0x32 *)atomic_load(&_renderPlayer);
+    while (player && filled < bufferSize) {
+        //前面已经填充的部分播完才轮到这次取的数据
+        const double lat = latency + [self durationOfBytes:filled player:player planar:NO];
+        UInt32 got = [player fetchPacketSample:buffer + filled wantBytes:bufferSize - filled latency:lat];
+        filled += got;
+        //取到了部分数据，再取一次才能知道是缓冲不足还是播放完毕
+        if (got > 0) {
+            continue;
+        }
+        //当前节目的音频取完了，接着用下一个节目填充剩余的部分，保证采样连续
+        if (!player.audioEnds) {
+            break;
+        }
+        player = [self renderSwapToArmedPlayer];
+    }
+    return filled;
+}
+
+- (UInt32)fetchPlanarSamples:(uint8_t * const *)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+{
+    return [self fetchPlanarSamples:planes count:count planeSize:planeSize latency:NAN];
+}
+
+- (UInt32)fetchPlanarSamples:(uint8_t * const *)planes
+                       count:(int)count
+                   planeSize:(UInt32)planeSize
+                     latency:(double)latency
+{
+    UInt32 filled = 0;
+    uint8_t *dst[MR_CH_LAYOUT_MAX_CHANNELS];
+    count = FFMIN(count, MR_CH_LAYOUT_MAX_CHANNELS);
+    __unsafe_unretained FFPlayer0x32 *player = (__bridge FFPlayer0x32 *)atomic_load(&_renderPlayer);
+    while (player && filled < planeSize) {
+        for (int i = 0; i < count; i++) {
+            dst[i] = planes[i] + filled;
+        }
+        const double lat = latency + [self durationOfBytes:filled player:player planar:YES];
+        UInt32 got = [player fetchPlanarSamples:dst count:count planeSize:planeSize - filled latency:lat];
+        filled += got;
+        if (got > 0) {
+            continue;
+        }
+        if (!player.audioEnds) {
+            break;
+        }
+        player = [self renderSwapToArmedPlayer];
+    }
+    return filled;
+}
+
+- (UInt32)fetchPlanarSample:(uint8_t *)left
+                   leftSize:(UInt32)leftSize
+                      right:(uint8_t *)right
+                  rightSize:(UInt32)rightSize
+{
+    UInt32 filled = 0;
+    __unsafe_unretained FFPlayer0x32 *player = (__bridge FFPlayer0x32 *)atomic_load(&_renderPlayer);
+    while (player && filled < leftSize) {
+        UInt32 got = [player fetchPlanarSample:left + filled
+                                      leftSize:leftSize - filled
+                                         right:right + filled
+                                     rightSize:rightSize - filled];
+        filled += got;
+        if (got > 0) {
+            continue;
+        }
+        if (!player.audioEnds) {
+            break;
+        }
+        player = [self renderSwapToArmedPlayer];
+    }
+    return filled;
+}
+
+#pragma mark - 控制
+
+- (void)setPlaybackRate:(double)playbackRate
+{
+    _playbackRate = playbackRate;
+    self.currentPlayer.playbackRate = playbackRate;
+    self.nextPlayer.playbackRate = playbackRate;
+}
+
+- (void)setMediaSelection:(FFPlayer0x32MediaSelection)mediaSelection
+{
+    _mediaSelection = mediaSelection;
+    self.currentPlayer.mediaSelection = mediaSelection;
+    self.nextPlayer.mediaSelection = mediaSelection;
+}
+
+- (void)setAudioMeterEnabled:(BOOL)audioMeterEnabled
+{
+    _audioMeterEnabled = audioMeterEnabled;
+    self.currentPlayer.audioMeterEnabled = audioMeterEnabled;
+    self.nextPlayer.audioMeterEnabled = audioMeterEnabled;
+}
+
+- (void)pause
+{
+    [self.currentPlayer pause];
+}
+
+- (void)play
+{
+    [self.currentPlayer play];
+}
+
+- (void)asyncStop
+{
+    FFPlayer0x32 *current = nil;
+    FFPlayer0x32 *next = nil;
+    @synchronized (self) {
+        self.stopped = YES;
+        atomic_store(&_renderPlayer, NULL);
+        atomic_store(&_armedPlayer, NULL);
+        atomic_store(&_swapPending, false);
+        current = self.currentPlayer;
+        next = self.nextPlayer;
+        self.currentPlayer = nil;
+        self.nextPlayer = nil;
+    }
+    [self stopPreloadTimer];
+    self.retiredPlayer = nil;
+    current.delegate = nil;
+    [current asyncStop];
+    [next asyncStop];
+}
+
+- (void)onError:(dispatch_block_t)block
+{
+    self.onErrorBlock = block;
+}
+
+- (void)onItemChanged:(void (^)(NSInteger))block
+{
+    self.onItemChangedBlock = block;
+}
+
+- (void)onPlaylistEnds:(dispatch_block_t)block
+{
+    self.onPlaylistEndsBlock = block;
+}
+
+@end
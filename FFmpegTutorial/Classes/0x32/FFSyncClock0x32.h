@@ -15,6 +15,8 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign) double pts_drift;
 @property (nonatomic, assign) double last_update;
 @property (nonatomic, assign) double frame_timer;
+//时钟走的速度，即播放速率；修改时从当前时间点开始按新速度走，默认 1.0
+@property (nonatomic, assign) double speed;
 //每个采样几个字节
 @property (nonatomic, assign) int bytesPerSample;
 @property (atomic, assign) BOOL eof;
@@ -15,6 +15,23 @@
     
 }
 
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _speed = 1.0;
+    }
+    return self;
+}
+
+- (void)setSpeed:(double)speed
+{
+    if (_speed != speed) {
+        [self setClock:[self getClock]];
+        _speed = speed;
+    }
+}
+
 - (void)setClock:(double)pts
 {
     double time = av_gettime_relative() / 1000000.0;
@@ -34,7 +51,7 @@
         return self.pts;
     } else {
         double time = av_gettime_relative() / 1000000.0;
-        return self.pts_drift + time;
+        return self.pts_drift + time - (time - self.last_update) * (1.0 - self.speed);
     }
 }
 
@@ -0,0 +1,58 @@
+//
+//  FFSyntheticSource0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 合成的媒体源，不需要媒体文件和网络
+// 用 MRPatternGenerator 生成画面，按参数输出原始视频包（rawvideo）或编码后的视频包，以及正弦波 PCM 音频包；
+// 播放器把它当作普通的 AVFormatContext，包照常经过读包线程、解码器、帧队列和音视频同步，
+// 用于稳定复现吞吐和延迟问题。
+//
+// 地址格式：synthetic://?w=1920&h=1080&fps=60&codec=mpeg4&bitrate=8000000&gop=60&ar=48000&duration=30&pattern=snow&timecode=1&live=0
+// w/h：分辨率，默认 1280x720
+// fps：帧率，默认 25
+// codec：视频编码器名字，默认 rawvideo 即不编码；其他值需要 FFmpeg 编译了对应的编码器
+// bitrate：编码码率，默认 4000000；gop：关键帧间隔，默认 fps 的 2 倍
+// ar：音频采样率，默认 44100，0 表示没有音频
+// duration：时长，单位s，默认 0 表示不结束
+// pattern：snow、gray 或 gradient，默认 gradient；timecode：是否叠加时间码，默认 1
+// live：为 1 时按实际时间产生包，模拟直播源，默认 0 即尽快产生
+// 被丢弃（AVDISCARD_ALL）的流不产生包；直播模式的等待通过 formatContext 的 interrupt_callback 打断
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct AVFormatContext AVFormatContext;
+typedef struct AVPacket AVPacket;
+
+@interface FFSyntheticSource0x32 : NSObject
+
+@property (nonatomic, assign) int width;
+@property (nonatomic, assign) int height;
+@property (nonatomic, assign) double fps;
+@property (nonatomic, copy) NSString *codecName;
+@property (nonatomic, assign) int64_t bitRate;
+@property (nonatomic, assign) int gopSize;
+@property (nonatomic, assign) int sampleRate;
+@property (nonatomic, assign) double duration;
+@property (nonatomic, copy) NSString *pattern;
+@property (nonatomic, assign) BOOL timecode;
+@property (nonatomic, assign) BOOL live;
+///open 之后可用，包含视频流和音频流（如果有），由本对象释放
+@property (nonatomic, assign, readonly, nullable) AVFormatContext *formatContext;
+
++ (BOOL)isSyntheticURL:(NSString *)url;
+///解析地址里的参数
+- (instancetype)initWithURL:(NSString *)url;
+///创建流，打开编码器；return 0 没有错误
+- (int)open;
+///按时间顺序交错产生音视频包；到达时长后返回 AVERROR_EOF，等待时被打断返回 AVERROR_EXIT
+- (int)readPacket:(AVPacket *)pkt;
+///已产生的包数和字节数
+- (NSString *)statsDescription;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,472 @@
+//
+//  FFSyntheticSource0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFSyntheticSource0x32.h"
+#import "MRPatternGenerator.h"
+#import <libavformat/avformat.h>
+#import <libavcodec/avcodec.h>
+#import <libavutil/imgutils.h>
+#import <libavutil/time.h>
+
+#define SYNTHETIC_SCHEME @"synthetic://"
+//每个音频包的采样数
+#define SYNTHETIC_AUDIO_SAMPLES 1024
+//正弦波频率
+#define SYNTHETIC_TONE_HZ 440.0
+//模拟直播源等待时，每次最多睡这么久，单位s，醒来检查是否要打断
+#define SYNTHETIC_WAIT_SLICE 0.01
+
+@implementation FFSyntheticSource0x32
+{
+    AVFormatContext *_ic;
+    AVStream *_videoSt;
+    AVStream *_audioSt;
+    AVCodecContext *_enc;
+    AVFrame *_frame;
+    MRPatternGenerator *_generator;
+    //下一个视频帧的序号，单位是视频流的 time_base
+    int64_t _videoPts;
+    //下一个音频包的第一个采样
+    int64_t _audioPts;
+    BOOL _videoEOF;
+    BOOL _encoderFlushing;
+    double _phase;
+    double _beginTime;
+    int64_t _videoPackets;
+    int64_t _videoBytes;
+    int64_t _keyFrames;
+    int64_t _audioPackets;
+    int64_t _audioBytes;
+}
+
+- (void)dealloc
+{
+    if (_enc) {
+        avcodec_free_context(&_enc);
+    }
+    if (_frame) {
+        av_frame_free(&_frame);
+    }
+    if (_ic) {
+        avformat_free_context(_ic);
+        _ic = NULL;
+    }
+}
+
++ (BOOL)isSyntheticURL:(NSString *)url
+{
+    return [url hasPrefix:SYNTHETIC_SCHEME];
+}
+
+- (instancetype)initWithURL:(NSString *)url
+{
+    self = [super init];
+    if (self) {
+        _width = 1280;
+        _height = 720;
+        _fps = 25;
+        _codecName = @"rawvideo";
+        _bitRate = 4000000;
+        _sampleRate = 44100;
+        _pattern = @"gradient";
+        _timecode = YES;
+
+        NSURLComponents *components = [NSURLComponents componentsWithString:url];
+        for (NSURLQueryItem *item in components.queryItems) {
+            NSString *v = item.value;
+            if (v.length == 0) {
+                continue;
+            }
+            if ([item.name isEqualToString:@"w"]) {
+                _width = [v intValue];
+            } else if ([item.name isEqualToString:@"h"]) {
+                _height = [v intValue];
+            } else if ([item.name isEqualToString:@"fps"]) {
+                _fps = [v doubleValue];
+            } else if ([item.name isEqualToString:@"codec"]) {
+                _codecName = v;
+            } else if ([item.name isEqualToString:@"bitrate"]) {
+                _bitRate = [v longLongValue];
+            } else if ([item.name isEqualToString:@"gop"]) {
+                _gopSize = [v intValue];
+            } else if ([item.name isEqualToString:@"ar"]) {
+                _sampleRate = [v intValue];
+            } else if ([item.name isEqualToString:@"duration"]) {
+                _duration = [v doubleValue];
+            } else if ([item.name isEqualToString:@"pattern"]) {
+                _pattern = v;
+            } else if ([item.name isEqualToString:@"timecode"]) {
+                _timecode = [v boolValue];
+            } else if ([item.name isEqualToString:@"live"]) {
+                _live = [v boolValue];
+            }
+        }
+    }
+    return self;
+}
+
+- (AVFormatContext *)formatContext
+{
+    return _ic;
+}
+
+#pragma mark - 创建流
+
+- (MRPatternType)patternType
+{
+    if ([self.pattern isEqualToString:@"snow"]) {
+        return MRPatternSnow;
+    } else if ([self.pattern isEqualToString:@"gray"]) {
+        return MRPatternGrayBar;
+    }
+    return MRPatternGradient;
+}
+
+//编码器支持的像素格式里，挑一个生成器能直接填充的
+static enum AVPixelFormat choose_encoder_pix_fmt(const AVCodec *codec)
+{
+    if (!codec->pix_fmts) {
+        return AV_PIX_FMT_YUV420P;
+    }
+    for (const enum AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+        if (*p == AV_PIX_FMT_YUV420P || *p == AV_PIX_FMT_YUVJ420P || *p == AV_PIX_FMT_NV12) {
+            return *p;
+        }
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+- (int)openVideoStream
+{
+    if (self.width <= 0 || self.height <= 0 || self.fps <= 0) {
+        return AVERROR(EINVAL);
+    }
+    const AVRational frameRate = av_d2q(self.fps, 100000);
+    AVStream *st = avformat_new_stream(_ic, NULL);
+    if (!st) {
+        return AVERROR(ENOMEM);
+    }
+    st->time_base = av_inv_q(frameRate);
+    st->avg_frame_rate = frameRate;
+    st->r_frame_rate = frameRate;
+
+    enum AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
+    const int gop = self.gopSize > 0 ? self.gopSize : (int)lrint(self.fps * 2);
+
+    if ([self.codecName isEqualToString:@"rawvideo"]) {
+        AVCodecParameters *par = st->codecpar;
+        par->codec_type = AVMEDIA_TYPE_VIDEO;
+        par->codec_id = AV_CODEC_ID_RAWVIDEO;
+        par->format = pix_fmt;
+        par->width = self.width;
+        par->height = self.height;
+        par->color_range = AVCOL_RANGE_JPEG;
+        par->bit_rate = (int64_t)(av_image_get_buffer_size(pix_fmt, self.width, self.height, 1) * 8 * self.fps);
+    } else {
+        const AVCodec *codec = avcodec_find_encoder_by_name([self.codecName UTF8String]);
+        if (!codec || codec->type != AVMEDIA_TYPE_VIDEO) {
+            av_log(NULL, AV_LOG_ERROR, "synthetic source:can't find video encoder %s\n", [self.codecName UTF8String]);
+            return AVERROR_ENCODER_NOT_FOUND;
+        }
+        pix_fmt = choose_encoder_pix_fmt(codec);
+        if (pix_fmt == AV_PIX_FMT_NONE) {
+            av_log(NULL, AV_LOG_ERROR, "synthetic source:%s has no supported pixel format\n", codec->name);
+            return AVERROR(EINVAL);
+        }
+        AVCodecContext *enc = avcodec_alloc_context3(codec);
+        if (!enc) {
+            return AVERROR(ENOMEM);
+        }
+        enc->width = self.width;
+        enc->height = self.height;
+        enc->pix_fmt = pix_fmt;
+        enc->time_base = st->time_base;
+        enc->framerate = frameRate;
+        enc->bit_rate = self.bitRate;
+        enc->gop_size = gop;
+        //不要 B 帧，一帧进一帧出，解码端不需要重排
+        enc->max_b_frames = 0;
+        //参数集放到 extradata 里，和普通的封装格式一样交给解码器
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        int ret = avcodec_open2(enc, codec, NULL);
+        if (ret < 0) {
+            avcodec_free_context(&enc);
+            return ret;
+        }
+        ret = avcodec_parameters_from_context(st->codecpar, enc);
+        if (ret < 0) {
+            avcodec_free_context(&enc);
+            return ret;
+        }
+        _enc = enc;
+    }
+    _videoSt = st;
+
+    _frame = av_frame_alloc();
+    if (!_frame) {
+        return AVERROR(ENOMEM);
+    }
+    _frame->format = pix_fmt;
+    _frame->width = self.width;
+    _frame->height = self.height;
+    _frame->color_range = AVCOL_RANGE_JPEG;
+    //rawvideo 直接把画面画到包里，不需要单独分配
+    if (_enc) {
+        int ret = av_frame_get_buffer(_frame, 32);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    _generator = [[MRPatternGenerator alloc] initWithType:[self patternType] width:self.width height:self.height];
+    _generator.fps = self.fps;
+    _generator.burnInTimecode = self.timecode;
+    return 0;
+}
+
+- (int)openAudioStream
+{
+    AVStream *st = avformat_new_stream(_ic, NULL);
+    if (!st) {
+        return AVERROR(ENOMEM);
+    }
+    st->time_base = (AVRational){1, self.sampleRate};
+    AVCodecParameters *par = st->codecpar;
+    par->codec_type = AVMEDIA_TYPE_AUDIO;
+    par->codec_id = AV_CODEC_ID_PCM_S16LE;
+    par->format = AV_SAMPLE_FMT_S16;
+    par->sample_rate = self.sampleRate;
+    par->channels = 2;
+    par->channel_layout = AV_CH_LAYOUT_STEREO;
+    par->bits_per_coded_sample = 16;
+    par->block_align = 4;
+    par->bit_rate = (int64_t)self.sampleRate * 2 * 16;
+    _audioSt = st;
+    return 0;
+}
+
+- (int)open
+{
+    if (_ic) {
+        return 0;
+    }
+    _ic = avformat_alloc_context();
+    if (!_ic) {
+        return AVERROR(ENOMEM);
+    }
+    int ret = [self openVideoStream];
+    if (ret < 0) {
+        return ret;
+    }
+    if (self.sampleRate > 0) {
+        ret = [self openAudioStream];
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    _ic->duration = self.duration > 0 ? (int64_t)(self.duration * AV_TIME_BASE) : AV_NOPTS_VALUE;
+    _beginTime = av_gettime_relative() / 1000000.0;
+    av_log(NULL, AV_LOG_INFO, "synthetic source:%dx%d@%g %s gop:%d bitrate:%lld,audio:%d,duration:%g,live:%d\n", self.width, self.height, self.fps, [self.codecName UTF8String], _enc ? _enc->gop_size : 1, _videoSt->codecpar->bit_rate, self.sampleRate, self.duration, self.live);
+    return 0;
+}
+
+#pragma mark - 产生包
+
+- (BOOL)videoReachEnd
+{
+    return self.duration > 0 && _videoPts * av_q2d(_videoSt->time_base) >= self.duration;
+}
+
+- (BOOL)audioReachEnd
+{
+    return !_audioSt || (self.duration > 0 && _audioPts >= self.duration * self.sampleRate);
+}
+
+- (int)readRawVideoPacket:(AVPacket *)pkt
+{
+    const int size = av_image_get_buffer_size(_frame->format, _frame->width, _frame->height, 1);
+    int ret = av_new_packet(pkt, size);
+    if (ret < 0) {
+        return ret;
+    }
+    av_image_fill_arrays(_frame->data, _frame->linesize, pkt->data, _frame->format, _frame->width, _frame->height, 1);
+    [_generator fillFrame:_frame];
+    pkt->pts = pkt->dts = _videoPts++;
+    pkt->duration = 1;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+    return 0;
+}
+
+- (int)readEncodedVideoPacket:(AVPacket *)pkt
+{
+    for (;;) {
+        int ret = avcodec_receive_packet(_enc, pkt);
+        if (ret == 0) {
+            av_packet_rescale_ts(pkt, _enc->time_base, _videoSt->time_base);
+            return 0;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            return ret;
+        }
+        //到达时长后冲洗编码器，取完剩下的包后返回 AVERROR_EOF
+        if ([self videoReachEnd]) {
+            if (_encoderFlushing) {
+                return AVERROR_EOF;
+            }
+            _encoderFlushing = YES;
+            avcodec_send_frame(_enc, NULL);
+            continue;
+        }
+        //编码器可能还引用着上一帧
+        ret = av_frame_make_writable(_frame);
+        if (ret < 0) {
+            return ret;
+        }
+        [_generator fillFrame:_frame];
+        _frame->pts = _videoPts++;
+        ret = avcodec_send_frame(_enc, _frame);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+}
+
+- (int)readVideoPacket:(AVPacket *)pkt
+{
+    if (_videoEOF) {
+        return AVERROR_EOF;
+    }
+    int ret;
+    if (_enc) {
+        ret = [self readEncodedVideoPacket:pkt];
+    } else {
+        ret = [self videoReachEnd] ? AVERROR_EOF : [self readRawVideoPacket:pkt];
+    }
+    if (ret == AVERROR_EOF) {
+        _videoEOF = YES;
+    } else if (ret == 0) {
+        pkt->stream_index = _videoSt->index;
+        _videoPackets++;
+        _videoBytes += pkt->size;
+        if (pkt->flags & AV_PKT_FLAG_KEY) {
+            _keyFrames++;
+        }
+    }
+    return ret;
+}
+
+- (int)readAudioPacket:(AVPacket *)pkt
+{
+    if ([self audioReachEnd]) {
+        return AVERROR_EOF;
+    }
+    const int nb_samples = SYNTHETIC_AUDIO_SAMPLES;
+    int ret = av_new_packet(pkt, nb_samples * 4);
+    if (ret < 0) {
+        return ret;
+    }
+    int16_t *samples = (int16_t *)pkt->data;
+    const double step = 2 * M_PI * SYNTHETIC_TONE_HZ / self.sampleRate;
+    for (int i = 0; i < nb_samples; i++) {
+        const int16_t v = (int16_t)(sin(_phase) * 0.2 * INT16_MAX);
+        samples[2 * i] = v;
+        samples[2 * i + 1] = v;
+        _phase += step;
+        if (_phase > 2 * M_PI) {
+            _phase -= 2 * M_PI;
+        }
+    }
+    pkt->pts = pkt->dts = _audioPts;
+    pkt->duration = nb_samples;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+    pkt->stream_index = _audioSt->index;
+    _audioPts += nb_samples;
+    _audioPackets++;
+    _audioBytes += pkt->size;
+    return 0;
+}
+
+//和 FFmpeg 的协议层一样，通过 formatContext 的 interrupt_callback 打断
+- (BOOL)isInterrupted
+{
+    const AVIOInterruptCB *cb = &_ic->interrupt_callback;
+    return cb->callback && cb->callback(cb->opaque);
+}
+
+//模拟直播源：包的时间戳没到就等，分成小段睡，停止时不用等到时间戳；被打断时返回 AVERROR_EXIT
+- (int)waitUntil:(double)ts
+{
+    for (;;) {
+        if ([self isInterrupted]) {
+            return AVERROR_EXIT;
+        }
+        const double wait = _beginTime + ts - av_gettime_relative() / 1000000.0;
+        if (wait <= 0) {
+            return 0;
+        }
+        av_usleep((unsigned)(FFMIN(wait, SYNTHETIC_WAIT_SLICE) * 1000000));
+    }
+}
+
+//播放器丢弃的流（比如媒体选择只要音频）不产生包，也不编码
+- (BOOL)isDiscarded:(AVStream *)st
+{
+    return st && st->discard == AVDISCARD_ALL;
+}
+
+- (int)readPacket:(AVPacket *)pkt
+{
+    for (;;) {
+        const BOOL videoDiscarded = [self isDiscarded:_videoSt];
+        const BOOL audioDiscarded = [self isDiscarded:_audioSt];
+        //丢弃的流跟着另一路走，重新选中时从当前时间接着产生
+        if (videoDiscarded && !audioDiscarded && _audioSt) {
+            _videoPts = FFMAX(_videoPts, av_rescale_q(_audioPts, _audioSt->time_base, _videoSt->time_base));
+        } else if (audioDiscarded && !videoDiscarded) {
+            _audioPts = FFMAX(_audioPts, av_rescale_q(_videoPts, _videoSt->time_base, _audioSt->time_base));
+        }
+        const BOOL videoDone = _videoEOF || videoDiscarded;
+        const BOOL audioDone = [self audioReachEnd] || audioDiscarded;
+        if (videoDone && audioDone) {
+            return AVERROR_EOF;
+        }
+        //按时间戳交错，谁落后就先产生谁
+        BOOL wantVideo;
+        if (videoDone) {
+            wantVideo = NO;
+        } else if (audioDone) {
+            wantVideo = YES;
+        } else {
+            wantVideo = av_compare_ts(_videoPts, _videoSt->time_base, _audioPts, _audioSt->time_base) <= 0;
+        }
+
+        if (self.live) {
+            int ret = [self waitUntil:wantVideo ? _videoPts * av_q2d(_videoSt->time_base) : (double)_audioPts / self.sampleRate];
+            if (ret < 0) {
+                return ret;
+            }
+        }
+
+        int ret = wantVideo ? [self readVideoPacket:pkt] : [self readAudioPacket:pkt];
+        //这一路结束了，换另一路
+        if (ret == AVERROR_EOF) {
+            continue;
+        }
+        return ret;
+    }
+}
+
+- (NSString *)statsDescription
+{
+    const double elapsed = av_gettime_relative() / 1000000.0 - _beginTime;
+    const double mediaTime = _videoSt ? _videoPts * av_q2d(_videoSt->time_base) : 0;
+    return [NSString stringWithFormat:@"synthetic source:video %lld pkts(%lld key),%lld bytes,%.0fkbps;audio %lld pkts,%lld bytes;%.2fs media in %.2fs",
+            _videoPackets, _keyFrames, _videoBytes, mediaTime > 0 ? _videoBytes * 8 / mediaTime / 1000 : 0,
+            _audioPackets, _audioBytes, mediaTime, elapsed];
+}
+
+@end
@@ -0,0 +1,36 @@
+//
+//  FFTimeStretch0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 变速不变调（WSOLA）
+// 输入按 rate 倍的间隔取出 40ms 的窗口，在 ±10ms 内找和上一个窗口的自然延续最相似的位置，加汉宁窗后以 20ms 的间隔叠加输出；
+// 在音频解码线程里每帧调用一次，音频渲染回调里没有额外的计算。rate 为 1 时不搜索，输出和输入完全一样（有固定延迟）。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayerHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+///data 为每个平面的首地址，格式和输入一样；pts 为第一个采样对应的媒体时间
+typedef void(^FFTimeStretchOutput0x32)(uint8_t * _Nonnull const * _Nonnull data, int samples, double pts);
+
+@interface FFTimeStretch0x32 : NSObject
+
+///播放速率，0.5~4
+@property (nonatomic, assign) double rate;
+@property (nonatomic, assign, readonly) MRSampleFormat format;
+@property (nonatomic, assign, readonly) int channels;
+@property (nonatomic, assign, readonly) int sampleRate;
+
+- (nullable instancetype)initWithFormat:(MRSampleFormat)format channels:(int)channels sampleRate:(int)sampleRate;
+
+///输入 samples 个采样，src 为每个平面的首地址，pts 为第一个采样的媒体时间；处理好的数据通过 output 交出，可能一次都没有；return 0 没有错误
+- (int)process:(uint8_t * const _Nonnull * _Nonnull)src samples:(int)samples pts:(double)pts output:(FFTimeStretchOutput0x32)output;
+///交出还没处理的输入（不变速），用于恢复 1 倍速时不丢数据，之后回到初始状态
+- (void)flush:(FFTimeStretchOutput0x32)output;
+
+@end
+
+NS_ASSUME_NONNULL_END
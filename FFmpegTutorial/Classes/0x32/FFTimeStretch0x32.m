@@ -0,0 +1,360 @@
+//
+//  FFTimeStretch0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFTimeStretch0x32.h"
+#import "MRAudioKernels.h"
+#import <libavutil/mem.h>
+#import <libavutil/common.h>
+#include <math.h>
+
+//输出的间隔（窗口长度的一半），单位s
+#define STRETCH_HOP_DURATION 0.02
+//粗搜索时相似度的采样间隔和位置步长
+#define STRETCH_COARSE_STEP 4
+
+@implementation FFTimeStretch0x32
+{
+    int _hop;       //输出间隔，窗口长度为 2 倍
+    int _window;
+    int _tolerance; //搜索范围
+    float *_win;
+    //待处理的输入，每个声道一个平面，_mono 是混合后的单声道用于计算相似度
+    float *_in[MR_CH_LAYOUT_MAX_CHANNELS];
+    float *_mono;
+    int _inLen;
+    int _inCap;
+    double _inPts;  //_in[0] 的媒体时间
+    double _inPos;  //下一个窗口的名义起始位置
+    int _prev;      //上一个窗口的实际起始位置
+    BOOL _started;
+    //叠加缓冲区，窗口长度
+    float *_acc[MR_CH_LAYOUT_MAX_CHANNELS];
+    //本次处理的输出
+    float *_out[MR_CH_LAYOUT_MAX_CHANNELS];
+    int _outLen;
+    int _outCap;
+    double _outPts;
+    //转换回输入格式后的输出
+    uint8_t *_conv[MR_CH_LAYOUT_MAX_CHANNELS];
+    int _convCap;
+}
+
+- (void)dealloc
+{
+    av_freep(&_win);
+    av_freep(&_mono);
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        av_freep(&_in[c]);
+        av_freep(&_acc[c]);
+        av_freep(&_out[c]);
+        av_freep(&_conv[c]);
+    }
+}
+
+- (instancetype)initWithFormat:(MRSampleFormat)format channels:(int)channels sampleRate:(int)sampleRate
+{
+    if (format == MR_SAMPLE_FMT_NONE || channels <= 0 || channels > MR_CH_LAYOUT_MAX_CHANNELS || sampleRate <= 0) {
+        return nil;
+    }
+    self = [super init];
+    if (self) {
+        _format = format;
+        _channels = channels;
+        _sampleRate = sampleRate;
+        _rate = 1.0;
+        _hop = FFMAX((int)(sampleRate * STRETCH_HOP_DURATION), 16);
+        _window = 2 * _hop;
+        _tolerance = _hop / 2;
+        _inPts = NAN;
+
+        _win = av_malloc_array(_window, sizeof(float));
+        if (!_win) {
+            return nil;
+        }
+        //周期汉宁窗，间隔半个窗口叠加后恒为 1
+        for (int i = 0; i < _window; i++) {
+            _win[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / _window);
+        }
+        for (int c = 0; c < channels; c++) {
+            _acc[c] = av_mallocz_array(_window, sizeof(float));
+            if (!_acc[c]) {
+                return nil;
+            }
+        }
+    }
+    return self;
+}
+
+- (void)setRate:(double)rate
+{
+    _rate = av_clipd(rate, 0.5, 4.0);
+}
+
+#pragma mark - 缓冲区
+
+- (BOOL)growArrays:(float **)arrays count:(int)count capacity:(int *)cap need:(int)need
+{
+    if (need <= *cap) {
+        return YES;
+    }
+    const int newCap = FFMAX(need, *cap * 2);
+    for (int c = 0; c < count; c++) {
+        float *p = av_realloc_array(arrays[c], newCap, sizeof(float));
+        if (!p) {
+            return NO;
+        }
+        arrays[c] = p;
+    }
+    *cap = newCap;
+    return YES;
+}
+
+- (BOOL)appendInput:(uint8_t * const *)src samples:(int)samples pts:(double)pts
+{
+    int cap = _inCap;
+    if (![self growArrays:_in count:_channels capacity:&cap need:_inLen + samples]) {
+        return NO;
+    }
+    int monoCap = _inCap;
+    if (![self growArrays:&_mono count:1 capacity:&monoCap need:_inLen + samples]) {
+        return NO;
+    }
+    _inCap = cap;
+
+    if (_inLen == 0) {
+        _inPts = pts;
+    }
+    uint8_t *dst[MR_CH_LAYOUT_MAX_CHANNELS];
+    for (int c = 0; c < _channels; c++) {
+        dst[c] = (uint8_t *)(_in[c] + _inLen);
+    }
+    [MRAudioKernels convert:src format:_format to:dst format:MR_SAMPLE_FMT_FLTP channels:_channels samples:samples];
+
+    const float k = 1.0f / _channels;
+    float *mono = _mono + _inLen;
+    memcpy(mono, _in[0] + _inLen, samples * sizeof(float));
+    for (int c = 1; c < _channels; c++) {
+        const float *s = _in[c] + _inLen;
+        for (int i = 0; i < samples; i++) {
+            mono[i] += s[i];
+        }
+    }
+    if (_channels > 1) {
+        for (int i = 0; i < samples; i++) {
+            mono[i] *= k;
+        }
+    }
+    _inLen += samples;
+    return YES;
+}
+
+//丢掉之后用不到的输入
+- (void)discardInput:(int)count
+{
+    if (count <= 0) {
+        return;
+    }
+    count = FFMIN(count, _inLen);
+    const int left = _inLen - count;
+    for (int c = 0; c < _channels; c++) {
+        memmove(_in[c], _in[c] + count, left * sizeof(float));
+    }
+    memmove(_mono, _mono + count, left * sizeof(float));
+    _inLen = left;
+    _inPos -= count;
+    _prev -= count;
+    if (!isnan(_inPts)) {
+        _inPts += (double)count / _sampleRate;
+    }
+}
+
+- (BOOL)appendOutput:(float * const *)src samples:(int)samples pts:(double)pts
+{
+    if (samples <= 0) {
+        return YES;
+    }
+    int cap = _outCap;
+    if (![self growArrays:_out count:_channels capacity:&cap need:_outLen + samples]) {
+        return NO;
+    }
+    _outCap = cap;
+    if (_outLen == 0) {
+        _outPts = pts;
+    }
+    for (int c = 0; c < _channels; c++) {
+        memcpy(_out[c] + _outLen, src[c], samples * sizeof(float));
+    }
+    _outLen += samples;
+    return YES;
+}
+
+//把输出转换回输入格式交给调用方
+- (void)deliverOutput:(FFTimeStretchOutput0x32)output
+{
+    if (_outLen == 0) {
+        return;
+    }
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(_format);
+    const int bps = MR_Sample_Fmt_Is_FloatX(_format) ? sizeof(float) : sizeof(int16_t);
+    const int planes = planar ? _channels : 1;
+    const int bytes = _outLen * bps * (planar ? 1 : _channels);
+    if (bytes > _convCap) {
+        for (int p = 0; p < planes; p++) {
+            uint8_t *buf = av_realloc(_conv[p], bytes);
+            if (!buf) {
+                _outLen = 0;
+                return;
+            }
+            _conv[p] = buf;
+        }
+        _convCap = bytes;
+    }
+    uint8_t *src[MR_CH_LAYOUT_MAX_CHANNELS];
+    for (int c = 0; c < _channels; c++) {
+        src[c] = (uint8_t *)_out[c];
+    }
+    [MRAudioKernels convert:src format:MR_SAMPLE_FMT_FLTP to:_conv format:_format channels:_channels samples:_outLen];
+    output(_conv, _outLen, _outPts);
+    _outLen = 0;
+}
+
+#pragma mark - WSOLA
+
+//候选窗口和参考窗口的归一化相关度
+static float stretch_similarity(const float *ref, const float *cand, int n, int stride)
+{
+    float dot = 0, energy = 0;
+    for (int i = 0; i < n; i += stride) {
+        dot += ref[i] * cand[i];
+        energy += cand[i] * cand[i];
+    }
+    return dot / sqrtf(energy + 1e-9f);
+}
+
+//在 [lo, hi] 里找和上一个窗口的自然延续最相似的起始位置，先粗搜索再在附近细搜索
+- (int)searchFrom:(int)lo to:(int)hi
+{
+    const float *ref = _mono + _prev + _hop;
+    int best = lo;
+    float bestScore = -INFINITY;
+    for (int s = lo; s <= hi; s += STRETCH_COARSE_STEP) {
+        const float score = stretch_similarity(ref, _mono + s, _window, STRETCH_COARSE_STEP);
+        if (score > bestScore) {
+            bestScore = score;
+            best = s;
+        }
+    }
+    const int center = best;
+    bestScore = -INFINITY;
+    for (int s = FFMAX(lo, center - STRETCH_COARSE_STEP + 1); s <= FFMIN(hi, center + STRETCH_COARSE_STEP - 1); s++) {
+        const float score = stretch_similarity(ref, _mono + s, _window, 2);
+        if (score > bestScore) {
+            bestScore = score;
+            best = s;
+        }
+    }
+    return best;
+}
+
+//叠加一个窗口，输出一个间隔的采样
+- (BOOL)overlapAddAt:(int)s
+{
+    for (int c = 0; c < _channels; c++) {
+        float *acc = _acc[c];
+        const float *in = _in[c] + s;
+        for (int i = 0; i < _window; i++) {
+            acc[i] += _win[i] * in[i];
+        }
+    }
+    const double pts = isnan(_inPts) ? NAN : _inPts + (double)s / _sampleRate;
+    if (![self appendOutput:_acc samples:_hop pts:pts]) {
+        return NO;
+    }
+    for (int c = 0; c < _channels; c++) {
+        memmove(_acc[c], _acc[c] + _hop, (_window - _hop) * sizeof(float));
+        memset(_acc[c] + _window - _hop, 0, _hop * sizeof(float));
+    }
+    return YES;
+}
+
+- (int)process:(uint8_t * const *)src samples:(int)samples pts:(double)pts output:(FFTimeStretchOutput0x32)output
+{
+    if (![self appendInput:src samples:samples pts:pts]) {
+        return AVERROR(ENOMEM);
+    }
+
+    if (!_started) {
+        if (_inLen < _window) {
+            return 0;
+        }
+        //假设前面还有一个窗口正好自然衔接，第一个窗口不会淡入
+        for (int c = 0; c < _channels; c++) {
+            for (int i = 0; i < _window - _hop; i++) {
+                _acc[c][i] = _win[i + _hop] * _in[c][i];
+            }
+        }
+        if (![self overlapAddAt:0]) {
+            return AVERROR(ENOMEM);
+        }
+        _prev = 0;
+        _inPos = _hop * _rate;
+        _started = YES;
+    }
+
+    for (;;) {
+        int s;
+        if (_rate == 1.0) {
+            //不变速时直接取自然延续的位置，输出和输入一样
+            s = _prev + _hop;
+            if (s + _window > _inLen) {
+                break;
+            }
+            _inPos = s;
+        } else {
+            const int p = (int)lrint(_inPos);
+            if (FFMAX(p + _tolerance, _prev + _hop) + _window > _inLen) {
+                break;
+            }
+            s = [self searchFrom:FFMAX(p - _tolerance, 0) to:p + _tolerance];
+        }
+        if (![self overlapAddAt:s]) {
+            return AVERROR(ENOMEM);
+        }
+        _prev = s;
+        _inPos += _hop * _rate;
+    }
+    //参考窗口从 _prev + _hop 开始，下一次搜索从 _inPos - _tolerance 开始
+    [self discardInput:FFMIN(_prev + _hop, (int)lrint(_inPos) - _tolerance)];
+    [self deliverOutput:output];
+    return 0;
+}
+
+- (void)flush:(FFTimeStretchOutput0x32)output
+{
+    //叠加缓冲区里是上一个窗口的后半部分，加上自然延续正好还原输入，所以从 _prev + _hop 开始原样输出即可
+    const int from = _started ? FFMIN(_prev + _hop, _inLen) : 0;
+    if (_inLen > from) {
+        float *src[MR_CH_LAYOUT_MAX_CHANNELS];
+        for (int c = 0; c < _channels; c++) {
+            src[c] = _in[c] + from;
+        }
+        const double pts = isnan(_inPts) ? NAN : _inPts + (double)from / _sampleRate;
+        [self appendOutput:src samples:_inLen - from pts:pts];
+    }
+    [self deliverOutput:output];
+
+    _inLen = 0;
+    _inPos = 0;
+    _prev = 0;
+    _inPts = NAN;
+    _started = NO;
+    for (int c = 0; c < _channels; c++) {
+        memset(_acc[c], 0, _window * sizeof(float));
+    }
+}
+
+@end
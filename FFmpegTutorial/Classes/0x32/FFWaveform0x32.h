@@ -0,0 +1,60 @@
+//
+//  FFWaveform0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 多级分辨率的最小/最大值波形文件（MRWF），由 FFWaveformAnalyzer0x32 生成
+// 文件按小端序存储，依次为：文件头、levelCount 个层级描述、各层的数据（按 16 字节对齐）；
+// 每层有 binCount 个 bin，每个 bin 依次是每个声道的 {int16 min, int16 max}，满幅为 ±32767；
+// 第 0 层每个 bin 对应 samplesPerBin 个采样，之后每层的一个 bin 对应上一层的 levelFactor 个 bin。
+// 读取时整个文件内存映射，不拷贝也不解析数据，可以直接交给绘制代码。
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define MR_WAVEFORM_MAGIC "MRWF"
+#define MR_WAVEFORM_VERSION 1
+#define MR_WAVEFORM_ALIGNMENT 16
+
+typedef struct MRWaveformFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t samplesPerBin;     //第 0 层每个 bin 的采样数
+    uint32_t levelFactor;       //相邻两层的倍数
+    uint32_t levelCount;
+    uint32_t reserved;
+    uint64_t totalSamples;      //每个声道的采样数
+} MRWaveformFileHeader;
+
+typedef struct MRWaveformLevel {
+    uint64_t offset;            //数据相对文件开头的偏移
+    uint64_t binCount;
+} MRWaveformLevel;
+
+@interface FFWaveform0x32 : NSObject
+
+@property (nonatomic, assign, readonly) int sampleRate;
+@property (nonatomic, assign, readonly) int channels;
+@property (nonatomic, assign, readonly) int samplesPerBin;
+@property (nonatomic, assign, readonly) int levelFactor;
+@property (nonatomic, assign, readonly) int levelCount;
+@property (nonatomic, assign, readonly) int64_t totalSamples;
+///时长，单位s
+@property (nonatomic, assign, readonly) double duration;
+
+///内存映射打开，格式不对时返回 nil
+- (nullable instancetype)initWithPath:(NSString *)path;
+///第 level 层的数据，count 为 bin 的个数，每个 bin 有 channels * 2 个 int16
+- (nullable const int16_t *)binsAtLevel:(int)level count:(int64_t *)count;
+///第 level 层每个 bin 对应的采样数
+- (int64_t)samplesPerBinAtLevel:(int)level;
+///画 width 个点时使用的层级：bin 数不少于 width 的最粗的一层
+- (int)levelForWidth:(int)width;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,101 @@
+//
+//  FFWaveform0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFWaveform0x32.h"
+
+@interface FFWaveform0x32 ()
+
+@property (nonatomic, strong) NSData *data;
+
+@end
+
+@implementation FFWaveform0x32
+{
+    const MRWaveformLevel *_levels;
+}
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:NULL];
+    if (data.length < sizeof(MRWaveformFileHeader)) {
+        return nil;
+    }
+    const uint8_t *bytes = data.bytes;
+    const MRWaveformFileHeader *header = (const MRWaveformFileHeader *)bytes;
+    if (memcmp(header->magic, MR_WAVEFORM_MAGIC, 4) || header->version != MR_WAVEFORM_VERSION) {
+        return nil;
+    }
+    if (header->channels == 0 || header->sampleRate == 0 || header->samplesPerBin == 0 || header->levelFactor < 2) {
+        return nil;
+    }
+    const uint64_t tableEnd = sizeof(MRWaveformFileHeader) + (uint64_t)header->levelCount * sizeof(MRWaveformLevel);
+    if (tableEnd > data.length) {
+        return nil;
+    }
+    //每层的数据都要在文件里，并且按 int16 对齐
+    const MRWaveformLevel *levels = (const MRWaveformLevel *)(bytes + sizeof(MRWaveformFileHeader));
+    const uint64_t binBytes = (uint64_t)header->channels * 2 * sizeof(int16_t);
+    for (uint32_t i = 0; i < header->levelCount; i++) {
+        const MRWaveformLevel *l = &levels[i];
+        if (l->offset % sizeof(int16_t) || l->offset < tableEnd || l->offset > data.length
+            || l->binCount > (data.length - l->offset) / binBytes) {
+            return nil;
+        }
+    }
+    
+    self = [super init];
+    if (self) {
+        _data = data;
+        _levels = levels;
+        _sampleRate = header->sampleRate;
+        _channels = header->channels;
+        _samplesPerBin = header->samplesPerBin;
+        _levelFactor = header->levelFactor;
+        _levelCount = header->levelCount;
+        _totalSamples = header->totalSamples;
+        _duration = (double)_totalSamples / _sampleRate;
+    }
+    return self;
+}
+
+- (const int16_t *)binsAtLevel:(int)level count:(int64_t *)count
+{
+    if (level < 0 || level >= self.levelCount) {
+        if (count) {
+            *count = 0;
+        }
+        return NULL;
+    }
+    const MRWaveformLevel *l = &_levels[level];
+    if (count) {
+        *count = l->binCount;
+    }
+    return (const int16_t *)((const uint8_t *)self.data.bytes + l->offset);
+}
+
+- (int64_t)samplesPerBinAtLevel:(int)level
+{
+    int64_t n = self.samplesPerBin;
+    for (int i = 0; i < level; i++) {
+        n *= self.levelFactor;
+    }
+    return n;
+}
+
+- (int)levelForWidth:(int)width
+{
+    int level = 0;
+    for (int i = 1; i < self.levelCount; i++) {
+        if (_levels[i].binCount < width) {
+            break;
+        }
+        level = i;
+    }
+    return level;
+}
+
+@end
@@ -0,0 +1,52 @@
+//
+//  FFWaveformAnalyzer0x32.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 波形分析，用于拖动进度条时显示整个文件的波形
+// 只解封装和解码音频，其他流在解封装时就丢弃；没有同步和渲染线程，读包线程 -> 包队列 -> FFDecoder0x32 解码线程全速运行，
+// 在解码线程里按 bin 统计每个声道的最小/最大值（SIMD），逐层合并成多级分辨率，结束后写成 MRWF 文件（见 FFWaveform0x32）。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayerHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct FFWaveformAnalyzerStats0x32 {
+    int64_t packets;            //读到的音频包数
+    int64_t frames;             //解码出的音频帧数
+    int64_t samples;            //每个声道统计的采样数
+    double media_duration;      //已经分析的音频时长，单位s
+    double elapsed;             //耗时（含打开文件和写文件），单位s
+    double speed;               //media_duration / elapsed，即多少倍实时
+    int64_t file_size;          //波形文件的大小
+} FFWaveformAnalyzerStats0x32;
+
+@interface FFWaveformAnalyzer0x32 : NSObject
+
+///音频或视频文件的地址
+@property (nonatomic, copy) NSString *contentPath;
+///波形文件的保存路径，先写临时文件，完成后再改名
+@property (nonatomic, copy) NSString *outputPath;
+///第 0 层每个 bin 的采样数，默认 256
+@property (nonatomic, assign) int samplesPerBin;
+///相邻两层的倍数，默认 4；bin 数少于这个值的一层为最上层
+@property (nonatomic, assign) int levelFactor;
+///code is FFPlayerErrorCode enum.
+@property (nonatomic, strong, nullable) NSError *error;
+
+///开始分析，在后台线程里进行
+- (void)start;
+///取消分析，不会回调，也不会生成文件
+- (void)cancel;
+///分析完成，波形文件已经写好，在主线程回调
+- (void)onFinished:(void(^)(FFWaveformAnalyzerStats0x32 stats))block;
+///发生错误，具体错误为 self.error
+- (void)onError:(dispatch_block_t)block;
+///分析进度，可以在任意线程调用
+- (FFWaveformAnalyzerStats0x32)stats;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,548 @@
+//
+//  FFWaveformAnalyzer0x32.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFWaveformAnalyzer0x32.h"
+#import "FFWaveform0x32.h"
+#import "MRThread.h"
+#import "FFPlayerInternalHeader.h"
+#import "FFPlayerPacketHeader.h"
+#import "FFDecoder0x32.h"
+#import "FFAudioResample0x32.h"
+#import "MRAudioKernels.h"
+#import <libavutil/time.h>
+#include <stdio.h>
+#include <unistd.h>
+
+//最多生成的层数，256 * 4^15 个采样足够覆盖任何音频
+#define WAVEFORM_MAX_LEVELS 16
+//非 FLTP 的帧分块转换成 float 平面，每块的采样点数
+#define WAVEFORM_CHUNK_SAMPLES 1024
+
+///一层的数据和正在累计的 bin
+typedef struct WaveformLevel {
+    int16_t *bins;
+    int64_t count;
+    int64_t cap;
+    float min[MR_CH_LAYOUT_MAX_CHANNELS];
+    float max[MR_CH_LAYOUT_MAX_CHANNELS];
+    //第 0 层为已经累计的采样数，其他层为已经累计的下一层的 bin 数
+    int64_t filled;
+} WaveformLevel;
+
+static MRSampleFormat waveform_mr_format(int format)
+{
+    switch (format) {
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S16P:
+        case AV_SAMPLE_FMT_FLT:
+        case AV_SAMPLE_FMT_FLTP:
+            return AVSampleFormat2MR(format);
+        default:
+            return MR_SAMPLE_FMT_NONE;
+    }
+}
+
+@interface FFWaveformAnalyzer0x32 ()<FFDecoderDelegate0x32>
+{
+    PacketQueue _audioq;
+    WaveformLevel _levels[WAVEFORM_MAX_LEVELS];
+    float *_scratch[MR_CH_LAYOUT_MAX_CHANNELS];
+    FFWaveformAnalyzerStats0x32 _stats;
+}
+
+@property (nonatomic, strong) MRThread *readThread;
+@property (atomic, strong) FFDecoder0x32 *audioDecoder;
+//格式不是 S16/S16P/FLT/FLTP，或者声道数、采样率中途变化时转换成第一帧的参数
+@property (nonatomic, strong, nullable) FFAudioResample0x32 *audioResample;
+@property (nonatomic, assign) int resampleSrcFormat;
+@property (nonatomic, assign) int64_t resampleSrcLayout;
+@property (nonatomic, assign) int resampleSrcRate;
+//以第一帧为准
+@property (nonatomic, assign) int sampleRate;
+@property (nonatomic, assign) int channels;
+@property (atomic, assign) int abort_request;
+//内存不够或者转换失败，不再统计
+@property (atomic, assign) BOOL failed;
+@property (nonatomic, assign) double beginTime;
+@property (nonatomic, copy) void(^onFinishedBlock)(FFWaveformAnalyzerStats0x32 stats);
+@property (nonatomic, copy) dispatch_block_t onErrorBlock;
+
+@end
+
+static int waveform_interrupt_cb(void *ctx)
+{
+    FFWaveformAnalyzer0x32 *analyzer = (__bridge FFWaveformAnalyzer0x32 *)ctx;
+    return analyzer.abort_request;
+}
+
+@implementation FFWaveformAnalyzer0x32
+
+- (void)dealloc
+{
+    packet_queue_destroy(&_audioq);
+    for (int i = 0; i < WAVEFORM_MAX_LEVELS; i++) {
+        av_freep(&_levels[i].bins);
+    }
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        av_freep(&_scratch[c]);
+    }
+    PRINT_DEALLOC;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _samplesPerBin = 256;
+        _levelFactor = 4;
+    }
+    return self;
+}
+
+- (void)start
+{
+    if (self.readThread) {
+        NSAssert(NO, @"不允许重复创建");
+    }
+    packet_queue_init(&_audioq);
+    init_ffmpeg_once();
+    memset(_levels, 0, sizeof(_levels));
+    memset(&_stats, 0, sizeof(_stats));
+    self.samplesPerBin = FFMAX(self.samplesPerBin, 1);
+    self.levelFactor = FFMAX(self.levelFactor, 2);
+    
+    self.readThread = [[MRThread alloc] initWithTarget:self selector:@selector(analyzeFunc) object:nil];
+    self.readThread.name = @"mr-waveform-read";
+    [self.readThread start];
+}
+
+- (void)cancel
+{
+    self.abort_request = 1;
+    _audioq.abort_request = 1;
+    [self.audioDecoder cancel];
+    [self.readThread cancel];
+}
+
+- (void)onFinished:(void (^)(FFWaveformAnalyzerStats0x32))block
+{
+    self.onFinishedBlock = block;
+}
+
+- (void)onError:(dispatch_block_t)block
+{
+    self.onErrorBlock = block;
+}
+
+- (FFWaveformAnalyzerStats0x32)stats
+{
+    return _stats;
+}
+
+- (void)performErrorResultOnMainThread
+{
+    MR_sync_main_queue(^{
+        if (self.onErrorBlock) {
+            self.onErrorBlock();
+        }
+    });
+}
+
+#pragma mark - 读包线程
+
+- (void)analyzeFunc
+{
+    self.beginTime = av_gettime_relative() / 1000000.0;
+    if (![self.contentPath hasPrefix:@"/"]) {
+        _init_net_work_once();
+    }
+    
+    AVFormatContext *formatCtx = avformat_alloc_context();
+    if (!formatCtx) {
+        self.error = _make_nserror_desc(FFPlayerErrorCode_AllocFmtCtxFailed, @"创建 AVFormatContext 失败！");
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    formatCtx->interrupt_callback.callback = waveform_interrupt_cb;
+    formatCtx->interrupt_callback.opaque = (__bridge void *)self;
+    
+    const char *path = [self.contentPath cStringUsingEncoding:NSUTF8StringEncoding];
+    if (0 != avformat_open_input(&formatCtx, path, NULL, NULL)) {
+        avformat_free_context(formatCtx);
+        if (!self.abort_request) {
+            self.error = _make_nserror_desc(FFPlayerErrorCode_OpenFileFailed, @"文件打开失败！");
+            [self performErrorResultOnMainThread];
+        }
+        return;
+    }
+    
+    if (0 != avformat_find_stream_info(formatCtx, NULL)) {
+        avformat_close_input(&formatCtx);
+        if (!self.abort_request) {
+            self.error = _make_nserror_desc(FFPlayerErrorCode_StreamNotFound, @"不能找到流！");
+            [self performErrorResultOnMainThread];
+        }
+        return;
+    }
+    
+    const int audioIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    if (audioIdx < 0) {
+        avformat_close_input(&formatCtx);
+        self.error = _make_nserror_desc(FFPlayerErrorCode_StreamNotFound, @"不能找到音频流！");
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    //除了音频都在解封装时丢弃，视频包不会读出来
+    for (int i = 0; i < formatCtx->nb_streams; i++) {
+        formatCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+    
+    FFDecoder0x32 *decoder = [FFDecoder0x32 new];
+    decoder.ic = formatCtx;
+    decoder.streamIdx = audioIdx;
+    decoder.delegate = self;
+    decoder.name = @"mr-waveform-dec";
+    if ([decoder open] != 0) {
+        avformat_close_input(&formatCtx);
+        self.error = _make_nserror_desc(FFPlayerErrorCode_StreamOpenFailed, @"音频流打开失败！");
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    self.audioDecoder = decoder;
+    [decoder start];
+    
+    [self readPacketLoop:formatCtx audioIdx:audioIdx];
+    //等解码线程处理完最后的空包
+    [decoder join];
+    self.audioDecoder = nil;
+    avformat_close_input(&formatCtx);
+    
+    if (self.abort_request) {
+        return;
+    }
+    if (self.failed) {
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    [self finishLevels];
+    if (self.failed) {
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    const int64_t size = [self writeFile];
+    if (size < 0) {
+        self.error = _make_nserror_desc(FFPlayerErrorCode_WriteFileFailed, @"波形文件写入失败！");
+        [self performErrorResultOnMainThread];
+        return;
+    }
+    _stats.file_size = size;
+    [self updateElapsed];
+    
+    FFWaveformAnalyzerStats0x32 st = _stats;
+    MRFF_INFO_LOG(@"waveform:%0.1fs audio in %0.3fs,%0.1fx realtime,packets:%lld,frames:%lld,file:%lld bytes",st.media_duration,st.elapsed,st.speed,st.packets,st.frames,st.file_size);
+    MR_sync_main_queue(^{
+        if (self.onFinishedBlock) {
+            self.onFinishedBlock(st);
+        }
+    });
+}
+
+//只读音频包，不限速，队列里的数据超过上限时等解码线程
+- (void)readPacketLoop:(AVFormatContext *)formatCtx audioIdx:(int)audioIdx
+{
+    AVPacket pkt1, *pkt = &pkt1;
+    for (;;) {
+        if (self.abort_request || self.failed || self.audioDecoder.eof) {
+            break;
+        }
+        if (_audioq.size > MAX_QUEUE_SIZE) {
+            mr_msleep(10);
+            continue;
+        }
+        int ret = av_read_frame(formatCtx, pkt);
+        if (ret < 0) {
+            if (ret == AVERROR_EOF || avio_feof(formatCtx->pb) || (formatCtx->pb && formatCtx->pb->error)) {
+                break;
+            }
+            mr_msleep(10);
+            continue;
+        }
+        if (pkt->stream_index == audioIdx) {
+            _stats.packets++;
+            packet_queue_put(&_audioq, pkt);
+        } else {
+            av_packet_unref(pkt);
+        }
+    }
+    //读完了放一个空包，解码器吐出缓存的帧后结束
+    packet_queue_put_nullpacket(&_audioq, audioIdx);
+}
+
+- (void)updateElapsed
+{
+    _stats.elapsed = av_gettime_relative() / 1000000.0 - self.beginTime;
+    _stats.media_duration = self.sampleRate > 0 ? (double)_stats.samples / self.sampleRate : 0;
+    _stats.speed = _stats.elapsed > 0 ? _stats.media_duration / _stats.elapsed : 0;
+}
+
+#pragma mark - FFDecoderDelegate0x32
+
+- (int)decoder:(FFDecoder0x32 *)decoder wantAPacket:(AVPacket *)pkt
+{
+    return packet_queue_get(&_audioq, pkt, 1);
+}
+
+- (void)decoder:(FFDecoder0x32 *)decoder reveivedAFrame:(AVFrame *)frame
+{
+    if (self.failed || frame->nb_samples <= 0) {
+        return;
+    }
+    if (self.sampleRate == 0) {
+        self.sampleRate = frame->sample_rate;
+        self.channels = FFMIN(frame->channels, MR_CH_LAYOUT_MAX_CHANNELS);
+    }
+    _stats.frames++;
+    
+    MRSampleFormat fmt = waveform_mr_format(frame->format);
+    AVFrame *outP = frame;
+    if (fmt == MR_SAMPLE_FMT_NONE || frame->channels != self.channels || frame->sample_rate != self.sampleRate) {
+        if (![self resampleFrame:frame out:&outP]) {
+            self.error = _make_nserror_desc(FFPlayerErrorCode_ResampleFrameFailed, @"音频帧重采样失败！");
+            self.failed = YES;
+            return;
+        }
+        fmt = MR_SAMPLE_FMT_FLTP;
+    }
+    if (![self analyze:outP->extended_data format:fmt samples:outP->nb_samples]) {
+        self.error = _make_nserror_desc(FFPlayerErrorCode_WriteFileFailed, @"波形数据内存不足！");
+        self.failed = YES;
+        return;
+    }
+    [self updateElapsed];
+}
+
+- (BOOL)resampleFrame:(AVFrame *)frame out:(AVFrame **)outP
+{
+    //重采样需要的是声道布局，没有布局时按声道数取默认布局
+    if (!frame->channel_layout) {
+        frame->channel_layout = av_get_default_channel_layout(frame->channels);
+    }
+    const int64_t srcLayout = frame->channel_layout;
+    if (!self.audioResample || self.resampleSrcFormat != frame->format || self.resampleSrcLayout != srcLayout || self.resampleSrcRate != frame->sample_rate) {
+        //只是为了画波形，用最快的参数
+        self.audioResample = [[FFAudioResample0x32 alloc] initWithSrcSampleFmt:frame->format
+                                                                  dstSampleFmt:AV_SAMPLE_FMT_FLTP
+                                                                    srcChannel:srcLayout
+                                                                    dstChannel:av_get_default_channel_layout(self.channels)
+                                                                       srcRate:frame->sample_rate
+                                                                       dstRate:self.sampleRate
+                                                                       profile:FFAudioResampleProfileFast0x32];
+        self.resampleSrcFormat = frame->format;
+        self.resampleSrcLayout = srcLayout;
+        self.resampleSrcRate = frame->sample_rate;
+    }
+    if (!self.audioResample) {
+        return NO;
+    }
+    return [self.audioResample resampleFrame:frame out:outP];
+}
+
+#pragma mark - 统计
+
+- (BOOL)analyze:(uint8_t * const *)data format:(MRSampleFormat)format samples:(int)samples
+{
+    const int channels = self.channels;
+    if (format != MR_SAMPLE_FMT_FLTP && !_scratch[0]) {
+        for (int c = 0; c < channels; c++) {
+            _scratch[c] = av_malloc_array(WAVEFORM_CHUNK_SAMPLES, sizeof(float));
+            if (!_scratch[c]) {
+                return NO;
+            }
+        }
+    }
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(format);
+    const int bps = MR_Sample_Fmt_Is_FloatX(format) ? sizeof(float) : sizeof(int16_t);
+    uint8_t *src[MR_CH_LAYOUT_MAX_CHANNELS];
+    const float *planes[MR_CH_LAYOUT_MAX_CHANNELS];
+    
+    int off = 0;
+    while (off < samples) {
+        const int n = FFMIN(samples - off, WAVEFORM_CHUNK_SAMPLES);
+        if (format == MR_SAMPLE_FMT_FLTP) {
+            for (int c = 0; c < channels; c++) {
+                planes[c] = (const float *)data[c] + off;
+            }
+        } else {
+            for (int c = 0; c < (planar ? channels : 1); c++) {
+                src[c] = data[c] + (size_t)off * bps * (planar ? 1 : channels);
+            }
+            [MRAudioKernels convert:src format:format to:(uint8_t * const *)_scratch format:MR_SAMPLE_FMT_FLTP channels:channels samples:n];
+            for (int c = 0; c < channels; c++) {
+                planes[c] = _scratch[c];
+            }
+        }
+        if (![self accumulate:planes samples:n]) {
+            return NO;
+        }
+        off += n;
+    }
+    _stats.samples += samples;
+    return YES;
+}
+
+//第 0 层按 bin 的边界分段，每段每个声道算一次最值
+- (BOOL)accumulate:(const float * const *)planes samples:(int)n
+{
+    WaveformLevel *level = &_levels[0];
+    const int channels = self.channels;
+    int off = 0;
+    while (off < n) {
+        const int k = (int)FFMIN(n - off, self.samplesPerBin - level->filled);
+        for (int c = 0; c < channels; c++) {
+            float lo, hi;
+            [MRAudioKernels minMax:planes[c] + off count:k min:&lo max:&hi];
+            if (level->filled == 0) {
+                level->min[c] = lo;
+                level->max[c] = hi;
+            } else {
+                level->min[c] = FFMIN(level->min[c], lo);
+                level->max[c] = FFMAX(level->max[c], hi);
+            }
+        }
+        level->filled += k;
+        off += k;
+        if (level->filled == self.samplesPerBin) {
+            if (![self emitBin:0 min:level->min max:level->max]) {
+                return NO;
+            }
+            level->filled = 0;
+        }
+    }
+    return YES;
+}
+
+//第 idx 层追加一个 bin，同时合并到上一层正在累计的 bin 里，满了继续往上
+- (BOOL)emitBin:(int)idx min:(const float *)mn max:(const float *)mx
+{
+    WaveformLevel *level = &_levels[idx];
+    const int channels = self.channels;
+    if (level->count == level->cap) {
+        const int64_t cap = FFMAX(level->cap * 2, 1024);
+        int16_t *bins = av_realloc_array(level->bins, cap, channels * 2 * sizeof(int16_t));
+        if (!bins) {
+            return NO;
+        }
+        level->bins = bins;
+        level->cap = cap;
+    }
+    int16_t *bin = level->bins + level->count * channels * 2;
+    for (int c = 0; c < channels; c++) {
+        //最小值向下取整，最大值向上取整，量化后的包络不会比实际的小
+        bin[2 * c] = (int16_t)floorf(av_clipf(mn[c], -1.0f, 1.0f) * 32767.0f);
+        bin[2 * c + 1] = (int16_t)ceilf(av_clipf(mx[c], -1.0f, 1.0f) * 32767.0f);
+    }
+    level->count++;
+    
+    if (idx + 1 >= WAVEFORM_MAX_LEVELS) {
+        return YES;
+    }
+    WaveformLevel *parent = &_levels[idx + 1];
+    for (int c = 0; c < channels; c++) {
+        if (parent->filled == 0) {
+            parent->min[c] = mn[c];
+            parent->max[c] = mx[c];
+        } else {
+            parent->min[c] = FFMIN(parent->min[c], mn[c]);
+            parent->max[c] = FFMAX(parent->max[c], mx[c]);
+        }
+    }
+    parent->filled++;
+    if (parent->filled == self.levelFactor) {
+        parent->filled = 0;
+        return [self emitBin:idx + 1 min:parent->min max:parent->max];
+    }
+    return YES;
+}
+
+//结束时每层没满的 bin 也要输出，从下往上依次合并
+- (void)finishLevels
+{
+    for (int i = 0; i < WAVEFORM_MAX_LEVELS; i++) {
+        WaveformLevel *level = &_levels[i];
+        if (level->filled > 0) {
+            level->filled = 0;
+            if (![self emitBin:i min:level->min max:level->max]) {
+                self.error = _make_nserror_desc(FFPlayerErrorCode_WriteFileFailed, @"波形数据内存不足！");
+                self.failed = YES;
+                return;
+            }
+        }
+    }
+}
+
+#pragma mark - 写文件
+
+//返回文件大小，失败返回 -1；iOS/macOS 都是小端序，直接写内存里的结构体
+- (int64_t)writeFile
+{
+    //bin 数少于 levelFactor 的一层为最上层
+    int levelCount = 0;
+    for (int i = 0; i < WAVEFORM_MAX_LEVELS && _levels[i].count > 0; i++) {
+        levelCount = i + 1;
+        if (_levels[i].count < self.levelFactor) {
+            break;
+        }
+    }
+    
+    MRWaveformFileHeader header = {0};
+    memcpy(header.magic, MR_WAVEFORM_MAGIC, 4);
+    header.version = MR_WAVEFORM_VERSION;
+    header.sampleRate = self.sampleRate;
+    header.channels = self.channels;
+    header.samplesPerBin = self.samplesPerBin;
+    header.levelFactor = self.levelFactor;
+    header.levelCount = levelCount;
+    header.totalSamples = _stats.samples;
+    
+    const int64_t binBytes = self.channels * 2 * sizeof(int16_t);
+    MRWaveformLevel table[WAVEFORM_MAX_LEVELS];
+    uint64_t offset = sizeof(header) + levelCount * sizeof(MRWaveformLevel);
+    for (int i = 0; i < levelCount; i++) {
+        offset = FFALIGN(offset, MR_WAVEFORM_ALIGNMENT);
+        table[i].offset = offset;
+        table[i].binCount = _levels[i].count;
+        offset += _levels[i].count * binBytes;
+    }
+    
+    NSString *tmpPath = [self.outputPath stringByAppendingString:@".tmp"];
+    FILE *fp = fopen([tmpPath fileSystemRepresentation], "wb");
+    if (!fp) {
+        return -1;
+    }
+    static const uint8_t zeros[MR_WAVEFORM_ALIGNMENT] = {0};
+    BOOL ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && levelCount > 0) {
+        ok = fwrite(table, sizeof(MRWaveformLevel), levelCount, fp) == levelCount;
+    }
+    for (int i = 0; ok && i < levelCount; i++) {
+        const long pad = (long)(table[i].offset - ftell(fp));
+        if (pad > 0) {
+            ok = fwrite(zeros, 1, pad, fp) == pad;
+        }
+        if (ok && _levels[i].count > 0) {
+            ok = fwrite(_levels[i].bins, binBytes, _levels[i].count, fp) == _levels[i].count;
+        }
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename([tmpPath fileSystemRepresentation], [self.outputPath fileSystemRepresentation]) != 0) {
+        unlink([tmpPath fileSystemRepresentation]);
+        return -1;
+    }
+    return (int64_t)offset;
+}
+
+@end
@@ -12,6 +12,10 @@
 typedef NS_ENUM(NSUInteger, FFPlayer0x40VideoType) {
     FFPlayer0x40VideoSnowType,
     FFPlayer0x40VideoGrayType,
+    //移动的斜向渐变
+    FFPlayer0x40VideoGradientType,
+    //灰阶叠加时间码
+    FFPlayer0x40VideoTimecodeType,
 };
 
 NS_ASSUME_NONNULL_BEGIN
@@ -26,6 +30,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, weak) id <FFPlayer0x40Delegate> delegate;
 @property (nonatomic, assign) FFPlayer0x40VideoType videoType;
+///帧率，默认 25
+@property (nonatomic, assign) double fps;
 
 - (void)prapareWithSize:(CGSize)size;
 - (void)play;
@@ -8,8 +8,10 @@
 #import "FFPlayer0x40.h"
 #import "MRThread.h"
 #import "MRConvertUtil.h"
+#import "MRPatternGenerator.h"
 #import "FFPlayerInternalHeader.h"
 #import <CoreVideo/CVPixelBufferPool.h>
+#import <libavutil/time.h>
 
 @interface FFPlayer0x40 ()
 
@@ -20,6 +22,7 @@
 @property (atomic, assign) int abort_request;
 @property (nonatomic, copy) dispatch_block_t onErrorBlock;
 @property (assign, nonatomic) CGSize videoSize;
+@property (nonatomic, strong) MRPatternGenerator *generator;
 
 @end
 
@@ -49,36 +52,59 @@
     PRINT_DEALLOC;
 }
 
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _fps = 25;
+    }
+    return self;
+}
+
 - (void)prepareRendererThread
 {
     self.rendererThread = [[MRThread alloc] initWithTarget:self selector:@selector(rendererThreadFunc) object:nil];
     self.rendererThread.name = @"mr-renderer";
 }
 
+- (CVPixelBufferRef)nextPixelBuffer
+{
+    MRPatternGenerator *generator = self.generator;
+    generator.fps = self.fps;
+    switch (self.videoType) {
+        case FFPlayer0x40VideoGrayType:
+            generator.type = MRPatternGrayBar;
+            generator.burnInTimecode = NO;
+            break;
+        case FFPlayer0x40VideoSnowType:
+            generator.type = MRPatternSnow;
+            generator.burnInTimecode = NO;
+            break;
+        case FFPlayer0x40VideoGradientType:
+            generator.type = MRPatternGradient;
+            generator.burnInTimecode = NO;
+            break;
+        case FFPlayer0x40VideoTimecodeType:
+            generator.type = MRPatternGrayBar;
+            generator.burnInTimecode = YES;
+            break;
+    }
+    return [generator nextPixelBuffer:self.pixelBufferPool];
+}
+
 - (void)rendererThreadFunc
 {
+    //按绝对时间排期，生成耗时的波动不会累积成帧率偏差
+    double begin = av_gettime_relative() / 1000000.0;
+    int64_t frames = 0;
     //调用了stop方法，则不再渲染
     while (!self.abort_request) {
         
-        NSTimeInterval begin = CFAbsoluteTimeGetCurrent();
+        NSTimeInterval start = CFAbsoluteTimeGetCurrent();
         
         if ([self.delegate respondsToSelector:@selector(reveiveFrameToRenderer:)]) {
             @autoreleasepool {
-                
-                CVPixelBufferRef sample = NULL;
-                switch (self.videoType) {
-                    case FFPlayer0x40VideoGrayType:
-                    {
-                        sample = [MRConvertUtil grayColorBarPixelBuffer:self.videoSize.width h:self.videoSize.height opt:self.pixelBufferPool];
-                    }
-                        break;
-                    case FFPlayer0x40VideoSnowType:
-                    {
-                        sample = [MRConvertUtil snowPixelBuffer:self.videoSize.width h:self.videoSize.height opt:self.pixelBufferPool];
-                    }
-                        break;
-                }
-                
+                CVPixelBufferRef sample = [self nextPixelBuffer];
                 if (sample) {
                     [self.delegate reveiveFrameToRenderer:[MRConvertUtil cmSampleBufferRefFromCVPixelBufferRef:sample]];
                 }
@@ -86,11 +112,20 @@
         }
         
         NSTimeInterval end = CFAbsoluteTimeGetCurrent();
-        int cost = (end - begin) * 1000;
+        int cost = (end - start) * 1000;
         av_log(NULL, AV_LOG_DEBUG, "render video frame cost:%dms\n", cost);
-        int delay = 40 - cost;
+        
+        frames++;
+        const double fps = self.fps > 0 ? self.fps : 25;
+        const double now = av_gettime_relative() / 1000000.0;
+        int delay = (int)((begin + frames / fps - now) * 1000);
         if (delay > 0) {
             mr_msleep(delay);
+        } else if (delay < -1000) {
+            //落后太多时重新排期，不去追赶
+            av_log(NULL, AV_LOG_WARNING, "pattern generator is %dms behind at %gfps\n", -delay, fps);
+            begin = now;
+            frames = 0;
         }
     }
 }
@@ -98,6 +133,7 @@
 - (void)prapareWithSize:(CGSize)size
 {
     self.videoSize = size;
+    self.generator = [[MRPatternGenerator alloc] initWithType:MRPatternSnow width:size.width height:size.height];
     //准备渲染线程
     [self prepareRendererThread];
 }
@@ -0,0 +1,53 @@
+//
+//  FFStreamInfoCache.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 流信息持久化缓存
+// avformat_find_stream_info 是打开阶段最耗时的部分，反复打开同一个本地文件时（审片、循环播放）
+// 可以把上次探测的结果缓存下来，再次打开时直接填充，缩短探测。
+// 缓存以 路径 + 文件大小 + 修改时间 + 文件号 + 前 4KB 的哈希 作为 key，只读文件头不读整个文件，文件被改写后自然失效。
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct AVFormatContext AVFormatContext;
+
+typedef enum : NSUInteger {
+    FFStreamInfoCacheMiss,          //未命中，或打开时创建的流和缓存的个数不一样，需要完整探测
+    FFStreamInfoCacheHitPartial,    //命中，但有的流参数还不全，可缩短探测
+    FFStreamInfoCacheHitFull,       //命中，流参数已全部填充，可使用缓存的最优流；仍需很短的探测补齐缓存以外的字段
+} FFStreamInfoCacheResult;
+
+@interface FFStreamInfoCache : NSObject
+
++ (instancetype)sharedCache;
+
+///缓存目录，默认为 Caches/FFStreamInfoCache
+@property (nonatomic, copy) NSString *cacheDir;
+
+/// 打开输入流后调用，命中缓存时将缓存的流信息填充到 ic 里
+/// @param path 本地文件路径，非本地文件始终返回 FFStreamInfoCacheMiss
+/// @param ic avformat_open_input 之后的 AVFormatContext
+/// @param st_index 缓存的最优流索引，长度为 count，可为 NULL
+/// @param count st_index 数组长度，一般为 AVMEDIA_TYPE_NB
+- (FFStreamInfoCacheResult)applyForPath:(NSString *)path
+                                context:(AVFormatContext *)ic
+                             bestStreams:(int * _Nullable)st_index
+                                   count:(int)count;
+
+/// avformat_find_stream_info 成功后调用，保存流信息
+/// @param st_index 选定的最优流索引，长度为 count，可为 NULL
+- (void)storeForPath:(NSString *)path
+             context:(AVFormatContext *)ic
+         bestStreams:(const int * _Nullable)st_index
+               count:(int)count;
+
+///清空全部缓存
+- (void)removeAll;
+
+@end
+
+NS_ASSUME_NONNULL_END
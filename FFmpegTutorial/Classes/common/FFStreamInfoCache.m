@@ -0,0 +1,394 @@
+//
+//  FFStreamInfoCache.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "FFStreamInfoCache.h"
+#include <libavformat/avformat.h>
+#include <libavutil/mem.h>
+
+//缓存格式版本号，结构变化时递增，旧缓存自动失效
+#define CACHE_VERSION 2
+//参与 key 计算的文件头长度；原地改写后大小和修改时间都可能不变，文件头能区分开
+#define CACHE_HEADER_BYTES 4096
+
+static uint64_t fnv1a_64(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+@interface FFStreamInfoCache ()
+
+//内存里再缓存一份，避免重复读盘
+@property (nonatomic, strong) NSCache *memCache;
+
+@end
+
+@implementation FFStreamInfoCache
+
++ (instancetype)sharedCache
+{
+    static id instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [[self alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        NSString *caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        _cacheDir = [caches stringByAppendingPathComponent:@"FFStreamInfoCache"];
+        _memCache = [[NSCache alloc] init];
+        _memCache.countLimit = 64;
+    }
+    return self;
+}
+
+#pragma mark - key
+
+///路径 + 大小 + 修改时间 + 文件号 + 文件头的哈希；文件不存在或者读不了时返回 nil
+- (NSString *)keyForPath:(NSString *)path
+{
+    if (![path hasPrefix:@"/"]) {
+        return nil;
+    }
+
+    NSDictionary *attr = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+    if (!attr) {
+        return nil;
+    }
+    unsigned long long size = [attr fileSize];
+    NSTimeInterval mtime = [[attr fileModificationDate] timeIntervalSince1970];
+    //替换成同名的新文件时文件号会变
+    unsigned long long inode = [attr fileSystemFileNumber];
+
+    //只读开头一小段，不会因为文件大而变慢
+    FILE *fp = fopen([path fileSystemRepresentation], "rb");
+    if (!fp) {
+        return nil;
+    }
+    uint8_t header[CACHE_HEADER_BYTES];
+    const size_t len = fread(header, 1, sizeof(header), fp);
+    fclose(fp);
+    uint64_t headerHash = fnv1a_64(header, len);
+
+    return [NSString stringWithFormat:@"%@|%llu|%.6f|%llu|%016llx|v%d", path, size, mtime, inode, headerHash, CACHE_VERSION];
+}
+
+- (NSString *)filePathForKey:(NSString *)key
+{
+    const char *str = [key UTF8String];
+    uint64_t hash = fnv1a_64((const uint8_t *)str, strlen(str));
+    return [self.cacheDir stringByAppendingPathComponent:[NSString stringWithFormat:@"%016llx.plist", hash]];
+}
+
+#pragma mark - codecpar <-> dictionary
+
+static NSDictionary *rationalToDic(AVRational r)
+{
+    return @{@"num":@(r.num), @"den":@(r.den)};
+}
+
+static AVRational dicToRational(NSDictionary *dic)
+{
+    return (AVRational){[dic[@"num"] intValue], [dic[@"den"] intValue]};
+}
+
+static NSDictionary *streamToDic(AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+    NSMutableDictionary *dic = [NSMutableDictionary dictionary];
+    dic[@"codec_type"] = @(par->codec_type);
+    dic[@"codec_id"]   = @(par->codec_id);
+    dic[@"codec_tag"]  = @(par->codec_tag);
+    dic[@"format"]     = @(par->format);
+    dic[@"bit_rate"]   = @(par->bit_rate);
+    dic[@"profile"]    = @(par->profile);
+    dic[@"level"]      = @(par->level);
+    dic[@"bits_per_coded_sample"] = @(par->bits_per_coded_sample);
+    dic[@"bits_per_raw_sample"]   = @(par->bits_per_raw_sample);
+    //video
+    dic[@"video_delay"] = @(par->video_delay);
+    dic[@"width"]      = @(par->width);
+    dic[@"height"]     = @(par->height);
+    dic[@"sar"]        = rationalToDic(par->sample_aspect_ratio);
+    dic[@"field_order"]     = @(par->field_order);
+    dic[@"color_range"]     = @(par->color_range);
+    dic[@"color_primaries"] = @(par->color_primaries);
+    dic[@"color_trc"]       = @(par->color_trc);
+    dic[@"color_space"]     = @(par->color_space);
+    dic[@"chroma_location"] = @(par->chroma_location);
+    dic[@"avg_frame_rate"]  = rationalToDic(st->avg_frame_rate);
+    dic[@"r_frame_rate"]    = rationalToDic(st->r_frame_rate);
+    //audio
+    dic[@"channel_layout"] = @(par->channel_layout);
+    dic[@"channels"]       = @(par->channels);
+    dic[@"sample_rate"]    = @(par->sample_rate);
+    dic[@"frame_size"]     = @(par->frame_size);
+    //common
+    dic[@"time_base"]  = rationalToDic(st->time_base);
+    dic[@"duration"]   = @(st->duration);
+    dic[@"start_time"] = @(st->start_time);
+    if (par->extradata && par->extradata_size > 0) {
+        dic[@"extradata"] = [NSData dataWithBytes:par->extradata length:par->extradata_size];
+    }
+    return [dic copy];
+}
+
+///只填充打开输入流后仍然缺失的字段，头部已经给出的信息以头部为准
+static void fillStreamFromDic(AVStream *st, NSDictionary *dic)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (par->format < 0) {
+            par->format = [dic[@"format"] intValue];
+        }
+        if (par->width <= 0 || par->height <= 0) {
+            par->width  = [dic[@"width"] intValue];
+            par->height = [dic[@"height"] intValue];
+        }
+        if (par->sample_aspect_ratio.num == 0) {
+            par->sample_aspect_ratio = dicToRational(dic[@"sar"]);
+        }
+        if (par->color_range == AVCOL_RANGE_UNSPECIFIED) {
+            par->color_range = [dic[@"color_range"] intValue];
+        }
+        if (par->color_primaries == AVCOL_PRI_UNSPECIFIED) {
+            par->color_primaries = [dic[@"color_primaries"] intValue];
+        }
+        if (par->color_trc == AVCOL_TRC_UNSPECIFIED) {
+            par->color_trc = [dic[@"color_trc"] intValue];
+        }
+        if (par->color_space == AVCOL_SPC_UNSPECIFIED) {
+            par->color_space = [dic[@"color_space"] intValue];
+        }
+        if (par->chroma_location == AVCHROMA_LOC_UNSPECIFIED) {
+            par->chroma_location = [dic[@"chroma_location"] intValue];
+        }
+        if (par->video_delay <= 0) {
+            par->video_delay = [dic[@"video_delay"] intValue];
+        }
+        if (par->field_order == AV_FIELD_UNKNOWN) {
+            par->field_order = [dic[@"field_order"] intValue];
+        }
+        if (st->avg_frame_rate.num == 0 || st->avg_frame_rate.den == 0) {
+            st->avg_frame_rate = dicToRational(dic[@"avg_frame_rate"]);
+        }
+        if (st->r_frame_rate.num == 0 || st->r_frame_rate.den == 0) {
+            st->r_frame_rate = dicToRational(dic[@"r_frame_rate"]);
+        }
+    } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+        if (par->format < 0) {
+            par->format = [dic[@"format"] intValue];
+        }
+        if (par->sample_rate <= 0) {
+            par->sample_rate = [dic[@"sample_rate"] intValue];
+        }
+        if (par->channels <= 0) {
+            par->channels = [dic[@"channels"] intValue];
+        }
+        if (par->channel_layout == 0) {
+            par->channel_layout = [dic[@"channel_layout"] unsignedLongLongValue];
+        }
+        if (par->frame_size <= 0) {
+            par->frame_size = [dic[@"frame_size"] intValue];
+        }
+    }
+
+    if (par->bit_rate <= 0) {
+        par->bit_rate = [dic[@"bit_rate"] longLongValue];
+    }
+    if (par->profile == FF_PROFILE_UNKNOWN) {
+        par->profile = [dic[@"profile"] intValue];
+    }
+    if (par->level == FF_LEVEL_UNKNOWN) {
+        par->level = [dic[@"level"] intValue];
+    }
+    if (par->bits_per_coded_sample <= 0) {
+        par->bits_per_coded_sample = [dic[@"bits_per_coded_sample"] intValue];
+    }
+    if (par->bits_per_raw_sample <= 0) {
+        par->bits_per_raw_sample = [dic[@"bits_per_raw_sample"] intValue];
+    }
+    if (st->duration == AV_NOPTS_VALUE) {
+        st->duration = [dic[@"duration"] longLongValue];
+    }
+    if (st->start_time == AV_NOPTS_VALUE) {
+        st->start_time = [dic[@"start_time"] longLongValue];
+    }
+
+    NSData *extradata = dic[@"extradata"];
+    if (par->extradata_size <= 0 && extradata.length > 0) {
+        par->extradata = av_mallocz(extradata.length + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (par->extradata) {
+            memcpy(par->extradata, extradata.bytes, extradata.length);
+            par->extradata_size = (int)extradata.length;
+        }
+    }
+}
+
+///解码器需要的关键参数是否齐全
+static BOOL streamIsComplete(AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE) {
+        return NO;
+    }
+    if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+        return par->width > 0 && par->height > 0 && par->format >= 0;
+    } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+        return par->sample_rate > 0 && par->channels > 0 && par->format >= 0;
+    }
+    return YES;
+}
+
+#pragma mark - public
+
+- (NSDictionary *)loadEntryForKey:(NSString *)key
+{
+    NSDictionary *entry = [self.memCache objectForKey:key];
+    if (!entry) {
+        entry = [NSDictionary dictionaryWithContentsOfFile:[self filePathForKey:key]];
+        if (entry) {
+            [self.memCache setObject:entry forKey:key];
+        }
+    }
+    //路径哈希碰撞时 key 不会相等
+    if (entry && ![entry[@"key"] isEqualToString:key]) {
+        return nil;
+    }
+    return entry;
+}
+
+- (FFStreamInfoCacheResult)applyForPath:(NSString *)path
+                                context:(AVFormatContext *)ic
+                             bestStreams:(int *)st_index
+                                   count:(int)count
+{
+    if (!ic) {
+        return FFStreamInfoCacheMiss;
+    }
+
+    NSString *key = [self keyForPath:path];
+    if (!key) {
+        return FFStreamInfoCacheMiss;
+    }
+
+    NSDictionary *entry = nil;
+    @synchronized (self) {
+        entry = [self loadEntryForKey:key];
+    }
+
+    if (!entry) {
+        return FFStreamInfoCacheMiss;
+    }
+
+    NSArray<NSDictionary *> *streams = entry[@"streams"];
+    //打开时创建的流和缓存的一样多才使用缓存；少了说明是 TS、裸流这类探测时才创建流的格式，缓存补不出这些流，需要完整探测
+    if (ic->nb_streams != streams.count) {
+        return FFStreamInfoCacheMiss;
+    }
+
+    for (int i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        NSDictionary *dic = streams[i];
+        if (st->codecpar->codec_type != [dic[@"codec_type"] intValue] ||
+            st->codecpar->codec_id != [dic[@"codec_id"] intValue]) {
+            return FFStreamInfoCacheMiss;
+        }
+    }
+
+    BOOL complete = YES;
+    for (int i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        fillStreamFromDic(st, streams[i]);
+        if (!streamIsComplete(st)) {
+            complete = NO;
+        }
+    }
+
+    if (ic->duration == AV_NOPTS_VALUE) {
+        ic->duration = [entry[@"duration"] longLongValue];
+    }
+    if (ic->start_time == AV_NOPTS_VALUE) {
+        ic->start_time = [entry[@"start_time"] longLongValue];
+    }
+    if (ic->bit_rate <= 0) {
+        ic->bit_rate = [entry[@"bit_rate"] longLongValue];
+    }
+
+    if (st_index) {
+        NSArray<NSNumber *> *best = entry[@"best_streams"];
+        for (int i = 0; i < count && i < best.count; i++) {
+            st_index[i] = [best[i] intValue];
+        }
+    }
+
+    return complete ? FFStreamInfoCacheHitFull : FFStreamInfoCacheHitPartial;
+}
+
+- (void)storeForPath:(NSString *)path
+             context:(AVFormatContext *)ic
+         bestStreams:(const int *)st_index
+               count:(int)count
+{
+    if (!ic || ic->nb_streams == 0) {
+        return;
+    }
+
+    NSString *key = [self keyForPath:path];
+    if (!key) {
+        return;
+    }
+
+    NSMutableArray *streams = [NSMutableArray arrayWithCapacity:ic->nb_streams];
+    for (int i = 0; i < ic->nb_streams; i++) {
+        [streams addObject:streamToDic(ic->streams[i])];
+    }
+
+    NSMutableArray *best = [NSMutableArray array];
+    if (st_index) {
+        for (int i = 0; i < count; i++) {
+            [best addObject:@(st_index[i])];
+        }
+    }
+
+    NSDictionary *entry = @{
+        @"key"          : key,
+        @"duration"     : @(ic->duration),
+        @"start_time"   : @(ic->start_time),
+        @"bit_rate"     : @(ic->bit_rate),
+        @"streams"      : streams,
+        @"best_streams" : best,
+    };
+
+    @synchronized (self) {
+        [self.memCache setObject:entry forKey:key];
+        [[NSFileManager defaultManager] createDirectoryAtPath:self.cacheDir withIntermediateDirectories:YES attributes:nil error:nil];
+        if (![entry writeToFile:[self filePathForKey:key] atomically:YES]) {
+            av_log(NULL, AV_LOG_WARNING, "stream info cache write failed:%s\n", [path UTF8String]);
+        }
+    }
+}
+
+- (void)removeAll
+{
+    @synchronized (self) {
+        [self.memCache removeAllObjects];
+        [[NSFileManager defaultManager] removeItemAtPath:self.cacheDir error:nil];
+    }
+}
+
+@end
@@ -13,13 +13,37 @@ NS_ASSUME_NONNULL_BEGIN
 
 typedef struct AVFrame AVFrame;
 
+typedef enum : NSUInteger {
+    FFVideoScaleProfileFastPoint,   //最快；尺寸不变时用最近邻，需要缩放时用 SWS_FAST_BILINEAR
+    FFVideoScaleProfileBilinear,    //双线性，缩放时速度和质量比较均衡
+    FFVideoScaleProfileBicubic,     //双三次，缩放质量最好，也最慢
+} FFVideoScaleProfile;
+
 @interface FFVideoScale : NSObject
 
+///进程内 SwsContext 缓存最多保留多少个空闲的上下文，默认 32，设为 0 则不缓存
++ (void)setContextCacheLimit:(int)limit;
+///释放缓存里全部空闲的 SwsContext
++ (void)purgeContextCache;
+
 /// @param src 原帧像素格式
 /// @param dest 目标帧像素格式
 /// @return YES:可以转换； NO:无法转换
 + (BOOL)checkCanConvertFrom:(int)src to:(int)dest;
 
+/// 按转换代价协商目标像素格式
+/// 代价考虑每个像素写入的字节数、是否只需平面重排（比如 YUV420P→NV12）、色度采样是否一致，
+/// 有实测耗时的格式对优先使用实测数据
+/// @param src 原帧像素格式
+/// @param mask 期望的像素格式
+/// @return 代价最小的目标像素格式；没有可转换的格式时返回 AV_PIX_FMT_NONE
++ (int)negotiateDstPixFmt:(int)src supportedPixelFormats:(MRPixelFormatMask)mask;
+
+/// 每个像素的转换代价，有实测数据时为实测耗时（单位ns），否则由代价模型换算
+/// @param src 原帧像素格式
+/// @param dest 目标帧像素格式
++ (double)convertCostFrom:(int)src to:(int)dest;
+
 /// @param srcPixFmt 原帧像素格式
 /// @param dstPixFmt 目标帧像素格式
 /// @param picWidth 图像宽度
@@ -29,7 +53,30 @@ typedef struct AVFrame AVFrame;
                          picWidth:(int)picWidth
                         picHeight:(int)picHeight;
 
-/// @param inF 需要转换的帧
+///缩放算法，默认 FFVideoScaleProfileFastPoint
+@property (nonatomic, assign) FFVideoScaleProfile profile;
+///更精确的舍入（SWS_ACCURATE_RND），稍慢
+@property (nonatomic, assign) BOOL accurateRound;
+///色度全分辨率插值（SWS_FULL_CHR_H_INT|SWS_FULL_CHR_H_INP），转 RGB 时色彩边缘更清晰，稍慢
+@property (nonatomic, assign) BOOL fullChromaInterp;
+
+///限定输出尺寸，按原图宽高比缩小到不超过 maxOutputWidth × maxOutputHeight，不会放大；
+///缩放和像素格式转换在同一次 sws_scale 里完成；0 表示该方向不限制，默认都为 0 即输出原尺寸
+@property (nonatomic, assign) int maxOutputWidth;
+@property (nonatomic, assign) int maxOutputHeight;
+
+/// 分片并发转换的片数，把图像切成水平条带，每个条带用独立的 SwsContext 并发转换；
+/// 默认 1 即不分片，4K 等大尺寸图像建议设置为 CPU 核数（不超过 8）；需要缩放时不分片
+@property (nonatomic, assign) int sliceCount;
+
+/// 分片转换的吞吐量测试，依次用 1、2、4、8 片转换 frames 帧，返回各片数的耗时和相对单片的加速比
++ (NSString *)benchmarkSlicesWithSrcPixFmt:(int)srcPixFmt
+                                 dstPixFmt:(int)dstPixFmt
+                                  picWidth:(int)picWidth
+                                 picHeight:(int)picHeight
+                                    frames:(int)frames;
+
+/// @param inF 需要转换的帧，中途分辨率或像素格式变化时会自动切换到对应的 SwsContext
 /// @param outP 转换的结果[不要free相关内存，通过ref/unref的方式使用]
 - (BOOL)rescaleFrame:(AVFrame *)inF out:(AVFrame *_Nonnull*_Nonnull)outP;
 
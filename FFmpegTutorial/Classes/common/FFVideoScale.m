@@ -7,17 +7,146 @@
 
 #import "FFVideoScale.h"
 #import "FFPlayerInternalHeader.h"
+#import "MRPixelKernels.h"
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#include <pthread.h>
+
+//实测耗时表最多记录多少个格式对
+#define MR_MAX_MEASURED_PAIRS 64
+//每转换多少帧上报一次实测耗时
+#define MR_COST_REPORT_INTERVAL 30
+//最多分几片
+#define MR_MAX_SLICE_COUNT 8
+
+typedef struct MRMeasuredCost {
+    enum AVPixelFormat src;
+    enum AVPixelFormat dst;
+    //每个像素的耗时，单位ns
+    double ns_per_pixel;
+} MRMeasuredCost;
+
+//进程内共享的实测耗时表
+static MRMeasuredCost g_measured_costs[MR_MAX_MEASURED_PAIRS];
+static int g_measured_count = 0;
+
+//SwsContext 缓存最多能存多少个
+#define MR_SWS_CACHE_CAPACITY 128
+
+typedef struct MRSwsKey {
+    int src_fmt;
+    int dst_fmt;
+    int src_w;
+    int src_h;
+    int dst_w;
+    int dst_h;
+    int flags;
+} MRSwsKey;
+
+typedef struct MRSwsEntry {
+    MRSwsKey key;
+    struct SwsContext *ctx;
+    int64_t last_used;
+} MRSwsEntry;
+
+/*
+ 进程内共享的 SwsContext 缓存，只存放空闲的上下文；
+ SwsContext 不能多线程同时使用，因此采用借出/归还的方式，借出后由使用方独占，用完归还。
+ 创建 SwsContext 要初始化滤波器系数表，缩略图这类频繁创建转换器的场景缓存效果明显。
+ */
+static MRSwsEntry g_sws_cache[MR_SWS_CACHE_CAPACITY];
+static int g_sws_cache_count = 0;
+static int g_sws_cache_limit = 32;
+static pthread_mutex_t g_sws_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static MRSwsKey mr_sws_key(int src_fmt, int dst_fmt, int src_w, int src_h, int dst_w, int dst_h, int flags)
+{
+    MRSwsKey key;
+    memset(&key, 0, sizeof(key));
+    key.src_fmt = src_fmt;
+    key.dst_fmt = dst_fmt;
+    key.src_w = src_w;
+    key.src_h = src_h;
+    key.dst_w = dst_w;
+    key.dst_h = dst_h;
+    key.flags = flags;
+    return key;
+}
+
+//借出一个上下文，缓存里没有就新建
+static struct SwsContext * mr_sws_checkout(MRSwsKey key)
+{
+    pthread_mutex_lock(&g_sws_cache_lock);
+    for (int i = g_sws_cache_count - 1; i >= 0; i--) {
+        if (memcmp(&g_sws_cache[i].key, &key, sizeof(key)) == 0) {
+            struct SwsContext *ctx = g_sws_cache[i].ctx;
+            g_sws_cache[i] = g_sws_cache[--g_sws_cache_count];
+            pthread_mutex_unlock(&g_sws_cache_lock);
+            return ctx;
+        }
+    }
+    pthread_mutex_unlock(&g_sws_cache_lock);
+    return sws_getContext(key.src_w, key.src_h, key.src_fmt, key.dst_w, key.dst_h, key.dst_fmt, key.flags, NULL, NULL, NULL);
+}
+
+//归还上下文，超过上限时释放最久没用的
+static void mr_sws_checkin(MRSwsKey key, struct SwsContext *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    struct SwsContext *evicted = NULL;
+    pthread_mutex_lock(&g_sws_cache_lock);
+    if (g_sws_cache_limit <= 0) {
+        evicted = ctx;
+    } else {
+        if (g_sws_cache_count >= g_sws_cache_limit) {
+            int oldest = 0;
+            for (int i = 1; i < g_sws_cache_count; i++) {
+                if (g_sws_cache[i].last_used < g_sws_cache[oldest].last_used) {
+                    oldest = i;
+                }
+            }
+            evicted = g_sws_cache[oldest].ctx;
+            g_sws_cache[oldest] = g_sws_cache[--g_sws_cache_count];
+        }
+        g_sws_cache[g_sws_cache_count++] = (MRSwsEntry){key, ctx, av_gettime_relative()};
+    }
+    pthread_mutex_unlock(&g_sws_cache_lock);
+    if (evicted) {
+        sws_freeContext(evicted);
+    }
+}
 
 @interface FFVideoScale()
+{
+    //当前整帧转换用的 SwsContext 对应的 key
+    MRSwsKey _sws_key;
+    //分片转换用的 SwsContext，每片一个
+    struct SwsContext *_slice_ctx[MR_MAX_SLICE_COUNT];
+    MRSwsKey _slice_key[MR_MAX_SLICE_COUNT];
+    //每片的起始行和行数
+    int _slice_y[MR_MAX_SLICE_COUNT];
+    int _slice_h[MR_MAX_SLICE_COUNT];
+    int _slice_num;
+}
 
+@property (nonatomic, assign) enum AVPixelFormat srcPixFmt;
 @property (nonatomic, assign) enum AVPixelFormat dstPixFmt;
 @property (nonatomic, assign) struct SwsContext *sws_ctx;
+//当前输入的图像尺寸
 @property (nonatomic, assign) int picWidth;
 @property (nonatomic, assign) int picHeight;
+//输出的图像尺寸
+@property (nonatomic, assign) int dstWidth;
+@property (nonatomic, assign) int dstHeight;
 //复用一个，效率更高些
 @property (nonatomic, assign) AVFrame *frame;
+//本转换器的平均耗时，单位ns/像素
+@property (nonatomic, assign) double ns_per_pixel;
+@property (nonatomic, assign) int measured_frames;
 
 @end
 
@@ -219,8 +348,265 @@
     return YES;
 }
 
+#pragma mark - 像素格式协商
+
+//代价模型：每个像素写入的字节数 × 转换方式的权重
+static double mr_model_cost(enum AVPixelFormat src, enum AVPixelFormat dst)
+{
+    const AVPixFmtDescriptor *s = av_pix_fmt_desc_get(src);
+    const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(dst);
+    if (!s || !d) {
+        return -1;
+    }
+    
+    const double bytes = av_get_padded_bits_per_pixel(d) / 8.0;
+    const bool s_rgb = s->flags & AV_PIX_FMT_FLAG_RGB;
+    const bool d_rgb = d->flags & AV_PIX_FMT_FLAG_RGB;
+    const bool same_chroma = s->log2_chroma_w == d->log2_chroma_w && s->log2_chroma_h == d->log2_chroma_h;
+    const bool same_depth = s->comp[0].depth == d->comp[0].depth;
+    
+    double weight;
+    if (s_rgb != d_rgb) {
+        //YUV 和 RGB 互转，每个像素都要做矩阵运算，色度还要上/下采样
+        weight = 4.0;
+    } else if (same_chroma && same_depth) {
+        //只需重排平面或分量，比如 YUV420P→NV12、BGRA→RGBA
+        weight = 1.0;
+    } else if (same_depth) {
+        //色度采样不一致，需要重采样色度
+        weight = 2.0;
+    } else {
+        //位深不一致
+        weight = 2.5;
+    }
+    return bytes * weight;
+}
+
+static int mr_find_measured_cost(enum AVPixelFormat src, enum AVPixelFormat dst)
+{
+    for (int i = 0; i < g_measured_count; i++) {
+        if (g_measured_costs[i].src == src && g_measured_costs[i].dst == dst) {
+            return i;
+        }
+    }
+    return -1;
+}
+
++ (void)recordCost:(double)ns_per_pixel from:(enum AVPixelFormat)src to:(enum AVPixelFormat)dst
+{
+    @synchronized (self) {
+        int idx = mr_find_measured_cost(src, dst);
+        if (idx < 0) {
+            if (g_measured_count >= MR_MAX_MEASURED_PAIRS) {
+                return;
+            }
+            idx = g_measured_count++;
+            g_measured_costs[idx] = (MRMeasuredCost){src, dst, ns_per_pixel};
+        } else {
+            //平滑一下，避免偶尔的抖动影响协商结果
+            g_measured_costs[idx].ns_per_pixel = g_measured_costs[idx].ns_per_pixel * 0.7 + ns_per_pixel * 0.3;
+        }
+    }
+}
+
++ (double)convertCostFrom:(int)src to:(int)dest
+{
+    const double model = mr_model_cost(src, dest);
+    if (model < 0) {
+        return -1;
+    }
+    @synchronized (self) {
+        int idx = mr_find_measured_cost(src, dest);
+        if (idx >= 0) {
+            return g_measured_costs[idx].ns_per_pixel;
+        }
+        //没有实测数据时，用已有的实测数据把模型代价换算成耗时，这样两者可以放在一起比较
+        double ratio = 0;
+        int n = 0;
+        for (int i = 0; i < g_measured_count; i++) {
+            double m = mr_model_cost(g_measured_costs[i].src, g_measured_costs[i].dst);
+            if (m > 0) {
+                ratio += g_measured_costs[i].ns_per_pixel / m;
+                n++;
+            }
+        }
+        return n > 0 ? model * ratio / n : model;
+    }
+}
+
++ (int)negotiateDstPixFmt:(int)src supportedPixelFormats:(MRPixelFormatMask)mask
+{
+    const bool canConvert = sws_isSupportedInput(src) > 0;
+    int best = AV_PIX_FMT_NONE;
+    double bestCost = 0;
+    for (int i = MR_PIX_FMT_BEGIN; i <= MR_PIX_FMT_END; i ++) {
+        const MRPixelFormat fmt = i;
+        if (!(mask & (1 << fmt))) {
+            continue;
+        }
+        const int dst = MRPixelFormat2AV(fmt);
+        if (dst == src) {
+            return dst;
+        }
+        if (!canConvert || sws_isSupportedOutput(dst) <= 0) {
+            continue;
+        }
+        const double cost = [self convertCostFrom:src to:dst];
+        if (cost < 0) {
+            continue;
+        }
+        if (best == AV_PIX_FMT_NONE || cost < bestCost) {
+            best = dst;
+            bestCost = cost;
+        }
+    }
+    if (best != AV_PIX_FMT_NONE) {
+        av_log(NULL, AV_LOG_INFO, "negotiate pixel format:%s->%s,cost:%g\n", av_get_pix_fmt_name(src), av_get_pix_fmt_name(best), bestCost);
+    }
+    return best;
+}
+
+#pragma mark - SwsContext 缓存
+
++ (void)setContextCacheLimit:(int)limit
+{
+    pthread_mutex_lock(&g_sws_cache_lock);
+    g_sws_cache_limit = FFMAX(0, FFMIN(limit, MR_SWS_CACHE_CAPACITY));
+    pthread_mutex_unlock(&g_sws_cache_lock);
+    if (limit <= 0) {
+        [self purgeContextCache];
+    }
+}
+
++ (void)purgeContextCache
+{
+    pthread_mutex_lock(&g_sws_cache_lock);
+    for (int i = 0; i < g_sws_cache_count; i++) {
+        sws_freeContext(g_sws_cache[i].ctx);
+        g_sws_cache[i].ctx = NULL;
+    }
+    g_sws_cache_count = 0;
+    pthread_mutex_unlock(&g_sws_cache_lock);
+}
+
+- (int)swsFlags
+{
+    int flags;
+    switch (self.profile) {
+        case FFVideoScaleProfileBilinear:
+            flags = SWS_BILINEAR;
+            break;
+        case FFVideoScaleProfileBicubic:
+            flags = SWS_BICUBIC;
+            break;
+        default:
+            //最近邻缩小会有明显的锯齿，需要缩放时换成快速双线性
+            if (self.dstWidth != self.picWidth || self.dstHeight != self.picHeight) {
+                flags = SWS_FAST_BILINEAR;
+            } else {
+                flags = SWS_POINT;
+            }
+            break;
+    }
+    if (self.accurateRound) {
+        flags |= SWS_ACCURATE_RND;
+    }
+    if (self.fullChromaInterp) {
+        flags |= SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP;
+    }
+    return flags;
+}
+
+- (BOOL)prepareContext
+{
+    if (self.sws_ctx) {
+        return YES;
+    }
+    _sws_key = mr_sws_key(self.srcPixFmt, self.dstPixFmt, self.picWidth, self.picHeight, self.dstWidth, self.dstHeight, [self swsFlags]);
+    self.sws_ctx = mr_sws_checkout(_sws_key);
+    return self.sws_ctx != NULL;
+}
+
+//把上下文还给缓存，下次转换时按新的参数重新借出
+- (void)releaseContexts
+{
+    if (self.sws_ctx) {
+        mr_sws_checkin(_sws_key, self.sws_ctx);
+        self.sws_ctx = NULL;
+    }
+    [self releaseSliceContexts];
+}
+
+- (void)setProfile:(FFVideoScaleProfile)profile
+{
+    if (_profile != profile) {
+        _profile = profile;
+        [self releaseContexts];
+    }
+}
+
+- (void)setAccurateRound:(BOOL)accurateRound
+{
+    if (_accurateRound != accurateRound) {
+        _accurateRound = accurateRound;
+        [self releaseContexts];
+    }
+}
+
+- (void)setFullChromaInterp:(BOOL)fullChromaInterp
+{
+    if (_fullChromaInterp != fullChromaInterp) {
+        _fullChromaInterp = fullChromaInterp;
+        [self releaseContexts];
+    }
+}
+
+- (void)setMaxOutputWidth:(int)maxOutputWidth
+{
+    if (_maxOutputWidth != maxOutputWidth) {
+        _maxOutputWidth = maxOutputWidth;
+        [self updateDstSize];
+    }
+}
+
+- (void)setMaxOutputHeight:(int)maxOutputHeight
+{
+    if (_maxOutputHeight != maxOutputHeight) {
+        _maxOutputHeight = maxOutputHeight;
+        [self updateDstSize];
+    }
+}
+
+//按限定的输出尺寸等比缩小，宽高取偶数，避免色度采样出现半个像素
+- (void)updateDstSize
+{
+    int w = self.picWidth;
+    int h = self.picHeight;
+    double ratio = 1.0;
+    if (self.maxOutputWidth > 0 && w > 0) {
+        ratio = FFMIN(ratio, (double)self.maxOutputWidth / w);
+    }
+    if (self.maxOutputHeight > 0 && h > 0) {
+        ratio = FFMIN(ratio, (double)self.maxOutputHeight / h);
+    }
+    if (ratio < 1.0) {
+        w = FFMAX(2, (int)lrint(w * ratio) & ~1);
+        h = FFMAX(2, (int)lrint(h * ratio) & ~1);
+    }
+    if (w == self.dstWidth && h == self.dstHeight) {
+        return;
+    }
+    self.dstWidth = w;
+    self.dstHeight = h;
+    [self releaseContexts];
+    if (self.frame && self.frame->data[0] != NULL) {
+        av_freep(self.frame->data);
+    }
+}
+
 - (void)dealloc
 {
+    [self releaseContexts];
     if (self.frame) {
         if(_frame->data[0] != NULL){
             av_freep(_frame->data);
@@ -236,46 +622,250 @@
 {
     self = [super init];
     if (self) {
+        self.srcPixFmt = srcPixFmt;
         self.dstPixFmt = dstPixFmt;
         self.picWidth  = picWidth;
         self.picHeight = picHeight;
+        self.dstWidth  = picWidth;
+        self.dstHeight = picHeight;
         
-        self.sws_ctx = sws_getContext(picWidth, picHeight, srcPixFmt, picWidth, picHeight, dstPixFmt, SWS_POINT, NULL, NULL, NULL);
-        
-        if (NULL == self.sws_ctx) {
+        if (![self prepareContext]) {
             NSAssert(NO, @"create sws ctx failed");
             return nil;
         }
         self.frame = av_frame_alloc();
+        self.sliceCount = 1;
     }
     return self;
 }
 
+#pragma mark - 分片转换
+
+- (void)releaseSliceContexts
+{
+    for (int i = 0; i < _slice_num; i++) {
+        mr_sws_checkin(_slice_key[i], _slice_ctx[i]);
+        _slice_ctx[i] = NULL;
+    }
+    _slice_num = 0;
+}
+
+- (void)setSliceCount:(int)sliceCount
+{
+    sliceCount = FFMAX(1, FFMIN(sliceCount, MR_MAX_SLICE_COUNT));
+    if (_sliceCount != sliceCount) {
+        _sliceCount = sliceCount;
+        [self releaseSliceContexts];
+    }
+}
+
+//按色度采样对齐切分条带，每片创建一个和条带大小一致的 SwsContext
+- (BOOL)prepareSliceContexts
+{
+    if (_slice_num > 0) {
+        return YES;
+    }
+    const AVPixFmtDescriptor *s = av_pix_fmt_desc_get(self.srcPixFmt);
+    const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(self.dstPixFmt);
+    if (!s || !d) {
+        return NO;
+    }
+    //条带高度要能被色度的垂直采样整除，否则色度行会被切开
+    const int align = 1 << FFMAX(s->log2_chroma_h, d->log2_chroma_h);
+    const int h = self.picHeight;
+    const int band = FFALIGN((h + self.sliceCount - 1) / self.sliceCount, align);
+    const int flags = [self swsFlags];
+    
+    int y = 0;
+    int n = 0;
+    while (y < h && n < MR_MAX_SLICE_COUNT) {
+        const int bh = FFMIN(band, h - y);
+        MRSwsKey key = mr_sws_key(self.srcPixFmt, self.dstPixFmt, self.picWidth, bh, self.picWidth, bh, flags);
+        struct SwsContext *ctx = mr_sws_checkout(key);
+        if (!ctx) {
+            _slice_num = n;
+            [self releaseSliceContexts];
+            return NO;
+        }
+        _slice_ctx[n] = ctx;
+        _slice_key[n] = key;
+        _slice_y[n] = y;
+        _slice_h[n] = bh;
+        y += bh;
+        n++;
+    }
+    _slice_num = n;
+    return YES;
+}
+
+//平面 plane 的第 y 行（亮度行号）的起始地址
+static uint8_t * mr_plane_row(const AVPixFmtDescriptor *desc, uint8_t *data, int linesize, int plane, int y)
+{
+    if (!data) {
+        return NULL;
+    }
+    int shift = 0;
+    if (!(desc->flags & AV_PIX_FMT_FLAG_RGB)) {
+        //YUV 的色度平面需要按垂直采样换算行号，亮度和 alpha 平面不用
+        for (int c = 1; c < 3 && c < desc->nb_components; c++) {
+            if (desc->comp[c].plane == plane && desc->comp[0].plane != plane) {
+                shift = desc->log2_chroma_h;
+                break;
+            }
+        }
+    }
+    return data + (ptrdiff_t)(y >> shift) * linesize;
+}
+
+- (int)scaleSlices:(AVFrame *)inF out:(AVFrame *)out_frame
+{
+    if (![self prepareSliceContexts]) {
+        return -1;
+    }
+    const AVPixFmtDescriptor *s = av_pix_fmt_desc_get(self.srcPixFmt);
+    const AVPixFmtDescriptor *d = av_pix_fmt_desc_get(self.dstPixFmt);
+    struct SwsContext **ctxs = _slice_ctx;
+    const int *slice_y = _slice_y;
+    const int *slice_h = _slice_h;
+    __block int ret = 0;
+    dispatch_apply(_slice_num, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        uint8_t *src[AV_NUM_DATA_POINTERS] = {0};
+        uint8_t *dst[AV_NUM_DATA_POINTERS] = {0};
+        for (int p = 0; p < AV_NUM_DATA_POINTERS; p++) {
+            src[p] = mr_plane_row(s, inF->data[p], inF->linesize[p], p, slice_y[i]);
+            dst[p] = mr_plane_row(d, out_frame->data[p], out_frame->linesize[p], p, slice_y[i]);
+        }
+        if (sws_scale(ctxs[i], (const uint8_t* const*)src, inF->linesize, 0, slice_h[i], dst, out_frame->linesize) < 0) {
+            ret = -1;
+        }
+    });
+    return ret;
+}
+
++ (NSString *)benchmarkSlicesWithSrcPixFmt:(int)srcPixFmt
+                                 dstPixFmt:(int)dstPixFmt
+                                  picWidth:(int)picWidth
+                                 picHeight:(int)picHeight
+                                    frames:(int)frames
+{
+    AVFrame *inF = av_frame_alloc();
+    inF->format = srcPixFmt;
+    inF->width  = picWidth;
+    inF->height = picHeight;
+    if (av_frame_get_buffer(inF, 32) < 0) {
+        av_frame_free(&inF);
+        return nil;
+    }
+    //填点内容，全 0 的图像有些转换会走捷径
+    for (int p = 0; p < AV_NUM_DATA_POINTERS && inF->buf[p]; p++) {
+        for (int i = 0; i < inF->buf[p]->size; i++) {
+            inF->buf[p]->data[i] = (uint8_t)(i * 7);
+        }
+    }
+    
+    NSMutableString *report = [NSMutableString stringWithFormat:@"%s->%s %dx%d,%d frames\n", av_get_pix_fmt_name(srcPixFmt), av_get_pix_fmt_name(dstPixFmt), picWidth, picHeight, frames];
+    double base = 0;
+    for (int slices = 1; slices <= MR_MAX_SLICE_COUNT; slices *= 2) {
+        FFVideoScale *scale = [[FFVideoScale alloc] initWithSrcPixFmt:srcPixFmt dstPixFmt:dstPixFmt picWidth:picWidth picHeight:picHeight];
+        scale.sliceCount = slices;
+        AVFrame *outF = NULL;
+        //预热，创建上下文、分配内存不计入耗时
+        [scale rescaleFrame:inF out:&outF];
+        const int64_t begin = av_gettime_relative();
+        for (int i = 0; i < frames; i++) {
+            [scale rescaleFrame:inF out:&outF];
+        }
+        const double cost = (av_gettime_relative() - begin) / 1000.0 / FFMAX(frames, 1);
+        if (slices == 1) {
+            base = cost;
+        }
+        [report appendFormat:@"slices:%d %.3fms/frame %.1ffps speedup:%.2fx\n", slices, cost, 1000.0 / cost, base / cost];
+    }
+    av_frame_free(&inF);
+    av_log(NULL, AV_LOG_INFO, "%s", [report UTF8String]);
+    return report;
+}
+
+//输入的分辨率或像素格式中途变了，换成对应的上下文，输出缓冲区也要重新分配
+- (void)onInputChanged:(AVFrame *)inF
+{
+    av_log(NULL, AV_LOG_INFO, "video scale input changed:%s %dx%d -> %s %dx%d\n", av_get_pix_fmt_name(self.srcPixFmt), self.picWidth, self.picHeight, av_get_pix_fmt_name(inF->format), inF->width, inF->height);
+    [self releaseContexts];
+    self.srcPixFmt = inF->format;
+    self.picWidth  = inF->width;
+    self.picHeight = inF->height;
+    //格式对变了，之前的平均耗时不再适用
+    self.measured_frames = 0;
+    [self updateDstSize];
+    if (self.frame->data[0] != NULL) {
+        av_freep(self.frame->data);
+    }
+}
+
 - (BOOL)rescaleFrame:(AVFrame *)inF out:(AVFrame **)outP
 {
+    if (inF->width != self.picWidth || inF->height != self.picHeight || inF->format != self.srcPixFmt) {
+        [self onInputChanged:inF];
+    }
+    
     AVFrame *out_frame = self.frame;
     //important！
     av_frame_copy_props(out_frame, inF);
 
     if(NULL == out_frame->data[0]){
         out_frame->format  = self.dstPixFmt;
-        out_frame->width   = self.picWidth;
-        out_frame->height  = self.picHeight;
+        out_frame->width   = self.dstWidth;
+        out_frame->height  = self.dstHeight;
         
         av_image_fill_linesizes(out_frame->linesize, out_frame->format, out_frame->width);
-        av_image_alloc(out_frame->data, out_frame->linesize, self.picWidth, self.picHeight, self.dstPixFmt, 1);
+        av_image_alloc(out_frame->data, out_frame->linesize, self.dstWidth, self.dstHeight, self.dstPixFmt, 1);
     }
     
-    int ret = sws_scale(self.sws_ctx, (const uint8_t* const*)inF->data, inF->linesize, 0, inF->height, out_frame->data, out_frame->linesize);
+    const int64_t begin = av_gettime_relative();
+    int ret;
+    //只有单线程、尺寸不变的 swscale 转换计入协商用的耗时表，快速路径、分片、缩放的耗时没法和别的格式对比
+    BOOL measurable = NO;
+    const BOOL sameSize = self.dstWidth == self.picWidth && self.dstHeight == self.picHeight;
+    if (sameSize && [MRPixelKernels canConvertFrom:self.srcPixFmt to:self.dstPixFmt]) {
+        //只需重排字节的格式对，走 SIMD 快速路径
+        ret = [MRPixelKernels convertFrame:inF to:out_frame] ? 0 : -1;
+    }
+    //分片只用于尺寸不变的格式转换，缩放时垂直方向的滤波会跨越条带
+    else if (self.sliceCount > 1 && sameSize) {
+        ret = [self scaleSlices:inF out:out_frame];
+    } else if ([self prepareContext]) {
+        measurable = sameSize;
+        ret = sws_scale(self.sws_ctx, (const uint8_t* const*)inF->data, inF->linesize, 0, inF->height, out_frame->data, out_frame->linesize);
+    } else {
+        ret = -1;
+    }
     if(ret < 0){
         // convert error, try next frame
         av_log(NULL, AV_LOG_ERROR, "fail scale video");
         av_freep(&out_frame->data);
         return NO;
     }
+    if (measurable) {
+        [self updateCost:av_gettime_relative() - begin];
+    }
     
     *outP = out_frame;
     return YES;
 }
 
+//统计实测耗时，按输出的像素数折算，定期上报给协商用的耗时表
+- (void)updateCost:(int64_t)us
+{
+    const double pixels = (double)self.dstWidth * self.dstHeight;
+    if (pixels <= 0) {
+        return;
+    }
+    const double ns = us * 1000.0 / pixels;
+    self.ns_per_pixel = self.measured_frames == 0 ? ns : self.ns_per_pixel * 0.9 + ns * 0.1;
+    self.measured_frames++;
+    if (self.measured_frames % MR_COST_REPORT_INTERVAL == 0) {
+        [FFVideoScale recordCost:self.ns_per_pixel from:self.srcPixFmt to:self.dstPixFmt];
+    }
+}
+
 @end
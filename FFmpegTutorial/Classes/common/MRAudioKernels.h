@@ -0,0 +1,55 @@
+//
+//  MRAudioKernels.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 音频采样交付时的格式转换：S16/S16P/FLT/FLTP 之间互转，任意声道数
+// 交错/解交错、int16/float 转换和电平统计、波形的最值、混音使用 SIMD（AVX2、SSE2、NEON），运行时按 CPU 选择；
+// 不分配内存、不加锁，可以在音频渲染回调里调用。float 转 int16 时四舍五入（偶数优先）并饱和，和指令集无关。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayerHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+///编译期特化的交付函数，格式和声道数已经固定，参数同 convert；不检查参数，samples 需大于 0
+typedef void (*MRAudioDeliverFunc)(uint8_t * const _Nonnull * _Nonnull src, uint8_t * const _Nonnull * _Nonnull dst, int samples);
+
+@interface MRAudioKernels : NSObject
+
+///使用的指令集：AVX2、SSE2、NEON 或 C
++ (NSString *)activeISA;
+
+///转换 samples 个采样点，src/dst 是每个平面的首地址，交错格式只用第 0 个；channels 最大为 MR_CH_LAYOUT_MAX_CHANNELS
++ (void)convert:(uint8_t * const _Nonnull * _Nonnull)src
+         format:(MRSampleFormat)srcFmt
+             to:(uint8_t * const _Nonnull * _Nonnull)dst
+         format:(MRSampleFormat)dstFmt
+       channels:(int)channels
+        samples:(int)samples;
+
+///绝对值的最大值和平方和，用于电平表
++ (void)peakAndSumSquares:(const float *)src count:(int)count peak:(float *)peak sumSquares:(double *)sumSquares;
+///最小值和最大值，用于生成波形
++ (void)minMax:(const float *)src count:(int)count min:(float *)min max:(float *)max;
+///dst[i] += src[i] * gain，用于多音轨混音
++ (void)mix:(const float *)src gain:(float)gain into:(float *)dst count:(int)count;
+///dst[i] = src[i] / 32768
++ (void)s16ToFloat:(const int16_t *)src dst:(float *)dst count:(int)count;
+///dst[i] = clamp(round(src[i] * 32768))
++ (void)floatToS16:(const float *)src dst:(int16_t *)dst count:(int)count;
+///把 channels 个平面交错到一起，bytesPerSample 为 2 或 4
++ (void)interleave:(const uint8_t * const _Nonnull * _Nonnull)src dst:(uint8_t *)dst channels:(int)channels samples:(int)samples bytesPerSample:(int)bytesPerSample;
+///把交错的采样拆成 channels 个平面，bytesPerSample 为 2 或 4
++ (void)deinterleave:(const uint8_t *)src dst:(uint8_t * const _Nonnull * _Nonnull)dst channels:(int)channels samples:(int)samples bytesPerSample:(int)bytesPerSample;
+
+///S16/S16P/FLT/FLTP 两两之间、1~2 声道的特化交付函数，在输出格式确定时取一次；其他声道数返回 NULL，使用 convert
++ (nullable MRAudioDeliverFunc)deliverFuncFrom:(MRSampleFormat)srcFmt to:(MRSampleFormat)dstFmt channels:(int)channels;
+
+///对每个特化的组合，分别用 convert 和特化函数转换 iterations 次，给出每次的耗时对比并校验结果是否逐字节一致
++ (NSString *)benchmarkDeliverWithSamples:(int)samples iterations:(int)iterations;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,992 @@
+//
+//  MRAudioKernels.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "MRAudioKernels.h"
+#import <libavutil/cpu.h>
+#import <libavutil/common.h>
+#import <libavutil/mem.h>
+#import <libavutil/time.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MR_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+//float 转 int16 用到了 ARMv8 的就近取整和 NaN 处理指令
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define MR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+//格式和交错方式都不同时，分块经过栈上的临时缓冲区，每块的采样点数
+#define MR_AUDIO_BLOCK_SAMPLES 256
+
+typedef void (*mr_s16_to_flt_func)(const int16_t *src, float *dst, int n);
+typedef void (*mr_flt_to_s16_func)(const float *src, int16_t *dst, int n);
+//双声道交错/解交错，l/r 为两个平面
+typedef void (*mr_interleave2_func)(const void *l, const void *r, void *dst, int n);
+typedef void (*mr_deinterleave2_func)(const void *src, void *l, void *r, int n);
+//绝对值的最大值和平方和
+typedef void (*mr_peak_sumsq_func)(const float *src, int n, float *peak, double *sumsq);
+//最小值和最大值，n 大于 0
+typedef void (*mr_min_max_func)(const float *src, int n, float *min, float *max);
+//dst[i] += src[i] * gain，先乘后加不用 FMA，各指令集的结果一样
+typedef void (*mr_mix_func)(const float *src, float gain, float *dst, int n);
+
+typedef struct MRAudioKernelFuncs {
+    const char *name;
+    mr_s16_to_flt_func s16_to_flt;
+    mr_flt_to_s16_func flt_to_s16;
+    mr_interleave2_func interleave2_s16;
+    mr_interleave2_func interleave2_flt;
+    mr_deinterleave2_func deinterleave2_s16;
+    mr_deinterleave2_func deinterleave2_flt;
+    mr_peak_sumsq_func peak_sumsq_flt;
+    mr_min_max_func min_max_flt;
+    mr_mix_func mix_flt;
+} MRAudioKernelFuncs;
+
+#pragma mark - C
+
+static inline int16_t mr_flt_to_s16_one(float f)
+{
+    f *= 32768.0f;
+    //NaN 也按正向溢出处理，和 SIMD 的 min/max 结果一致
+    if (!(f <= 32767.0f)) {
+        f = 32767.0f;
+    }
+    if (f < -32768.0f) {
+        f = -32768.0f;
+    }
+    return (int16_t)lrintf(f);
+}
+
+static void mr_s16_to_flt_c(const int16_t *src, float *dst, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+}
+
+static void mr_flt_to_s16_c(const float *src, int16_t *dst, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = mr_flt_to_s16_one(src[i]);
+    }
+}
+
+static void mr_interleave2_s16_c(const void *l, const void *r, void *dst, int n)
+{
+    const int16_t *a = l;
+    const int16_t *b = r;
+    int16_t *d = dst;
+    for (int i = 0; i < n; i++) {
+        d[2 * i] = a[i];
+        d[2 * i + 1] = b[i];
+    }
+}
+
+static void mr_interleave2_flt_c(const void *l, const void *r, void *dst, int n)
+{
+    const float *a = l;
+    const float *b = r;
+    float *d = dst;
+    for (int i = 0; i < n; i++) {
+        d[2 * i] = a[i];
+        d[2 * i + 1] = b[i];
+    }
+}
+
+static void mr_deinterleave2_s16_c(const void *src, void *l, void *r, int n)
+{
+    const int16_t *s = src;
+    int16_t *a = l;
+    int16_t *b = r;
+    for (int i = 0; i < n; i++) {
+        a[i] = s[2 * i];
+        b[i] = s[2 * i + 1];
+    }
+}
+
+static void mr_deinterleave2_flt_c(const void *src, void *l, void *r, int n)
+{
+    const float *s = src;
+    float *a = l;
+    float *b = r;
+    for (int i = 0; i < n; i++) {
+        a[i] = s[2 * i];
+        b[i] = s[2 * i + 1];
+    }
+}
+
+static void mr_peak_sumsq_flt_c(const float *src, int n, float *peak, double *sumsq)
+{
+    float p = 0;
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        const float v = fabsf(src[i]);
+        p = v > p ? v : p;
+        s += (double)src[i] * src[i];
+    }
+    *peak = p;
+    *sumsq = s;
+}
+
+static void mr_min_max_flt_c(const float *src, int n, float *min, float *max)
+{
+    float lo = src[0], hi = src[0];
+    for (int i = 1; i < n; i++) {
+        lo = src[i] < lo ? src[i] : lo;
+        hi = src[i] > hi ? src[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static void mr_mix_flt_c(const float *src, float gain, float *dst, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+#pragma mark - SSE2/AVX2
+
+#if MR_HAVE_X86
+
+__attribute__((target("sse2")))
+static void mr_s16_to_flt_sse2(const int16_t *src, float *dst, int n)
+{
+    const __m128 k = _mm_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        //低 16 位复制到高位再算术右移，得到符号扩展的 int32
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+    mr_s16_to_flt_c(src + i, dst + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_flt_to_s16_sse2(const float *src, int16_t *dst, int n)
+{
+    const __m128 k = _mm_set1_ps(32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        //min 的第一个参数是 NaN 时返回第二个参数
+        __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), k), max), min);
+        __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), k), max), min);
+        __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    mr_flt_to_s16_c(src + i, dst + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_interleave2_s16_sse2(const void *l, const void *r, void *dst, int n)
+{
+    const int16_t *a = l;
+    const int16_t *b = r;
+    int16_t *d = dst;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(d + 2 * i), _mm_unpacklo_epi16(va, vb));
+        _mm_storeu_si128((__m128i *)(d + 2 * i + 8), _mm_unpackhi_epi16(va, vb));
+    }
+    mr_interleave2_s16_c(a + i, b + i, d + 2 * i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_interleave2_flt_sse2(const void *l, const void *r, void *dst, int n)
+{
+    const float *a = l;
+    const float *b = r;
+    float *d = dst;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(d + 2 * i, _mm_unpacklo_ps(va, vb));
+        _mm_storeu_ps(d + 2 * i + 4, _mm_unpackhi_ps(va, vb));
+    }
+    mr_interleave2_flt_c(a + i, b + i, d + 2 * i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_deinterleave2_s16_sse2(const void *src, void *l, void *r, int n)
+{
+    const int16_t *s = src;
+    int16_t *a = l;
+    int16_t *b = r;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(s + 2 * i + 8));
+        //每个 32 位里低 16 位是左声道，高 16 位是右声道；取出后符号扩展，pack 时不会饱和
+        __m128i l0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+        __m128i l1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+        __m128i r0 = _mm_srai_epi32(v0, 16);
+        __m128i r1 = _mm_srai_epi32(v1, 16);
+        _mm_storeu_si128((__m128i *)(a + i), _mm_packs_epi32(l0, l1));
+        _mm_storeu_si128((__m128i *)(b + i), _mm_packs_epi32(r0, r1));
+    }
+    mr_deinterleave2_s16_c(s + 2 * i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_deinterleave2_flt_sse2(const void *src, void *l, void *r, int n)
+{
+    const float *s = src;
+    float *a = l;
+    float *b = r;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v0 = _mm_loadu_ps(s + 2 * i);
+        __m128 v1 = _mm_loadu_ps(s + 2 * i + 4);
+        _mm_storeu_ps(a + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(b + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    mr_deinterleave2_flt_c(s + 2 * i, a + i, b + i, n - i);
+}
+
+//每个通道单独累加平方和，最后再合并成 double；一帧只有几千个采样，float 的精度足够
+__attribute__((target("sse2")))
+static void mr_peak_sumsq_flt_sse2(const float *src, int n, float *peak, double *sumsq)
+{
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 p = _mm_setzero_ps();
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_loadu_ps(src + i);
+        __m128 b = _mm_loadu_ps(src + i + 4);
+        p = _mm_max_ps(p, _mm_max_ps(_mm_and_ps(a, abs_mask), _mm_and_ps(b, abs_mask)));
+        s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+    }
+    float pv[4], sv[4];
+    _mm_storeu_ps(pv, p);
+    _mm_storeu_ps(sv, _mm_add_ps(s0, s1));
+    float tail_peak;
+    double tail_sumsq;
+    mr_peak_sumsq_flt_c(src + i, n - i, &tail_peak, &tail_sumsq);
+    *peak = FFMAX(FFMAX(FFMAX(pv[0], pv[1]), FFMAX(pv[2], pv[3])), tail_peak);
+    *sumsq = (double)sv[0] + sv[1] + sv[2] + sv[3] + tail_sumsq;
+}
+
+__attribute__((target("avx2")))
+static void mr_peak_sumsq_flt_avx2(const float *src, int n, float *peak, double *sumsq)
+{
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 p = _mm256_setzero_ps();
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_loadu_ps(src + i);
+        __m256 b = _mm256_loadu_ps(src + i + 8);
+        p = _mm256_max_ps(p, _mm256_max_ps(_mm256_and_ps(a, abs_mask), _mm256_and_ps(b, abs_mask)));
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(a, a));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(b, b));
+    }
+    float pv[8], sv[8];
+    _mm256_storeu_ps(pv, p);
+    _mm256_storeu_ps(sv, _mm256_add_ps(s0, s1));
+    float tail_peak;
+    double tail_sumsq;
+    mr_peak_sumsq_flt_sse2(src + i, n - i, &tail_peak, &tail_sumsq);
+    double sum = tail_sumsq;
+    for (int k = 0; k < 8; k++) {
+        tail_peak = FFMAX(tail_peak, pv[k]);
+        sum += sv[k];
+    }
+    *peak = tail_peak;
+    *sumsq = sum;
+}
+
+__attribute__((target("sse2")))
+static void mr_min_max_flt_sse2(const float *src, int n, float *min, float *max)
+{
+    if (n < 8) {
+        mr_min_max_flt_c(src, n, min, max);
+        return;
+    }
+    __m128 lo = _mm_loadu_ps(src);
+    __m128 hi = lo;
+    int i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i);
+        lo = _mm_min_ps(lo, a);
+        hi = _mm_max_ps(hi, a);
+    }
+    float lv[4], hv[4];
+    _mm_storeu_ps(lv, lo);
+    _mm_storeu_ps(hv, hi);
+    float l = FFMIN(FFMIN(lv[0], lv[1]), FFMIN(lv[2], lv[3]));
+    float h = FFMAX(FFMAX(hv[0], hv[1]), FFMAX(hv[2], hv[3]));
+    for (; i < n; i++) {
+        l = FFMIN(l, src[i]);
+        h = FFMAX(h, src[i]);
+    }
+    *min = l;
+    *max = h;
+}
+
+__attribute__((target("avx2")))
+static void mr_min_max_flt_avx2(const float *src, int n, float *min, float *max)
+{
+    if (n < 16) {
+        mr_min_max_flt_sse2(src, n, min, max);
+        return;
+    }
+    __m256 lo = _mm256_loadu_ps(src);
+    __m256 hi = lo;
+    int i = 8;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(src + i);
+        lo = _mm256_min_ps(lo, a);
+        hi = _mm256_max_ps(hi, a);
+    }
+    float lv[8], hv[8];
+    _mm256_storeu_ps(lv, lo);
+    _mm256_storeu_ps(hv, hi);
+    float l = lv[0], h = hv[0];
+    for (int k = 1; k < 8; k++) {
+        l = FFMIN(l, lv[k]);
+        h = FFMAX(h, hv[k]);
+    }
+    for (; i < n; i++) {
+        l = FFMIN(l, src[i]);
+        h = FFMAX(h, src[i]);
+    }
+    *min = l;
+    *max = h;
+}
+
+__attribute__((target("sse2")))
+static void mr_mix_flt_sse2(const float *src, float gain, float *dst, int n)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), g);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), a));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), b));
+    }
+    mr_mix_flt_c(src + i, gain, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mr_mix_flt_avx2(const float *src, float gain, float *dst, int n)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), g);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), a));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), b));
+    }
+    mr_mix_flt_sse2(src + i, gain, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mr_s16_to_flt_avx2(const int16_t *src, float *dst, int n)
+{
+    const __m256 k = _mm256_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), k));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), k));
+    }
+    mr_s16_to_flt_sse2(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mr_flt_to_s16_avx2(const float *src, int16_t *dst, int n)
+{
+    const __m256 k = _mm256_set1_ps(32768.0f);
+    const __m256 max = _mm256_set1_ps(32767.0f);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), k), max), min);
+        __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), k), max), min);
+        //pack 是按 128 位分别进行的，结果为 a0 b0 a1 b1，需要重排成 a0 a1 b0 b1
+        __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    mr_flt_to_s16_sse2(src + i, dst + i, n - i);
+}
+
+#endif
+
+#pragma mark - NEON
+
+#if MR_HAVE_NEON
+
+static void mr_s16_to_flt_neon(const int16_t *src, float *dst, int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, 1.0f / 32768.0f));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, 1.0f / 32768.0f));
+    }
+    mr_s16_to_flt_c(src + i, dst + i, n - i);
+}
+
+static void mr_flt_to_s16_neon(const float *src, int16_t *dst, int n)
+{
+    const float32x4_t max = vdupq_n_f32(32767.0f);
+    const float32x4_t min = vdupq_n_f32(-32768.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        //minnm 遇到 NaN 时返回另一个参数
+        float32x4_t a = vmaxnmq_f32(vminnmq_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f), max), min);
+        float32x4_t b = vmaxnmq_f32(vminnmq_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f), max), min);
+        int16x8_t v = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+        vst1q_s16(dst + i, v);
+    }
+    mr_flt_to_s16_c(src + i, dst + i, n - i);
+}
+
+static void mr_interleave2_s16_neon(const void *l, const void *r, void *dst, int n)
+{
+    const int16_t *a = l;
+    const int16_t *b = r;
+    int16_t *d = dst;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v = {{vld1q_s16(a + i), vld1q_s16(b + i)}};
+        vst2q_s16(d + 2 * i, v);
+    }
+    mr_interleave2_s16_c(a + i, b + i, d + 2 * i, n - i);
+}
+
+static void mr_interleave2_flt_neon(const void *l, const void *r, void *dst, int n)
+{
+    const float *a = l;
+    const float *b = r;
+    float *d = dst;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = {{vld1q_f32(a + i), vld1q_f32(b + i)}};
+        vst2q_f32(d + 2 * i, v);
+    }
+    mr_interleave2_flt_c(a + i, b + i, d + 2 * i, n - i);
+}
+
+static void mr_deinterleave2_s16_neon(const void *src, void *l, void *r, int n)
+{
+    const int16_t *s = src;
+    int16_t *a = l;
+    int16_t *b = r;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8x2_t v = vld2q_s16(s + 2 * i);
+        vst1q_s16(a + i, v.val[0]);
+        vst1q_s16(b + i, v.val[1]);
+    }
+    mr_deinterleave2_s16_c(s + 2 * i, a + i, b + i, n - i);
+}
+
+static void mr_deinterleave2_flt_neon(const void *src, void *l, void *r, int n)
+{
+    const float *s = src;
+    float *a = l;
+    float *b = r;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t v = vld2q_f32(s + 2 * i);
+        vst1q_f32(a + i, v.val[0]);
+        vst1q_f32(b + i, v.val[1]);
+    }
+    mr_deinterleave2_flt_c(s + 2 * i, a + i, b + i, n - i);
+}
+
+static void mr_peak_sumsq_flt_neon(const float *src, int n, float *peak, double *sumsq)
+{
+    float32x4_t p = vdupq_n_f32(0);
+    float32x4_t s0 = vdupq_n_f32(0);
+    float32x4_t s1 = vdupq_n_f32(0);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vld1q_f32(src + i);
+        float32x4_t b = vld1q_f32(src + i + 4);
+        p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(a), vabsq_f32(b)));
+        s0 = vfmaq_f32(s0, a, a);
+        s1 = vfmaq_f32(s1, b, b);
+    }
+    float tail_peak;
+    double tail_sumsq;
+    mr_peak_sumsq_flt_c(src + i, n - i, &tail_peak, &tail_sumsq);
+    *peak = FFMAX(vmaxvq_f32(p), tail_peak);
+    *sumsq = (double)vaddvq_f32(vaddq_f32(s0, s1)) + tail_sumsq;
+}
+
+static void mr_min_max_flt_neon(const float *src, int n, float *min, float *max)
+{
+    if (n < 8) {
+        mr_min_max_flt_c(src, n, min, max);
+        return;
+    }
+    float32x4_t lo = vld1q_f32(src);
+    float32x4_t hi = lo;
+    int i = 4;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t a = vld1q_f32(src + i);
+        lo = vminq_f32(lo, a);
+        hi = vmaxq_f32(hi, a);
+    }
+    float l = vminvq_f32(lo);
+    float h = vmaxvq_f32(hi);
+    for (; i < n; i++) {
+        l = FFMIN(l, src[i]);
+        h = FFMAX(h, src[i]);
+    }
+    *min = l;
+    *max = h;
+}
+
+static void mr_mix_flt_neon(const float *src, float gain, float *dst, int n)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vmulq_f32(vld1q_f32(src + i), g);
+        float32x4_t b = vmulq_f32(vld1q_f32(src + i + 4), g);
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), a));
+        vst1q_f32(dst + i + 4, vaddq_f32(vld1q_f32(dst + i + 4), b));
+    }
+    mr_mix_flt_c(src + i, gain, dst + i, n - i);
+}
+
+#endif
+
+#pragma mark - 运行时选择
+
+static const MRAudioKernelFuncs mr_audio_kernels_c = {"C", mr_s16_to_flt_c, mr_flt_to_s16_c, mr_interleave2_s16_c, mr_interleave2_flt_c, mr_deinterleave2_s16_c, mr_deinterleave2_flt_c, mr_peak_sumsq_flt_c, mr_min_max_flt_c, mr_mix_flt_c};
+#if MR_HAVE_X86
+static const MRAudioKernelFuncs mr_audio_kernels_sse2 = {"SSE2", mr_s16_to_flt_sse2, mr_flt_to_s16_sse2, mr_interleave2_s16_sse2, mr_interleave2_flt_sse2, mr_deinterleave2_s16_sse2, mr_deinterleave2_flt_sse2, mr_peak_sumsq_flt_sse2, mr_min_max_flt_sse2, mr_mix_flt_sse2};
+//交错只是搬运数据，SSE2 已经够快
+static const MRAudioKernelFuncs mr_audio_kernels_avx2 = {"AVX2", mr_s16_to_flt_avx2, mr_flt_to_s16_avx2, mr_interleave2_s16_sse2, mr_interleave2_flt_sse2, mr_deinterleave2_s16_sse2, mr_deinterleave2_flt_sse2, mr_peak_sumsq_flt_avx2, mr_min_max_flt_avx2, mr_mix_flt_avx2};
+#endif
+#if MR_HAVE_NEON
+static const MRAudioKernelFuncs mr_audio_kernels_neon = {"NEON", mr_s16_to_flt_neon, mr_flt_to_s16_neon, mr_interleave2_s16_neon, mr_interleave2_flt_neon, mr_deinterleave2_s16_neon, mr_deinterleave2_flt_neon, mr_peak_sumsq_flt_neon, mr_min_max_flt_neon, mr_mix_flt_neon};
+#endif
+
+static const MRAudioKernelFuncs * mr_best_audio_kernels(void)
+{
+    static const MRAudioKernelFuncs *best = &mr_audio_kernels_c;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        const int flags = av_get_cpu_flags();
+#if MR_HAVE_X86
+        if (flags & AV_CPU_FLAG_SSE2) {
+            best = &mr_audio_kernels_sse2;
+        }
+        if (flags & AV_CPU_FLAG_AVX2) {
+            best = &mr_audio_kernels_avx2;
+        }
+#endif
+#if MR_HAVE_NEON
+        if (flags & AV_CPU_FLAG_NEON) {
+            best = &mr_audio_kernels_neon;
+        }
+#endif
+        (void)flags;
+    });
+    return best;
+}
+
+#pragma mark - 交错和转换
+
+static void mr_interleave(const MRAudioKernelFuncs *k, const uint8_t * const *src, uint8_t *dst, int channels, int n, int bps)
+{
+    if (channels == 1) {
+        memcpy(dst, src[0], (size_t)n * bps);
+    } else if (channels == 2) {
+        (bps == 2 ? k->interleave2_s16 : k->interleave2_flt)(src[0], src[1], dst, n);
+    } else if (bps == 2) {
+        int16_t *d = (int16_t *)dst;
+        for (int c = 0; c < channels; c++) {
+            const int16_t *s = (const int16_t *)src[c];
+            for (int i = 0; i < n; i++) {
+                d[i * channels + c] = s[i];
+            }
+        }
+    } else {
+        float *d = (float *)dst;
+        for (int c = 0; c < channels; c++) {
+            const float *s = (const float *)src[c];
+            for (int i = 0; i < n; i++) {
+                d[i * channels + c] = s[i];
+            }
+        }
+    }
+}
+
+static void mr_deinterleave(const MRAudioKernelFuncs *k, const uint8_t *src, uint8_t * const *dst, int channels, int n, int bps)
+{
+    if (channels == 1) {
+        memcpy(dst[0], src, (size_t)n * bps);
+    } else if (channels == 2) {
+        (bps == 2 ? k->deinterleave2_s16 : k->deinterleave2_flt)(src, dst[0], dst[1], n);
+    } else if (bps == 2) {
+        const int16_t *s = (const int16_t *)src;
+        for (int c = 0; c < channels; c++) {
+            int16_t *d = (int16_t *)dst[c];
+            for (int i = 0; i < n; i++) {
+                d[i] = s[i * channels + c];
+            }
+        }
+    } else {
+        const float *s = (const float *)src;
+        for (int c = 0; c < channels; c++) {
+            float *d = (float *)dst[c];
+            for (int i = 0; i < n; i++) {
+                d[i] = s[i * channels + c];
+            }
+        }
+    }
+}
+
+//连续的 n 个采样转换采样深度，深度相同时直接拷贝
+static void mr_convert_depth(const MRAudioKernelFuncs *k, const uint8_t *src, BOOL srcFloat, uint8_t *dst, BOOL dstFloat, int n)
+{
+    if (srcFloat == dstFloat) {
+        if (src != dst) {
+            memcpy(dst, src, (size_t)n * (srcFloat ? sizeof(float) : sizeof(int16_t)));
+        }
+    } else if (srcFloat) {
+        k->flt_to_s16((const float *)src, (int16_t *)dst, n);
+    } else {
+        k->s16_to_flt((const int16_t *)src, (float *)dst, n);
+    }
+}
+
+static void mr_audio_convert(const MRAudioKernelFuncs *k, uint8_t * const *src, MRSampleFormat srcFmt, uint8_t * const *dst, MRSampleFormat dstFmt, int channels, int samples)
+{
+    const BOOL srcPlanar = MR_Sample_Fmt_Is_Planar(srcFmt);
+    const BOOL dstPlanar = MR_Sample_Fmt_Is_Planar(dstFmt);
+    const BOOL srcFloat = MR_Sample_Fmt_Is_FloatX(srcFmt);
+    const BOOL dstFloat = MR_Sample_Fmt_Is_FloatX(dstFmt);
+    const int sbps = srcFloat ? sizeof(float) : sizeof(int16_t);
+    const int dbps = dstFloat ? sizeof(float) : sizeof(int16_t);
+
+    //交错方式相同，只需要转换采样深度，交错格式当作一个很长的平面
+    if (srcPlanar == dstPlanar) {
+        const int planes = srcPlanar ? channels : 1;
+        const int count = srcPlanar ? samples : samples * channels;
+        for (int p = 0; p < planes; p++) {
+            mr_convert_depth(k, src[p], srcFloat, dst[p], dstFloat, count);
+        }
+        return;
+    }
+
+    //交错方式不同，深度也不同时分块：先在栈上的缓冲区里转换深度，再交错/解交错
+    uint8_t scratch[MR_CH_LAYOUT_MAX_CHANNELS * MR_AUDIO_BLOCK_SAMPLES * sizeof(float)] __attribute__((aligned(32)));
+    const uint8_t *planes[MR_CH_LAYOUT_MAX_CHANNELS];
+    uint8_t *outs[MR_CH_LAYOUT_MAX_CHANNELS];
+    for (int off = 0; off < samples; off += MR_AUDIO_BLOCK_SAMPLES) {
+        const int n = FFMIN(MR_AUDIO_BLOCK_SAMPLES, samples - off);
+        if (srcPlanar) {
+            for (int c = 0; c < channels; c++) {
+                const uint8_t *from = src[c] + (size_t)off * sbps;
+                if (srcFloat == dstFloat) {
+                    planes[c] = from;
+                } else {
+                    uint8_t *tmp = scratch + c * MR_AUDIO_BLOCK_SAMPLES * dbps;
+                    mr_convert_depth(k, from, srcFloat, tmp, dstFloat, n);
+                    planes[c] = tmp;
+                }
+            }
+            mr_interleave(k, planes, dst[0] + (size_t)off * channels * dbps, channels, n, dbps);
+        } else {
+            const uint8_t *from = src[0] + (size_t)off * channels * sbps;
+            if (srcFloat == dstFloat) {
+                for (int c = 0; c < channels; c++) {
+                    outs[c] = dst[c] + (size_t)off * dbps;
+                }
+                mr_deinterleave(k, from, outs, channels, n, sbps);
+            } else {
+                for (int c = 0; c < channels; c++) {
+                    outs[c] = scratch + c * MR_AUDIO_BLOCK_SAMPLES * sbps;
+                }
+                mr_deinterleave(k, from, outs, channels, n, sbps);
+                for (int c = 0; c < channels; c++) {
+                    mr_convert_depth(k, outs[c], srcFloat, dst[c] + (size_t)off * dbps, dstFloat, n);
+                }
+            }
+        }
+    }
+}
+
+#pragma mark - 特化的交付函数
+
+//格式和声道数都是常量，内联展开后分支在编译时就确定了，每次调用只剩拷贝或一两次 SIMD 转换
+static inline __attribute__((always_inline)) void mr_deliver_fixed(uint8_t * const *src, uint8_t * const *dst, int n, MRSampleFormat srcFmt, MRSampleFormat dstFmt, int channels)
+{
+    const MRAudioKernelFuncs *k = mr_best_audio_kernels();
+    const BOOL srcPlanar = MR_Sample_Fmt_Is_Planar(srcFmt);
+    const BOOL dstPlanar = MR_Sample_Fmt_Is_Planar(dstFmt);
+    const BOOL srcFloat = MR_Sample_Fmt_Is_FloatX(srcFmt);
+    const BOOL dstFloat = MR_Sample_Fmt_Is_FloatX(dstFmt);
+
+    //单声道时交错和平面的内存布局一样
+    if (channels == 1 || srcPlanar == dstPlanar) {
+        const int planes = srcPlanar ? channels : 1;
+        const int count = srcPlanar ? n : n * channels;
+        for (int p = 0; p < planes; p++) {
+            if (srcFloat == dstFloat) {
+                memcpy(dst[p], src[p], (size_t)count * (srcFloat ? sizeof(float) : sizeof(int16_t)));
+            } else if (srcFloat) {
+                k->flt_to_s16((const float *)src[p], (int16_t *)dst[p], count);
+            } else {
+                k->s16_to_flt((const int16_t *)src[p], (float *)dst[p], count);
+            }
+        }
+        return;
+    }
+
+    //双声道，交错方式不同
+    if (srcFloat == dstFloat) {
+        if (srcPlanar) {
+            (srcFloat ? k->interleave2_flt : k->interleave2_s16)(src[0], src[1], dst[0], n);
+        } else {
+            (srcFloat ? k->deinterleave2_flt : k->deinterleave2_s16)(src[0], dst[0], dst[1], n);
+        }
+        return;
+    }
+
+    //深度也不同时分块经过栈上的缓冲区：平面先转深度再交错，交错的先整块转深度再解交错
+    uint8_t scratch[2 * MR_AUDIO_BLOCK_SAMPLES * sizeof(float)] __attribute__((aligned(32)));
+    for (int off = 0; off < n; off += MR_AUDIO_BLOCK_SAMPLES) {
+        const int m = FFMIN(MR_AUDIO_BLOCK_SAMPLES, n - off);
+        if (srcPlanar && srcFloat) {
+            int16_t *l = (int16_t *)scratch;
+            int16_t *r = l + MR_AUDIO_BLOCK_SAMPLES;
+            k->flt_to_s16((const float *)src[0] + off, l, m);
+            k->flt_to_s16((const float *)src[1] + off, r, m);
+            k->interleave2_s16(l, r, (int16_t *)dst[0] + off * 2, m);
+        } else if (srcPlanar) {
+            float *l = (float *)scratch;
+            float *r = l + MR_AUDIO_BLOCK_SAMPLES;
+            k->s16_to_flt((const int16_t *)src[0] + off, l, m);
+            k->s16_to_flt((const int16_t *)src[1] + off, r, m);
+            k->interleave2_flt(l, r, (float *)dst[0] + off * 2, m);
+        } else if (srcFloat) {
+            int16_t *tmp = (int16_t *)scratch;
+            k->flt_to_s16((const float *)src[0] + off * 2, tmp, m * 2);
+            k->deinterleave2_s16(tmp, (int16_t *)dst[0] + off, (int16_t *)dst[1] + off, m);
+        } else {
+            float *tmp = (float *)scratch;
+            k->s16_to_flt((const int16_t *)src[0] + off * 2, tmp, m * 2);
+            k->deinterleave2_flt(tmp, (float *)dst[0] + off, (float *)dst[1] + off, m);
+        }
+    }
+}
+
+//每个 (原格式, 目标格式, 声道数) 生成一个函数，比如 mr_deliver_FLTP_S16_2
+#define MR_DELIVER_FUNC(SRC, DST, CH) \
+static void mr_deliver_##SRC##_##DST##_##CH(uint8_t * const *src, uint8_t * const *dst, int samples) \
+{ \
+    mr_deliver_fixed(src, dst, samples, MR_SAMPLE_FMT_##SRC, MR_SAMPLE_FMT_##DST, CH); \
+}
+#define MR_DELIVER_FUNCS_TO(SRC, DST) MR_DELIVER_FUNC(SRC, DST, 1) MR_DELIVER_FUNC(SRC, DST, 2)
+#define MR_DELIVER_FUNCS_FROM(SRC) \
+    MR_DELIVER_FUNCS_TO(SRC, S16) MR_DELIVER_FUNCS_TO(SRC, FLT) MR_DELIVER_FUNCS_TO(SRC, S16P) MR_DELIVER_FUNCS_TO(SRC, FLTP)
+
+MR_DELIVER_FUNCS_FROM(S16)
+MR_DELIVER_FUNCS_FROM(FLT)
+MR_DELIVER_FUNCS_FROM(S16P)
+MR_DELIVER_FUNCS_FROM(FLTP)
+
+//特化的声道数，更多声道走通用的 mr_audio_convert
+#define MR_DELIVER_MAX_CHANNELS 2
+#define MR_DELIVER_ENTRY_TO(SRC, DST) {mr_deliver_##SRC##_##DST##_1, mr_deliver_##SRC##_##DST##_2}
+#define MR_DELIVER_ENTRY_FROM(SRC) \
+    {MR_DELIVER_ENTRY_TO(SRC, S16), MR_DELIVER_ENTRY_TO(SRC, FLT), MR_DELIVER_ENTRY_TO(SRC, S16P), MR_DELIVER_ENTRY_TO(SRC, FLTP)}
+
+//按 MRSampleFormat 的顺序：S16、FLT、S16P、FLTP
+static const MRAudioDeliverFunc mr_deliver_funcs[4][4][MR_DELIVER_MAX_CHANNELS] = {
+    MR_DELIVER_ENTRY_FROM(S16),
+    MR_DELIVER_ENTRY_FROM(FLT),
+    MR_DELIVER_ENTRY_FROM(S16P),
+    MR_DELIVER_ENTRY_FROM(FLTP),
+};
+
+static MRAudioDeliverFunc mr_find_deliver_func(MRSampleFormat srcFmt, MRSampleFormat dstFmt, int channels)
+{
+    if (srcFmt < MR_SAMPLE_FMT_BEGIN || srcFmt > MR_SAMPLE_FMT_END || dstFmt < MR_SAMPLE_FMT_BEGIN || dstFmt > MR_SAMPLE_FMT_END) {
+        return NULL;
+    }
+    if (channels <= 0 || channels > MR_DELIVER_MAX_CHANNELS) {
+        return NULL;
+    }
+    return mr_deliver_funcs[srcFmt - MR_SAMPLE_FMT_BEGIN][dstFmt - MR_SAMPLE_FMT_BEGIN][channels - 1];
+}
+
+@implementation MRAudioKernels
+
++ (NSString *)activeISA
+{
+    return [NSString stringWithUTF8String:mr_best_audio_kernels()->name];
+}
+
++ (void)convert:(uint8_t * const *)src format:(MRSampleFormat)srcFmt to:(uint8_t * const *)dst format:(MRSampleFormat)dstFmt channels:(int)channels samples:(int)samples
+{
+    if (channels <= 0 || channels > MR_CH_LAYOUT_MAX_CHANNELS || samples <= 0) {
+        return;
+    }
+    mr_audio_convert(mr_best_audio_kernels(), src, srcFmt, dst, dstFmt, channels, samples);
+}
+
++ (void)peakAndSumSquares:(const float *)src count:(int)count peak:(float *)peak sumSquares:(double *)sumSquares
+{
+    if (count <= 0) {
+        *peak = 0;
+        *sumSquares = 0;
+        return;
+    }
+    mr_best_audio_kernels()->peak_sumsq_flt(src, count, peak, sumSquares);
+}
+
++ (void)minMax:(const float *)src count:(int)count min:(float *)min max:(float *)max
+{
+    if (count <= 0) {
+        *min = 0;
+        *max = 0;
+        return;
+    }
+    mr_best_audio_kernels()->min_max_flt(src, count, min, max);
+}
+
++ (void)mix:(const float *)src gain:(float)gain into:(float *)dst count:(int)count
+{
+    if (count <= 0) {
+        return;
+    }
+    mr_best_audio_kernels()->mix_flt(src, gain, dst, count);
+}
+
++ (void)s16ToFloat:(const int16_t *)src dst:(float *)dst count:(int)count
+{
+    mr_best_audio_kernels()->s16_to_flt(src, dst, count);
+}
+
++ (void)floatToS16:(const float *)src dst:(int16_t *)dst count:(int)count
+{
+    mr_best_audio_kernels()->flt_to_s16(src, dst, count);
+}
+
++ (void)interleave:(const uint8_t * const *)src dst:(uint8_t *)dst channels:(int)channels samples:(int)samples bytesPerSample:(int)bytesPerSample
+{
+    mr_interleave(mr_best_audio_kernels(), src, dst, channels, samples, bytesPerSample);
+}
+
++ (void)deinterleave:(const uint8_t *)src dst:(uint8_t * const *)dst channels:(int)channels samples:(int)samples bytesPerSample:(int)bytesPerSample
+{
+    mr_deinterleave(mr_best_audio_kernels(), src, dst, channels, samples, bytesPerSample);
+}
+
++ (MRAudioDeliverFunc)deliverFuncFrom:(MRSampleFormat)srcFmt to:(MRSampleFormat)dstFmt channels:(int)channels
+{
+    return mr_find_deliver_func(srcFmt, dstFmt, channels);
+}
+
++ (NSString *)benchmarkDeliverWithSamples:(int)samples iterations:(int)iterations
+{
+    samples = MAX(samples, 1);
+    iterations = MAX(iterations, 1);
+    const MRSampleFormat fmts[] = {MR_SAMPLE_FMT_S16, MR_SAMPLE_FMT_FLT, MR_SAMPLE_FMT_S16P, MR_SAMPLE_FMT_FLTP};
+    const char *names[] = {"s16", "flt", "s16p", "fltp"};
+    const int fmtCount = sizeof(fmts) / sizeof(fmts[0]);
+    //交错格式只用第 0 个平面，按最大的情况分配
+    const size_t planeBytes = (size_t)samples * MR_DELIVER_MAX_CHANNELS * sizeof(float);
+    uint8_t *src[MR_DELIVER_MAX_CHANNELS] = {0};
+    uint8_t *ref[MR_DELIVER_MAX_CHANNELS] = {0};
+    uint8_t *out[MR_DELIVER_MAX_CHANNELS] = {0};
+    BOOL allocated = YES;
+    for (int p = 0; p < MR_DELIVER_MAX_CHANNELS; p++) {
+        src[p] = av_malloc(planeBytes);
+        ref[p] = av_malloc(planeBytes);
+        out[p] = av_malloc(planeBytes);
+        allocated = allocated && src[p] && ref[p] && out[p];
+    }
+
+    NSMutableString *report = [NSMutableString stringWithFormat:@"audio deliver %d samples,%d iterations,active:%s\n", samples, iterations, mr_best_audio_kernels()->name];
+    const MRAudioKernelFuncs *k = mr_best_audio_kernels();
+    for (int s = 0; allocated && s < fmtCount; s++) {
+        //填充可重复的伪随机内容，float 在 [-1.2, 1.2) 之间，包含需要饱和的值
+        uint32_t seed = 0x12345678;
+        for (int p = 0; p < MR_DELIVER_MAX_CHANNELS; p++) {
+            for (int i = 0; i < samples * MR_DELIVER_MAX_CHANNELS; i++) {
+                seed = seed * 1664525 + 1013904223;
+                if (MR_Sample_Fmt_Is_FloatX(fmts[s])) {
+                    ((float *)src[p])[i] = (seed >> 8) / (float)(1 << 24) * 2.4f - 1.2f;
+                } else {
+                    ((int16_t *)src[p])[i] = (int16_t)(seed >> 16);
+                }
+            }
+        }
+        for (int d = 0; d < fmtCount; d++) {
+            for (int ch = 1; ch <= MR_DELIVER_MAX_CHANNELS; ch++) {
+                const MRAudioDeliverFunc func = mr_find_deliver_func(fmts[s], fmts[d], ch);
+                const int planes = MR_Sample_Fmt_Is_Planar(fmts[d]) ? ch : 1;
+                const size_t bytes = (size_t)samples * (MR_Sample_Fmt_Is_FloatX(fmts[d]) ? sizeof(float) : sizeof(int16_t)) * (planes == 1 ? ch : 1);
+
+                int64_t begin = av_gettime_relative();
+                for (int i = 0; i < iterations; i++) {
+                    mr_audio_convert(k, src, fmts[s], ref, fmts[d], ch, samples);
+                }
+                const double generic_us = (double)(av_gettime_relative() - begin) / iterations;
+
+                begin = av_gettime_relative();
+                for (int i = 0; i < iterations; i++) {
+                    func(src, out, samples);
+                }
+                const double us = (double)(av_gettime_relative() - begin) / iterations;
+
+                BOOL exact = YES;
+                for (int p = 0; p < planes; p++) {
+                    exact = exact && memcmp(ref[p], out[p], bytes) == 0;
+                }
+                [report appendFormat:@"%s->%s %dch: generic %.3fus, specialized %.3fus(%.2fx,%s)\n", names[s], names[d], ch, generic_us, us, us > 0 ? generic_us / us : 0, exact ? "bit-exact" : "MISMATCH"];
+            }
+        }
+    }
+    if (!allocated) {
+        [report appendString:@"skipped: out of memory\n"];
+    }
+    for (int p = 0; p < MR_DELIVER_MAX_CHANNELS; p++) {
+        av_freep(&src[p]);
+        av_freep(&ref[p]);
+        av_freep(&out[p]);
+    }
+    av_log(NULL, AV_LOG_INFO, "%s", [report UTF8String]);
+    return report;
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  MRAudioMeter.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 电平表：每个声道的峰值、有效值和 EBU R128 响度（瞬时 400ms、短期 3s）
+// 在音频解码线程里对每帧调用 process，峰值和平方和用 SIMD 计算；每 100ms 发布一次结果，
+// 发布使用顺序锁（seqlock），任意线程读取都不加锁，也不会阻塞解码线程。
+
+#import <Foundation/Foundation.h>
+#import "FFPlayerHeader.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct MRAudioMeterSnapshot {
+    int channels;
+    //最近 100ms 的峰值和有效值，线性值，满幅为 1
+    float peak[MR_CH_LAYOUT_MAX_CHANNELS];
+    float rms[MR_CH_LAYOUT_MAX_CHANNELS];
+    //响度，单位 LUFS，静音时为 -INFINITY
+    double momentary;   //最近 400ms
+    double shortTerm;   //最近 3s，不足 3s 时按已有的数据
+    //已经统计的采样点数
+    int64_t samples;
+    //最近 100ms 结束时的媒体时间，单位s，没有 pts 时为 NAN
+    double pts;
+} MRAudioMeterSnapshot;
+
+@interface MRAudioMeter : NSObject
+
+@property (nonatomic, assign, readonly) int channels;
+@property (nonatomic, assign, readonly) int sampleRate;
+
+- (nullable instancetype)initWithChannels:(int)channels sampleRate:(int)sampleRate;
+
+///[写的一方]统计 samples 个采样，data 为每个平面的首地址，pts 为第一个采样的媒体时间
+- (void)process:(uint8_t * const _Nonnull * _Nonnull)data format:(MRSampleFormat)format samples:(int)samples pts:(double)pts;
+///[任意线程]最近一次发布的结果
+- (MRAudioMeterSnapshot)snapshot;
+///[写的一方]清空统计，比如 seek 之后
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,294 @@
+//
+//  MRAudioMeter.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "MRAudioMeter.h"
+#import "MRAudioKernels.h"
+#import <libavutil/mem.h>
+#import <libavutil/common.h>
+#include <stdatomic.h>
+#include <math.h>
+
+//每次转换成 float 平面的最大采样点数
+#define METER_CHUNK_SAMPLES 1024
+//发布间隔和响度的分块时长，单位s
+#define METER_BLOCK_DURATION 0.1
+//短期响度 3s 即 30 块，瞬时响度 400ms 即 4 块
+#define METER_SHORT_TERM_BLOCKS 30
+#define METER_MOMENTARY_BLOCKS 4
+
+//二阶 IIR 滤波器（直接 II 型转置）
+typedef struct MRBiquad {
+    double b0, b1, b2, a1, a2;
+} MRBiquad;
+
+typedef struct MRBiquadState {
+    double z1, z2;
+} MRBiquadState;
+
+static inline double biquad_run(const MRBiquad *f, MRBiquadState *s, double x)
+{
+    const double y = f->b0 * x + s->z1;
+    s->z1 = f->b1 * x - f->a1 * y + s->z2;
+    s->z2 = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+//ITU-R BS.1770 的 K 加权：高频搁架滤波器 + 高通滤波器，按实际采样率计算系数
+static void meter_k_weighting(int sampleRate, MRBiquad *shelf, MRBiquad *highpass)
+{
+    double f0 = 1681.974450955533;
+    const double G = 3.999843853973347;
+    double Q = 0.7071752369554196;
+    double K = tan(M_PI * f0 / sampleRate);
+    const double Vh = pow(10.0, G / 20.0);
+    const double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    shelf->b0 = (Vh + Vb * K / Q + K * K) / a0;
+    shelf->b1 = 2.0 * (K * K - Vh) / a0;
+    shelf->b2 = (Vh - Vb * K / Q + K * K) / a0;
+    shelf->a1 = 2.0 * (K * K - 1.0) / a0;
+    shelf->a2 = (1.0 - K / Q + K * K) / a0;
+
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+    K = tan(M_PI * f0 / sampleRate);
+    a0 = 1.0 + K / Q + K * K;
+    highpass->b0 = 1.0;
+    highpass->b1 = -2.0;
+    highpass->b2 = 1.0;
+    highpass->a1 = 2.0 * (K * K - 1.0) / a0;
+    highpass->a2 = (1.0 - K / Q + K * K) / a0;
+}
+
+//声道权重：按 FFmpeg 的默认声道顺序，LFE 不计入，环绕声道 +1.5dB
+static double meter_channel_weight(int c, int channels)
+{
+    if (channels == 6 || channels == 8) {
+        if (c == 3) {
+            return 0.0;
+        }
+        return c > 3 ? 1.41 : 1.0;
+    }
+    //4.0 是 FL FR FC BC，只有后中是环绕声道；5.0 是 FL FR FC BL BR
+    if (channels == 4 || channels == 5) {
+        return c >= 3 ? 1.41 : 1.0;
+    }
+    return 1.0;
+}
+
+static double meter_loudness(double power)
+{
+    return power > 0 ? -0.691 + 10.0 * log10(power) : -INFINITY;
+}
+
+@implementation MRAudioMeter
+{
+    float *_scratch[MR_CH_LAYOUT_MAX_CHANNELS];
+    MRBiquad _shelf;
+    MRBiquad _highpass;
+    MRBiquadState _shelfState[MR_CH_LAYOUT_MAX_CHANNELS];
+    MRBiquadState _highpassState[MR_CH_LAYOUT_MAX_CHANNELS];
+    double _weight[MR_CH_LAYOUT_MAX_CHANNELS];
+    //当前 100ms 的累计值
+    int _blockSamples;
+    int _blockFilled;
+    float _peak[MR_CH_LAYOUT_MAX_CHANNELS];
+    double _sumsq[MR_CH_LAYOUT_MAX_CHANNELS];
+    double _weightedSumsq[MR_CH_LAYOUT_MAX_CHANNELS];
+    //最近 30 块的加权均方值
+    double _blockPower[METER_SHORT_TERM_BLOCKS];
+    int64_t _blocks;
+    int64_t _samples;
+    double _nextPts;
+    //顺序锁：写的时候是奇数
+    _Atomic uint32_t _seq;
+    MRAudioMeterSnapshot _published;
+}
+
+- (void)dealloc
+{
+    for (int c = 0; c < MR_CH_LAYOUT_MAX_CHANNELS; c++) {
+        av_freep(&_scratch[c]);
+    }
+}
+
+- (instancetype)initWithChannels:(int)channels sampleRate:(int)sampleRate
+{
+    if (channels <= 0 || channels > MR_CH_LAYOUT_MAX_CHANNELS || sampleRate <= 0) {
+        return nil;
+    }
+    self = [super init];
+    if (self) {
+        _channels = channels;
+        _sampleRate = sampleRate;
+        for (int c = 0; c < channels; c++) {
+            _scratch[c] = av_malloc_array(METER_CHUNK_SAMPLES, sizeof(float));
+            if (!_scratch[c]) {
+                return nil;
+            }
+            _weight[c] = meter_channel_weight(c, channels);
+        }
+        meter_k_weighting(sampleRate, &_shelf, &_highpass);
+        _blockSamples = FFMAX((int)(sampleRate * METER_BLOCK_DURATION), 1);
+        atomic_init(&_seq, 0);
+        [self reset];
+    }
+    return self;
+}
+
+- (void)reset
+{
+    memset(_shelfState, 0, sizeof(_shelfState));
+    memset(_highpassState, 0, sizeof(_highpassState));
+    memset(_peak, 0, sizeof(_peak));
+    memset(_sumsq, 0, sizeof(_sumsq));
+    memset(_weightedSumsq, 0, sizeof(_weightedSumsq));
+    memset(_blockPower, 0, sizeof(_blockPower));
+    _blockFilled = 0;
+    _blocks = 0;
+    _samples = 0;
+    _nextPts = NAN;
+    
+    MRAudioMeterSnapshot empty = {0};
+    empty.channels = _channels;
+    empty.momentary = -INFINITY;
+    empty.shortTerm = -INFINITY;
+    empty.pts = NAN;
+    [self publish:&empty];
+}
+
+#pragma mark - 发布
+
+- (void)publish:(const MRAudioMeterSnapshot *)snapshot
+{
+    const uint32_t seq = atomic_load_explicit(&_seq, memory_order_relaxed);
+    atomic_store_explicit(&_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    _published = *snapshot;
+    atomic_store_explicit(&_seq, seq + 2, memory_order_release);
+}
+
+- (MRAudioMeterSnapshot)snapshot
+{
+    MRAudioMeterSnapshot result;
+    for (;;) {
+        const uint32_t begin = atomic_load_explicit(&_seq, memory_order_acquire);
+        if (begin & 1) {
+            continue;
+        }
+        result = _published;
+        atomic_thread_fence(memory_order_acquire);
+        //期间写过就重读
+        if (atomic_load_explicit(&_seq, memory_order_relaxed) == begin) {
+            break;
+        }
+    }
+    return result;
+}
+
+#pragma mark - 统计
+
+//一块 float 平面数据：峰值和平方和走 SIMD，K 加权滤波是递归的只能逐个采样
+- (void)accumulate:(float * const *)planes samples:(int)n
+{
+    for (int c = 0; c < _channels; c++) {
+        const float *src = planes[c];
+        float peak;
+        double sumsq;
+        [MRAudioKernels peakAndSumSquares:src count:n peak:&peak sumSquares:&sumsq];
+        _peak[c] = FFMAX(_peak[c], peak);
+        _sumsq[c] += sumsq;
+        
+        if (_weight[c] == 0) {
+            continue;
+        }
+        MRBiquadState *shelf = &_shelfState[c];
+        MRBiquadState *highpass = &_highpassState[c];
+        double weighted = 0;
+        for (int i = 0; i < n; i++) {
+            const double y = biquad_run(&_highpass, highpass, biquad_run(&_shelf, shelf, src[i]));
+            weighted += y * y;
+        }
+        _weightedSumsq[c] += weighted;
+    }
+}
+
+//100ms 满了，算出结果并发布
+- (void)finishBlock
+{
+    MRAudioMeterSnapshot snapshot = {0};
+    snapshot.channels = _channels;
+    double power = 0;
+    for (int c = 0; c < _channels; c++) {
+        snapshot.peak[c] = _peak[c];
+        snapshot.rms[c] = (float)sqrt(_sumsq[c] / _blockFilled);
+        power += _weight[c] * _weightedSumsq[c] / _blockFilled;
+    }
+    _blockPower[_blocks % METER_SHORT_TERM_BLOCKS] = power;
+    _blocks++;
+    
+    double momentary = 0, shortTerm = 0;
+    const int nbMomentary = (int)FFMIN(_blocks, METER_MOMENTARY_BLOCKS);
+    const int nbShortTerm = (int)FFMIN(_blocks, METER_SHORT_TERM_BLOCKS);
+    for (int i = 0; i < nbShortTerm; i++) {
+        const double p = _blockPower[(_blocks - 1 - i) % METER_SHORT_TERM_BLOCKS];
+        shortTerm += p;
+        if (i < nbMomentary) {
+            momentary += p;
+        }
+    }
+    snapshot.momentary = meter_loudness(momentary / nbMomentary);
+    snapshot.shortTerm = meter_loudness(shortTerm / nbShortTerm);
+    snapshot.samples = _samples;
+    snapshot.pts = _nextPts;
+    [self publish:&snapshot];
+    
+    _blockFilled = 0;
+    memset(_peak, 0, sizeof(_peak));
+    memset(_sumsq, 0, sizeof(_sumsq));
+    memset(_weightedSumsq, 0, sizeof(_weightedSumsq));
+}
+
+- (void)process:(uint8_t * const *)data format:(MRSampleFormat)format samples:(int)samples pts:(double)pts
+{
+    if (samples <= 0 || format == MR_SAMPLE_FMT_NONE) {
+        return;
+    }
+    const BOOL planar = MR_Sample_Fmt_Is_Planar(format);
+    const int bps = MR_Sample_Fmt_Is_FloatX(format) ? sizeof(float) : sizeof(int16_t);
+    uint8_t *src[MR_CH_LAYOUT_MAX_CHANNELS];
+    float *planes[MR_CH_LAYOUT_MAX_CHANNELS];
+    
+    int off = 0;
+    while (off < samples) {
+        //不跨越 100ms 的边界
+        const int n = FFMIN(FFMIN(samples - off, METER_CHUNK_SAMPLES), _blockSamples - _blockFilled);
+        if (format == MR_SAMPLE_FMT_FLTP) {
+            for (int c = 0; c < _channels; c++) {
+                planes[c] = (float *)data[c] + off;
+            }
+        } else {
+            for (int c = 0; c < (planar ? _channels : 1); c++) {
+                src[c] = data[c] + (size_t)off * bps * (planar ? 1 : _channels);
+            }
+            [MRAudioKernels convert:src format:format to:(uint8_t * const *)_scratch format:MR_SAMPLE_FMT_FLTP channels:_channels samples:n];
+            for (int c = 0; c < _channels; c++) {
+                planes[c] = _scratch[c];
+            }
+        }
+        [self accumulate:planes samples:n];
+        off += n;
+        _blockFilled += n;
+        _samples += n;
+        if (_blockFilled >= _blockSamples) {
+            _nextPts = isnan(pts) ? NAN : pts + (double)off / _sampleRate;
+            [self finishBlock];
+        }
+    }
+}
+
+@end
@@ -12,18 +12,23 @@
 
 typedef struct AVFrame AVFrame;
 
+//CVPixelBuffer 的行字节数按 64 对齐，解码器按这个对齐分配内存时可以零拷贝包装
+#define MR_PIXEL_BUFFER_ALIGNMENT 64
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface MRConvertUtil : NSObject
 
 /**
 AVFrame to CGImage，pixel fmt support [RGB555BE/RGB555LE/RGB24/ARGB/0RGB/RGBA/RGB0]
+注：引用计数的 frame 不拷贝像素，CGImage 持有 frame 的一份引用，释放时才归还.
 */
 + (CGImageRef _Nullable)cgImageFromRGBFrame:(AVFrame*)frame;
 
 /**
  AVFrame to CIImage，pixel fmt support [ARGB/0RGB/RGBA/RGB0/ABGR/0BGR/BGRA/BGR0]
  注：ABGR/0BGR form iOS 9 supported.
+ 注：引用计数的 frame 不拷贝像素，CIImage 持有 frame 的一份引用，释放时才归还.
  */
 + (CIImage* )ciImageFromRGB32orBGR32Frame:(AVFrame*)frame;
 
@@ -41,6 +46,24 @@ AVFrame to CVPixelBuffer，pixel fmt support [RGB24/ARGB/0RGB/BGRA/BGR0/NV12/NV2
 */
 + (CVPixelBufferRef _Nullable)pixelBufferFromAVFrame:(AVFrame*)frame opt:(CVPixelBufferPoolRef _Nullable)poolRef;
 
+/**
+ 是否可以零拷贝包装：frame 是引用计数的，每个平面的首地址和 linesize 都按 alignment 对齐，并且 CoreVideo 有对应的像素格式；
+ pixel fmt support [RGB24/ARGB/0RGB/BGRA/BGR0/NV12/NV16/YUV420P/UYVY422/YUYV422]，NV21 需要重排 UV、全范围的 UYVY422 没有对应的 CoreVideo 格式，不能包装.
+ */
++ (BOOL)canWrapAVFrame:(AVFrame*)frame alignment:(int)alignment;
+
+/**
+ AVFrame to CVPixelBuffer，不拷贝像素，直接引用 frame 的内存；内部持有 frame 的一份引用，CVPixelBuffer 释放时才归还.
+ 不满足 canWrapAVFrame:alignment: 时返回 NULL.
+ 注：包装出来的 CVPixelBuffer 不是 IOSurface，不能用 CVOpenGLESTextureCache / CVMetalTextureCache 创建纹理.
+ */
++ (CVPixelBufferRef _Nullable)pixelBufferByWrappingAVFrame:(AVFrame*)frame alignment:(int)alignment;
+
+/**
+ zeroCopy 为 YES 时优先零拷贝包装，条件不满足时回退到拷贝.
+ */
++ (CVPixelBufferRef _Nullable)pixelBufferFromAVFrame:(AVFrame*)frame opt:(CVPixelBufferPoolRef _Nullable)poolRef zeroCopy:(BOOL)zeroCopy;
+
 + (CMSampleBufferRef)cmSampleBufferRefFromCVPixelBufferRef:(CVPixelBufferRef)pixelBuffer;
 
 #if TARGET_OS_IOS
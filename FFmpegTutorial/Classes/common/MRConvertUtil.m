@@ -8,6 +8,9 @@
 #import "MRConvertUtil.h"
 #import <libavutil/frame.h>
 #import <libavutil/imgutils.h>
+#import <libavutil/pixdesc.h>
+#import "MRPixelKernels.h"
+#import "MRPatternGenerator.h"
 
 #if TARGET_OS_IOS
 #import <OpenGLES/ES1/glext.h>
@@ -53,14 +56,38 @@ CGImageRef _CreateCGImageFromBitMap(void *pixels, size_t w, size_t h, size_t bpc
     return NULL;
 }
 
-CGImageRef _CreateCGImage(void *pixels,size_t w, size_t h, size_t bpc, size_t bpp, size_t bpr, int bmi)
+//CGImage 释放时归还 frame 的引用
+static void _ReleaseWrappedFrame(void *info, const void *data, size_t size)
 {
-    const UInt8 *rgb = pixels;
-    const CFIndex length = bpr * h;
-    
-    CFDataRef data = CFDataCreate(kCFAllocatorDefault, rgb, length);
+    AVFrame *frame = (AVFrame *)info;
+    av_frame_free(&frame);
+}
+
+//引用计数的帧直接引用像素内存，否则拷贝一份
+static CGDataProviderRef _CreateDataProvider(AVFrame *frame, const size_t length)
+{
+    if (frame->buf[0]) {
+        AVFrame *ref = av_frame_clone(frame);
+        if (ref) {
+            CGDataProviderRef provider = CGDataProviderCreateWithData(ref, ref->data[0], length, _ReleaseWrappedFrame);
+            if (!provider) {
+                av_frame_free(&ref);
+            }
+            return provider;
+        }
+    }
+    CFDataRef data = CFDataCreate(kCFAllocatorDefault, frame->data[0], length);
     CGDataProviderRef provider = CGDataProviderCreateWithCFData(data);
     CFRelease(data);
+    return provider;
+}
+
+CGImageRef _CreateCGImage(AVFrame *frame, size_t bpc, size_t bpp, int bmi)
+{
+    const size_t w = frame->width;
+    const size_t h = frame->height;
+    const size_t bpr = frame->linesize[0];
+    CGDataProviderRef provider = _CreateDataProvider(frame, bpr * h);
     
     if (provider) {
         CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
@@ -132,14 +159,10 @@ CGImageRef _CreateCGImage(void *pixels,size_t w, size_t h, size_t bpc, size_t bp
         return NULL;
     }
     
-    void *pixels = frame->data[0];
-    const int w  = frame->width;
-    const int h  = frame->height;
-    const size_t bpr = frame->linesize[0];
-    
-    return _CreateCGImage(pixels, w, h, bpc, bpp, bpr, bitMapInfo);
+    //引用计数的帧不拷贝像素，CGImage 释放时才归还 frame
+    return _CreateCGImage(frame, bpc, bpp, bitMapInfo);
     //not support bpp = 24;
-    return _CreateCGImageFromBitMap(pixels, w, h, bpc, bpp, bpr, bitMapInfo);
+    //return _CreateCGImageFromBitMap(frame->data[0], frame->width, frame->height, bpc, bpp, frame->linesize[0], bitMapInfo);
 }
 
 + (CIImage *)ciImageFromRGB32orBGR32Frame:(AVFrame *)frame
@@ -169,16 +192,26 @@ CGImageRef _CreateCGImage(void *pixels,size_t w, size_t h, size_t bpc, size_t bp
     const size_t bpr = frame->linesize[0];
     const int w = frame->width;
     const int h = frame->height;
-    const UInt8 *rgb = pixels;
     const CFIndex length = bpr * h;
     CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    NSData *data = [NSData dataWithBytes:rgb length:length];
+    NSData *data = nil;
+    AVFrame *ref = frame->buf[0] ? av_frame_clone(frame) : NULL;
+    if (ref) {
+        //引用计数的帧不拷贝像素，NSData 释放时才归还 frame
+        data = [[NSData alloc] initWithBytesNoCopy:pixels length:length deallocator:^(void * _Nonnull bytes, NSUInteger len) {
+            AVFrame *f = ref;
+            av_frame_free(&f);
+        }];
+    } else {
+        data = [NSData dataWithBytes:pixels length:length];
+    }
     
     CIImage *ciImage = [[CIImage alloc] initWithBitmapData:data
                                                bytesPerRow:bpr
                                                       size:CGSizeMake(w, h)
                                                     format:ciFmt
                                                 colorSpace:colorSpace];
+    CGColorSpaceRelease(colorSpace);
     return ciImage;
 }
 
@@ -295,7 +328,12 @@ CGImageRef _CreateCGImage(void *pixels,size_t w, size_t h, size_t bpc, size_t bp
             int dst_linesize = (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, p);
             int height = (int)CVPixelBufferGetHeightOfPlane(pixelBuffer, p);
             int bytewidth = MIN(src_linesize, dst_linesize);
-            av_image_copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+            if (format == AV_PIX_FMT_NV21 && p == 1) {
+                //CVPixelBuffer 是 NV12，拷贝的同时交换 VU 顺序，不修改 frame 本身
+                [MRPixelKernels swapUVPlane:dst dstLinesize:dst_linesize src:src srcLinesize:src_linesize widthBytes:(w + 1) / 2 * 2 height:height];
+            } else {
+                av_image_copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+            }
             CVPixelBufferUnlockBaseAddress(pixelBuffer, p);
             /**
              kCVReturnInvalidPixelFormat
@@ -338,6 +376,150 @@ CGImageRef _CreateCGImage(void *pixels,size_t w, size_t h, size_t bpc, size_t bp
     }
 }
 
+//零拷贝包装支持的像素格式，和 CoreVideo 的内存布局完全一致
+static OSType mr_wrappable_pixel_format(int format, bool fullRange)
+{
+    switch (format) {
+        case AV_PIX_FMT_RGB24:
+            return kCVPixelFormatType_24RGB;
+        case AV_PIX_FMT_ARGB:
+        case AV_PIX_FMT_0RGB:
+            return kCVPixelFormatType_32ARGB;
+        case AV_PIX_FMT_BGRA:
+        case AV_PIX_FMT_BGR0:
+            return kCVPixelFormatType_32BGRA;
+        case AV_PIX_FMT_NV12:
+            return fullRange ? kCVPixelFormatType_420YpCbCr8BiPlanarFullRange : kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+        case AV_PIX_FMT_NV16:
+            return fullRange ? kCVPixelFormatType_422YpCbCr8BiPlanarFullRange : kCVPixelFormatType_422YpCbCr8BiPlanarVideoRange;
+        case AV_PIX_FMT_YUV420P:
+            return fullRange ? kCVPixelFormatType_420YpCbCr8PlanarFullRange : kCVPixelFormatType_420YpCbCr8Planar;
+        case AV_PIX_FMT_UYVY422:
+            //'yuvf' 是 YUYV 字节顺序，CoreVideo 没有全范围的 UYVY 格式，不能直接包装
+            return fullRange ? 0 : kCVPixelFormatType_422YpCbCr8;
+        case AV_PIX_FMT_YUYV422:
+            return kCVPixelFormatType_422YpCbCr8_yuvs;
+        default:
+            return 0;
+    }
+}
+
+//CVPixelBuffer 释放时归还 frame 的引用
+static void mr_release_wrapped_planar_frame(void *releaseRefCon, const void *dataPtr, size_t dataSize, size_t numberOfPlanes, const void *planeAddresses[])
+{
+    AVFrame *frame = (AVFrame *)releaseRefCon;
+    av_frame_free(&frame);
+}
+
+static void mr_release_wrapped_packed_frame(void *releaseRefCon, const void *baseAddress)
+{
+    AVFrame *frame = (AVFrame *)releaseRefCon;
+    av_frame_free(&frame);
+}
+
++ (BOOL)canWrapAVFrame:(AVFrame *)frame alignment:(int)alignment
+{
+    //非引用计数的帧，无法保证 CVPixelBuffer 使用期间内存有效
+    if (NULL == frame || NULL == frame->buf[0]) {
+        return NO;
+    }
+    if (0 == mr_wrappable_pixel_format(frame->format, frame->color_range != AVCOL_RANGE_MPEG)) {
+        return NO;
+    }
+    if (alignment <= 0) {
+        alignment = 1;
+    }
+    const int planes = av_pix_fmt_count_planes(frame->format);
+    for (int p = 0; p < planes; p++) {
+        //负的 linesize 表示倒序存储，CoreVideo 不支持
+        if (NULL == frame->data[p] || frame->linesize[p] <= 0) {
+            return NO;
+        }
+        if (frame->linesize[p] % alignment || (uintptr_t)frame->data[p] % alignment) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
++ (CVPixelBufferRef _Nullable)pixelBufferByWrappingAVFrame:(AVFrame *)frame alignment:(int)alignment
+{
+    if (![self canWrapAVFrame:frame alignment:alignment]) {
+        return NULL;
+    }
+    const OSType pixelFormatType = mr_wrappable_pixel_format(frame->format, frame->color_range != AVCOL_RANGE_MPEG);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int planes = av_pix_fmt_count_planes(frame->format);
+    //只增加引用计数，不拷贝像素；由 CVPixelBuffer 的释放回调归还
+    AVFrame *ref = av_frame_clone(frame);
+    if (NULL == ref) {
+        return NULL;
+    }
+    
+    CVPixelBufferRef pixelBuffer = NULL;
+    CVReturn result = kCVReturnError;
+    if (planes > 1) {
+        void *planeBaseAddress[3] = {0};
+        size_t planeWidth[3] = {0};
+        size_t planeHeight[3] = {0};
+        size_t planeBytesPerRow[3] = {0};
+        for (int p = 0; p < planes; p++) {
+            const BOOL chroma = p > 0;
+            planeBaseAddress[p] = ref->data[p];
+            planeWidth[p] = chroma ? AV_CEIL_RSHIFT(ref->width, desc->log2_chroma_w) : ref->width;
+            planeHeight[p] = chroma ? AV_CEIL_RSHIFT(ref->height, desc->log2_chroma_h) : ref->height;
+            planeBytesPerRow[p] = ref->linesize[p];
+        }
+        result = CVPixelBufferCreateWithPlanarBytes(kCFAllocatorDefault,
+                                                    ref->width,
+                                                    ref->height,
+                                                    pixelFormatType,
+                                                    NULL,
+                                                    0,
+                                                    planes,
+                                                    planeBaseAddress,
+                                                    planeWidth,
+                                                    planeHeight,
+                                                    planeBytesPerRow,
+                                                    mr_release_wrapped_planar_frame,
+                                                    ref,
+                                                    NULL,
+                                                    &pixelBuffer);
+    } else {
+        result = CVPixelBufferCreateWithBytes(kCFAllocatorDefault,
+                                              ref->width,
+                                              ref->height,
+                                              pixelFormatType,
+                                              ref->data[0],
+                                              ref->linesize[0],
+                                              mr_release_wrapped_packed_frame,
+                                              ref,
+                                              NULL,
+                                              &pixelBuffer);
+    }
+    
+    if (kCVReturnSuccess == result) {
+        return (CVPixelBufferRef)CFAutorelease(pixelBuffer);
+    } else {
+        //创建失败时不会调用释放回调
+        av_frame_free(&ref);
+        return NULL;
+    }
+}
+
++ (CVPixelBufferRef _Nullable)pixelBufferFromAVFrame:(AVFrame *)frame
+                                                 opt:(CVPixelBufferPoolRef)poolRef
+                                            zeroCopy:(BOOL)zeroCopy
+{
+    if (zeroCopy) {
+        CVPixelBufferRef pixelBuffer = [self pixelBufferByWrappingAVFrame:frame alignment:MR_PIXEL_BUFFER_ALIGNMENT];
+        if (pixelBuffer) {
+            return pixelBuffer;
+        }
+    }
+    return [self pixelBufferFromAVFrame:frame opt:poolRef];
+}
+
 + (CMSampleBufferRef)cmSampleBufferRefFromCVPixelBufferRef:(CVPixelBufferRef)pixelBuffer
 {
     if (pixelBuffer) {
@@ -653,11 +835,8 @@ static inline const char * GetGLErrorString(GLenum error)
         
         //luma=[0,255] chroma=[1,255]
         
-        for (int i = 0; i < y_bytesPerRow * h; i ++) {
-            unsigned char *dest = yDestPlane + i;
-            size_t luma = arc4random()%256;
-            memset(dest, luma, 1);
-        }
+        //每帧取一次随机种子，整帧用 SIMD 生成，不再每个字节调用一次 arc4random
+        [MRPatternGenerator fillNoise:yDestPlane linesize:(int)y_bytesPerRow width:w height:h seed:arc4random()];
         
         unsigned char *uvDestPlane = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
         
@@ -689,40 +868,6 @@ static inline const char * GetGLErrorString(GLenum error)
     return (CVPixelBufferRef)CFAutorelease(pixelBuffer);
 }
 
-
-/// 填充灰色色阶
-/// @param bytesPerRow 每行多少个字节/像素
-/// @param y luma 分量内存指针
-/// @param uv chroma 分量内存指针
-/// @param w 渲染视图宽度
-/// @param h 渲染视图高度
-static void fillGrayBar(size_t bytesPerRow,unsigned char *y,unsigned char *uv,int w,int h)
-{
-    int barnum = 6;
-    int color_b = 0;
-    int color_w = 255;
-    int deltaC = (color_w - color_b)/barnum;
-    
-    int bytePerBar = w/barnum;
-    
-    unsigned char *y_dest = y;
-    //按行遍历
-    for (int i = 0; i < h; i ++) {
-        //每行分为barnum各块
-        for (int j = 0; j < barnum; j++) {
-            int luma = color_b + deltaC * j;
-            size_t size = bytePerBar;
-            if(j == barnum-1){
-                size = bytesPerRow - (barnum-1)*bytePerBar;
-            }
-            memset(y_dest, luma, size);
-            y_dest += size;
-        }
-    }
-    
-    memset(uv, 128, BYTE_ALIGN_2(h)/2 * bytesPerRow);
-}
-
 + (CVPixelBufferRef)grayColorBarPixelBuffer:(int)w h:(int)h opt:(CVPixelBufferPoolRef)poolRef
 {
     CVPixelBufferRef pixelBuffer = NULL;
@@ -746,8 +891,10 @@ static void fillGrayBar(size_t bytesPerRow,unsigned char *y,unsigned char *uv,in
         unsigned char *yDestPlane = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
         unsigned char *uvDestPlane = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
         size_t y_bytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+        size_t uv_bytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
         
-        fillGrayBar(y_bytesPerRow,yDestPlane,uvDestPlane,w,h);
+        [MRPatternGenerator fillGrayBar:yDestPlane linesize:(int)y_bytesPerRow width:w height:h bars:6];
+        memset(uvDestPlane, 128, BYTE_ALIGN_2(h)/2 * uv_bytesPerRow);
         
         CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
     }
@@ -0,0 +1,62 @@
+//
+//  MRPatternGenerator.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 测试画面生成器：雪花屏、灰阶、移动的渐变，可以叠加时间码
+// 雪花屏使用基于计数器的 xorshift 随机数，8 路并行，每次 SIMD 存储填满 32 字节；
+// 每行的随机数种子由帧序号和行号算出，同样的种子生成的画面完全一样，和指令集无关。
+// 不依赖媒体文件，可以按任意分辨率和帧率给渲染或后续流程压测。
+
+#import <Foundation/Foundation.h>
+#import <CoreVideo/CVPixelBuffer.h>
+#import <CoreVideo/CVPixelBufferPool.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct AVFrame AVFrame;
+
+typedef NS_ENUM(NSUInteger, MRPatternType) {
+    //黑白电视机雪花屏
+    MRPatternSnow,
+    //黑白色阶图
+    MRPatternGrayBar,
+    //随时间移动的斜向渐变
+    MRPatternGradient,
+};
+
+@interface MRPatternGenerator : NSObject
+
+@property (nonatomic, assign) MRPatternType type;
+@property (nonatomic, assign, readonly) int width;
+@property (nonatomic, assign, readonly) int height;
+///帧率，用于计算时间码和渐变移动速度；默认 25
+@property (nonatomic, assign) double fps;
+///随机数种子，相同种子生成的雪花屏序列相同；默认 0
+@property (nonatomic, assign) uint32_t seed;
+///是否在左上角叠加时间码 HH:MM:SS:FF；默认 NO
+@property (nonatomic, assign) BOOL burnInTimecode;
+///下一帧的序号
+@property (nonatomic, assign) int64_t frameIndex;
+
+- (instancetype)initWithType:(MRPatternType)type width:(int)width height:(int)height;
+
+///生成下一帧，格式为 NV12 full range
+- (CVPixelBufferRef _Nullable)nextPixelBuffer:(CVPixelBufferPoolRef _Nullable)poolRef;
+///生成下一帧到 frame 里，frame 需要已分配好内存，支持 NV12/NV21/YUV420P/YUVJ420P
+- (BOOL)fillFrame:(AVFrame *)frame;
+
+///雪花屏使用的指令集：AVX2、SSE2、NEON 或 C
++ (NSString *)activeISA;
+
+///用随机数填充一个平面
++ (void)fillNoise:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height seed:(uint32_t)seed;
+///填充灰阶：luma 平面分为 bars 个竖条，从黑到白
++ (void)fillGrayBar:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height bars:(int)bars;
+///填充斜向渐变：第 y 行第 x 列的亮度为 (offset + x + y) % 256
++ (void)fillGradient:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height offset:(int)offset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,465 @@
+//
+//  MRPatternGenerator.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "MRPatternGenerator.h"
+#import <libavutil/frame.h>
+#import <libavutil/pixfmt.h>
+#import <libavutil/cpu.h>
+#import <libavutil/common.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MR_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+//随机数的路数，每一步输出 8 个 uint32 即 32 字节
+#define MR_NOISE_LANES 8
+//超过这个高度时雪花屏按条带并行生成
+#define MR_NOISE_PARALLEL_HEIGHT 480
+#define MR_NOISE_BAND_ROWS 64
+
+//用随机数填充 n 个字节
+typedef void (*mr_noise_row_func)(uint8_t *dst, int n, uint32_t seed);
+//dst[x] = offset + x
+typedef void (*mr_ramp_row_func)(uint8_t *dst, int n, uint8_t offset);
+
+typedef struct MRPatternKernelFuncs {
+    const char *name;
+    mr_noise_row_func noise_row;
+    mr_ramp_row_func ramp_row;
+} MRPatternKernelFuncs;
+
+//整数哈希（lowbias32），由计数器得到互不相关的种子
+static inline uint32_t mr_hash32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+//xorshift 的状态不能为 0
+static inline void mr_noise_seed(uint32_t s[MR_NOISE_LANES], uint32_t seed)
+{
+    for (int l = 0; l < MR_NOISE_LANES; l++) {
+        s[l] = mr_hash32(seed ^ (0x9E3779B9U * (l + 1)));
+        if (s[l] == 0) {
+            s[l] = 0x6d2b79f5U;
+        }
+    }
+}
+
+#pragma mark - C
+
+static void mr_noise_row_c(uint8_t *dst, int n, uint32_t seed)
+{
+    uint32_t s[MR_NOISE_LANES];
+    mr_noise_seed(s, seed);
+    int i = 0;
+    while (i < n) {
+        for (int l = 0; l < MR_NOISE_LANES; l++) {
+            uint32_t x = s[l];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            s[l] = x;
+        }
+        //和 SIMD 存储的字节序一致（小端）
+        const int c = FFMIN(MR_NOISE_LANES * 4, n - i);
+        memcpy(dst + i, s, c);
+        i += c;
+    }
+}
+
+static void mr_ramp_row_c(uint8_t *dst, int n, uint8_t offset)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = (uint8_t)(offset + i);
+    }
+}
+
+#pragma mark - SSE2/AVX2
+
+#if MR_HAVE_X86
+
+#define MR_XORSHIFT_SSE2(v) do {                    \
+    v = _mm_xor_si128(v, _mm_slli_epi32(v, 13));    \
+    v = _mm_xor_si128(v, _mm_srli_epi32(v, 17));    \
+    v = _mm_xor_si128(v, _mm_slli_epi32(v, 5));     \
+} while (0)
+
+__attribute__((target("sse2")))
+static void mr_noise_row_sse2(uint8_t *dst, int n, uint32_t seed)
+{
+    uint32_t s[MR_NOISE_LANES];
+    mr_noise_seed(s, seed);
+    __m128i a = _mm_loadu_si128((const __m128i *)s);
+    __m128i b = _mm_loadu_si128((const __m128i *)(s + 4));
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        MR_XORSHIFT_SSE2(a);
+        MR_XORSHIFT_SSE2(b);
+        _mm_storeu_si128((__m128i *)(dst + i), a);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), b);
+    }
+    if (i < n) {
+        uint8_t tail[32];
+        MR_XORSHIFT_SSE2(a);
+        MR_XORSHIFT_SSE2(b);
+        _mm_storeu_si128((__m128i *)tail, a);
+        _mm_storeu_si128((__m128i *)(tail + 16), b);
+        memcpy(dst + i, tail, n - i);
+    }
+}
+
+__attribute__((target("sse2")))
+static void mr_ramp_row_sse2(uint8_t *dst, int n, uint8_t offset)
+{
+    const __m128i step = _mm_set1_epi8(16);
+    __m128i v = _mm_add_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm_set1_epi8((char)offset));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+        v = _mm_add_epi8(v, step);
+    }
+    mr_ramp_row_c(dst + i, n - i, (uint8_t)(offset + i));
+}
+
+#define MR_XORSHIFT_AVX2(v) do {                          \
+    v = _mm256_xor_si256(v, _mm256_slli_epi32(v, 13));    \
+    v = _mm256_xor_si256(v, _mm256_srli_epi32(v, 17));    \
+    v = _mm256_xor_si256(v, _mm256_slli_epi32(v, 5));     \
+} while (0)
+
+__attribute__((target("avx2")))
+static void mr_noise_row_avx2(uint8_t *dst, int n, uint32_t seed)
+{
+    uint32_t s[MR_NOISE_LANES];
+    mr_noise_seed(s, seed);
+    __m256i v = _mm256_loadu_si256((const __m256i *)s);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        MR_XORSHIFT_AVX2(v);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    if (i < n) {
+        uint8_t tail[32];
+        MR_XORSHIFT_AVX2(v);
+        _mm256_storeu_si256((__m256i *)tail, v);
+        memcpy(dst + i, tail, n - i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void mr_ramp_row_avx2(uint8_t *dst, int n, uint8_t offset)
+{
+    const __m256i step = _mm256_set1_epi8(32);
+    __m256i v = _mm256_add_epi8(_mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                                 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31),
+                                _mm256_set1_epi8((char)offset));
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+        v = _mm256_add_epi8(v, step);
+    }
+    mr_ramp_row_c(dst + i, n - i, (uint8_t)(offset + i));
+}
+
+#endif
+
+#pragma mark - NEON
+
+#if MR_HAVE_NEON
+
+#define MR_XORSHIFT_NEON(v) do {                \
+    v = veorq_u32(v, vshlq_n_u32(v, 13));       \
+    v = veorq_u32(v, vshrq_n_u32(v, 17));       \
+    v = veorq_u32(v, vshlq_n_u32(v, 5));        \
+} while (0)
+
+static void mr_noise_row_neon(uint8_t *dst, int n, uint32_t seed)
+{
+    uint32_t s[MR_NOISE_LANES];
+    mr_noise_seed(s, seed);
+    uint32x4_t a = vld1q_u32(s);
+    uint32x4_t b = vld1q_u32(s + 4);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        MR_XORSHIFT_NEON(a);
+        MR_XORSHIFT_NEON(b);
+        vst1q_u8(dst + i, vreinterpretq_u8_u32(a));
+        vst1q_u8(dst + i + 16, vreinterpretq_u8_u32(b));
+    }
+    if (i < n) {
+        uint8_t tail[32];
+        MR_XORSHIFT_NEON(a);
+        MR_XORSHIFT_NEON(b);
+        vst1q_u8(tail, vreinterpretq_u8_u32(a));
+        vst1q_u8(tail + 16, vreinterpretq_u8_u32(b));
+        memcpy(dst + i, tail, n - i);
+    }
+}
+
+static void mr_ramp_row_neon(uint8_t *dst, int n, uint8_t offset)
+{
+    static const uint8_t base[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const uint8x16_t step = vdupq_n_u8(16);
+    uint8x16_t v = vaddq_u8(vld1q_u8(base), vdupq_n_u8(offset));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, v);
+        v = vaddq_u8(v, step);
+    }
+    mr_ramp_row_c(dst + i, n - i, (uint8_t)(offset + i));
+}
+
+#endif
+
+#pragma mark - 运行时选择
+
+static const MRPatternKernelFuncs mr_pattern_kernels_c = {"C", mr_noise_row_c, mr_ramp_row_c};
+#if MR_HAVE_X86
+static const MRPatternKernelFuncs mr_pattern_kernels_sse2 = {"SSE2", mr_noise_row_sse2, mr_ramp_row_sse2};
+static const MRPatternKernelFuncs mr_pattern_kernels_avx2 = {"AVX2", mr_noise_row_avx2, mr_ramp_row_avx2};
+#endif
+#if MR_HAVE_NEON
+static const MRPatternKernelFuncs mr_pattern_kernels_neon = {"NEON", mr_noise_row_neon, mr_ramp_row_neon};
+#endif
+
+static const MRPatternKernelFuncs * mr_best_pattern_kernels(void)
+{
+    static const MRPatternKernelFuncs *best = &mr_pattern_kernels_c;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        const int flags = av_get_cpu_flags();
+#if MR_HAVE_X86
+        if (flags & AV_CPU_FLAG_SSE2) {
+            best = &mr_pattern_kernels_sse2;
+        }
+        if (flags & AV_CPU_FLAG_AVX2) {
+            best = &mr_pattern_kernels_avx2;
+        }
+#endif
+#if MR_HAVE_NEON
+        if (flags & AV_CPU_FLAG_NEON) {
+            best = &mr_pattern_kernels_neon;
+        }
+#endif
+        (void)flags;
+    });
+    return best;
+}
+
+#pragma mark - 时间码
+
+//3x5 点阵字体，每行 3 位，高位在左；0-9 和冒号
+static const uint8_t mr_timecode_font[11][5] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+    {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7},
+    {0, 2, 0, 2, 0},
+};
+
+//在 luma 平面左上角画黑底白字的时间码
+static void mr_draw_timecode(uint8_t *y, int linesize, int width, int height, const char *text)
+{
+    const int len = (int)strlen(text);
+    const int scale = FFMAX(2, height / 90);
+    //每个字 3 列加 1 列间隔，四周留 1 个点的边
+    const int boxW = FFMIN((len * 4 + 1) * scale, width);
+    const int boxH = FFMIN(7 * scale, height);
+    for (int r = 0; r < boxH; r++) {
+        memset(y + r * linesize, 0, boxW);
+    }
+    for (int c = 0; c < len; c++) {
+        const int glyph = text[c] == ':' ? 10 : text[c] - '0';
+        if (glyph < 0 || glyph > 10) {
+            continue;
+        }
+        const int x0 = (1 + c * 4) * scale;
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                if (!(mr_timecode_font[glyph][row] & (4 >> col))) {
+                    continue;
+                }
+                const int x = x0 + col * scale;
+                const int y0 = (1 + row) * scale;
+                if (x + scale > boxW || y0 + scale > boxH) {
+                    continue;
+                }
+                for (int k = 0; k < scale; k++) {
+                    memset(y + (y0 + k) * linesize + x, 255, scale);
+                }
+            }
+        }
+    }
+}
+
+@implementation MRPatternGenerator
+
+- (instancetype)initWithType:(MRPatternType)type width:(int)width height:(int)height
+{
+    self = [super init];
+    if (self) {
+        _type = type;
+        _width = width;
+        _height = height;
+        _fps = 25;
+    }
+    return self;
+}
+
++ (NSString *)activeISA
+{
+    return [NSString stringWithUTF8String:mr_best_pattern_kernels()->name];
+}
+
++ (void)fillNoise:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height seed:(uint32_t)seed
+{
+    const mr_noise_row_func noise_row = mr_best_pattern_kernels()->noise_row;
+    //每行的种子只和行号有关，条带之间互不依赖
+    if (height >= MR_NOISE_PARALLEL_HEIGHT) {
+        const size_t bands = (height + MR_NOISE_BAND_ROWS - 1) / MR_NOISE_BAND_ROWS;
+        dispatch_apply(bands, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t band) {
+            const int begin = (int)band * MR_NOISE_BAND_ROWS;
+            const int end = FFMIN(begin + MR_NOISE_BAND_ROWS, height);
+            for (int r = begin; r < end; r++) {
+                noise_row(dst + (size_t)r * linesize, width, mr_hash32(seed + 0x9E3779B9U * r));
+            }
+        });
+    } else {
+        for (int r = 0; r < height; r++) {
+            noise_row(dst + (size_t)r * linesize, width, mr_hash32(seed + 0x9E3779B9U * r));
+        }
+    }
+}
+
++ (void)fillGrayBar:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height bars:(int)bars
+{
+    if (height <= 0) {
+        return;
+    }
+    bars = FFMAX(bars, 1);
+    const int deltaC = bars > 1 ? 255 / (bars - 1) : 0;
+    const int barWidth = width / bars;
+    //先画好第一行，其余行直接拷贝
+    for (int j = 0; j < bars; j++) {
+        const int x = j * barWidth;
+        const int size = j == bars - 1 ? width - x : barWidth;
+        memset(dst + x, FFMIN(deltaC * j, 255), size);
+    }
+    for (int r = 1; r < height; r++) {
+        memcpy(dst + (size_t)r * linesize, dst, width);
+    }
+}
+
++ (void)fillGradient:(uint8_t *)dst linesize:(int)linesize width:(int)width height:(int)height offset:(int)offset
+{
+    const mr_ramp_row_func ramp_row = mr_best_pattern_kernels()->ramp_row;
+    for (int r = 0; r < height; r++) {
+        ramp_row(dst + (size_t)r * linesize, width, (uint8_t)(offset + r));
+    }
+}
+
+//按类型填充 luma，然后叠加时间码
+- (void)fillLuma:(uint8_t *)y linesize:(int)linesize
+{
+    const int64_t idx = self.frameIndex;
+    switch (self.type) {
+        case MRPatternSnow:
+            [MRPatternGenerator fillNoise:y linesize:linesize width:self.width height:self.height seed:mr_hash32(self.seed ^ (uint32_t)idx) ^ (uint32_t)(idx >> 32)];
+            break;
+        case MRPatternGrayBar:
+            [MRPatternGenerator fillGrayBar:y linesize:linesize width:self.width height:self.height bars:6];
+            break;
+        case MRPatternGradient:
+            //每秒移动 64 个像素
+            [MRPatternGenerator fillGradient:y linesize:linesize width:self.width height:self.height offset:-(int)(idx * 64 / FFMAX(self.fps, 1))];
+            break;
+    }
+
+    if (self.burnInTimecode) {
+        const int fps = FFMAX((int)lrint(self.fps), 1);
+        const int64_t secs = idx / fps;
+        char text[32];
+        snprintf(text, sizeof(text), "%02d:%02d:%02d:%02d", (int)(secs / 3600 % 100), (int)(secs / 60 % 60), (int)(secs % 60), (int)(idx % fps));
+        mr_draw_timecode(y, linesize, self.width, self.height, text);
+    }
+    self.frameIndex = idx + 1;
+}
+
+- (CVPixelBufferRef _Nullable)nextPixelBuffer:(CVPixelBufferPoolRef _Nullable)poolRef
+{
+    CVPixelBufferRef pixelBuffer = NULL;
+    CVReturn result = kCVReturnError;
+
+    if (poolRef) {
+        result = CVPixelBufferPoolCreatePixelBuffer(NULL, poolRef, &pixelBuffer);
+    } else {
+        NSDictionary *pixelAttributes = @{(NSString*)kCVPixelBufferIOSurfacePropertiesKey:@{}};
+
+        result = CVPixelBufferCreate(kCFAllocatorDefault,
+                                     self.width,
+                                     self.height,
+                                     kCVPixelFormatType_420YpCbCr8BiPlanarFullRange,
+                                     (__bridge CFDictionaryRef)(pixelAttributes),
+                                     &pixelBuffer);
+    }
+
+    if (kCVReturnSuccess != result) {
+        return NULL;
+    }
+
+    CVPixelBufferLockBaseAddress(pixelBuffer, 0);
+    uint8_t *y = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+    const int y_linesize = (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+    uint8_t *uv = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
+    const size_t uv_linesize = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
+
+    [self fillLuma:y linesize:y_linesize];
+    //都是灰度画面，chroma 取中间值；奇数高度时 UV 要多一行
+    memset(uv, 128, (self.height + 1) / 2 * uv_linesize);
+
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+    return (CVPixelBufferRef)CFAutorelease(pixelBuffer);
+}
+
+- (BOOL)fillFrame:(AVFrame *)frame
+{
+    if (!frame->data[0] || frame->width < self.width || frame->height < self.height) {
+        return NO;
+    }
+    const int chromaH = (self.height + 1) / 2;
+    switch (frame->format) {
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+            [self fillLuma:frame->data[0] linesize:frame->linesize[0]];
+            for (int r = 0; r < chromaH; r++) {
+                memset(frame->data[1] + r * frame->linesize[1], 128, (self.width + 1) / 2 * 2);
+            }
+            return YES;
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            [self fillLuma:frame->data[0] linesize:frame->linesize[0]];
+            for (int p = 1; p < 3; p++) {
+                for (int r = 0; r < chromaH; r++) {
+                    memset(frame->data[p] + r * frame->linesize[p], 128, (self.width + 1) / 2);
+                }
+            }
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+@end
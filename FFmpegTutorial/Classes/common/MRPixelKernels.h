@@ -0,0 +1,58 @@
+//
+//  MRPixelKernels.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 常见 YUV 重排的 SIMD 快速路径
+// NV12/NV21 只是 UV 顺序不同，YUV420P 转 NV12 只需交织 U、V 平面，UYVY/YUYV 转 NV16/YUV422P 只需拆分字节；
+// 这些转换不涉及任何计算，走 swscale 的通用流程不划算。
+// 每个内核都有 C、SSE2、AVX2、NEON 实现，运行时按 CPU 特性选择，结果和 swscale 逐字节一致。
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct AVFrame AVFrame;
+
+@interface MRPixelKernels : NSObject
+
+///当前使用的指令集：AVX2、SSE2、NEON 或 C
++ (NSString *)activeISA;
+
+/// 是否有 src→dst 的快速路径
+/// 支持 NV12↔NV21、YUV420P→NV12/NV21、UYVY422/YUYV422→NV16/YUV422P
+/// @param src 原帧像素格式（AVPixelFormat）
+/// @param dst 目标帧像素格式（AVPixelFormat）
++ (BOOL)canConvertFrom:(int)src to:(int)dst;
+
+/// 整帧转换，宽高不变
+/// @param inF 原帧
+/// @param outF 目标帧，需要已分配好内存，format 为目标像素格式
++ (BOOL)convertFrame:(AVFrame *)inF to:(AVFrame *)outF;
+
+///当前 CPU 能用的全部指令集，从慢到快
++ (NSArray<NSString *> *)availableISAs;
+
+/// 用指定指令集的实现整帧转换，用于逐个校验各指令集的实现
+/// @param isa availableISAs 里的一个
++ (BOOL)convertFrame:(AVFrame *)inF to:(AVFrame *)outF isa:(NSString *)isa;
+
+/// 交换 UV 平面里每对字节的顺序，用于 NV21 和 NV12 互转，可以原地转换
+/// @param widthBytes 每行有效的字节数
++ (void)swapUVPlane:(uint8_t *)dst
+        dstLinesize:(int)dstLinesize
+                src:(const uint8_t *)src
+        srcLinesize:(int)srcLinesize
+         widthBytes:(int)widthBytes
+             height:(int)height;
+
+/// 对每个支持的格式对，分别用各指令集的实现和 swscale 转换 frames 帧，
+/// 校验结果是否和 swscale 逐字节一致，并给出耗时对比
++ (NSString *)benchmarkWithWidth:(int)width
+                          height:(int)height
+                          frames:(int)frames;
+
+@end
+
+NS_ASSUME_NONNULL_END
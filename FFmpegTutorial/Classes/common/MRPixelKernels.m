@@ -0,0 +1,511 @@
+//
+//  MRPixelKernels.m
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+
+#import "MRPixelKernels.h"
+#import <libavutil/frame.h>
+#import <libavutil/imgutils.h>
+#import <libavutil/pixdesc.h>
+#import <libavutil/cpu.h>
+#import <libavutil/mem.h>
+#import <libavutil/time.h>
+#import <libswscale/swscale.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MR_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MR_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+//交换每对字节：UV UV ... -> VU VU ...，pairs 为字节对数
+typedef void (*mr_swap_uv_func)(uint8_t *dst, const uint8_t *src, int pairs);
+//交织：dst = a0 b0 a1 b1 ...
+typedef void (*mr_interleave_func)(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n);
+//拆分：a = src0 src2 ...，b = src1 src3 ...，n 为字节对数
+typedef void (*mr_deinterleave_func)(uint8_t *a, uint8_t *b, const uint8_t *src, int n);
+
+typedef struct MRPixelKernelFuncs {
+    const char *name;
+    mr_swap_uv_func swap_uv;
+    mr_interleave_func interleave;
+    mr_deinterleave_func deinterleave;
+} MRPixelKernelFuncs;
+
+#pragma mark - C
+
+static void mr_swap_uv_c(uint8_t *dst, const uint8_t *src, int pairs)
+{
+    for (int i = 0; i < pairs; i++) {
+        const uint8_t u = src[2 * i];
+        dst[2 * i] = src[2 * i + 1];
+        dst[2 * i + 1] = u;
+    }
+}
+
+static void mr_interleave_c(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[2 * i] = a[i];
+        dst[2 * i + 1] = b[i];
+    }
+}
+
+static void mr_deinterleave_c(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    for (int i = 0; i < n; i++) {
+        a[i] = src[2 * i];
+        b[i] = src[2 * i + 1];
+    }
+}
+
+#pragma mark - SSE2/AVX2
+
+#if MR_HAVE_X86
+
+__attribute__((target("sse2")))
+static void mr_swap_uv_sse2(uint8_t *dst, const uint8_t *src, int pairs)
+{
+    const int bytes = pairs * 2;
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), x);
+    }
+    mr_swap_uv_c(dst + i, src + i, (bytes - i) / 2);
+}
+
+__attribute__((target("sse2")))
+static void mr_interleave_sse2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(va, vb));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(va, vb));
+    }
+    mr_interleave_c(dst + 2 * i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mr_deinterleave_sse2(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i x0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        const __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        const __m128i even = _mm_packus_epi16(_mm_and_si128(x0, mask), _mm_and_si128(x1, mask));
+        const __m128i odd  = _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8));
+        _mm_storeu_si128((__m128i *)(a + i), even);
+        _mm_storeu_si128((__m128i *)(b + i), odd);
+    }
+    mr_deinterleave_c(a + i, b + i, src + 2 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mr_swap_uv_avx2(uint8_t *dst, const uint8_t *src, int pairs)
+{
+    const int bytes = pairs * 2;
+    int i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        x = _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8));
+        _mm256_storeu_si256((__m256i *)(dst + i), x);
+    }
+    mr_swap_uv_sse2(dst + i, src + i, (bytes - i) / 2);
+}
+
+__attribute__((target("avx2")))
+static void mr_interleave_avx2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        //unpack 只在 128 位通道内交织，需要再把两个通道排回顺序
+        const __m256i lo = _mm256_unpacklo_epi8(va, vb);
+        const __m256i hi = _mm256_unpackhi_epi8(va, vb);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    mr_interleave_sse2(dst + 2 * i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mr_deinterleave_avx2(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i x0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        const __m256i x1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        //packus 同样按通道进行，结果是 x0lo x1lo x0hi x1hi，按 64 位重排为 x0lo x0hi x1lo x1hi
+        __m256i even = _mm256_packus_epi16(_mm256_and_si256(x0, mask), _mm256_and_si256(x1, mask));
+        __m256i odd  = _mm256_packus_epi16(_mm256_srli_epi16(x0, 8), _mm256_srli_epi16(x1, 8));
+        even = _mm256_permute4x64_epi64(even, 0xD8);
+        odd  = _mm256_permute4x64_epi64(odd, 0xD8);
+        _mm256_storeu_si256((__m256i *)(a + i), even);
+        _mm256_storeu_si256((__m256i *)(b + i), odd);
+    }
+    mr_deinterleave_sse2(a + i, b + i, src + 2 * i, n - i);
+}
+
+#endif
+
+#pragma mark - NEON
+
+#if MR_HAVE_NEON
+
+static void mr_swap_uv_neon(uint8_t *dst, const uint8_t *src, int pairs)
+{
+    const int bytes = pairs * 2;
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        vst1q_u8(dst + i, vrev16q_u8(vld1q_u8(src + i)));
+    }
+    mr_swap_uv_c(dst + i, src + i, (bytes - i) / 2);
+}
+
+static void mr_interleave_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8(a + i);
+        v.val[1] = vld1q_u8(b + i);
+        vst2q_u8(dst + 2 * i, v);
+    }
+    mr_interleave_c(dst + 2 * i, a + i, b + i, n - i);
+}
+
+static void mr_deinterleave_neon(uint8_t *a, uint8_t *b, const uint8_t *src, int n)
+{
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16x2_t v = vld2q_u8(src + 2 * i);
+        vst1q_u8(a + i, v.val[0]);
+        vst1q_u8(b + i, v.val[1]);
+    }
+    mr_deinterleave_c(a + i, b + i, src + 2 * i, n - i);
+}
+
+#endif
+
+#pragma mark - 运行时选择
+
+static const MRPixelKernelFuncs mr_kernels_c = {"C", mr_swap_uv_c, mr_interleave_c, mr_deinterleave_c};
+#if MR_HAVE_X86
+static const MRPixelKernelFuncs mr_kernels_sse2 = {"SSE2", mr_swap_uv_sse2, mr_interleave_sse2, mr_deinterleave_sse2};
+static const MRPixelKernelFuncs mr_kernels_avx2 = {"AVX2", mr_swap_uv_avx2, mr_interleave_avx2, mr_deinterleave_avx2};
+#endif
+#if MR_HAVE_NEON
+static const MRPixelKernelFuncs mr_kernels_neon = {"NEON", mr_swap_uv_neon, mr_interleave_neon, mr_deinterleave_neon};
+#endif
+
+//当前 CPU 能用的全部实现，从慢到快
+static int mr_available_kernels(const MRPixelKernelFuncs *list[4])
+{
+    int n = 0;
+    list[n++] = &mr_kernels_c;
+    const int flags = av_get_cpu_flags();
+#if MR_HAVE_X86
+    if (flags & AV_CPU_FLAG_SSE2) {
+        list[n++] = &mr_kernels_sse2;
+    }
+    if (flags & AV_CPU_FLAG_AVX2) {
+        list[n++] = &mr_kernels_avx2;
+    }
+#endif
+#if MR_HAVE_NEON
+    if (flags & AV_CPU_FLAG_NEON) {
+        list[n++] = &mr_kernels_neon;
+    }
+#endif
+    (void)flags;
+    return n;
+}
+
+static const MRPixelKernelFuncs * mr_best_kernels(void)
+{
+    static const MRPixelKernelFuncs *best = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        const MRPixelKernelFuncs *list[4];
+        int n = mr_available_kernels(list);
+        best = list[n - 1];
+    });
+    return best;
+}
+
+#pragma mark - 整帧转换
+
+static void mr_copy_plane(AVFrame *outF, AVFrame *inF, int plane, int bytewidth, int height)
+{
+    av_image_copy_plane(outF->data[plane], outF->linesize[plane], inF->data[plane], inF->linesize[plane], bytewidth, height);
+}
+
+static BOOL mr_convert_frame(const MRPixelKernelFuncs *k, AVFrame *inF, AVFrame *outF)
+{
+    const int w = inF->width;
+    const int h = inF->height;
+    const int cw = (w + 1) / 2;
+    const int ch = (h + 1) / 2;
+    const enum AVPixelFormat src = inF->format;
+    const enum AVPixelFormat dst = outF->format;
+
+    if ((src == AV_PIX_FMT_NV12 && dst == AV_PIX_FMT_NV21) || (src == AV_PIX_FMT_NV21 && dst == AV_PIX_FMT_NV12)) {
+        mr_copy_plane(outF, inF, 0, w, h);
+        for (int y = 0; y < ch; y++) {
+            k->swap_uv(outF->data[1] + y * outF->linesize[1], inF->data[1] + y * inF->linesize[1], cw);
+        }
+        return YES;
+    }
+
+    if (src == AV_PIX_FMT_YUV420P && (dst == AV_PIX_FMT_NV12 || dst == AV_PIX_FMT_NV21)) {
+        mr_copy_plane(outF, inF, 0, w, h);
+        //NV21 的色度是 VU 顺序
+        const int first = dst == AV_PIX_FMT_NV12 ? 1 : 2;
+        const int second = dst == AV_PIX_FMT_NV12 ? 2 : 1;
+        for (int y = 0; y < ch; y++) {
+            k->interleave(outF->data[1] + y * outF->linesize[1],
+                          inF->data[first] + y * inF->linesize[first],
+                          inF->data[second] + y * inF->linesize[second],
+                          cw);
+        }
+        return YES;
+    }
+
+    if (src == AV_PIX_FMT_UYVY422 || src == AV_PIX_FMT_YUYV422) {
+        //UYVY 的偶数字节是色度（U V 交替），奇数字节是亮度；YUYV 反过来
+        const BOOL chromaFirst = src == AV_PIX_FMT_UYVY422;
+        //宽是奇数时最后一个宏像素只有一个有效亮度，但 U、V 都在，单独取出来，和 swscale 一样
+        const int even = w & ~1;
+        const int yi = chromaFirst ? 1 : 0;
+        const int ui = chromaFirst ? 0 : 1;
+        const int vi = chromaFirst ? 2 : 3;
+        if (dst == AV_PIX_FMT_NV16) {
+            for (int y = 0; y < h; y++) {
+                uint8_t *luma = outF->data[0] + y * outF->linesize[0];
+                uint8_t *chroma = outF->data[1] + y * outF->linesize[1];
+                const uint8_t *s = inF->data[0] + y * inF->linesize[0];
+                if (chromaFirst) {
+                    k->deinterleave(chroma, luma, s, even);
+                } else {
+                    k->deinterleave(luma, chroma, s, even);
+                }
+                if (w & 1) {
+                    const uint8_t *m = s + 2 * even;
+                    luma[even] = m[yi];
+                    chroma[even] = m[ui];
+                    chroma[even + 1] = m[vi];
+                }
+            }
+            return YES;
+        } else if (dst == AV_PIX_FMT_YUV422P) {
+            //先拆出亮度和交替的色度，再把色度拆成 U、V
+            uint8_t *tmp = av_malloc(FFALIGN(2 * cw, 64));
+            if (!tmp) {
+                return NO;
+            }
+            for (int y = 0; y < h; y++) {
+                uint8_t *luma = outF->data[0] + y * outF->linesize[0];
+                const uint8_t *s = inF->data[0] + y * inF->linesize[0];
+                if (chromaFirst) {
+                    k->deinterleave(tmp, luma, s, even);
+                } else {
+                    k->deinterleave(luma, tmp, s, even);
+                }
+                if (w & 1) {
+                    const uint8_t *m = s + 2 * even;
+                    luma[even] = m[yi];
+                    tmp[even] = m[ui];
+                    tmp[even + 1] = m[vi];
+                }
+                k->deinterleave(outF->data[1] + y * outF->linesize[1], outF->data[2] + y * outF->linesize[2], tmp, cw);
+            }
+            av_free(tmp);
+            return YES;
+        }
+    }
+    return NO;
+}
+
+@implementation MRPixelKernels
+
++ (NSString *)activeISA
+{
+    return [NSString stringWithUTF8String:mr_best_kernels()->name];
+}
+
++ (BOOL)canConvertFrom:(int)src to:(int)dst
+{
+    switch (src) {
+        case AV_PIX_FMT_NV12:
+            return dst == AV_PIX_FMT_NV21;
+        case AV_PIX_FMT_NV21:
+            return dst == AV_PIX_FMT_NV12;
+        case AV_PIX_FMT_YUV420P:
+            return dst == AV_PIX_FMT_NV12 || dst == AV_PIX_FMT_NV21;
+        case AV_PIX_FMT_UYVY422:
+        case AV_PIX_FMT_YUYV422:
+            return dst == AV_PIX_FMT_NV16 || dst == AV_PIX_FMT_YUV422P;
+        default:
+            return NO;
+    }
+}
+
++ (BOOL)convertFrame:(AVFrame *)inF to:(AVFrame *)outF
+{
+    if (!inF || !outF || inF->width != outF->width || inF->height != outF->height) {
+        return NO;
+    }
+    return mr_convert_frame(mr_best_kernels(), inF, outF);
+}
+
++ (NSArray<NSString *> *)availableISAs
+{
+    const MRPixelKernelFuncs *kernels[4];
+    const int n = mr_available_kernels(kernels);
+    NSMutableArray *isas = [NSMutableArray arrayWithCapacity:n];
+    for (int k = 0; k < n; k++) {
+        [isas addObject:[NSString stringWithUTF8String:kernels[k]->name]];
+    }
+    return isas;
+}
+
++ (BOOL)convertFrame:(AVFrame *)inF to:(AVFrame *)outF isa:(NSString *)isa
+{
+    if (!inF || !outF || inF->width != outF->width || inF->height != outF->height) {
+        return NO;
+    }
+    const MRPixelKernelFuncs *kernels[4];
+    const int n = mr_available_kernels(kernels);
+    for (int k = 0; k < n; k++) {
+        if (strcmp(kernels[k]->name, [isa UTF8String]) == 0) {
+            return mr_convert_frame(kernels[k], inF, outF);
+        }
+    }
+    return NO;
+}
+
++ (void)swapUVPlane:(uint8_t *)dst
+        dstLinesize:(int)dstLinesize
+                src:(const uint8_t *)src
+        srcLinesize:(int)srcLinesize
+         widthBytes:(int)widthBytes
+             height:(int)height
+{
+    const mr_swap_uv_func swap_uv = mr_best_kernels()->swap_uv;
+    for (int y = 0; y < height; y++) {
+        swap_uv(dst + (ptrdiff_t)y * dstLinesize, src + (ptrdiff_t)y * srcLinesize, widthBytes / 2);
+    }
+}
+
+#pragma mark - 校验和性能测试
+
+static AVFrame * mr_alloc_frame(int format, int w, int h)
+{
+    AVFrame *frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = w;
+    frame->height = h;
+    if (av_frame_get_buffer(frame, 64) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+    return frame;
+}
+
+//逐行比较可见区域，对齐填充的字节不参与比较
+static BOOL mr_frame_equal(AVFrame *a, AVFrame *b)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+    int linesizes[4];
+    av_image_fill_linesizes(linesizes, a->format, a->width);
+    for (int p = 0; p < 4 && a->data[p]; p++) {
+        const int shift = (p == 1 || p == 2) ? desc->log2_chroma_h : 0;
+        const int rows = AV_CEIL_RSHIFT(a->height, shift);
+        for (int y = 0; y < rows; y++) {
+            if (memcmp(a->data[p] + y * a->linesize[p], b->data[p] + y * b->linesize[p], linesizes[p]) != 0) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
++ (NSString *)benchmarkWithWidth:(int)width
+                          height:(int)height
+                          frames:(int)frames
+{
+    const int pairs[][2] = {
+        {AV_PIX_FMT_NV21, AV_PIX_FMT_NV12},
+        {AV_PIX_FMT_NV12, AV_PIX_FMT_NV21},
+        {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12},
+        {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV21},
+        {AV_PIX_FMT_UYVY422, AV_PIX_FMT_NV16},
+        {AV_PIX_FMT_YUYV422, AV_PIX_FMT_NV16},
+        {AV_PIX_FMT_UYVY422, AV_PIX_FMT_YUV422P},
+        {AV_PIX_FMT_YUYV422, AV_PIX_FMT_YUV422P},
+    };
+    frames = MAX(frames, 1);
+    const MRPixelKernelFuncs *kernels[4];
+    const int kernel_count = mr_available_kernels(kernels);
+
+    NSMutableString *report = [NSMutableString stringWithFormat:@"pixel kernels %dx%d,%d frames,active:%s\n", width, height, frames, mr_best_kernels()->name];
+    for (int i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        const int src = pairs[i][0];
+        const int dst = pairs[i][1];
+        AVFrame *inF = mr_alloc_frame(src, width, height);
+        AVFrame *ref = mr_alloc_frame(dst, width, height);
+        AVFrame *outF = mr_alloc_frame(dst, width, height);
+        struct SwsContext *sws = sws_getContext(width, height, src, width, height, dst, SWS_POINT, NULL, NULL, NULL);
+        if (!inF || !ref || !outF || !sws) {
+            [report appendFormat:@"%s->%s: skipped\n", av_get_pix_fmt_name(src), av_get_pix_fmt_name(dst)];
+        } else {
+            //填充可重复的伪随机内容
+            uint32_t seed = 0x12345678;
+            for (int p = 0; p < AV_NUM_DATA_POINTERS && inF->buf[p]; p++) {
+                for (int b = 0; b < inF->buf[p]->size; b++) {
+                    seed = seed * 1664525 + 1013904223;
+                    inF->buf[p]->data[b] = seed >> 24;
+                }
+            }
+
+            int64_t begin = av_gettime_relative();
+            for (int f = 0; f < frames; f++) {
+                sws_scale(sws, (const uint8_t * const *)inF->data, inF->linesize, 0, height, ref->data, ref->linesize);
+            }
+            const double sws_ms = (av_gettime_relative() - begin) / 1000.0 / frames;
+            [report appendFormat:@"%s->%s: swscale %.3fms", av_get_pix_fmt_name(src), av_get_pix_fmt_name(dst), sws_ms];
+
+            for (int k = 0; k < kernel_count; k++) {
+                begin = av_gettime_relative();
+                for (int f = 0; f < frames; f++) {
+                    mr_convert_frame(kernels[k], inF, outF);
+                }
+                const double ms = (av_gettime_relative() - begin) / 1000.0 / frames;
+                const BOOL exact = mr_frame_equal(ref, outF);
+                [report appendFormat:@", %s %.3fms(%.1fx,%s)", kernels[k]->name, ms, sws_ms / ms, exact ? "bit-exact" : "MISMATCH"];
+            }
+            [report appendString:@"\n"];
+        }
+        sws_freeContext(sws);
+        av_frame_free(&inF);
+        av_frame_free(&ref);
+        av_frame_free(&outF);
+    }
+    av_log(NULL, AV_LOG_INFO, "%s", [report UTF8String]);
+    return report;
+}
+
+@end
@@ -0,0 +1,277 @@
+//
+//  FFPlayerPCMRingHeader.h
+//  FFmpegTutorial
+//
+//  Created by Matt Reach on 2026/10/18.
+//
+// 解码后的 PCM 环形缓冲区，单生产者单消费者，无锁
+// 音频解码线程重采样后写入，音频渲染回调读出；读的一方不加锁、不分配内存、不打日志，也不会被写的一方阻塞。
+// 交错格式只用 1 个平面，平面格式每个声道一个平面；读写位置是按平面计算的累计字节数，只增不减。
+// 容量是整数个采样点，交错的多声道采样点不会跨越缓冲区末尾。
+// 每次写入的一段数据（一个音频帧）记录起始位置、pts 和播放速率，读的一方据此算出正在播放的采样的时间。
+// 写的一方可以标记已写入的数据不再播放（比如中途关掉音频），由读的一方在下次读时跳过，不需要加锁清空。
+
+#ifndef FFPlayerPCMRingHeader_h
+#define FFPlayerPCMRingHeader_h
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#import <libavutil/mem.h>
+#import <libavutil/common.h>
+#import "FFPlayerHeader.h"
+
+#define PCM_RING_MAX_PLANES 8
+//最多记录多少段 pts，必须是 2 的幂
+#define PCM_RING_MAX_CHUNKS 64
+
+//一段数据的元信息
+typedef struct PCMChunk {
+    uint64_t pos;   //起始位置
+    double pts;     //第一个采样的 pts，单位s，没有 pts 时为 NAN
+    double speed;   //变速后的数据里，播放 1s 对应的媒体时长
+} PCMChunk;
+
+typedef struct PCMRing {
+    uint8_t *data[PCM_RING_MAX_PLANES];
+    int planes;
+    uint32_t capacity; //每个平面的字节数，采样点数为 2 的幂
+    //每个平面一个采样点的字节数
+    int frame_bytes;
+    //每秒的字节数（按平面），用于把位置换算成时间
+    double bytes_per_sec;
+    PCMChunk chunks[PCM_RING_MAX_CHUNKS];
+    //写的一方修改
+    _Atomic uint64_t write_pos;
+    _Atomic uint64_t chunk_windex;
+    //这个位置之前的数据不再播放，读的一方读到时直接跳过
+    _Atomic uint64_t discard_pos;
+    //读的一方修改
+    _Atomic uint64_t read_pos;
+    _Atomic uint64_t chunk_rindex;
+    //标记为停止，写的一方不再等待
+    _Atomic int abort_request;
+} PCMRing;
+
+///初始化，nb_samples 会向上取整到 2 的幂；return 0 没有错误
+static __inline__ int pcm_ring_init(PCMRing *r, int planes, int frame_bytes, int sample_rate, uint32_t nb_samples)
+{
+    memset((void*)r, 0, sizeof(PCMRing));
+    if (planes <= 0 || planes > PCM_RING_MAX_PLANES || frame_bytes <= 0 || sample_rate <= 0 || nb_samples == 0) {
+        return AVERROR(EINVAL);
+    }
+    uint32_t samples = 1;
+    while (samples < nb_samples) {
+        samples <<= 1;
+    }
+    const uint32_t cap = samples * frame_bytes;
+    for (int p = 0; p < planes; p++) {
+        if (!(r->data[p] = av_mallocz(cap))) {
+            for (int i = 0; i < p; i++) {
+                av_freep(&r->data[i]);
+            }
+            return AVERROR(ENOMEM);
+        }
+    }
+    r->planes = planes;
+    r->capacity = cap;
+    r->frame_bytes = frame_bytes;
+    r->bytes_per_sec = (double)frame_bytes * sample_rate;
+    atomic_init(&r->write_pos, 0);
+    atomic_init(&r->chunk_windex, 0);
+    atomic_init(&r->discard_pos, 0);
+    atomic_init(&r->read_pos, 0);
+    atomic_init(&r->chunk_rindex, 0);
+    atomic_init(&r->abort_request, 0);
+    return 0;
+}
+
+static __inline__ void pcm_ring_destroy(PCMRing *r)
+{
+    for (int p = 0; p < PCM_RING_MAX_PLANES; p++) {
+        av_freep(&r->data[p]);
+    }
+    r->planes = 0;
+}
+
+static __inline__ void pcm_ring_abort(PCMRing *r)
+{
+    atomic_store_explicit(&r->abort_request, 1, memory_order_release);
+}
+
+///取消停止标记，写的一方可以继续写入
+static __inline__ void pcm_ring_resume(PCMRing *r)
+{
+    atomic_store_explicit(&r->abort_request, 0, memory_order_release);
+}
+
+///[写的一方]已经写入的数据都不再播放，读的一方下次读时丢掉；缓存是读的一方在用，不能直接清空
+static __inline__ void pcm_ring_discard_written(PCMRing *r)
+{
+    const uint64_t w = atomic_load_explicit(&r->write_pos, memory_order_relaxed);
+    atomic_store_explicit(&r->discard_pos, w, memory_order_release);
+}
+
+///可读字节数（按平面）
+static __inline__ uint32_t pcm_ring_readable(PCMRing *r)
+{
+    const uint64_t w = atomic_load_explicit(&r->write_pos, memory_order_acquire);
+    const uint64_t rd = atomic_load_explicit(&r->read_pos, memory_order_relaxed);
+    const uint64_t d = atomic_load_explicit(&r->discard_pos, memory_order_acquire);
+    return (uint32_t)(w - FFMAX(rd, d));
+}
+
+///缓存的段数
+static __inline__ int pcm_ring_nb_chunks(PCMRing *r)
+{
+    const uint64_t w = atomic_load_explicit(&r->chunk_windex, memory_order_acquire);
+    const uint64_t rd = atomic_load_explicit(&r->chunk_rindex, memory_order_acquire);
+    return (int)(w - rd);
+}
+
+//拷贝到环形缓冲区，跨越末尾时拆成两段
+static __inline__ void pcm_ring_copy_in(PCMRing *r, int p, uint64_t pos, const uint8_t *src, uint32_t size)
+{
+    const uint32_t off = (uint32_t)(pos % r->capacity);
+    const uint32_t first = FFMIN(size, r->capacity - off);
+    memcpy(r->data[p] + off, src, first);
+    if (size > first) {
+        memcpy(r->data[p], src + first, size - first);
+    }
+}
+
+
+static __inline__ int pcm_ring_write_chunk(PCMRing *r, uint8_t * const *src, uint32_t size, double pts, double speed)
+{
+    const uint64_t w = atomic_load_explicit(&r->write_pos, memory_order_relaxed);
+    const uint64_t cw = atomic_load_explicit(&r->chunk_windex, memory_order_relaxed);
+    //空间不足或者段数满了就等渲染回调读走，只有写的一方会等待
+    while (w + size - atomic_load_explicit(&r->read_pos, memory_order_acquire) > r->capacity ||
+           cw - atomic_load_explicit(&r->chunk_rindex, memory_order_acquire) >= PCM_RING_MAX_CHUNKS) {
+        if (atomic_load_explicit(&r->abort_request, memory_order_acquire)) {
+            return -1;
+        }
+        mr_msleep(5);
+    }
+    for (int p = 0; p < r->planes; p++) {
+        pcm_ring_copy_in(r, p, w, src[p], size);
+    }
+    PCMChunk *c = &r->chunks[cw & (PCM_RING_MAX_CHUNKS - 1)];
+    c->pos = w;
+    c->pts = pts;
+    c->speed = speed;
+    //先发布段信息再发布数据，读的一方看到数据时一定能看到对应的段
+    atomic_store_explicit(&r->chunk_windex, cw + 1, memory_order_release);
+    atomic_store_explicit(&r->write_pos, w + size, memory_order_release);
+    return 0;
+}
+
+///[写的一方，阻塞等待]写入 nb_samples 个采样，src 是每个平面的首地址，speed 为这段数据的播放速率；停止时返回 -1
+static __inline__ int pcm_ring_write(PCMRing *r, uint8_t * const *src, int nb_samples, double pts, double speed)
+{
+    if (r->planes == 0) {
+        return AVERROR(EINVAL);
+    }
+    const uint8_t *from[PCM_RING_MAX_PLANES];
+    for (int p = 0; p < r->planes; p++) {
+        from[p] = src[p];
+    }
+    //比半个缓冲区大的帧拆开写，不然可能永远等不到足够的空间
+    const uint32_t max_chunk = (r->capacity / 2) / r->frame_bytes * r->frame_bytes;
+    uint32_t left = (uint32_t)nb_samples * r->frame_bytes;
+    while (left > 0) {
+        const uint32_t size = FFMIN(left, max_chunk);
+        if (pcm_ring_write_chunk(r, (uint8_t * const *)from, size, pts, speed) < 0) {
+            return -1;
+        }
+        for (int p = 0; p < r->planes; p++) {
+            from[p] += size;
+        }
+        left -= size;
+        if (!isnan(pts)) {
+            pts += size / r->bytes_per_sec * speed;
+        }
+    }
+    return 0;
+}
+
+///[读的一方，不阻塞]peek 出来的数据用完后，把读位置后移 size 个字节
+static __inline__ void pcm_ring_consume(PCMRing *r, uint32_t size)
+{
+    const uint64_t rd = atomic_load_explicit(&r->read_pos, memory_order_relaxed) + size;
+    //丢掉已经完全读完的段，保留当前正在读的段
+    uint64_t cr = atomic_load_explicit(&r->chunk_rindex, memory_order_relaxed);
+    const uint64_t cw = atomic_load_explicit(&r->chunk_windex, memory_order_acquire);
+    while (cw - cr > 1 && r->chunks[(cr + 1) & (PCM_RING_MAX_CHUNKS - 1)].pos <= rd) {
+        cr++;
+    }
+    atomic_store_explicit(&r->chunk_rindex, cr, memory_order_release);
+    atomic_store_explicit(&r->read_pos, rd, memory_order_release);
+}
+
+///[读的一方，不阻塞]不拷贝，取出从读位置开始的连续数据，不会跨越缓冲区末尾；src 填入每个平面的地址，返回字节数（按平面，最多 size）
+static __inline__ uint32_t pcm_ring_peek(PCMRing *r, uint8_t **src, uint32_t size)
+{
+    uint64_t rd = atomic_load_explicit(&r->read_pos, memory_order_relaxed);
+    //先跳过不再播放的数据
+    const uint64_t d = atomic_load_explicit(&r->discard_pos, memory_order_acquire);
+    if (rd < d) {
+        pcm_ring_consume(r, (uint32_t)(d - rd));
+        rd = d;
+    }
+    const uint64_t w = atomic_load_explicit(&r->write_pos, memory_order_acquire);
+    if (w == rd) {
+        return 0;
+    }
+    const uint32_t off = (uint32_t)(rd % r->capacity);
+    const uint32_t n = (uint32_t)FFMIN(FFMIN((uint64_t)size, w - rd), (uint64_t)(r->capacity - off));
+    for (int p = 0; p < r->planes; p++) {
+        src[p] = r->data[p] + off;
+    }
+    return n;
+}
+
+///[读的一方，不阻塞]每个平面最多读出 size 个字节，dst 为 NULL 的平面跳过；返回读出的字节数
+static __inline__ uint32_t pcm_ring_read(PCMRing *r, uint8_t * const *dst, int nb_dst, uint32_t size)
+{
+    uint32_t filled = 0;
+    uint8_t *src[PCM_RING_MAX_PLANES];
+    //跨越缓冲区末尾时分两次
+    while (filled < size) {
+        const uint32_t n = pcm_ring_peek(r, src, size - filled);
+        if (n == 0) {
+            break;
+        }
+        const int planes = FFMIN(nb_dst, r->planes);
+        for (int p = 0; p < planes; p++) {
+            if (dst[p]) {
+                memcpy(dst[p] + filled, src[p], n);
+            }
+        }
+        pcm_ring_consume(r, n);
+        filled += n;
+    }
+    return filled;
+}
+
+///[读的一方]已读出的最后一个采样之后的时间，没有 pts 时返回 NAN；speed 不为 NULL 时填入这段数据的播放速率
+static __inline__ double pcm_ring_read_clock(PCMRing *r, double *speed)
+{
+    const uint64_t rd = atomic_load_explicit(&r->read_pos, memory_order_relaxed);
+    const uint64_t cr = atomic_load_explicit(&r->chunk_rindex, memory_order_relaxed);
+    const uint64_t cw = atomic_load_explicit(&r->chunk_windex, memory_order_acquire);
+    if (cw == cr || r->bytes_per_sec <= 0) {
+        return NAN;
+    }
+    const PCMChunk *c = &r->chunks[cr & (PCM_RING_MAX_CHUNKS - 1)];
+    if (isnan(c->pts)) {
+        return NAN;
+    }
+    if (speed) {
+        *speed = c->speed;
+    }
+    return c->pts + (double)(rd - c->pos) / r->bytes_per_sec * c->speed;
+}
+
+#endif /* FFPlayerPCMRingHeader_h */
@@ -15,6 +15,8 @@ typedef enum : NSUInteger {
     FFPlayerErrorCode_StreamOpenFailed,     //音视频流打开失败
     FFPlayerErrorCode_RescaleFrameFailed,   //视频帧重转失败
     FFPlayerErrorCode_ResampleFrameFailed,  //音频帧格式重采样失败
+    FFPlayerErrorCode_IOTimeout,            //打开或读包超时
+    FFPlayerErrorCode_WriteFileFailed,      //输出文件写入失败
 } FFPlayerErrorCode;
 
 typedef enum : NSUInteger {
@@ -121,6 +123,27 @@ static inline bool MR_Sample_Fmt_Is_S16X(MRSampleFormat fmt){
     }
 }
 
+//按声道数区分的声道布局，第 n 位表示支持 n 个声道；声道顺序和 FFmpeg 的默认布局一致，比如 5.1 为 FL FR FC LFE BL BR
+#define MR_CH_LAYOUT_MAX_CHANNELS 8
+
+typedef NS_OPTIONS(NSUInteger, MRChannelLayoutMask) {
+    MR_CH_LAYOUT_MASK_NONE    = 0,
+    MR_CH_LAYOUT_MASK_MONO    = 1 << 1,
+    MR_CH_LAYOUT_MASK_STEREO  = 1 << 2,
+    MR_CH_LAYOUT_MASK_QUAD    = 1 << 4,
+    MR_CH_LAYOUT_MASK_5POINT1 = 1 << 6,
+    MR_CH_LAYOUT_MASK_7POINT1 = 1 << 8,
+    MR_CH_LAYOUT_MASK_AUTO    = 0x1FE// 1~8 个声道都支持，即使用音频的声道数
+};
+
+static inline bool MR_Channel_Layout_Mask_Has(MRChannelLayoutMask mask, int channels){
+    if (channels > 0 && channels <= MR_CH_LAYOUT_MAX_CHANNELS && (mask & (1 << channels))) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
 static inline void MR_sync_main_queue(dispatch_block_t block){
     assert(block);
     if (strcmp(dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL), dispatch_queue_get_label(dispatch_get_main_queue())) == 0) {